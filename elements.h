@@ -6,11 +6,13 @@
 #define ELEMENTS_H
 
 #include <stddef.h>
+#include <stdint.h>
 #include <limits.h>
 
 /* == Оперируемые единицы информации == */
 /* базовые единицы */
 typedef unsigned int word;  // unsigned выбран для битовых сдвигов - заполняется нулями
+typedef uint64_t qword;     // 64-разрядное слово, применяется для адресов
 typedef unsigned char byte; // задание байта, он должен быть не более слова
 typedef unsigned char bit;  // бит хранится в младшем разряде, остальные - игнорируются
 typedef int endian_types;   // порядок хранения и представления
@@ -18,6 +20,7 @@ typedef int number_base;    // база единицы
 
 /* наибольшие значения слова, байта, бита, тетрады */
 #define WORD_MAX  UINT_MAX
+#define QWORD_MAX UINT64_MAX
 #define BYTE_MAX  UCHAR_MAX
 #define BIT_MAX   1
 #define TETRA_MAX 0xF
@@ -28,10 +31,17 @@ typedef int number_base;    // база единицы
 #define WORD_SIZE_IN_BITS   (CHAR_BIT * sizeof(word))
 #define BYTE_SIZE_IN_TETRAS (BYTE_SIZE_IN_BITS / TETRA_SIZE_IN_BITS + (BYTE_SIZE_IN_BITS % TETRA_SIZE_IN_BITS != 0 ? 1 : 0))
 #define WORD_SIZE_IN_BYTES  (WORD_SIZE_IN_BITS / BYTE_SIZE_IN_BITS)
+#define QWORD_SIZE_IN_BYTES (sizeof(qword))
 
-/* порядок хранения и представления */
-enum endian_types_v {LITTLE_ENDIAN=0, BIG_ENDIAN=1};
-#define WORD_ENDIAN LITTLE_ENDIAN	// тип по умолчанию в словах
+/* порядок хранения и представления.
+ENDIAN_LITTLE и ENDIAN_BIG - те же значения под именами, не совпадающими с макросами LITTLE_ENDIAN
+и BIG_ENDIAN из <endian.h> (видны при _GNU_SOURCE и _DEFAULT_SOURCE, в том числе всегда в g++):
+такие единицы трансляции подключают elements.h без этих макросов, как hexprn.hpp. */
+#if defined(LITTLE_ENDIAN) || defined(BIG_ENDIAN)
+#error "elements.h: LITTLE_ENDIAN/BIG_ENDIAN from <endian.h> are defined: compile without _GNU_SOURCE/_DEFAULT_SOURCE (-std=c99) or #undef them before including, as hexprn.hpp does"
+#endif
+enum endian_types_v {LITTLE_ENDIAN=0, BIG_ENDIAN=1, ENDIAN_LITTLE=LITTLE_ENDIAN, ENDIAN_BIG=BIG_ENDIAN};
+#define WORD_ENDIAN ENDIAN_LITTLE	// тип по умолчанию в словах
 
 /* операции с битами */
 #define BIT_SET   1
@@ -143,4 +153,167 @@ int word_trans(const word w, char *s, const struct trans_mode tm);
 /* преобразует слово w в массив шестнадцатеричных цифр без пробелов в порядке BIG_ENDIAN */
 int word_hex(const word w, char *s);
 
+/* преобразует младшие digits шестнадцатеричных цифр 64-разрядного слова w
+в массив цифр без пробелов в порядке BIG_ENDIAN, digits не более 16 */
+int qword_hex(const qword w, char *s, size_t digits);
+
+/* --- Векторное ядро преобразования массива байт в шестнадцатеричные цифры --- */
+
+/* уровни векторных расширений процессора, по которым выбирается ядро */
+enum simd_level_v {SIMD_SCALAR = 0, SIMD_SSE2 = 1, SIMD_SSSE3 = 2, SIMD_AVX2 = 3};
+
+/* преобразует массив байт в непрерывную последовательность шестнадцатеричных цифр */
+int bytes_hex(const byte *bm, char *s, size_t count, const endian_types endian_type);
+/* 
+Преобразует массив байт в последовательность шестнадцатеричных цифр без разделителей 
+и записывает её в строку s. Конечный ноль не ставится. Один байт - две цифры.
+Результат совпадает с последовательным вызовом byte_hex() для каждого байта.
+За одну инструкцию обрабатывается 16 (SSE2, SSSE3) или 32 (AVX2) байта,
+ядро выбирается один раз по cpuid при первом вызове.
+Параметры:
+	bm  -  массив байт
+	s   -  строка символов для записи, не менее count * BYTE_SIZE_IN_TETRAS символов
+	count - количество байт для преобразования, не более INT_MAX / BYTE_SIZE_IN_TETRAS
+	endian_type  -  порядок вывода тетрад в байте (младшая тетрада идет первой или последней)
+Возврат:
+	>= 0	число записанных символов
+	 < 0	ошибка
+*/
+
+/* преобразует массив байт в непрерывную последовательность двоичных цифр */
+int bytes_bin(const byte *bm, char *s, size_t count, const endian_types endian_type);
+/* 
+Преобразует массив байт в последовательность двоичных цифр без разделителей 
+и записывает её в строку s. Конечный ноль не ставится. Один байт - восемь цифр.
+Результат совпадает с последовательным вызовом byte_bin() для каждого байта.
+За проход векторного ядра 16 байт разворачиваются в 128 цифр, скалярное ядро
+получает восемь цифр байта одним умножением и маской. Ядро выбирается так же, как у bytes_hex().
+Параметры:
+	bm  -  массив байт
+	s   -  строка символов для записи, не менее count * BYTE_SIZE_IN_BITS символов
+	count - количество байт для преобразования, не более INT_MAX / BYTE_SIZE_IN_BITS
+	endian_type  -  порядок вывода разрядов в байте (младший разряд идет первым или последним)
+Возврат:
+	>= 0	число записанных символов
+	 < 0	ошибка
+*/
+
+/* преобразует непрерывную последовательность двоичных цифр в массив байт */
+int bin_bytes(const char *s, byte *bm, size_t count);
+/* 
+Преобразует последовательность из count * 8 двоичных цифр без разделителей
+в порядке BIG_ENDIAN (старший разряд идет первым) в массив из count байт.
+Восемь цифр проверяются и собираются в байт одним словом.
+Возврат аналогичен hex_bytes().
+*/
+
+/* --- Векторное ядро обратного преобразования шестнадцатеричных цифр в массив байт --- */
+
+/* возвращает значение шестнадцатеричной цифры c (0-9, A-F, a-f) или -1, если c не цифра */
+int hex_tetra(char c);
+
+/* преобразует непрерывную последовательность шестнадцатеричных цифр в массив байт */
+int hex_bytes(const char *s, byte *bm, size_t count);
+/* 
+Преобразует последовательность из count * 2 шестнадцатеричных цифр без разделителей
+в порядке BIG_ENDIAN (старшая тетрада идет первой) в массив из count байт.
+Допускаются цифры в верхнем и нижнем регистре. За одну инструкцию проверяется и 
+преобразуется 32 (SSE2, SSSE3) или 64 (AVX2) цифры, ядро выбирается так же, как у bytes_hex().
+Параметры:
+	s   -  строка шестнадцатеричных цифр, не менее count * BYTE_SIZE_IN_TETRAS символов
+	bm  -  массив байт для записи, не менее count байт
+	count - количество байт, не более INT_MAX
+Возврат:
+	== count  все цифры верны
+	 < count  номер первого байта, цифры которого неверны; предыдущие байты записаны
+	 < 0	ошибка аргументов
+*/
+
+/* --- Векторное сравнение массивов байт --- */
+
+/* возвращает номер первого различающегося байта массивов a и b длиной count */
+size_t bytes_mismatch(const byte *a, const byte *b, size_t count);
+/* 
+Сравнивает массивы байт a и b по 16 (SSE2, SSSE3) или 32 (AVX2) байта за инструкцию.
+Возврат:
+	< count  номер первого различающегося байта
+	== count массивы совпадают или ошибка аргументов (a или b равен NULL)
+*/
+
+/* --- Векторная перестановка байт в словах --- */
+
+/* переставляет байты каждого слова из word_bytes байт в обратном порядке */
+int bytes_swap(const byte *bm, byte *out, size_t count, size_t word_bytes);
+/* 
+Переставляет байты массива bm в каждом слове из word_bytes байт в обратном порядке
+и записывает их в out: слова LITTLE_ENDIAN получают порядок BIG_ENDIAN и наоборот.
+Заменяет split_word() и form_word() для массива слов: SSSE3 и AVX2 переставляют 16 или 32 байта
+одной инструкцией pshufb, SSE2 - сдвигами и перестановкой полуслов.
+Параметры:
+	bm  -  массив байт
+	out -  массив для записи, может совпадать с bm (но не перекрываться частично)
+	count - количество байт, кратно word_bytes
+	word_bytes - число байт в слове: 1, 2, 4 или 8
+Возврат:
+	>= 0	число переставленных байт
+	 < 0	ошибка
+*/
+
+/* --- Векторная классификация печатаемых символов --- */
+
+/* копирует печатаемые ascii символы массива байт, остальные заменяет символом subst */
+int bytes_print(const byte *bm, char *s, size_t count, char subst);
+/* 
+Классифицирует байты массива bm: печатаемые ascii символы 0x20..0x7E записываются в s как есть,
+управляющие символы, 0x7F и байты больше 0x7F заменяются символом subst. Классификация выполняется
+сравнением диапазона по 16 (SSE2, SSSE3) или 32 (AVX2) байта за проход без ветвлений по байтам.
+Параметры:
+	bm  -  массив байт
+	s   -  строка для записи count символов, без завершающего нуля
+	count - количество байт
+	subst - символ замены непечатаемых байт
+Возврат:
+	>= 0	число замененных байт, 0 - все байты печатаемые
+	 < 0	ошибка
+*/
+
+/* --- Векторный поиск образца --- */
+
+/* возвращает смещение первого вхождения образца needle длиной length в массив hay длиной count */
+size_t bytes_find(const byte *hay, size_t count, const byte *needle, size_t length);
+/* 
+Ищет образец в массиве байт: первый и последний байт образца сравниваются сразу с 16 (SSE2, SSSE3)
+или 32 (AVX2) возможными началами, остальные байты образца проверяются только у начал, где совпали оба.
+Образец из одного байта ищется memchr().
+Возврат:
+	< count  смещение первого вхождения
+	== count образец не найден или ошибка аргументов (NULL, length == 0 или length > count)
+*/
+
+/* наибольшее число байт набора bytes_find_any() */
+#define BYTES_SET_MAX 8
+
+/* возвращает смещение первого байта массива hay, равного одному из set_count байт набора set */
+size_t bytes_find_any(const byte *hay, size_t count, const byte *set, size_t set_count);
+/* 
+Каждый байт набора сравнивается сразу с 16 (SSE2, SSSE3) или 32 (AVX2) байтами массива,
+результаты сравнений объединяются. Применяется для пропуска байт, с которых не начинается ни один
+из нескольких образцов. Набор из одного байта ищется memchr().
+Возврат:
+	< count  смещение найденного байта
+	== count байт не найден или ошибка аргументов (NULL, set_count == 0 или больше BYTES_SET_MAX)
+*/
+
+/* возвращает уровень векторных расширений, используемый ядром */
+int simd_level(void);
+
+/* Принудительно задает уровень векторных расширений, не выше доступного процессору.
+Возвращает установленный уровень. Применяется для сравнения ядер и проверок и не предназначена
+для вызова во время преобразований в других потоках: гонки данных нет, но части одного
+преобразования могут выполниться ядрами разных уровней. */
+int simd_set_level(int level);
+
+/* возвращает название уровня векторных расширений */
+const char *simd_level_name(int level);
+
 #endif //ELEMENTS_H
\ No newline at end of file
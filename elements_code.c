@@ -3,8 +3,16 @@
 	Оперирование с единицами информации
 */
 #include <stdlib.h>
+#include <string.h>
 #include "elements.h"
 
+/* векторные расширения доступны при сборке GCC/Clang для x86 и x86-64 */
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#define ELEMENTS_SIMD_X86 1
+#include <cpuid.h>
+#include <immintrin.h>
+#endif
+
 /* == Оперируемые единицы информации == */
 
 /* -- константы -- */
@@ -241,6 +249,31 @@ inline char tetra_hex(byte tetra)
 	return tetra_char[tetra & 0xF];
 }
 
+/* Значения шестнадцатеричных цифр, увеличенные на единицу, для всех символов:
+ноль означает, что символ не является цифрой */
+static const byte tetra_code[BYTE_MAX + 1] = {
+	['0'] = 0x1, ['1'] = 0x2, ['2'] = 0x3, ['3'] = 0x4, ['4'] = 0x5, 
+	['5'] = 0x6, ['6'] = 0x7, ['7'] = 0x8, ['8'] = 0x9, ['9'] = 0xA,
+	['A'] = 0xB, ['B'] = 0xC, ['C'] = 0xD, ['D'] = 0xE, ['E'] = 0xF, ['F'] = 0x10,
+	['a'] = 0xB, ['b'] = 0xC, ['c'] = 0xD, ['d'] = 0xE, ['e'] = 0xF, ['f'] = 0x10 };
+
+/* возвращает значение шестнадцатеричной цифры c или -1, если c не цифра */
+int hex_tetra(char c)
+{
+	return (int) tetra_code[(byte) c] - 1;
+}
+
+/* Пары шестнадцатеричных цифр для всех значений байта.
+Для байта b пара цифр находится по смещению b * 2:
+	hex_pairs_be - старшая тетрада идет первой (BIG_ENDIAN)
+	hex_pairs_le - младшая тетрада идет первой (LITTLE_ENDIAN) */
+#define HEX_ROW_BE(h) h"0" h"1" h"2" h"3" h"4" h"5" h"6" h"7" h"8" h"9" h"A" h"B" h"C" h"D" h"E" h"F"
+#define HEX_ROW_LE(h) "0"h "1"h "2"h "3"h "4"h "5"h "6"h "7"h "8"h "9"h "A"h "B"h "C"h "D"h "E"h "F"h
+#define HEX_TABLE(ROW) ROW("0") ROW("1") ROW("2") ROW("3") ROW("4") ROW("5") ROW("6") ROW("7") \
+	ROW("8") ROW("9") ROW("A") ROW("B") ROW("C") ROW("D") ROW("E") ROW("F")
+static const char hex_pairs_be[] = HEX_TABLE(HEX_ROW_BE);
+static const char hex_pairs_le[] = HEX_TABLE(HEX_ROW_LE);
+
 /* преобразует байт в последовательность шестнадцатеричных цифр и записывает символы в строку s */
 int byte_hex(const byte b, char *s, const endian_types endian_type)
 /* 
@@ -258,35 +291,33 @@ int byte_hex(const byte b, char *s, const endian_types endian_type)
 	if (s == NULL)
 		return -1;
 
-	/* тетрады проходятся с нулевой тетрады,
-	в массив записывается либо с нулевого элемента, либо с последнего */ 
-
-	/* локальные переменные */
-	int char_counter = 0;  // число записанных символов
-	size_t j = 0;	// счетчик номера тетрады
-	int i;          // счетчик массива s
-	int delta;      // прирост счетчика массива s
+	/* пара цифр берется из таблицы целиком */
+	const char *pair = (endian_type == LITTLE_ENDIAN ? hex_pairs_le : hex_pairs_be) + b * BYTE_SIZE_IN_TETRAS;
+	s[0] = pair[0];
+	s[1] = pair[1];
 
-	/* определение элементов у массива */
-	if (endian_type == LITTLE_ENDIAN)
-	{
-		i = 0;
-		delta = 1;
-	}
-	else
-	{
-		i = ((int) BYTE_SIZE_IN_TETRAS) - 1;
-		delta = -1;
-	}
+	return BYTE_SIZE_IN_TETRAS;
+}
 
-	/* цикл преобразования */
-	for (; j < BYTE_SIZE_IN_TETRAS; j++, i+= delta)
-	{
-		s[i] = tetra_hex(get_tetrab(b, j));
-		char_counter++;
-	}
+/* Маски разрядов для восьми двоичных цифр байта в порядке символов строки:
+в байте слова с номером i (по адресу s + i) остается разряд, цифра которого стоит на i-м месте.
+На машине с обратным порядком байт в слове маски переставляются. */
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+#define BIN_BITS_LE UINT64_C(0x0102040810204080)  // младший разряд первым
+#define BIN_BITS_BE UINT64_C(0x8040201008040201)  // старший разряд первым
+#else
+#define BIN_BITS_LE UINT64_C(0x8040201008040201)
+#define BIN_BITS_BE UINT64_C(0x0102040810204080)
+#endif
+#define BIN_ONES    UINT64_C(0x0101010101010101)
 
-	return char_counter;
+/* Восемь двоичных цифр байта b одним словом для записи memcpy():
+байт размножается умножением, каждая копия маскируется своим разрядом,
+ненулевые копии сложением с 0x7F переводятся в единицу старшего разряда и сдвигаются к цифре */
+static inline uint64_t bin_digits8(const byte b, const endian_types endian_type)
+{
+	uint64_t x = ((uint64_t) b * BIN_ONES) & (endian_type == LITTLE_ENDIAN ? BIN_BITS_LE : BIN_BITS_BE);
+	return (((x + BIN_ONES * 0x7F) >> 7) & BIN_ONES) | (BIN_ONES * '0');
 }
 
 /* преобразует байт в последовательность двоичных цифр и записывает символы в строку s */
@@ -306,32 +337,11 @@ int byte_bin(const byte b, char *s, const endian_types endian_type)
 	if (s == NULL)
 		return -1;
 
-	/* локальные переменные */
-	int char_counter = 0;   // число записанных символов
-	size_t j = 0;		    // счетчик бита
-	int i;                  // счетчик массива s
-	int delta;              // прирост счетчика массива s
-
-	/* определение порядка записи в массив s */
-	if (endian_type == LITTLE_ENDIAN)
-	{
-		i = 0;
-		delta = 1;
-	}
-	else
-	{
-		i = ((int) BYTE_SIZE_IN_BITS) - 1;
-		delta = -1;
-	}
-
-	/* цикл преобразования */
-	for (; j < BYTE_SIZE_IN_BITS; j++, i+= delta)
-	{
-		s[i] = ((b>>j) & 0x01) == 0 ? '0' : '1';
-		char_counter++;
-	}
+	/* восемь цифр получаются сразу одним словом */
+	uint64_t digits = bin_digits8(b, endian_type);
+	memcpy(s, &digits, BYTE_SIZE_IN_BITS);
 
-	return char_counter;
+	return BYTE_SIZE_IN_BITS;
 }
 
 /* преобразует байт в последовательность двоичных или шестнадцатеричных цифр и записывает символы в строку s */
@@ -340,7 +350,10 @@ int byte_base(const byte b, char *s, const endian_types endian_type, const numbe
 	return base == BASE_HEX ? byte_hex(b, s, endian_type) : byte_bin(b, s, endian_type);
 }
 
-/* преобразует массив байт в массив двоичных или шестнадцатеричных цифр */
+/* число байт, преобразуемых ядром за один проход в byte_trans() */
+#define TRANS_CHUNK 64
+
+/* преобразует массив байт в массив цифр с разделителями групп */
 int byte_trans(const byte *bm, char *s, size_t count, const struct trans_mode tm)
 /* 
 Преобразует массив байт в последовательность цифр и записывает её в строку s.
@@ -352,6 +365,8 @@ int byte_trans(const byte *bm, char *s, size_t count, const struct trans_mode tm
 Возврат:
 	>= 0	число записанных символов
 	 < 0	ошибка
+Преобразование идет участками между разделителями групп векторным ядром bytes_hex() или bytes_bin().
+Байты в обратном порядке (seq_endian == LITTLE_ENDIAN) предварительно переставляются в локальный буфер.
 */
 {
 	/* первичная обработка аргументов */
@@ -359,62 +374,48 @@ int byte_trans(const byte *bm, char *s, size_t count, const struct trans_mode tm
 		return -1;
 	if (count == 0)
 		return 0;
-	
-	/* локальные переменные */
-	int result;              // результат преобразования отдельного байта
-	int char_counter = 0;    // число записанных символов
-	int mas_counter = 0;     // счетчик массива s
-	int gap_counter = 0;   // счетчик выведенных символов с последнего разделителя
 
-	size_t byte_counter;     // счетчик байтов
-	int byte_inc;            // прирост счетчика массива s
-	size_t byte_stop;        // остановка байта
+	/* ядро по виду цифр: всё, что не BASE_HEX, выводится двоичными цифрами */
+	int (*kernel)(const byte *, char *, size_t, const endian_types) = tm.base == BASE_HEX ? bytes_hex : bytes_bin;
 
-	/* подготовка переменных */
-	if (tm.seq_endian == LITTLE_ENDIAN)
-	{
-		byte_counter = count-1;  // байты обрабатываем с последнего
-		byte_inc = -1;           // мы двигаемся назад
-		byte_stop = 0;           // останавливаемся на нулевом байте
-	}
-	else
+	byte rev[TRANS_CHUNK];      // буфер переставленных байт
+	const byte *src;            // начало участка для ядра
+	size_t done = 0;            // число преобразованных байт
+	size_t gap_counter = 0;     // число байт с последнего разделителя
+	size_t run, i;              // длина участка, счетчик
+	int mas_counter = 0;        // счетчик массива s
+	int use_gap = !(tm.gap == 0 || tm.gap > count);
+
+	while (done < count)
 	{
-		byte_counter = 0;     // байты обрабатываем с первого
-		byte_inc = +1;        // мы двигаемся вперед
-		byte_stop = count-1;  // останавливаемся на последнем байте
-	}
-	
-	/* цикл преобразования */
-	/* контроль цикла идет по байтам */
-	for (;;)
-	{
-		/* преобразование отдельного байта */
-		result = byte_base(bm[byte_counter], s+mas_counter, tm.byte_endian, tm.base);
-		if (result <= 0)
-			return char_counter; // если результат не более 0, то возврат
-		char_counter += result; // увеличим счетчик выведенных символов
-		mas_counter += result;  // увеличим счетчик для символа-разделителя
-		gap_counter++;  // увеличим счетчик для символа-разделителя
-
-		/* проверка необходимости установки символа-разделителя */
-		if (!(tm.gap == 0 || tm.gap > count))
+		/* длина участка: до конца массива, до разделителя и не более буфера */
+		run = count - done;
+		if (use_gap && run > tm.gap - gap_counter)
+			run = tm.gap - gap_counter;
+		if (tm.seq_endian == LITTLE_ENDIAN)
 		{
-			if (gap_counter == tm.gap)
-			{
-				s[mas_counter++] = tm.gap_delim;
-				char_counter++;
-				gap_counter = 0;
-			}
+			if (run > TRANS_CHUNK)
+				run = TRANS_CHUNK;
+			for (i = 0; i < run; i++)
+				rev[i] = bm[count - 1 - done - i];
+			src = rev;
 		}
-
-		/* проверка необходимости выхода из цикла */
-		if (byte_counter == byte_stop)
-			break;
 		else
-			byte_counter += byte_inc;
+			src = bm + done;
+
+		mas_counter += kernel(src, s + mas_counter, run, tm.byte_endian);
+		done += run;
+		gap_counter += run;
+
+		/* постановка символа-разделителя */
+		if (use_gap && gap_counter == tm.gap)
+		{
+			s[mas_counter++] = tm.gap_delim;
+			gap_counter = 0;
+		}
 	}
 
-	return char_counter;
+	return mas_counter;
 }
 
 /* преобразует слово w в массив двоичных или шестнадцатеричных цифр */
@@ -433,12 +434,890 @@ int word_hex(const word w, char *s)
 {
 	if (s == NULL)
 		return -1;	
-	/* параметры преобразования */	
-	struct trans_mode tm;
-	tm.base = BASE_HEX;
-	tm.byte_endian = BIG_ENDIAN;
-	tm.seq_endian = BIG_ENDIAN;
-	tm.gap = 0;
-	tm.gap_delim = ' ';
-	return word_trans(w, s, tm);
-}
\ No newline at end of file
+	/* байты слова от старшего к младшему сразу отдаются ядру */
+	byte bm[WORD_SIZE_IN_BYTES];
+	split_word(bm, w, BIG_ENDIAN);
+	return bytes_hex(bm, s, WORD_SIZE_IN_BYTES, BIG_ENDIAN);
+}
+
+/* преобразует младшие digits шестнадцатеричных цифр 64-разрядного слова w в массив цифр */
+int qword_hex(const qword w, char *s, size_t digits)
+{
+	byte bm[QWORD_SIZE_IN_BYTES];
+	char all[QWORD_SIZE_IN_BYTES * BYTE_SIZE_IN_TETRAS];
+	size_t i;
+
+	if (s == NULL || digits > QWORD_SIZE_IN_BYTES * BYTE_SIZE_IN_TETRAS)
+		return -1;
+	/* байты от старшего к младшему */
+	for (i = 0; i < QWORD_SIZE_IN_BYTES; i++)
+		bm[i] = (byte) (w >> ((QWORD_SIZE_IN_BYTES - 1 - i) * BYTE_SIZE_IN_BITS));
+	bytes_hex(bm, all, QWORD_SIZE_IN_BYTES, BIG_ENDIAN);
+	memcpy(s, all + sizeof(all) - digits, digits);
+	return (int) digits;
+}
+
+/* --- векторное ядро преобразования массива байт в шестнадцатеричные цифры --- */
+
+/* ядро: преобразует count байт массива bm в 2*count цифр строки s */
+typedef void (*hex_kernel)(const byte *bm, char *s, size_t count, const endian_types endian_type);
+
+/* скалярное ядро, оно же обрабатывает остаток после векторных ядер */
+static void hex_kernel_scalar(const byte *bm, char *s, size_t count, const endian_types endian_type)
+{
+	const char *pairs = endian_type == LITTLE_ENDIAN ? hex_pairs_le : hex_pairs_be;
+	size_t i;
+	for (i = 0; i < count; i++, s += BYTE_SIZE_IN_TETRAS)
+		memcpy(s, pairs + bm[i] * BYTE_SIZE_IN_TETRAS, BYTE_SIZE_IN_TETRAS);
+}
+
+/* ядро двоичного преобразования: преобразует count байт массива bm в 8*count цифр строки s */
+typedef void (*bin_kernel)(const byte *bm, char *s, size_t count, const endian_types endian_type);
+
+/* скалярное ядро двоичного преобразования: по байту за слово, оно же обрабатывает остаток */
+static void bin_kernel_scalar(const byte *bm, char *s, size_t count, const endian_types endian_type)
+{
+	uint64_t digits;
+	size_t i;
+	for (i = 0; i < count; i++, s += BYTE_SIZE_IN_BITS)
+	{
+		digits = bin_digits8(bm[i], endian_type);
+		memcpy(s, &digits, BYTE_SIZE_IN_BITS);
+	}
+}
+
+/* ядро обратного преобразования: переводит 2*count цифр строки s в count байт массива bm,
+возвращает число байт до первой неверной цифры */
+typedef size_t (*unhex_kernel)(const char *s, byte *bm, size_t count);
+
+/* скалярное ядро обратного преобразования, оно же обрабатывает остаток после векторных ядер */
+static size_t unhex_kernel_scalar(const char *s, byte *bm, size_t count)
+{
+	byte hi, lo;
+	size_t i;
+	for (i = 0; i < count; i++, s += BYTE_SIZE_IN_TETRAS)
+	{
+		hi = tetra_code[(byte) s[0]];
+		lo = tetra_code[(byte) s[1]];
+		if (hi == 0 || lo == 0)
+			return i;
+		bm[i] = (byte) (((hi - 1) << TETRA_SIZE_IN_BITS) | (lo - 1));
+	}
+	return count;
+}
+
+/* ядро сравнения: возвращает номер первого различающегося байта или count */
+typedef size_t (*mismatch_kernel)(const byte *a, const byte *b, size_t count);
+
+/* скалярное ядро сравнения, оно же обрабатывает остаток после векторных ядер */
+static size_t mismatch_kernel_scalar(const byte *a, const byte *b, size_t count)
+{
+	size_t i;
+	for (i = 0; i < count; i++)
+		if (a[i] != b[i])
+			return i;
+	return count;
+}
+
+/* ядро перестановки: переставляет байты каждого слова из word_bytes (2, 4 или 8) байт */
+typedef void (*swap_kernel)(const byte *bm, byte *out, size_t count, size_t word_bytes);
+
+/* скалярное ядро перестановки: слово целиком инструкцией bswap, оно же обрабатывает остаток */
+static void swap_kernel_scalar(const byte *bm, byte *out, size_t count, size_t word_bytes)
+{
+	uint16_t w2;
+	uint32_t w4;
+	uint64_t w8;
+	size_t i;
+	for (i = 0; i < count; i += word_bytes)
+	{
+		switch (word_bytes)
+		{
+		case 2:
+			memcpy(&w2, bm + i, 2);
+			w2 = __builtin_bswap16(w2);
+			memcpy(out + i, &w2, 2);
+			break;
+		case 4:
+			memcpy(&w4, bm + i, 4);
+			w4 = __builtin_bswap32(w4);
+			memcpy(out + i, &w4, 4);
+			break;
+		default:
+			memcpy(&w8, bm + i, 8);
+			w8 = __builtin_bswap64(w8);
+			memcpy(out + i, &w8, 8);
+			break;
+		}
+	}
+}
+
+/* ядро классификации: печатаемые ascii символы копируются, остальные заменяются subst,
+возвращает число замененных байт */
+typedef size_t (*print_kernel)(const byte *bm, char *s, size_t count, char subst);
+
+/* скалярное ядро классификации, оно же обрабатывает остаток после векторных ядер */
+static size_t print_kernel_scalar(const byte *bm, char *s, size_t count, char subst)
+{
+	size_t i, n = 0;
+	int p;
+	for (i = 0; i < count; i++)
+	{
+		p = bm[i] >= 0x20 && bm[i] < 0x7F;
+		s[i] = p ? (char) bm[i] : subst;
+		n += (size_t) !p;
+	}
+	return n;
+}
+
+/* ядро поиска образца needle длиной length >= 2: возвращает смещение первого вхождения или count */
+typedef size_t (*find_kernel)(const byte *hay, size_t count, const byte *needle, size_t length);
+
+/* скалярное ядро поиска: первый байт образца ищется memchr(), затем сравниваются последний и средние,
+оно же обрабатывает остаток после векторных ядер */
+static size_t find_kernel_scalar(const byte *hay, size_t count, const byte *needle, size_t length)
+{
+	const byte *p = hay, *end;
+	if (count < length)
+		return count;
+	end = hay + (count - length + 1);  // за последним возможным началом
+	while (p < end && (p = (const byte *) memchr(p, needle[0], (size_t) (end - p))) != NULL)
+	{
+		if (p[length - 1] == needle[length - 1] && memcmp(p + 1, needle + 1, length - 2) == 0)
+			return (size_t) (p - hay);
+		p++;
+	}
+	return count;
+}
+
+/* ядро поиска байта из набора set: возвращает смещение первого найденного байта или count */
+typedef size_t (*find_any_kernel)(const byte *hay, size_t count, const byte *set, size_t set_count);
+
+/* скалярное ядро поиска байта из набора, оно же обрабатывает остаток после векторных ядер */
+static size_t find_any_kernel_scalar(const byte *hay, size_t count, const byte *set, size_t set_count)
+{
+	size_t i, k;
+	for (i = 0; i < count; i++)
+		for (k = 0; k < set_count; k++)
+			if (hay[i] == set[k])
+				return i;
+	return count;
+}
+
+#ifdef ELEMENTS_SIMD_X86
+
+/* SSE2: тетрада переводится в цифру сложением с '0' и поправкой 'A' - '9' - 1 для тетрад больше 9 */
+__attribute__((target("sse2")))
+static void hex_kernel_sse2(const byte *bm, char *s, size_t count, const endian_types endian_type)
+{
+	const __m128i mask = _mm_set1_epi8(0x0F);
+	const __m128i nine = _mm_set1_epi8(9);
+	const __m128i zero = _mm_set1_epi8('0');
+	const __m128i gap  = _mm_set1_epi8('A' - '9' - 1);
+	__m128i v, hi, lo, first, second;
+	size_t i = 0;
+
+	for (; i + 16 <= count; i += 16, s += 32)
+	{
+		v  = _mm_loadu_si128((const __m128i *) (bm + i));
+		hi = _mm_and_si128(_mm_srli_epi16(v, 4), mask);
+		lo = _mm_and_si128(v, mask);
+		hi = _mm_add_epi8(_mm_add_epi8(hi, zero), _mm_and_si128(_mm_cmpgt_epi8(hi, nine), gap));
+		lo = _mm_add_epi8(_mm_add_epi8(lo, zero), _mm_and_si128(_mm_cmpgt_epi8(lo, nine), gap));
+		first  = endian_type == LITTLE_ENDIAN ? lo : hi;
+		second = endian_type == LITTLE_ENDIAN ? hi : lo;
+		_mm_storeu_si128((__m128i *) s, _mm_unpacklo_epi8(first, second));
+		_mm_storeu_si128((__m128i *) (s + 16), _mm_unpackhi_epi8(first, second));
+	}
+	hex_kernel_scalar(bm + i, s, count - i, endian_type);
+}
+
+/* SSSE3: тетрада переводится в цифру выборкой pshufb из таблицы цифр */
+__attribute__((target("ssse3")))
+static void hex_kernel_ssse3(const byte *bm, char *s, size_t count, const endian_types endian_type)
+{
+	const __m128i mask  = _mm_set1_epi8(0x0F);
+	const __m128i table = _mm_setr_epi8('0', '1', '2', '3', '4', '5', '6', '7',
+	                                    '8', '9', 'A', 'B', 'C', 'D', 'E', 'F');
+	__m128i v, hi, lo, first, second;
+	size_t i = 0;
+
+	for (; i + 16 <= count; i += 16, s += 32)
+	{
+		v  = _mm_loadu_si128((const __m128i *) (bm + i));
+		hi = _mm_shuffle_epi8(table, _mm_and_si128(_mm_srli_epi16(v, 4), mask));
+		lo = _mm_shuffle_epi8(table, _mm_and_si128(v, mask));
+		first  = endian_type == LITTLE_ENDIAN ? lo : hi;
+		second = endian_type == LITTLE_ENDIAN ? hi : lo;
+		_mm_storeu_si128((__m128i *) s, _mm_unpacklo_epi8(first, second));
+		_mm_storeu_si128((__m128i *) (s + 16), _mm_unpackhi_epi8(first, second));
+	}
+	hex_kernel_scalar(bm + i, s, count - i, endian_type);
+}
+
+/* AVX2: 32 байта за проход; распаковка идет внутри 128-разрядных половин, 
+поэтому половины результата переставляются перед записью */
+__attribute__((target("avx2")))
+static void hex_kernel_avx2(const byte *bm, char *s, size_t count, const endian_types endian_type)
+{
+	const __m256i mask  = _mm256_set1_epi8(0x0F);
+	const __m256i table = _mm256_setr_epi8('0', '1', '2', '3', '4', '5', '6', '7',
+	                                       '8', '9', 'A', 'B', 'C', 'D', 'E', 'F',
+	                                       '0', '1', '2', '3', '4', '5', '6', '7',
+	                                       '8', '9', 'A', 'B', 'C', 'D', 'E', 'F');
+	__m256i v, hi, lo, first, second, a, b;
+	size_t i = 0;
+
+	for (; i + 32 <= count; i += 32, s += 64)
+	{
+		v  = _mm256_loadu_si256((const __m256i *) (bm + i));
+		hi = _mm256_shuffle_epi8(table, _mm256_and_si256(_mm256_srli_epi16(v, 4), mask));
+		lo = _mm256_shuffle_epi8(table, _mm256_and_si256(v, mask));
+		first  = endian_type == LITTLE_ENDIAN ? lo : hi;
+		second = endian_type == LITTLE_ENDIAN ? hi : lo;
+		a = _mm256_unpacklo_epi8(first, second);  // байты 0-7 и 16-23
+		b = _mm256_unpackhi_epi8(first, second);  // байты 8-15 и 24-31
+		_mm256_storeu_si256((__m256i *) s, _mm256_permute2x128_si256(a, b, 0x20));
+		_mm256_storeu_si256((__m256i *) (s + 32), _mm256_permute2x128_si256(a, b, 0x31));
+	}
+	hex_kernel_ssse3(bm + i, s, count - i, endian_type);
+}
+
+/* SSE2: восемь копий каждого байта v переводятся в цифры: копия маскируется своим разрядом bits,
+сравнение с маской дает -1 для единичного разряда, вычитание из '0' - цифру '1' */
+__attribute__((target("sse2")))
+static inline __m128i bin_digits_sse2(__m128i v, __m128i bits)
+{
+	return _mm_sub_epi8(_mm_set1_epi8('0'), _mm_cmpeq_epi8(_mm_and_si128(v, bits), bits));
+}
+
+/* SSE2: 16 байт в 128 цифр за проход; байты размножаются тремя ступенями распаковки,
+после третьей ступени в регистре восемь копий двух соседних байт */
+__attribute__((target("sse2")))
+static void bin_kernel_sse2(const byte *bm, char *s, size_t count, const endian_types endian_type)
+{
+	const __m128i bits = endian_type == LITTLE_ENDIAN ?
+		_mm_setr_epi8(0x01, 0x02, 0x04, 0x08, 0x10, 0x20, 0x40, (char) 0x80,
+		              0x01, 0x02, 0x04, 0x08, 0x10, 0x20, 0x40, (char) 0x80) :
+		_mm_setr_epi8((char) 0x80, 0x40, 0x20, 0x10, 0x08, 0x04, 0x02, 0x01,
+		              (char) 0x80, 0x40, 0x20, 0x10, 0x08, 0x04, 0x02, 0x01);
+	__m128i v, b2[2], b4[4];
+	size_t i = 0;
+	int j;
+
+	for (; i + 16 <= count; i += 16, s += 128)
+	{
+		v = _mm_loadu_si128((const __m128i *) (bm + i));
+		b2[0] = _mm_unpacklo_epi8(v, v);          // байты 0-7 по две копии
+		b2[1] = _mm_unpackhi_epi8(v, v);          // байты 8-15
+		b4[0] = _mm_unpacklo_epi16(b2[0], b2[0]); // байты 0-3 по четыре копии
+		b4[1] = _mm_unpackhi_epi16(b2[0], b2[0]);
+		b4[2] = _mm_unpacklo_epi16(b2[1], b2[1]);
+		b4[3] = _mm_unpackhi_epi16(b2[1], b2[1]);
+		for (j = 0; j < 4; j++)
+		{
+			_mm_storeu_si128((__m128i *) (s + j * 32), bin_digits_sse2(_mm_unpacklo_epi32(b4[j], b4[j]), bits));
+			_mm_storeu_si128((__m128i *) (s + j * 32 + 16), bin_digits_sse2(_mm_unpackhi_epi32(b4[j], b4[j]), bits));
+		}
+	}
+	bin_kernel_scalar(bm + i, s, count - i, endian_type);
+}
+
+/* AVX2: 16 байт в 128 цифр за проход; байты загружаются в обе 128-разрядные половины,
+выборка vpshufb размножает в каждой половине по два байта, индексы растут на 4 с каждой записью */
+__attribute__((target("avx2")))
+static void bin_kernel_avx2(const byte *bm, char *s, size_t count, const endian_types endian_type)
+{
+	const __m256i bits = endian_type == LITTLE_ENDIAN ?
+		_mm256_set1_epi64x((long long) UINT64_C(0x8040201008040201)) :
+		_mm256_set1_epi64x((long long) UINT64_C(0x0102040810204080));
+	const __m256i first = _mm256_setr_epi8(0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 1, 1, 1, 1,
+	                                       2, 2, 2, 2, 2, 2, 2, 2, 3, 3, 3, 3, 3, 3, 3, 3);
+	const __m256i step = _mm256_set1_epi8(4);
+	const __m256i zero = _mm256_set1_epi8('0');
+	__m256i v, idx, x;
+	size_t i = 0;
+	int j;
+
+	for (; i + 16 <= count; i += 16, s += 128)
+	{
+		v = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i *) (bm + i)));
+		for (j = 0, idx = first; j < 4; j++, idx = _mm256_add_epi8(idx, step))
+		{
+			x = _mm256_and_si256(_mm256_shuffle_epi8(v, idx), bits);
+			_mm256_storeu_si256((__m256i *) (s + j * 32), _mm256_sub_epi8(zero, _mm256_cmpeq_epi8(x, bits)));
+		}
+	}
+	bin_kernel_scalar(bm + i, s, count - i, endian_type);
+}
+
+/* SSE2: значения 16 цифр v; в valid - признаки верных цифр.
+Цифры '0'-'9' и буквы 'a'-'f' (после приведения к нижнему регистру) проверяются 
+беззнаковым сравнением через min: x <= n, если min(x, n) == x */
+__attribute__((target("sse2")))
+static inline __m128i unhex_digits_sse2(__m128i v, __m128i *valid)
+{
+	__m128i d = _mm_sub_epi8(v, _mm_set1_epi8('0'));
+	__m128i l = _mm_sub_epi8(_mm_or_si128(v, _mm_set1_epi8(0x20)), _mm_set1_epi8('a'));
+	__m128i dv = _mm_cmpeq_epi8(_mm_min_epu8(d, _mm_set1_epi8(9)), d);
+	__m128i lv = _mm_cmpeq_epi8(_mm_min_epu8(l, _mm_set1_epi8(5)), l);
+	*valid = _mm_or_si128(dv, lv);
+	return _mm_or_si128(_mm_and_si128(dv, d), _mm_and_si128(lv, _mm_add_epi8(l, _mm_set1_epi8(10))));
+}
+
+/* SSE2: пары значений цифр (старшая, младшая) собираются в байты внутри 16-разрядных слов */
+__attribute__((target("sse2")))
+static inline __m128i unhex_pairs_sse2(__m128i t)
+{
+	return _mm_and_si128(_mm_or_si128(_mm_slli_epi16(t, 4), _mm_srli_epi16(t, 8)), _mm_set1_epi16(0x00FF));
+}
+
+/* SSE2: 32 цифры в 16 байт за проход; при неверной цифре остаток разбирает скалярное ядро */
+__attribute__((target("sse2")))
+static size_t unhex_kernel_sse2(const char *s, byte *bm, size_t count)
+{
+	__m128i a, b, va, vb;
+	size_t i = 0;
+
+	for (; i + 16 <= count; i += 16, s += 32)
+	{
+		a = unhex_digits_sse2(_mm_loadu_si128((const __m128i *) s), &va);
+		b = unhex_digits_sse2(_mm_loadu_si128((const __m128i *) (s + 16)), &vb);
+		if (_mm_movemask_epi8(_mm_and_si128(va, vb)) != 0xFFFF)
+			break;
+		_mm_storeu_si128((__m128i *) (bm + i), _mm_packus_epi16(unhex_pairs_sse2(a), unhex_pairs_sse2(b)));
+	}
+	return i + unhex_kernel_scalar(s, bm + i, count - i);
+}
+
+/* AVX2: значения 32 цифр v аналогично unhex_digits_sse2() */
+__attribute__((target("avx2")))
+static inline __m256i unhex_digits_avx2(__m256i v, __m256i *valid)
+{
+	__m256i d = _mm256_sub_epi8(v, _mm256_set1_epi8('0'));
+	__m256i l = _mm256_sub_epi8(_mm256_or_si256(v, _mm256_set1_epi8(0x20)), _mm256_set1_epi8('a'));
+	__m256i dv = _mm256_cmpeq_epi8(_mm256_min_epu8(d, _mm256_set1_epi8(9)), d);
+	__m256i lv = _mm256_cmpeq_epi8(_mm256_min_epu8(l, _mm256_set1_epi8(5)), l);
+	*valid = _mm256_or_si256(dv, lv);
+	return _mm256_or_si256(_mm256_and_si256(dv, d), _mm256_and_si256(lv, _mm256_add_epi8(l, _mm256_set1_epi8(10))));
+}
+
+/* AVX2: пары значений цифр собираются в байты аналогично unhex_pairs_sse2() */
+__attribute__((target("avx2")))
+static inline __m256i unhex_pairs_avx2(__m256i t)
+{
+	return _mm256_and_si256(_mm256_or_si256(_mm256_slli_epi16(t, 4), _mm256_srli_epi16(t, 8)), 
+		_mm256_set1_epi16(0x00FF));
+}
+
+/* AVX2: 64 цифры в 32 байта за проход; упаковка идет внутри 128-разрядных половин,
+поэтому четверти результата переставляются перед записью */
+__attribute__((target("avx2")))
+static size_t unhex_kernel_avx2(const char *s, byte *bm, size_t count)
+{
+	__m256i a, b, va, vb, r;
+	size_t i = 0;
+
+	for (; i + 32 <= count; i += 32, s += 64)
+	{
+		a = unhex_digits_avx2(_mm256_loadu_si256((const __m256i *) s), &va);
+		b = unhex_digits_avx2(_mm256_loadu_si256((const __m256i *) (s + 32)), &vb);
+		if (_mm256_movemask_epi8(_mm256_and_si256(va, vb)) != -1)
+			break;
+		r = _mm256_packus_epi16(unhex_pairs_avx2(a), unhex_pairs_avx2(b));
+		_mm256_storeu_si256((__m256i *) (bm + i), _mm256_permute4x64_epi64(r, 0xD8));
+	}
+	return i + unhex_kernel_sse2(s, bm + i, count - i);
+}
+
+/* SSE2: байты полуслов меняются сдвигами, полуслова в словах - перестановкой pshuflw/pshufhw */
+__attribute__((target("sse2")))
+static void swap_kernel_sse2(const byte *bm, byte *out, size_t count, size_t word_bytes)
+{
+	__m128i v;
+	size_t i = 0;
+
+	for (; i + 16 <= count; i += 16)
+	{
+		v = _mm_loadu_si128((const __m128i *) (bm + i));
+		v = _mm_or_si128(_mm_slli_epi16(v, 8), _mm_srli_epi16(v, 8));
+		if (word_bytes == 4)
+			v = _mm_shufflehi_epi16(_mm_shufflelo_epi16(v, 0xB1), 0xB1);
+		else if (word_bytes == 8)
+			v = _mm_shufflehi_epi16(_mm_shufflelo_epi16(v, 0x1B), 0x1B);
+		_mm_storeu_si128((__m128i *) (out + i), v);
+	}
+	swap_kernel_scalar(bm + i, out + i, count - i, word_bytes);
+}
+
+/* Маска pshufb перестановки байт слов из word_bytes байт: байт i берется с места
+(i - i % word_bytes) + word_bytes - 1 - i % word_bytes */
+static void swap_mask(byte *mask, size_t count, size_t word_bytes)
+{
+	size_t i;
+	for (i = 0; i < count; i++)
+		mask[i] = (byte) (i - i % word_bytes + word_bytes - 1 - i % word_bytes);
+}
+
+/* SSSE3: 16 байт одной перестановкой pshufb */
+__attribute__((target("ssse3")))
+static void swap_kernel_ssse3(const byte *bm, byte *out, size_t count, size_t word_bytes)
+{
+	byte m[16];
+	size_t i = 0;
+
+	swap_mask(m, sizeof(m), word_bytes);
+	const __m128i mask = _mm_loadu_si128((const __m128i *) m);
+	for (; i + 16 <= count; i += 16)
+		_mm_storeu_si128((__m128i *) (out + i),
+			_mm_shuffle_epi8(_mm_loadu_si128((const __m128i *) (bm + i)), mask));
+	swap_kernel_scalar(bm + i, out + i, count - i, word_bytes);
+}
+
+/* AVX2: 32 байта за проход, vpshufb переставляет байты внутри каждой половины регистра,
+слова не пересекают половины, поэтому маска - две маски SSSE3 */
+__attribute__((target("avx2")))
+static void swap_kernel_avx2(const byte *bm, byte *out, size_t count, size_t word_bytes)
+{
+	byte m[16];
+	size_t i = 0;
+
+	swap_mask(m, sizeof(m), word_bytes);
+	const __m256i mask = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i *) m));
+	for (; i + 32 <= count; i += 32)
+		_mm256_storeu_si256((__m256i *) (out + i),
+			_mm256_shuffle_epi8(_mm256_loadu_si256((const __m256i *) (bm + i)), mask));
+	swap_kernel_ssse3(bm + i, out + i, count - i, word_bytes);
+}
+
+/* SSE2: сдвиг на 0x60 переносит печатаемые 0x20..0x7E в знаковый диапазон -128..-34,
+печатаемость проверяется одним знаковым сравнением, замена - по маске */
+__attribute__((target("sse2")))
+static size_t print_kernel_sse2(const byte *bm, char *s, size_t count, char subst)
+{
+	const __m128i shift = _mm_set1_epi8(0x60);
+	const __m128i limit = _mm_set1_epi8(-33);
+	const __m128i sub = _mm_set1_epi8(subst);
+	__m128i v, p;
+	size_t i = 0, n = 0;
+
+	for (; i + 16 <= count; i += 16)
+	{
+		v = _mm_loadu_si128((const __m128i *) (bm + i));
+		p = _mm_cmplt_epi8(_mm_add_epi8(v, shift), limit);
+		_mm_storeu_si128((__m128i *) (s + i), _mm_or_si128(_mm_and_si128(p, v), _mm_andnot_si128(p, sub)));
+		n += (size_t) (16 - __builtin_popcount((unsigned int) _mm_movemask_epi8(p)));
+	}
+	return n + print_kernel_scalar(bm + i, s + i, count - i, subst);
+}
+
+/* AVX2: 32 байта за проход, замена смешиванием по маске */
+__attribute__((target("avx2")))
+static size_t print_kernel_avx2(const byte *bm, char *s, size_t count, char subst)
+{
+	const __m256i shift = _mm256_set1_epi8(0x60);
+	const __m256i limit = _mm256_set1_epi8(-33);
+	const __m256i sub = _mm256_set1_epi8(subst);
+	__m256i v, p;
+	size_t i = 0, n = 0;
+
+	for (; i + 32 <= count; i += 32)
+	{
+		v = _mm256_loadu_si256((const __m256i *) (bm + i));
+		p = _mm256_cmpgt_epi8(limit, _mm256_add_epi8(v, shift));
+		_mm256_storeu_si256((__m256i *) (s + i), _mm256_blendv_epi8(sub, v, p));
+		n += (size_t) (32 - __builtin_popcount((unsigned int) _mm256_movemask_epi8(p)));
+	}
+	return n + print_kernel_sse2(bm + i, s + i, count - i, subst);
+}
+
+/* SSE2: 16 байт за проход, номер различия - по младшему нулевому разряду маски сравнения */
+__attribute__((target("sse2")))
+static size_t mismatch_kernel_sse2(const byte *a, const byte *b, size_t count)
+{
+	unsigned int m;
+	size_t i = 0;
+
+	for (; i + 16 <= count; i += 16)
+	{
+		m = (unsigned int) _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *) (a + i)),
+			_mm_loadu_si128((const __m128i *) (b + i))));
+		if (m != 0xFFFF)
+			return i + (size_t) __builtin_ctz(~m);
+	}
+	return i + mismatch_kernel_scalar(a + i, b + i, count - i);
+}
+
+/* AVX2: 32 байта за проход */
+__attribute__((target("avx2")))
+static size_t mismatch_kernel_avx2(const byte *a, const byte *b, size_t count)
+{
+	unsigned int m;
+	size_t i = 0;
+
+	for (; i + 32 <= count; i += 32)
+	{
+		m = (unsigned int) _mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i *) (a + i)),
+			_mm256_loadu_si256((const __m256i *) (b + i))));
+		if (m != 0xFFFFFFFFu)
+			return i + (size_t) __builtin_ctz(~m);
+	}
+	return i + mismatch_kernel_sse2(a + i, b + i, count - i);
+}
+
+/* SSE2: первый и последний байт образца сравниваются сразу с 16 возможными началами,
+средние байты сравниваются memcmp() только у начал, где совпали оба */
+__attribute__((target("sse2")))
+static size_t find_kernel_sse2(const byte *hay, size_t count, const byte *needle, size_t length)
+{
+	const __m128i f = _mm_set1_epi8((char) needle[0]);
+	const __m128i l = _mm_set1_epi8((char) needle[length - 1]);
+	unsigned int m;
+	size_t i = 0, j;
+
+	for (; i + 16 + length - 1 <= count; i += 16)
+	{
+		m = (unsigned int) _mm_movemask_epi8(_mm_and_si128(
+			_mm_cmpeq_epi8(f, _mm_loadu_si128((const __m128i *) (hay + i))),
+			_mm_cmpeq_epi8(l, _mm_loadu_si128((const __m128i *) (hay + i + length - 1)))));
+		for (; m != 0; m &= m - 1)
+		{
+			j = i + (size_t) __builtin_ctz(m);
+			if (memcmp(hay + j + 1, needle + 1, length - 2) == 0)
+				return j;
+		}
+	}
+	j = find_kernel_scalar(hay + i, count - i, needle, length);
+	return j == count - i ? count : i + j;
+}
+
+/* AVX2: 32 возможных начала за проход */
+__attribute__((target("avx2")))
+static size_t find_kernel_avx2(const byte *hay, size_t count, const byte *needle, size_t length)
+{
+	const __m256i f = _mm256_set1_epi8((char) needle[0]);
+	const __m256i l = _mm256_set1_epi8((char) needle[length - 1]);
+	unsigned int m;
+	size_t i = 0, j;
+
+	for (; i + 32 + length - 1 <= count; i += 32)
+	{
+		m = (unsigned int) _mm256_movemask_epi8(_mm256_and_si256(
+			_mm256_cmpeq_epi8(f, _mm256_loadu_si256((const __m256i *) (hay + i))),
+			_mm256_cmpeq_epi8(l, _mm256_loadu_si256((const __m256i *) (hay + i + length - 1)))));
+		for (; m != 0; m &= m - 1)
+		{
+			j = i + (size_t) __builtin_ctz(m);
+			if (memcmp(hay + j + 1, needle + 1, length - 2) == 0)
+				return j;
+		}
+	}
+	j = find_kernel_sse2(hay + i, count - i, needle, length);
+	return j == count - i ? count : i + j;
+}
+
+/* SSE2: 16 байт массива сравниваются с каждым байтом набора, маски сравнений объединяются */
+__attribute__((target("sse2")))
+static size_t find_any_kernel_sse2(const byte *hay, size_t count, const byte *set, size_t set_count)
+{
+	__m128i v[BYTES_SET_MAX], x, m;
+	unsigned int mask;
+	size_t i = 0, k;
+
+	for (k = 0; k < set_count; k++)
+		v[k] = _mm_set1_epi8((char) set[k]);
+	for (; i + 16 <= count; i += 16)
+	{
+		x = _mm_loadu_si128((const __m128i *) (hay + i));
+		m = _mm_cmpeq_epi8(x, v[0]);
+		for (k = 1; k < set_count; k++)
+			m = _mm_or_si128(m, _mm_cmpeq_epi8(x, v[k]));
+		mask = (unsigned int) _mm_movemask_epi8(m);
+		if (mask != 0)
+			return i + (size_t) __builtin_ctz(mask);
+	}
+	return i + find_any_kernel_scalar(hay + i, count - i, set, set_count);
+}
+
+/* AVX2: 32 байта за проход */
+__attribute__((target("avx2")))
+static size_t find_any_kernel_avx2(const byte *hay, size_t count, const byte *set, size_t set_count)
+{
+	__m256i v[BYTES_SET_MAX], x, m;
+	unsigned int mask;
+	size_t i = 0, k;
+
+	for (k = 0; k < set_count; k++)
+		v[k] = _mm256_set1_epi8((char) set[k]);
+	for (; i + 32 <= count; i += 32)
+	{
+		x = _mm256_loadu_si256((const __m256i *) (hay + i));
+		m = _mm256_cmpeq_epi8(x, v[0]);
+		for (k = 1; k < set_count; k++)
+			m = _mm256_or_si256(m, _mm256_cmpeq_epi8(x, v[k]));
+		mask = (unsigned int) _mm256_movemask_epi8(m);
+		if (mask != 0)
+			return i + (size_t) __builtin_ctz(mask);
+	}
+	return i + find_any_kernel_sse2(hay + i, count - i, set, set_count);
+}
+
+/* определение доступного уровня векторных расширений по cpuid */
+static int simd_detect(void)
+{
+	unsigned int eax, ebx, ecx, edx, xcr0_lo, xcr0_hi;
+	int level = SIMD_SCALAR;
+
+	if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx))
+		return level;
+	if (edx & bit_SSE2)
+		level = SIMD_SSE2;
+	if ((ecx & bit_SSSE3) && level == SIMD_SSE2)
+		level = SIMD_SSSE3;
+
+	/* AVX2 требует поддержки сохранения регистров ymm операционной системой */
+	if (level == SIMD_SSSE3 && (ecx & bit_OSXSAVE) && (ecx & bit_AVX))
+	{
+		__asm__ ("xgetbv" : "=a" (xcr0_lo), "=d" (xcr0_hi) : "c" (0));
+		if ((xcr0_lo & 0x6) == 0x6 && __get_cpuid_count(7, 0, &eax, &ebx, &ecx, &edx) && (ebx & bit_AVX2))
+			level = SIMD_AVX2;
+	}
+	return level;
+}
+
+#else
+
+static int simd_detect(void)
+{
+	return SIMD_SCALAR;
+}
+
+#endif //ELEMENTS_SIMD_X86
+
+/* ядра по уровням векторных расширений */
+static const hex_kernel hex_kernels[] = {
+	hex_kernel_scalar,
+#ifdef ELEMENTS_SIMD_X86
+	hex_kernel_sse2, hex_kernel_ssse3, hex_kernel_avx2
+#endif
+};
+
+/* ядра двоичного преобразования по уровням векторных расширений, для SSSE3 - ядро SSE2 */
+static const bin_kernel bin_kernels[] = {
+	bin_kernel_scalar,
+#ifdef ELEMENTS_SIMD_X86
+	bin_kernel_sse2, bin_kernel_sse2, bin_kernel_avx2
+#endif
+};
+
+/* ядра обратного преобразования по уровням векторных расширений, для SSSE3 - ядро SSE2 */
+static const unhex_kernel unhex_kernels[] = {
+	unhex_kernel_scalar,
+#ifdef ELEMENTS_SIMD_X86
+	unhex_kernel_sse2, unhex_kernel_sse2, unhex_kernel_avx2
+#endif
+};
+
+/* ядра сравнения по уровням векторных расширений, для SSSE3 - ядро SSE2 */
+static const mismatch_kernel mismatch_kernels[] = {
+	mismatch_kernel_scalar,
+#ifdef ELEMENTS_SIMD_X86
+	mismatch_kernel_sse2, mismatch_kernel_sse2, mismatch_kernel_avx2
+#endif
+};
+
+/* ядра перестановки байт в словах по уровням векторных расширений */
+static const swap_kernel swap_kernels[] = {
+	swap_kernel_scalar,
+#ifdef ELEMENTS_SIMD_X86
+	swap_kernel_sse2, swap_kernel_ssse3, swap_kernel_avx2
+#endif
+};
+
+/* ядра классификации печатаемых символов по уровням векторных расширений, для SSSE3 - ядро SSE2 */
+static const print_kernel print_kernels[] = {
+	print_kernel_scalar,
+#ifdef ELEMENTS_SIMD_X86
+	print_kernel_sse2, print_kernel_sse2, print_kernel_avx2
+#endif
+};
+
+/* ядра поиска образца по уровням векторных расширений, для SSSE3 - ядро SSE2 */
+static const find_kernel find_kernels[] = {
+	find_kernel_scalar,
+#ifdef ELEMENTS_SIMD_X86
+	find_kernel_sse2, find_kernel_sse2, find_kernel_avx2
+#endif
+};
+
+/* ядра поиска байта из набора по уровням векторных расширений, для SSSE3 - ядро SSE2 */
+static const find_any_kernel find_any_kernels[] = {
+	find_any_kernel_scalar,
+#ifdef ELEMENTS_SIMD_X86
+	find_any_kernel_sse2, find_any_kernel_sse2, find_any_kernel_avx2
+#endif
+};
+
+/* выбранный уровень: < 0 - еще не выбран. Ядра вызываются из потоков пула, конвейера и журнала,
+поэтому уровни читаются и записываются атомарно (__atomic, как позиции колец hexlog.c). */
+static int simd_current = -1;
+static int simd_available = -1;
+
+/* Выбор ядра при первом обращении. Одновременный первый вызов из нескольких потоков определяет
+один и тот же уровень; simd_available записывается до simd_current, и поток, прочитавший
+выбранный simd_current (acquire), видит и simd_available. */
+static inline int simd_resolve(void)
+{
+	int level = __atomic_load_n(&simd_current, __ATOMIC_ACQUIRE);
+	if (level < 0)
+	{
+		level = simd_detect();
+		__atomic_store_n(&simd_available, level, __ATOMIC_RELAXED);
+		__atomic_store_n(&simd_current, level, __ATOMIC_RELEASE);
+	}
+	return level;
+}
+
+/* возвращает уровень векторных расширений, используемый ядром */
+int simd_level(void)
+{
+	return simd_resolve();
+}
+
+/* принудительно задает уровень векторных расширений, не выше доступного процессору */
+int simd_set_level(int level)
+{
+	simd_resolve();
+	int available = __atomic_load_n(&simd_available, __ATOMIC_RELAXED);
+	if (level < SIMD_SCALAR)
+		level = SIMD_SCALAR;
+	if (level > available)
+		level = available;
+	__atomic_store_n(&simd_current, level, __ATOMIC_RELEASE);
+	return level;
+}
+
+/* возвращает название уровня векторных расширений */
+const char *simd_level_name(int level)
+{
+	static const char *names[] = { "scalar", "sse2", "ssse3", "avx2" };
+	if (level < SIMD_SCALAR || level > SIMD_AVX2)
+		return "unknown";
+	return names[level];
+}
+
+/* преобразует массив байт в непрерывную последовательность шестнадцатеричных цифр */
+int bytes_hex(const byte *bm, char *s, size_t count, const endian_types endian_type)
+{
+	if (bm == NULL || s == NULL)
+		return -1;
+	if (count > INT_MAX / BYTE_SIZE_IN_TETRAS)
+		return -1;
+	hex_kernels[simd_resolve()](bm, s, count, endian_type);
+	return (int) (count * BYTE_SIZE_IN_TETRAS);
+}
+
+/* преобразует массив байт в непрерывную последовательность двоичных цифр */
+int bytes_bin(const byte *bm, char *s, size_t count, const endian_types endian_type)
+{
+	if (bm == NULL || s == NULL)
+		return -1;
+	if (count > INT_MAX / BYTE_SIZE_IN_BITS)
+		return -1;
+	bin_kernels[simd_resolve()](bm, s, count, endian_type);
+	return (int) (count * BYTE_SIZE_IN_BITS);
+}
+
+/* преобразует непрерывную последовательность двоичных цифр в массив байт */
+int bin_bytes(const char *s, byte *bm, size_t count)
+{
+	uint64_t x;
+	size_t i;
+
+	if (s == NULL || bm == NULL)
+		return -1;
+	if (count > INT_MAX)
+		return -1;
+	for (i = 0; i < count; i++, s += BYTE_SIZE_IN_BITS)
+	{
+		/* восемь цифр одним словом: каждый символ должен быть '0' или '1' */
+		memcpy(&x, s, BYTE_SIZE_IN_BITS);
+		if (((x ^ (BIN_ONES * '0')) & (BIN_ONES * 0xFE)) != 0)
+			break;
+		/* умножение собирает младшие разряды цифр в старшем байте слова, первая цифра - старший разряд */
+		x &= BIN_ONES;
+		bm[i] = (byte) ((x * BIN_BITS_LE) >> (QWORD_SIZE_IN_BYTES - 1) * BYTE_SIZE_IN_BITS);
+	}
+	return (int) i;
+}
+
+/* преобразует непрерывную последовательность шестнадцатеричных цифр в массив байт */
+int hex_bytes(const char *s, byte *bm, size_t count)
+{
+	if (s == NULL || bm == NULL)
+		return -1;
+	if (count > INT_MAX)
+		return -1;
+	return (int) unhex_kernels[simd_resolve()](s, bm, count);
+}
+
+/* возвращает номер первого различающегося байта массивов a и b длиной count */
+size_t bytes_mismatch(const byte *a, const byte *b, size_t count)
+{
+	if (a == NULL || b == NULL)
+		return count;
+	return mismatch_kernels[simd_resolve()](a, b, count);
+}
+
+/* переставляет байты каждого слова из word_bytes байт в обратном порядке */
+int bytes_swap(const byte *bm, byte *out, size_t count, size_t word_bytes)
+{
+	if (bm == NULL || out == NULL || count > INT_MAX)
+		return -1;
+	if ((word_bytes != 1 && word_bytes != 2 && word_bytes != 4 && word_bytes != 8) || count % word_bytes != 0)
+		return -1;
+	if (word_bytes == 1)
+	{
+		if (out != bm)
+			memcpy(out, bm, count);
+	}
+	else
+		swap_kernels[simd_resolve()](bm, out, count, word_bytes);
+	return (int) count;
+}
+
+/* копирует печатаемые ascii символы массива байт, остальные заменяет символом subst */
+int bytes_print(const byte *bm, char *s, size_t count, char subst)
+{
+	if (bm == NULL || s == NULL || count > INT_MAX)
+		return -1;
+	return (int) print_kernels[simd_resolve()](bm, s, count, subst);
+}
+
+/* возвращает смещение первого вхождения образца needle длиной length в массив hay длиной count */
+size_t bytes_find(const byte *hay, size_t count, const byte *needle, size_t length)
+{
+	const byte *p;
+	if (hay == NULL || needle == NULL || length == 0 || length > count)
+		return count;
+	if (length == 1)
+	{
+		p = (const byte *) memchr(hay, needle[0], count);
+		return p == NULL ? count : (size_t) (p - hay);
+	}
+	return find_kernels[simd_resolve()](hay, count, needle, length);
+}
+
+/* возвращает смещение первого байта массива hay, равного одному из байт набора set */
+size_t bytes_find_any(const byte *hay, size_t count, const byte *set, size_t set_count)
+{
+	const byte *p;
+	if (hay == NULL || set == NULL || set_count == 0 || set_count > BYTES_SET_MAX)
+		return count;
+	if (set_count == 1)
+	{
+		p = (const byte *) memchr(hay, set[0], count);
+		return p == NULL ? count : (size_t) (p - hay);
+	}
+	return find_any_kernels[simd_resolve()](hay, count, set, set_count);
+}
@@ -51,9 +51,9 @@ int main()
     tf.hex_block_length = 4;
     tf.ascii_block_delimeter = '|';
     tf.ascii_block_length = 4;    
-    tr = calc_tr_result(BYTE_COUNT, 0, &tf, "\n");    
+    tr = calc_tr_result(BYTE_COUNT, 0xFF14, &tf, "\n");    
     s = (char *) calloc(tr.char_count+1, sizeof(char)); s[tr.char_count] = '\0';
-    tr = shexprn_formatted(s, bm, BYTE_COUNT, 0xFF14, &tf, "\n", tr);
+    tr = shexprnf(s, bm, BYTE_COUNT, 0xFF14, &tf, "\n", tr);
     printf("\nAlso we could look at it in a different way:\n\n");  
     printf("%s", s);
     printf("----------\n");
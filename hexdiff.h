@@ -0,0 +1,64 @@
+/*
+	hexdiff.h
+	Сравнение двух массивов байт с выводом отличающихся адресных строк рядом
+
+Совпадающие строки пропускаются векторным сравнением bytes_mismatch() без преобразования,
+поэтому объем вывода и время работы зависят от числа отличий, а не от размера массивов.
+После отличия ищется ближайшее место, где массивы снова совпадают на sync_length байт,
+с учетом вставки или удаления байт в одном из массивов (скользящий хэш по окнам).
+Каждая выведенная строка содержит адресную строку массива a, разделитель и адресную строку
+массива b. Разделитель как у diff -y: " | " - отличие, " < " - байты только в a, " > " - только в b.
+*/
+#ifndef HEXDIFF_H
+#define HEXDIFF_H
+
+#include "hexprn.h"
+
+/* структура, определяющая параметры сравнения */
+struct Diff_Format
+{
+	char mark;           // символ отметки отличающейся ячейки, ставится вместо разделителя перед её цифрами,
+	                     // если разделителя нет, цифры ячейки выводятся строчными буквами
+	                     // (двоичные ячейки без разделителя не отмечаются)
+	size_t sync_length;  // число совпадающих байт для ресинхронизации, если 0, то без поиска сдвига
+	size_t sync_range;   // наибольшее смещение поиска ресинхронизации от места отличия в каждом массиве
+};
+
+/* Структура, определяющая результат сравнения */
+struct Diff_Result
+{
+	uint64_t same_count;    // число совпавших байт, пропущенных без вывода
+	uint64_t diff_count_a;  // число байт массива a в выведенных строках
+	uint64_t diff_count_b;  // число байт массива b в выведенных строках
+	uint64_t str_count;     // число выведенных строк
+	uint64_t char_count;    // число выведенных символов
+	uint64_t resync_count;  // число ресинхронизаций со сдвигом (вставка или удаление байт)
+	int error;              // != 0 ошибка аргументов, памяти или записи
+};
+
+/* возврат параметров сравнения по умолчанию */
+struct Diff_Format ret_default_df();
+
+/* Потоковое сравнение массивов байт по скомпилированному формату с выводом через функцию записи sink */
+struct Diff_Result stream_hexdiffc(hexprn_sink sink, void *sink_arg,
+	byte *a, size_t a_count, qword a_address, byte *b, size_t b_count, qword b_address,
+	struct Compiled_Format *cf, char *insert_str, struct Diff_Format *df);
+/* Параметры:
+	sink, sink_arg - функция записи и её аргумент, как у stream_hexprnc()
+	a, a_count, a_address - первый массив, его длина и адрес нулевого байта
+	b, b_count, b_address - второй массив, его длина и адрес нулевого байта
+	cf         - скомпилированный формат адресных строк
+	insert_str - строка после каждой выведенной строки, если NULL, то без вставки
+	df         - параметры сравнения, если NULL, то по умолчанию
+Строки выводятся порциями через буфер HEXPRN_STREAM_BUF, адрес строки - адрес её первого байта.
+Возвращает структуру Diff_Result.
+*/
+
+/* Сравнение массивов байт с заданным форматом tf и выводом в файл fp */
+struct Diff_Result fhexdifff(FILE *fp, byte *a, size_t a_count, qword a_address,
+	byte *b, size_t b_count, qword b_address, struct Trans_Format *tf, char *insert_str, struct Diff_Format *df);
+
+/* Сравнение массивов байт с форматом и параметрами по умолчанию и выводом в файл fp */
+struct Diff_Result fhexdiff(FILE *fp, byte *a, size_t a_count, byte *b, size_t b_count, qword address);
+
+#endif //HEXDIFF_H
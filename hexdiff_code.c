@@ -0,0 +1,380 @@
+/*
+	hexdiff.c
+	Сравнение двух массивов байт с выводом отличающихся адресных строк рядом
+*/
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "hexdiff.h"
+
+/* основание скользящего хэша окон ресинхронизации (простое число FNV) */
+#define DIFF_HASH_BASE 0x100000001B3ULL
+
+/* разделители между адресными строками a и b */
+#define DIFF_GUTTER_LENGTH 3
+static const char gutter_diff[] = " | ";
+static const char gutter_a[] = " < ";
+static const char gutter_b[] = " > ";
+
+/* элемент таблицы окон массива a: хэш окна и его смещение от места отличия */
+struct Sync_Entry
+{
+	uint64_t hash;
+	size_t pos;  // SIZE_MAX - свободный элемент
+};
+
+/* состояние сравнения */
+struct Diff_State
+{
+	hexprn_sink sink;
+	void *sink_arg;
+	struct Compiled_Format *cf;
+	char *insert_str;
+	size_t add_length;
+	struct Diff_Format df;
+	const byte *a, *b;
+	size_t na, nb;
+	qword a_address, b_address;
+	size_t row_length;              // длина выводимой строки: две адресные строки, разделитель и добавочная строка
+	struct Sync_Entry *table;       // таблица окон, выделяется при поиске ресинхронизации и растет по числу окон
+	size_t table_size;              // размер выделенной таблицы, степень двойки
+	struct Diff_Result dr;          // накопленный результат
+	size_t used;                    // заполнено символов в буфере
+	char buf[HEXPRN_STREAM_BUF];    // буфер вывода
+};
+
+/* возврат параметров сравнения по умолчанию */
+struct Diff_Format ret_default_df()
+{
+	struct Diff_Format df;
+	df.mark = '#';
+	df.sync_length = 0x10;
+	df.sync_range = 0x1000;
+	return df;
+}
+
+/* передача буфера в sink, возвращает 0 при успехе */
+static int diff_flush(struct Diff_State *st)
+{
+	if (st->used != 0 && st->sink(st->sink_arg, st->buf, st->used) != st->used)
+	{
+		st->dr.error = 1;
+		return -1;
+	}
+	st->used = 0;
+	return 0;
+}
+
+/* Отметка ячеек строки line, байты x которых отличаются от байт y другой строки
+или отсутствуют в ней, отметка - sprn_mark() */
+static void mark_cells(char *line, struct Compiled_Format *cf, const byte *x, size_t xc,
+	const byte *y, size_t yc, char mark)
+{
+	size_t wb = cf->word_bytes;
+	size_t j, k;
+	for (j = 0; j < xc; j += wb)
+	{
+		for (k = j; k < j + wb && k < xc; k++)
+			if (k >= yc || x[k] != y[k])
+				break;
+		if (k < j + wb && k < xc)
+			sprn_mark(line, cf, j, mark);
+	}
+}
+
+/* Вывод строки сравнения: xc байт массива a с адреса xa и yc байт массива b с адреса ya,
+если число байт одной из сторон равно нулю, её место заполняется пробелами.
+Стороны идут за значащими символами друг друга, дополняющие пробелы многобайтовых
+кодовых страниц собираются в конце строки, чтобы стороны не сдвигались на экране. */
+static int diff_row(struct Diff_State *st, const byte *x, size_t xc, qword xa, const byte *y, size_t yc, qword ya)
+{
+	struct Compiled_Format *cf = st->cf;
+	char *r, *row;
+	size_t n;
+
+	if (st->used + st->row_length > HEXPRN_STREAM_BUF && diff_flush(st) < 0)
+		return -1;
+	r = st->buf + st->used;
+	row = r;
+
+	if (xc != 0)
+	{
+		n = sprn_line(r, cf, x, xa, 0, xc);
+		mark_cells(r, cf, x, xc, y, yc, st->df.mark);
+	}
+	else
+	{
+		n = cf->columns;
+		memset(r, ' ', n);
+	}
+	r += n;
+
+	memcpy(r, xc != 0 && yc != 0 ? gutter_diff : (xc != 0 ? gutter_a : gutter_b), DIFF_GUTTER_LENGTH);
+	r += DIFF_GUTTER_LENGTH;
+
+	if (yc != 0)
+	{
+		n = sprn_line(r, cf, y, ya, 0, yc);
+		mark_cells(r, cf, y, yc, x, xc, st->df.mark);
+	}
+	else
+	{
+		n = cf->columns;
+		memset(r, ' ', n);
+	}
+	r += n;
+	n = (size_t) (row + 2 * cf->line_length + DIFF_GUTTER_LENGTH - r);
+	memset(r, ' ', n);
+	r += n;
+
+	if (st->add_length != 0)
+		memcpy(r, st->insert_str, st->add_length);
+
+	st->used += st->row_length;
+	st->dr.str_count++;
+	st->dr.char_count += st->row_length;
+	return 0;
+}
+
+/* Вывод отличающегося участка: la байт массива a с позиции pa и lb байт массива b с позиции pb.
+Строки сторон выводятся попарно, k-я строка a рядом с k-й строкой b. */
+static int diff_region(struct Diff_State *st, size_t pa, size_t la, size_t pb, size_t lb)
+{
+	size_t line_bytes = st->cf->line_bytes;
+	size_t k, xc, yc;
+
+	for (k = 0; k < la || k < lb; k += line_bytes)
+	{
+		xc = k < la ? (la - k < line_bytes ? la - k : line_bytes) : 0;
+		yc = k < lb ? (lb - k < line_bytes ? lb - k : line_bytes) : 0;
+		if (diff_row(st, st->a + pa + k, xc, st->a_address + pa + k, st->b + pb + k, yc, st->b_address + pb + k) < 0)
+			return -1;
+	}
+	st->dr.diff_count_a += la;
+	st->dr.diff_count_b += lb;
+	return 0;
+}
+
+/* хэш окна из n байт */
+static uint64_t window_hash(const byte *p, size_t n)
+{
+	uint64_t h = 0;
+	size_t i;
+	for (i = 0; i < n; i++)
+		h = h * DIFF_HASH_BASE + p[i];
+	return h;
+}
+
+/* Поиск ресинхронизации от мест отличия qa в a и qb в b: ближайшие смещения *da, *db
+(наименьшая сумма), с которых sync_length байт массивов совпадают.
+Окна a хэшируются в таблицу, окна b проверяются по ней скользящим хэшем.
+Возвращает 1, если место найдено, 0 - не найдено, -1 - ошибка памяти. */
+static int sync_search(struct Diff_State *st, size_t qa, size_t qb, size_t *da, size_t *db)
+{
+	size_t w = st->df.sync_length;
+	size_t la = st->na - qa, lb = st->nb - qb;
+	size_t ma, mb, i, j, slot, size, mask, best = SIZE_MAX;
+	uint64_t h, pw;
+	const byte *x = st->a + qa, *y = st->b + qb;
+
+	if (w == 0 || la < w || lb < w)
+		return 0;
+	ma = la - w < st->df.sync_range ? la - w : st->df.sync_range;
+	mb = lb - w < st->df.sync_range ? lb - w : st->df.sync_range;
+
+	/* Таблица окон не менее чем вдвое больше числа окон a этого поиска (ma + 1 не больше оставшейся
+	длины массива, а не sync_range), очищается и используется только её нужная часть */
+	if (ma >= SIZE_MAX / 4 / sizeof(struct Sync_Entry))
+	{
+		st->dr.error = 1;
+		return -1;
+	}
+	for (size = 0x10; size < 2 * (ma + 1); size <<= 1)
+		;
+	if (size > st->table_size)
+	{
+		free(st->table);
+		st->table = (struct Sync_Entry *) malloc(size * sizeof(struct Sync_Entry));
+		st->table_size = st->table == NULL ? 0 : size;
+		if (st->table == NULL)
+		{
+			st->dr.error = 1;
+			return -1;
+		}
+	}
+	mask = size - 1;
+	for (i = 0; i < size; i++)
+		st->table[i].pos = SIZE_MAX;
+
+	/* степень основания для удаления старшего байта окна */
+	for (pw = 1, i = 1; i < w; i++)
+		pw *= DIFF_HASH_BASE;
+
+	/* окна a: при совпадении хэша остается окно с меньшим смещением */
+	h = window_hash(x, w);
+	for (i = 0; ; i++)
+	{
+		for (slot = h & mask; st->table[slot].pos != SIZE_MAX; slot = (slot + 1) & mask)
+			if (st->table[slot].hash == h)
+				break;
+		if (st->table[slot].pos == SIZE_MAX)
+		{
+			st->table[slot].hash = h;
+			st->table[slot].pos = i;
+		}
+		if (i == ma)
+			break;
+		h = (h - x[i] * pw) * DIFF_HASH_BASE + x[i + w];
+	}
+
+	/* окна b: поиск прекращается, когда смещение в b не меньше лучшей суммы */
+	h = window_hash(y, w);
+	for (j = 0; j < best; j++)
+	{
+		for (slot = h & mask; st->table[slot].pos != SIZE_MAX; slot = (slot + 1) & mask)
+		{
+			if (st->table[slot].hash != h)
+				continue;
+			i = st->table[slot].pos;
+			if (i + j < best && memcmp(x + i, y + j, w) == 0)
+			{
+				best = i + j;
+				*da = i;
+				*db = j;
+			}
+			break;
+		}
+		if (j == mb)
+			break;
+		h = (h - y[j] * pw) * DIFF_HASH_BASE + y[j + w];
+	}
+	return best != SIZE_MAX ? 1 : 0;
+}
+
+/* округление n вверх до кратного line_bytes */
+static size_t round_line(size_t n, size_t line_bytes)
+{
+	return (n + line_bytes - 1) / line_bytes * line_bytes;
+}
+
+/* Потоковое сравнение массивов байт по скомпилированному формату */
+struct Diff_Result stream_hexdiffc(hexprn_sink sink, void *sink_arg,
+	byte *a, size_t a_count, qword a_address, byte *b, size_t b_count, qword b_address,
+	struct Compiled_Format *cf, char *insert_str, struct Diff_Format *df)
+{
+	struct Diff_State *st;
+	struct Diff_Result dr;
+	size_t pa = 0, pb = 0, common, m, skip, da = 0, db = 0, len, la, lb;
+	int found;
+
+	memset(&dr, 0, sizeof(dr));
+	dr.error = 1;
+
+	/* проверка аргументов */
+	if (sink == NULL || cf == NULL || (a == NULL && a_count != 0) || (b == NULL && b_count != 0))
+		return dr;
+
+	/* состояние с буфером вывода выделяется в куче, чтобы не занимать стек */
+	st = (struct Diff_State *) malloc(sizeof(struct Diff_State));
+	if (st == NULL)
+		return dr;
+	st->sink = sink;
+	st->sink_arg = sink_arg;
+	st->cf = cf;
+	st->insert_str = insert_str;
+	st->add_length = insert_str == NULL ? 0 : strlen(insert_str);
+	st->df = df == NULL ? ret_default_df() : *df;
+	st->a = a; st->na = a_count; st->a_address = a_address;
+	st->b = b; st->nb = b_count; st->b_address = b_address;
+	st->row_length = 2 * cf->line_length + DIFF_GUTTER_LENGTH + st->add_length;
+	st->table = NULL;
+	st->table_size = 0;
+	st->used = 0;
+	memset(&st->dr, 0, sizeof(st->dr));
+	if (st->row_length > HEXPRN_STREAM_BUF)
+	{
+		free(st);
+		return dr;
+	}
+
+	while (pa < st->na && pb < st->nb)
+	{
+		/* пропуск совпадающих строк */
+		common = st->na - pa < st->nb - pb ? st->na - pa : st->nb - pb;
+		m = bytes_mismatch(a + pa, b + pb, common);
+		if (m == common && st->na - pa == st->nb - pb)
+		{
+			/* остатки совпадают */
+			st->dr.same_count += m;
+			pa += m;
+			pb += m;
+			break;
+		}
+		skip = m - m % cf->line_bytes;
+		pa += skip;
+		pb += skip;
+		st->dr.same_count += skip;
+		m -= skip;
+		if (pa == st->na || pb == st->nb || m == common - skip)
+			break;
+
+		/* отличие в строке: поиск ресинхронизации от места отличия */
+		found = sync_search(st, pa + m, pb + m, &da, &db);
+		if (found < 0)
+			break;
+		if (found && da != db)
+		{
+			/* вставка или удаление: стороны выводятся до места совпадения */
+			la = m + da;
+			lb = m + db;
+			st->dr.resync_count++;
+		}
+		else
+		{
+			/* замена байт: обе стороны выводятся целыми строками, не менее чем до места отличия включительно */
+			len = found ? da : (st->df.sync_length == 0 ? 1 : st->df.sync_range);
+			if (len > st->na - pa - m && len > st->nb - pb - m)
+				len = (st->na - pa > st->nb - pb ? st->na - pa : st->nb - pb) - m;
+			len = round_line(m + (len == 0 ? 1 : len), cf->line_bytes);
+			la = len < st->na - pa ? len : st->na - pa;
+			lb = len < st->nb - pb ? len : st->nb - pb;
+		}
+		if (diff_region(st, pa, la, pb, lb) < 0)
+			break;
+		pa += la;
+		pb += lb;
+	}
+
+	/* остаток более длинного массива */
+	if (st->dr.error == 0 && (pa < st->na || pb < st->nb))
+		diff_region(st, pa, st->na - pa, pb, st->nb - pb);
+	if (st->dr.error == 0)
+		diff_flush(st);
+
+	dr = st->dr;
+	free(st->table);
+	free(st);
+	return dr;
+}
+
+/* Сравнение массивов байт с заданным форматом tf и выводом в файл fp */
+struct Diff_Result fhexdifff(FILE *fp, byte *a, size_t a_count, qword a_address,
+	byte *b, size_t b_count, qword b_address, struct Trans_Format *tf, char *insert_str, struct Diff_Format *df)
+{
+	struct Compiled_Format cf;
+	struct Diff_Result dr;
+	memset(&dr, 0, sizeof(dr));
+	dr.error = 1;
+
+	if (fp == NULL || compile_tf(&cf, tf) == NULL)
+		return dr;
+	return stream_hexdiffc(hexprn_sink_file, fp, a, a_count, a_address, b, b_count, b_address, &cf, insert_str, df);
+}
+
+/* Сравнение массивов байт с форматом и параметрами по умолчанию и выводом в файл fp */
+struct Diff_Result fhexdiff(FILE *fp, byte *a, size_t a_count, byte *b, size_t b_count, qword address)
+{
+	struct Trans_Format tf = ret_default_tf();
+	return fhexdifff(fp, a, a_count, address, b, b_count, address, &tf, "\n", NULL);
+}
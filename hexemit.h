@@ -0,0 +1,85 @@
+/*
+	hexemit.h
+	Вывод массива байт в виде текста для других программ: сплошные шестнадцатеричные цифры,
+	инициализатор массива C/C++ и массивы JSON
+
+Адресные строки hexprn предназначены для чтения человеком. Для встраивания данных в исходные тексты
+и файлы настроек нужны другие виды, которые раньше получались сценариями (xxd -i, xxd -p):
+	EMIT_HEX      - сплошные цифры, line_bytes байт в строке:  414243
+	EMIT_C        - значения массива C:                        0x41, 0x42, 0x43
+	                с именем name - объявление и длина, как у xxd -i:
+	                unsigned char name[] = { ... }; unsigned int name_len = 3;
+	EMIT_JSON     - массив JSON из чисел:                      [65, 66, 67]
+	EMIT_JSON_HEX - массив JSON из строк цифр по строке вывода: ["414243"]
+Цифры всех шестнадцатеричных видов получаются векторной функцией bytes_hex() сразу для нескольких
+строк вывода, вывод идет через буфер HEXPRN_STREAM_BUF в функцию записи, как у stream_hexprnc64().
+*/
+#ifndef HEXEMIT_H
+#define HEXEMIT_H
+
+#include "hexprn.h"
+
+/* вид вывода */
+typedef int emit_types;
+enum emit_types_v {EMIT_HEX = 0, EMIT_C, EMIT_JSON, EMIT_JSON_HEX, EMIT_COUNT};
+
+/* наибольшее число байт в строке вывода */
+#define HEXEMIT_LINE_BYTES_MAX 0x1000
+
+/* число байт в строке вывода EMIT_HEX и EMIT_C, как у xxd -p и xxd -i */
+#define HEXEMIT_HEX_LINE_BYTES 30
+#define HEXEMIT_C_LINE_BYTES 12
+
+/* наибольший отступ строк значений */
+#define HEXEMIT_INDENT_MAX 0x40
+
+/* наибольшая длина имени массива C */
+#define HEXEMIT_NAME_MAX 0x100
+
+/* структура, определяющая вид вывода */
+struct Emit_Format
+{
+	emit_types type;    // вид вывода
+	size_t line_bytes;  // число байт в строке вывода, от 1 до HEXEMIT_LINE_BYTES_MAX
+	size_t indent;      // отступ строк значений пробелами (кроме EMIT_HEX)
+	int lower;          // != 0 - цифры a-f строчные
+	char *name;         // имя массива EMIT_C, если NULL - только строки значений
+};
+
+/* возврат вида вывода по умолчанию: EMIT_HEX по 16 байт в строке */
+struct Emit_Format ret_default_ef();
+
+/* Подсчитывает результат вывода byte_count байт с видом ef и добавочной строкой insert_str
+после каждой строки. Для EMIT_JSON число символов - верхняя граница (все значения трехзначные),
+функции вывода возвращают фактическое. str_count - число строк значений, single_length -
+наибольшая длина строки значений с добавочной строкой. При ошибке формата error != 0. */
+struct Trans_Result64 calc_tr_emit(size_t byte_count, struct Emit_Format *ef, char *insert_str);
+
+/* Вывод в строку s не менее calc_tr_emit().char_count символов, без завершающего нуля */
+struct Trans_Result64 shexemit(char *s, byte *byte_array, size_t byte_count,
+	struct Emit_Format *ef, char *insert_str);
+
+/* Потоковый вывод через функцию записи sink порциями из целых строк */
+struct Trans_Result64 stream_hexemit(hexprn_sink sink, void *sink_arg, byte *byte_array, size_t byte_count,
+	struct Emit_Format *ef, char *insert_str);
+
+/* Потоковый вывод массива, поступающего частями (из канала или устройства) */
+struct Trans_Result64 stream_hexemit_part(hexprn_sink sink, void *sink_arg, byte *byte_array, size_t byte_count,
+	uint64_t offset, int more, struct Emit_Format *ef, char *insert_str);
+/* Параметры:
+	byte_array, byte_count - очередная часть
+	offset - число байт, выведенных предыдущими частями: при 0 выводится заголовок
+	more   - != 0, если за частью последуют еще части: длина такой части должна быть кратна
+	         line_bytes, окончание (с длиной offset + byte_count) выводится только при more == 0,
+	         пустая часть с more != 0 ничего не выводит
+Последовательность частей дает тот же текст, что и stream_hexemit() для всего массива;
+так как запятая после последней строки не ставится, часть с more == 0 должна быть последней,
+при неизвестной длине потока вызывающий держит одну часть до следующего чтения.
+byte_count результата - байты этой части. Остальные параметры - как у stream_hexemit().
+*/
+
+/* Потоковый вывод в файл fp */
+struct Trans_Result64 fhexemit(FILE *fp, byte *byte_array, size_t byte_count,
+	struct Emit_Format *ef, char *insert_str);
+
+#endif //HEXEMIT_H
@@ -0,0 +1,355 @@
+/*
+	hexemit.c
+	Вывод массива байт в виде текста для других программ: сплошные шестнадцатеричные цифры,
+	инициализатор массива C/C++ и массивы JSON
+*/
+#include <stdint.h>
+#include <string.h>
+
+#include "hexemit.h"
+
+/* длина значения в строке с разделителем ", ", у EMIT_JSON - наибольшая (трехзначное число) */
+static const size_t emit_item_length[EMIT_COUNT] = { BYTE_SIZE_IN_TETRAS, 6, 5, BYTE_SIZE_IN_TETRAS };
+
+/* проверенный вид вывода с длинами добавочной строки и имени */
+struct Emit_State
+{
+	struct Emit_Format ef;
+	char *insert_str;
+	size_t add_length;
+	size_t name_length;
+};
+
+/* возврат вида вывода по умолчанию */
+struct Emit_Format ret_default_ef()
+{
+	struct Emit_Format ef;
+	ef.type = EMIT_HEX;
+	ef.line_bytes = 0x10;
+	ef.indent = 2;
+	ef.lower = 0;
+	ef.name = NULL;
+	return ef;
+}
+
+/* проверка вида вывода и заполнение состояния, возвращает 0 при успехе */
+static int emit_init(struct Emit_State *es, struct Emit_Format *ef, char *insert_str)
+{
+	es->ef = ef == NULL ? ret_default_ef() : *ef;
+	es->insert_str = insert_str;
+	es->add_length = insert_str == NULL ? 0 : strlen(insert_str);
+	es->name_length = es->ef.name == NULL ? 0 : strlen(es->ef.name);
+	if (es->ef.type < 0 || es->ef.type >= EMIT_COUNT || es->ef.line_bytes == 0
+		|| es->ef.line_bytes > HEXEMIT_LINE_BYTES_MAX || es->ef.indent > HEXEMIT_INDENT_MAX
+		|| es->name_length > HEXEMIT_NAME_MAX || es->add_length > HEXPRN_STREAM_BUF / 4)
+		return -1;
+	if (es->ef.type == EMIT_HEX)
+		es->ef.indent = 0;
+	return 0;
+}
+
+/* Длина строки значений из n байт (n > 0) с добавочной строкой,
+last != 0 - последняя строка, без запятой после значений */
+static size_t emit_line_length(struct Emit_State *es, size_t n, int last)
+{
+	size_t length = es->ef.indent + n * emit_item_length[es->ef.type] + es->add_length;
+	switch (es->ef.type)
+	{
+	case EMIT_HEX:
+		return length;
+	case EMIT_JSON_HEX:
+		return length + 2 + (last ? 0 : 1);  // кавычки и запятая
+	default:
+		return length - 2 + (last ? 0 : 1);  // без разделителя после последнего значения
+	}
+}
+
+/* запись n символов t в s с позиции at (если s не NULL), возвращает следующую позицию */
+static size_t emit_put(char *s, size_t at, const char *t, size_t n)
+{
+	if (s != NULL && n != 0)
+		memcpy(s + at, t, n);
+	return at + n;
+}
+
+/* Заголовок (tail == 0) или окончание вывода total байт: скобки JSON, объявление и длина массива C.
+Если s равна NULL, только подсчитывает длину. Возвращает число символов. */
+static size_t emit_frame(char *s, struct Emit_State *es, uint64_t total, int tail)
+{
+	char number[24];
+	size_t at = 0, k = sizeof(number);
+
+	if (es->ef.type == EMIT_JSON || es->ef.type == EMIT_JSON_HEX)
+		at = emit_put(s, at, tail ? "]" : "[", 1);
+	else if (es->ef.type == EMIT_C && es->ef.name != NULL)
+	{
+		if (!tail)
+		{
+			at = emit_put(s, at, "unsigned char ", 14);
+			at = emit_put(s, at, es->ef.name, es->name_length);
+			at = emit_put(s, at, "[] = {", 6);
+		}
+		else
+		{
+			do
+				number[--k] = (char) ('0' + total % 10);
+			while ((total /= 10) != 0);
+			at = emit_put(s, at, "};", 2);
+			at = emit_put(s, at, es->insert_str, es->add_length);
+			at = emit_put(s, at, "unsigned int ", 13);
+			at = emit_put(s, at, es->ef.name, es->name_length);
+			at = emit_put(s, at, "_len = ", 7);
+			at = emit_put(s, at, number + k, sizeof(number) - k);
+			at = emit_put(s, at, ";", 1);
+		}
+	}
+	else
+		return 0;
+	return emit_put(s, at, es->insert_str, es->add_length);
+}
+
+/* Строка значений из n байт с цифрами d (кроме EMIT_JSON), last != 0 - последняя.
+Возвращает число записанных символов. */
+static size_t emit_line(char *s, struct Emit_State *es, const byte *bytes, const char *d, size_t n, int last)
+{
+	char *p = s;
+	size_t j;
+	byte b;
+
+	memset(p, ' ', es->ef.indent);
+	p += es->ef.indent;
+	switch (es->ef.type)
+	{
+	case EMIT_HEX:
+	case EMIT_JSON_HEX:
+		if (es->ef.type == EMIT_JSON_HEX)
+			*p++ = '"';
+		memcpy(p, d, n * BYTE_SIZE_IN_TETRAS);
+		p += n * BYTE_SIZE_IN_TETRAS;
+		if (es->ef.type == EMIT_JSON_HEX)
+			*p++ = '"';
+		break;
+	case EMIT_C:
+		/* разнос цифр по значениям "0xHH, " */
+		for (j = 0; j + 1 < n; j++, d += BYTE_SIZE_IN_TETRAS, p += 6)
+		{
+			p[0] = '0';
+			p[1] = 'x';
+			p[2] = d[0];
+			p[3] = d[1];
+			p[4] = ',';
+			p[5] = ' ';
+		}
+		p[0] = '0';
+		p[1] = 'x';
+		p[2] = d[0];
+		p[3] = d[1];
+		p += 4;
+		break;
+	default:
+		/* десятичные числа без ведущих нулей */
+		for (j = 0; j < n; j++)
+		{
+			b = bytes[j];
+			if (b >= 100)
+				*p++ = (char) ('0' + b / 100);
+			if (b >= 10)
+				*p++ = (char) ('0' + b / 10 % 10);
+			*p++ = (char) ('0' + b % 10);
+			if (j + 1 < n)
+			{
+				*p++ = ',';
+				*p++ = ' ';
+			}
+		}
+		break;
+	}
+	if (!last && es->ef.type != EMIT_HEX)
+		*p++ = ',';
+	if (es->add_length != 0)
+	{
+		memcpy(p, es->insert_str, es->add_length);
+		p += es->add_length;
+	}
+	return (size_t) (p - s);
+}
+
+/* Строки значений count байт с начала строки, last != 0 - за ними байт нет.
+Цифры получаются одним вызовом bytes_hex() для целых строк до HEXEMIT_LINE_BYTES_MAX байт,
+а не для каждой строки. Записывает результат в tr, возвращает число символов. */
+static size_t emit_lines(char *s, struct Emit_State *es, const byte *bytes, size_t count, int last,
+	struct Trans_Result64 *tr)
+{
+	char digits[HEXEMIT_LINE_BYTES_MAX * BYTE_SIZE_IN_TETRAS];
+	size_t lb = es->ef.line_bytes;
+	size_t chunk = HEXEMIT_LINE_BYTES_MAX / lb * lb;
+	size_t pos, k, j, n, length = 0;
+
+	for (pos = 0; pos < count; pos += chunk)
+	{
+		if (chunk > count - pos)
+			chunk = count - pos;
+		if (es->ef.type != EMIT_JSON)
+		{
+			bytes_hex(bytes + pos, digits, chunk, BIG_ENDIAN);
+			if (es->ef.lower)
+				for (j = 0; j < chunk * BYTE_SIZE_IN_TETRAS; j++)
+					digits[j] |= 0x20;  // 'A'-'F' в 'a'-'f', цифры 0-9 не меняются
+		}
+		for (k = 0; k < chunk; k += n)
+		{
+			n = chunk - k < lb ? chunk - k : lb;
+			length += emit_line(s + length, es, bytes + pos + k, digits + k * BYTE_SIZE_IN_TETRAS, n,
+				last && pos + k + n == count);
+			tr->str_count++;
+		}
+	}
+	tr->byte_count += count;
+	tr->char_count += length;
+	return length;
+}
+
+/* Подсчитывает результат вывода */
+struct Trans_Result64 calc_tr_emit(size_t byte_count, struct Emit_Format *ef, char *insert_str)
+{
+	struct Emit_State es;
+	struct Trans_Result64 tr;
+	size_t full, rest;
+
+	memset(&tr, 0, sizeof(tr));
+	if (emit_init(&es, ef, insert_str) < 0)
+	{
+		tr.error = 1;
+		return tr;
+	}
+	full = byte_count / es.ef.line_bytes;
+	rest = byte_count % es.ef.line_bytes;
+	tr.byte_count = byte_count;
+	tr.str_count = full + (rest != 0 ? 1 : 0);
+	tr.single_length = emit_line_length(&es, es.ef.line_bytes, 0);
+	tr.add_length = es.add_length;
+	tr.char_count = emit_frame(NULL, &es, byte_count, 0) + emit_frame(NULL, &es, byte_count, 1);
+	if (rest != 0)
+		tr.char_count += (uint64_t) full * tr.single_length + emit_line_length(&es, rest, 1);
+	else if (full != 0)
+		tr.char_count += (uint64_t) (full - 1) * tr.single_length + emit_line_length(&es, es.ef.line_bytes, 1);
+	return tr;
+}
+
+/* Вывод в строку s */
+struct Trans_Result64 shexemit(char *s, byte *byte_array, size_t byte_count,
+	struct Emit_Format *ef, char *insert_str)
+{
+	struct Emit_State es;
+	struct Trans_Result64 tr;
+	size_t length;
+
+	memset(&tr, 0, sizeof(tr));
+	tr.error = 1;
+	if (s == NULL || (byte_array == NULL && byte_count != 0) || emit_init(&es, ef, insert_str) < 0)
+		return tr;
+	tr.single_length = emit_line_length(&es, es.ef.line_bytes, 0);
+	tr.add_length = es.add_length;
+
+	length = emit_frame(s, &es, byte_count, 0);
+	length += emit_lines(s + length, &es, byte_array, byte_count, 1, &tr);
+	length += emit_frame(s + length, &es, byte_count, 1);
+	tr.char_count = length;
+	tr.error = 0;
+	return tr;
+}
+
+/* Потоковый вывод через функцию записи sink */
+struct Trans_Result64 stream_hexemit_part(hexprn_sink sink, void *sink_arg, byte *byte_array, size_t byte_count,
+	uint64_t offset, int more, struct Emit_Format *ef, char *insert_str)
+/* Порции из целых строк выводятся через буфер, заголовок - в первой порции первой части,
+окончание - в последней порции последней части */
+{
+	char buf[HEXPRN_STREAM_BUF];
+	struct Emit_State es;
+	struct Trans_Result64 tr;
+	size_t used = 0, pos = 0, part, part_lines, tail_length = 0;
+
+	memset(&tr, 0, sizeof(tr));
+	tr.error = 1;
+	if (sink == NULL || (byte_array == NULL && byte_count != 0) || emit_init(&es, ef, insert_str) < 0)
+		return tr;
+	if (more && byte_count % es.ef.line_bytes != 0)  // неполная строка не в последней части
+		return tr;
+	tr.single_length = emit_line_length(&es, es.ef.line_bytes, 0);
+	tr.add_length = es.add_length;
+	if (!more)
+		tail_length = emit_frame(NULL, &es, offset + byte_count, 1);
+	if (tr.single_length > HEXPRN_STREAM_BUF || emit_frame(NULL, &es, 0, 0) > HEXPRN_STREAM_BUF
+		|| tail_length > HEXPRN_STREAM_BUF)
+		return tr;
+
+	if (more && byte_count == 0)  // пустая промежуточная часть ничего не выводит
+	{
+		tr.error = 0;
+		return tr;
+	}
+	if (offset == 0)
+		used = emit_frame(buf, &es, 0, 0);
+	tr.char_count = used;
+	do
+	{
+		/* сколько целых строк помещается в остаток буфера */
+		part_lines = (HEXPRN_STREAM_BUF - used) / tr.single_length;
+		if (part_lines == 0)
+		{
+			if (sink(sink_arg, buf, used) != used)
+				return tr;
+			used = 0;
+			continue;
+		}
+		part = part_lines * es.ef.line_bytes;
+		if (part > byte_count - pos)
+			part = byte_count - pos;
+		used += emit_lines(buf + used, &es, byte_array + pos, part, !more && pos + part == byte_count, &tr);
+		pos += part;
+
+		/* окончание дописывается в буфер, если помещается */
+		if (pos == byte_count && tail_length != 0 && used + tail_length <= HEXPRN_STREAM_BUF)
+		{
+			used += emit_frame(buf + used, &es, offset + byte_count, 1);
+			tr.char_count += tail_length;
+			tail_length = 0;
+		}
+		if (sink(sink_arg, buf, used) != used)
+			return tr;
+		used = 0;
+	}
+	while (pos < byte_count);
+
+	if (tail_length != 0)
+	{
+		used = emit_frame(buf, &es, offset + byte_count, 1);
+		if (sink(sink_arg, buf, used) != used)
+			return tr;
+		tr.char_count += used;
+	}
+	tr.error = 0;
+	return tr;
+}
+
+/* Потоковый вывод через функцию записи sink порциями из целых строк */
+struct Trans_Result64 stream_hexemit(hexprn_sink sink, void *sink_arg, byte *byte_array, size_t byte_count,
+	struct Emit_Format *ef, char *insert_str)
+{
+	return stream_hexemit_part(sink, sink_arg, byte_array, byte_count, 0, 0, ef, insert_str);
+}
+
+/* Потоковый вывод в файл fp */
+struct Trans_Result64 fhexemit(FILE *fp, byte *byte_array, size_t byte_count,
+	struct Emit_Format *ef, char *insert_str)
+{
+	struct Trans_Result64 tr;
+	if (fp == NULL)
+	{
+		memset(&tr, 0, sizeof(tr));
+		tr.error = 1;
+		return tr;
+	}
+	return stream_hexemit(hexprn_sink_file, fp, byte_array, byte_count, ef, insert_str);
+}
@@ -0,0 +1,84 @@
+/*
+	hexgrep.h
+	Поиск образцов в массиве байт с выводом адресных строк вокруг найденных мест
+
+Один образец ищется векторным bytes_find(), несколько - автоматом Ахо-Корасик, переходы которого
+по всем значениям байта заранее сведены в таблицу: на байт массива приходится одна выборка
+из таблицы без возвратов по ссылкам неудач. Вокруг каждого найденного места выводятся его адресные
+строки и context строк до и после, пересекающиеся и соседние окна сливаются, между окнами
+выводится разделитель, как у grep -C. Ячейки байт найденных мест отмечаются sprn_mark(),
+как отличия в hexdiff. Строки выводятся по сетке адресов, как у stream_hexprnc64(), без цвета
+и без сжатия повторов.
+*/
+#ifndef HEXGREP_H
+#define HEXGREP_H
+
+#include "hexprn.h"
+
+/* наибольшее число образцов */
+#define HEXGREP_PATTERNS_MAX 0x100
+
+/* наибольшая суммарная длина образцов, байт: таблица переходов автомата до 4 Мбайт */
+#define HEXGREP_PATTERN_BYTES_MAX 0x1000
+
+/* скомпилированный набор образцов, только для чтения после создания */
+struct Hexgrep;
+
+/* структура, определяющая параметры вывода */
+struct Grep_Format
+{
+	char mark;        // символ отметки ячеек найденных байт, как у Diff_Format
+	size_t context;   // число адресных строк до и после строк найденного места
+	char *separator;  // строка между несмежными окнами, за ней добавочная строка; NULL - без разделителя
+};
+
+/* Структура, определяющая результат поиска */
+struct Grep_Result
+{
+	uint64_t match_count;   // число вхождений образцов, в том числе перекрывающихся
+	uint64_t window_count;  // число выведенных окон
+	uint64_t str_count;     // число выведенных адресных строк
+	uint64_t char_count;    // число выведенных символов
+	int error;              // != 0 ошибка аргументов, памяти или записи
+};
+
+/* возврат параметров вывода по умолчанию */
+struct Grep_Format ret_default_gf();
+
+/* Компилирует count образцов patterns длиной lengths (образцы копируются).
+Возвращает набор или NULL при ошибке: нет образцов, пустой образец, превышены
+HEXGREP_PATTERNS_MAX или HEXGREP_PATTERN_BYTES_MAX, нет памяти. */
+struct Hexgrep *hexgrep_create(const byte *const *patterns, const size_t *lengths, size_t count);
+
+/* освобождение набора образцов */
+void hexgrep_destroy(struct Hexgrep *g);
+
+/* Поиск первого вхождения с началом не раньше from: вхождения упорядочены по концу,
+из вхождений с общим концом берется самое длинное. Записывает его длину в *length (если не NULL)
+и возвращает смещение его начала или count, если вхождений нет. */
+size_t hexgrep_find(struct Hexgrep *g, const byte *bytes, size_t count, size_t from, size_t *length);
+
+/* Потоковый поиск по скомпилированному формату с выводом окон через функцию записи sink */
+struct Grep_Result stream_hexgrepc(hexprn_sink sink, void *sink_arg, byte *byte_array, size_t byte_count,
+	qword address_start, struct Hexgrep *g, struct Compiled_Format *cf, char *insert_str, struct Grep_Format *gf);
+/* Параметры:
+	sink, sink_arg - функция записи и её аргумент, как у stream_hexprnc()
+	byte_array, byte_count, address_start - массив, его длина и адрес нулевого байта
+	g          - набор образцов
+	cf         - скомпилированный формат адресных строк
+	insert_str - строка после каждой выведенной строки, если NULL, то без вставки
+	gf         - параметры вывода, если NULL, то по умолчанию
+Массив просматривается один раз, строки окна выводятся, как только ни одно следующее вхождение
+не может их отметить или продлить окно, поэтому память не зависит от числа вхождений.
+Строки выводятся порциями через буфер HEXPRN_STREAM_BUF. Возвращает структуру Grep_Result.
+*/
+
+/* Поиск с заданным форматом tf и выводом в файл fp */
+struct Grep_Result fhexgrepf(FILE *fp, byte *byte_array, size_t byte_count, qword address_start,
+	struct Hexgrep *g, struct Trans_Format *tf, char *insert_str, struct Grep_Format *gf);
+
+/* Поиск одного образца с форматом и параметрами по умолчанию и выводом в файл fp */
+struct Grep_Result fhexgrep(FILE *fp, byte *byte_array, size_t byte_count, qword address,
+	const byte *pattern, size_t pattern_length);
+
+#endif //HEXGREP_H
@@ -0,0 +1,557 @@
+/*
+	hexgrep.c
+	Поиск образцов в массиве байт с выводом адресных строк вокруг найденных мест
+*/
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "hexgrep.h"
+
+/* Элемент таблицы переходов: смещение строки состояния в таблице (номер состояния * 0x100)
+и признак GREP_OUT - в состоянии оканчивается хотя бы один образец. Смещения строк кратны 0x100,
+поэтому признак занимает свободный младший разряд, и цикл поиска проверяет его без второй выборки. */
+#define GREP_ROW 0x100
+#define GREP_OUT 1u
+#define GREP_NONE UINT32_MAX  // нет перехода (при построении бора)
+
+/* набор образцов */
+struct Hexgrep
+{
+	size_t count;          // число образцов
+	size_t max_length;     // длина самого длинного образца
+	byte *single;          // единственный образец, ищется bytes_find(); NULL - автомат
+	size_t single_length;
+	size_t states;         // число состояний автомата
+	uint32_t *next;        // таблица переходов states * GREP_ROW
+	uint32_t *out_length;  // длина самого длинного образца, оканчивающегося в состоянии
+	uint32_t *out_count;   // число образцов, оканчивающихся в состоянии
+	byte start[BYTES_SET_MAX];  // первые байты образцов для пропуска байт в начальном состоянии
+	size_t start_count;    // их число, 0 - первых байт больше BYTES_SET_MAX, без пропуска
+};
+
+/* отмеченный участок [start, end) массива */
+struct Grep_Span
+{
+	size_t start, end;
+};
+
+/* состояние поиска */
+struct Grep_State
+{
+	hexprn_sink sink;
+	void *sink_arg;
+	struct Compiled_Format *cf;
+	char *insert_str;
+	size_t add_length;
+	struct Grep_Format gf;
+	size_t sep_length;
+	const byte *bytes;
+	size_t count;
+	qword address;            // адрес нулевой ячейки строки 0
+	size_t offset;            // число пустых ячеек перед нулевым байтом в строке 0
+	uint64_t lines;           // число адресных строк массива
+	struct Grep_Span *spans;  // отмеченные участки, еще не выведенные целиком, по возрастанию
+	size_t head, tail, spans_size;
+	uint64_t line;            // следующая строка, еще не выведенная и не пропущенная
+	int hit;                  // != 0 - были выведенные целиком участки
+	uint64_t hit_line;        // последняя строка последнего из них
+	uint64_t printed_end;     // строка за последней выведенной, 0 - строк еще не было
+	struct Grep_Result gr;    // накопленный результат
+	size_t used;              // заполнено символов в буфере
+	char buf[HEXPRN_STREAM_BUF];  // буфер вывода
+};
+
+/* возврат параметров вывода по умолчанию */
+struct Grep_Format ret_default_gf()
+{
+	struct Grep_Format gf;
+	gf.mark = '#';
+	gf.context = 2;
+	gf.separator = "--";
+	return gf;
+}
+
+/* Построение автомата: бор образцов, затем обход в ширину, при котором отсутствующие
+переходы состояния заменяются переходами его ссылки неудачи, уже построенными на меньшей глубине */
+static int build_automaton(struct Hexgrep *g, const byte *const *patterns, const size_t *lengths)
+{
+	uint32_t *fail, *queue;
+	size_t i, j, c, s, t, f, states = 1, total = 0, qh = 0, qt = 0;
+
+	for (i = 0; i < g->count; i++)
+		total += lengths[i];
+	g->next = (uint32_t *) malloc((total + 1) * GREP_ROW * sizeof(uint32_t));
+	g->out_length = (uint32_t *) calloc(total + 1, sizeof(uint32_t));
+	g->out_count = (uint32_t *) calloc(total + 1, sizeof(uint32_t));
+	fail = (uint32_t *) malloc((total + 1) * sizeof(uint32_t));
+	queue = (uint32_t *) malloc((total + 1) * sizeof(uint32_t));
+	if (g->next == NULL || g->out_length == NULL || g->out_count == NULL || fail == NULL || queue == NULL)
+	{
+		free(fail);
+		free(queue);
+		return -1;
+	}
+
+	/* бор: переходы хранятся номерами состояний */
+	for (c = 0; c < GREP_ROW; c++)
+		g->next[c] = GREP_NONE;
+	for (i = 0; i < g->count; i++)
+	{
+		for (s = 0, j = 0; j < lengths[i]; j++)
+		{
+			t = g->next[s * GREP_ROW + patterns[i][j]];
+			if (t == GREP_NONE)
+			{
+				t = states++;
+				for (c = 0; c < GREP_ROW; c++)
+					g->next[t * GREP_ROW + c] = GREP_NONE;
+				g->next[s * GREP_ROW + patterns[i][j]] = (uint32_t) t;
+			}
+			s = t;
+		}
+		g->out_length[s] = (uint32_t) lengths[i];
+		g->out_count[s]++;
+	}
+
+	/* обход в ширину: ссылка неудачи - состояние самого длинного собственного суффикса */
+	for (c = 0; c < GREP_ROW; c++)
+	{
+		t = g->next[c];
+		if (t == GREP_NONE)
+			g->next[c] = 0;
+		else
+		{
+			fail[t] = 0;
+			queue[qt++] = (uint32_t) t;
+		}
+	}
+	while (qh < qt)
+	{
+		s = queue[qh++];
+		f = fail[s];
+		if (g->out_length[s] == 0)
+			g->out_length[s] = g->out_length[f];
+		g->out_count[s] += g->out_count[f];
+		for (c = 0; c < GREP_ROW; c++)
+		{
+			t = g->next[s * GREP_ROW + c];
+			if (t == GREP_NONE)
+				g->next[s * GREP_ROW + c] = g->next[f * GREP_ROW + c];
+			else
+			{
+				fail[t] = g->next[f * GREP_ROW + c];
+				queue[qt++] = (uint32_t) t;
+			}
+		}
+	}
+
+	/* различные первые байты образцов: переходы из начального состояния не в него */
+	for (c = 0; c < GREP_ROW; c++)
+		if (g->next[c] != 0)
+		{
+			if (g->start_count == BYTES_SET_MAX)
+			{
+				g->start_count = 0;
+				break;
+			}
+			g->start[g->start_count++] = (byte) c;
+		}
+
+	/* переходы в смещения строк с признаком окончания образца */
+	for (i = 0; i < states * GREP_ROW; i++)
+	{
+		t = g->next[i];
+		g->next[i] = (uint32_t) (t * GREP_ROW) | (g->out_length[t] != 0 ? GREP_OUT : 0);
+	}
+	g->states = states;
+	free(fail);
+	free(queue);
+	return 0;
+}
+
+/* Компилирует набор образцов */
+struct Hexgrep *hexgrep_create(const byte *const *patterns, const size_t *lengths, size_t count)
+{
+	struct Hexgrep *g;
+	size_t i, total = 0;
+
+	if (patterns == NULL || lengths == NULL || count == 0 || count > HEXGREP_PATTERNS_MAX)
+		return NULL;
+	for (i = 0; i < count; i++)
+	{
+		if (patterns[i] == NULL || lengths[i] == 0 || lengths[i] > HEXGREP_PATTERN_BYTES_MAX - total)
+			return NULL;
+		total += lengths[i];
+	}
+
+	g = (struct Hexgrep *) calloc(1, sizeof(struct Hexgrep));
+	if (g == NULL)
+		return NULL;
+	g->count = count;
+	for (i = 0; i < count; i++)
+		if (lengths[i] > g->max_length)
+			g->max_length = lengths[i];
+
+	/* один образец - векторный поиск, иначе автомат */
+	if (count == 1)
+	{
+		g->single = (byte *) malloc(lengths[0]);
+		if (g->single == NULL)
+		{
+			free(g);
+			return NULL;
+		}
+		memcpy(g->single, patterns[0], lengths[0]);
+		g->single_length = lengths[0];
+	}
+	else if (build_automaton(g, patterns, lengths) < 0)
+	{
+		hexgrep_destroy(g);
+		return NULL;
+	}
+	return g;
+}
+
+/* освобождение набора образцов */
+void hexgrep_destroy(struct Hexgrep *g)
+{
+	if (g == NULL)
+		return;
+	free(g->single);
+	free(g->next);
+	free(g->out_length);
+	free(g->out_count);
+	free(g);
+}
+
+/* Следующее вхождение с концом после *pos, состояние автомата *e переносится между вызовами.
+Записывает начало и конец вхождения и число оканчивающихся там образцов, возвращает 0,
+если вхождений больше нет. */
+static int grep_next(struct Hexgrep *g, const byte *bytes, size_t count, size_t *pos, uint32_t *e,
+	size_t *start, size_t *end, uint32_t *matches)
+{
+	const uint32_t *next = g->next;
+	uint32_t x = *e;
+	size_t i, p;
+
+	if (g->single != NULL)
+	{
+		if (*pos >= count)
+			return 0;
+		p = bytes_find(bytes + *pos, count - *pos, g->single, g->single_length);
+		if (p == count - *pos)
+		{
+			*pos = count;
+			return 0;
+		}
+		*start = *pos + p;
+		*end = *start + g->single_length;
+		*pos = *start + 1;
+		*matches = 1;
+		return 1;
+	}
+
+	for (i = *pos; i < count; i++)
+	{
+		/* в начальном состоянии пропускаются байты, с которых не начинается ни один образец */
+		if (x == 0 && g->start_count != 0)
+		{
+			i += bytes_find_any(bytes + i, count - i, g->start, g->start_count);
+			if (i == count)
+				break;
+		}
+		x = next[(x & ~GREP_OUT) + bytes[i]];
+		if (x & GREP_OUT)
+		{
+			*end = i + 1;
+			*start = *end - g->out_length[x / GREP_ROW];
+			*matches = g->out_count[x / GREP_ROW];
+			*pos = i + 1;
+			*e = x;
+			return 1;
+		}
+	}
+	*pos = count;
+	*e = x;
+	return 0;
+}
+
+/* Поиск первого вхождения с началом не раньше from */
+size_t hexgrep_find(struct Hexgrep *g, const byte *bytes, size_t count, size_t from, size_t *length)
+{
+	size_t pos = from, start, end;
+	uint32_t e = 0, matches;
+
+	if (g == NULL || bytes == NULL || from > count || !grep_next(g, bytes, count, &pos, &e, &start, &end, &matches))
+		return count;
+	if (length != NULL)
+		*length = end - start;
+	return start;
+}
+
+/* передача буфера в sink, возвращает 0 при успехе */
+static int grep_flush(struct Grep_State *st)
+{
+	if (st->used != 0 && st->sink(st->sink_arg, st->buf, st->used) != st->used)
+	{
+		st->gr.error = 1;
+		return -1;
+	}
+	st->used = 0;
+	return 0;
+}
+
+/* номер адресной строки байта b */
+static uint64_t grep_line(struct Grep_State *st, size_t b)
+{
+	return ((uint64_t) st->offset + b) / st->cf->line_bytes;
+}
+
+/* запись n символов s и добавочной строки в буфер, возвращает 0 при успехе */
+static int grep_put(struct Grep_State *st, const char *s, size_t n)
+{
+	if (st->used + n + st->add_length > HEXPRN_STREAM_BUF && grep_flush(st) < 0)
+		return -1;
+	memcpy(st->buf + st->used, s, n);
+	if (st->add_length != 0)
+		memcpy(st->buf + st->used + n, st->insert_str, st->add_length);
+	st->used += n + st->add_length;
+	st->gr.char_count += n + st->add_length;
+	return 0;
+}
+
+/* Вывод адресной строки line с отметкой ячеек байт отмеченных участков */
+static int grep_row(struct Grep_State *st, uint64_t line)
+{
+	struct Compiled_Format *cf = st->cf;
+	size_t lb = cf->line_bytes;
+	uint64_t line_start = line * lb;  // номер нулевой ячейки строки от начала сетки
+	size_t lo = line_start > st->offset ? (size_t) (line_start - st->offset) : 0;
+	size_t hi = (size_t) (line_start + lb - st->offset);
+	size_t first = (size_t) (st->offset + lo - line_start);
+	size_t i, b, end;
+	char *r;
+
+	if (hi > st->count)
+		hi = st->count;
+
+	/* разделитель перед несмежным окном */
+	if (st->printed_end == 0 || line != st->printed_end)
+	{
+		if (st->printed_end != 0 && st->gf.separator != NULL && grep_put(st, st->gf.separator, st->sep_length) < 0)
+			return -1;
+		st->gr.window_count++;
+	}
+
+	if (st->used + cf->line_length + st->add_length > HEXPRN_STREAM_BUF && grep_flush(st) < 0)
+		return -1;
+	r = st->buf + st->used;
+	sprn_line(r, cf, st->bytes + lo, st->address + line_start, first, hi - lo);
+
+	/* отметка ячеек: участки, пересекающие строку */
+	for (i = st->head; i < st->tail && st->spans[i].start < hi; i++)
+	{
+		if (st->spans[i].end <= lo)
+			continue;
+		b = st->spans[i].start > lo ? st->spans[i].start : lo;
+		end = st->spans[i].end < hi ? st->spans[i].end : hi;
+		for (; b < end; b += cf->word_bytes - (first + b - lo) % cf->word_bytes)
+			sprn_mark(r, cf, first + b - lo, st->gf.mark);
+	}
+	if (st->add_length != 0)
+		memcpy(r + cf->line_length, st->insert_str, st->add_length);
+
+	st->used += cf->line_length + st->add_length;
+	st->gr.str_count++;
+	st->gr.char_count += cf->line_length + st->add_length;
+	st->printed_end = line + 1;
+	return 0;
+}
+
+/* Вывод или пропуск строк до строки limit (не включая): строка выводится, если она не дальше
+context строк от строк какого-либо отмеченного участка */
+static int grep_emit(struct Grep_State *st, uint64_t limit)
+{
+	uint64_t ctx = st->gf.context;
+	uint64_t s;
+	struct Grep_Span *sp;
+
+	if (limit > st->lines)
+		limit = st->lines;
+	while (st->line < limit)
+	{
+		/* участки, целиком лежащие до текущей строки, больше не нужны */
+		while (st->head < st->tail && grep_line(st, st->spans[st->head].end - 1) < st->line)
+		{
+			st->hit = 1;
+			st->hit_line = grep_line(st, st->spans[st->head].end - 1);
+			st->head++;
+		}
+		if (!(st->hit && st->line <= st->hit_line + ctx))
+		{
+			/* пропуск строк до окна следующего участка */
+			sp = st->head < st->tail ? &st->spans[st->head] : NULL;
+			s = sp != NULL ? grep_line(st, sp->start) : limit;
+			if (sp == NULL || s > st->line + ctx)
+			{
+				s = sp != NULL ? s - ctx : limit;
+				st->line = s < limit ? s : limit;
+				continue;
+			}
+		}
+		if (grep_row(st, st->line) < 0)
+			return -1;
+		st->line++;
+	}
+	return 0;
+}
+
+/* Добавление отмеченного участка [start, end): пересекающиеся и смежные участки сливаются */
+static int grep_span(struct Grep_State *st, size_t start, size_t end)
+{
+	struct Grep_Span *p;
+
+	while (st->tail > st->head && st->spans[st->tail - 1].end >= start)
+	{
+		st->tail--;
+		if (st->spans[st->tail].start < start)
+			start = st->spans[st->tail].start;
+		if (st->spans[st->tail].end > end)
+			end = st->spans[st->tail].end;
+	}
+	if (st->tail == st->spans_size)
+	{
+		/* сдвиг к началу или расширение массива */
+		if (st->head > st->spans_size / 2)
+		{
+			memmove(st->spans, st->spans + st->head, (st->tail - st->head) * sizeof(struct Grep_Span));
+			st->tail -= st->head;
+			st->head = 0;
+		}
+		else
+		{
+			p = (struct Grep_Span *) realloc(st->spans, 2 * st->spans_size * sizeof(struct Grep_Span));
+			if (p == NULL)
+			{
+				st->gr.error = 1;
+				return -1;
+			}
+			st->spans = p;
+			st->spans_size *= 2;
+		}
+	}
+	st->spans[st->tail].start = start;
+	st->spans[st->tail].end = end;
+	st->tail++;
+	return 0;
+}
+
+/* Потоковый поиск по скомпилированному формату */
+struct Grep_Result stream_hexgrepc(hexprn_sink sink, void *sink_arg, byte *byte_array, size_t byte_count,
+	qword address_start, struct Hexgrep *g, struct Compiled_Format *cf, char *insert_str, struct Grep_Format *gf)
+{
+	struct Grep_State *st;
+	struct Grep_Result gr;
+	size_t pos = 0, start, end, safe;
+	uint32_t e = 0, matches;
+	uint64_t line;
+
+	memset(&gr, 0, sizeof(gr));
+	gr.error = 1;
+
+	/* проверка аргументов */
+	if (sink == NULL || g == NULL || cf == NULL || (byte_array == NULL && byte_count != 0))
+		return gr;
+
+	/* состояние с буфером вывода выделяется в куче, чтобы не занимать стек */
+	st = (struct Grep_State *) malloc(sizeof(struct Grep_State));
+	if (st == NULL)
+		return gr;
+	st->sink = sink;
+	st->sink_arg = sink_arg;
+	st->cf = cf;
+	st->insert_str = insert_str;
+	st->add_length = insert_str == NULL ? 0 : strlen(insert_str);
+	st->gf = gf == NULL ? ret_default_gf() : *gf;
+	st->sep_length = st->gf.separator == NULL ? 0 : strlen(st->gf.separator);
+	st->bytes = byte_array;
+	st->count = byte_count;
+	st->offset = (size_t) (address_start % cf->line_bytes);
+	st->address = address_start - st->offset;
+	st->lines = ((uint64_t) st->offset + byte_count + cf->line_bytes - 1) / cf->line_bytes;
+	st->spans_size = 0x40;
+	st->spans = (struct Grep_Span *) malloc(st->spans_size * sizeof(struct Grep_Span));
+	st->head = st->tail = 0;
+	st->line = 0;
+	st->hit = 0;
+	st->hit_line = 0;
+	st->printed_end = 0;
+	st->used = 0;
+	memset(&st->gr, 0, sizeof(st->gr));
+	if (st->spans == NULL || cf->line_length + st->add_length > HEXPRN_STREAM_BUF
+		|| st->sep_length + st->add_length > HEXPRN_STREAM_BUF)
+	{
+		free(st->spans);
+		free(st);
+		return gr;
+	}
+
+	while (grep_next(g, byte_array, byte_count, &pos, &e, &start, &end, &matches))
+	{
+		st->gr.match_count += matches;
+		if (grep_span(st, start, end) < 0)
+			break;
+
+		/* следующие вхождения начинаются не раньше safe: строки, которые они не могут
+		отметить или включить в окно, выводятся */
+		safe = end + 1 > g->max_length ? end + 1 - g->max_length : 0;
+		line = grep_line(st, safe);
+		if (line > st->gf.context && grep_emit(st, line - st->gf.context) < 0)
+			break;
+	}
+
+	/* строки после последнего вхождения */
+	if (st->gr.error == 0)
+		grep_emit(st, st->lines);
+	if (st->gr.error == 0)
+		grep_flush(st);
+
+	gr = st->gr;
+	free(st->spans);
+	free(st);
+	return gr;
+}
+
+/* Поиск с заданным форматом tf и выводом в файл fp */
+struct Grep_Result fhexgrepf(FILE *fp, byte *byte_array, size_t byte_count, qword address_start,
+	struct Hexgrep *g, struct Trans_Format *tf, char *insert_str, struct Grep_Format *gf)
+{
+	struct Compiled_Format cf;
+	struct Grep_Result gr;
+	memset(&gr, 0, sizeof(gr));
+	gr.error = 1;
+
+	if (fp == NULL || compile_tf(&cf, tf) == NULL)
+		return gr;
+	return stream_hexgrepc(hexprn_sink_file, fp, byte_array, byte_count, address_start, g, &cf, insert_str, gf);
+}
+
+/* Поиск одного образца с форматом и параметрами по умолчанию и выводом в файл fp */
+struct Grep_Result fhexgrep(FILE *fp, byte *byte_array, size_t byte_count, qword address,
+	const byte *pattern, size_t pattern_length)
+{
+	struct Trans_Format tf = ret_default_tf();
+	struct Grep_Result gr;
+	struct Hexgrep *g = hexgrep_create(&pattern, &pattern_length, 1);
+
+	if (g == NULL)
+	{
+		memset(&gr, 0, sizeof(gr));
+		gr.error = 1;
+		return gr;
+	}
+	gr = fhexgrepf(fp, byte_array, byte_count, address, g, &tf, "\n", NULL);
+	hexgrep_destroy(g);
+	return gr;
+}
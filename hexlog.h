@@ -0,0 +1,77 @@
+/*
+	hexlog.h
+	Асинхронная запись дампов: копирование байт в кольца потоков-источников и преобразование в отдельном потоке
+
+Вызов fhexprn() из потока обработки пакетов добавляет к задержке преобразование, выделение памяти
+и блокировку потока вывода stdio. Журнал переносит эту работу в поток записи: поток-источник только
+копирует байты, адрес и номер формата в свое кольцо (один memcpy ограниченного размера, без блокировок
+и системных вызовов), а поток записи забирает записи из всех колец, преобразует их stream_hexprnc64()
+и передает в функцию записи. У каждого кольца один источник и один потребитель (SPSC), поэтому
+позиции записи и чтения меняются без блокировок. Поток-источник не будит поток записи: тот сам
+проверяет кольца не реже чем через HEXLOG_IDLE_USEC, поэтому кольцо должно вмещать записи
+источника за это время. Если места в кольце нет, запись отбрасывается и учитывается в счетчиках
+отброшенных записей.
+*/
+#ifndef HEXLOG_H
+#define HEXLOG_H
+
+#include "hexprn.h"
+
+/* размер кольца потока-источника по умолчанию, байт */
+#define HEXLOG_RING_SIZE 0x100000
+
+/* наименьший размер кольца, размер округляется вверх до степени двойки */
+#define HEXLOG_RING_MIN 0x1000
+
+/* наибольшее число форматов журнала */
+#define HEXLOG_FORMATS_MAX 16
+
+/* время ожидания потока записи при пустых кольцах, микросекунды: наибольшая задержка до обработки записи */
+#define HEXLOG_IDLE_USEC 1000
+
+/* журнал: форматы, кольца потоков-источников и поток записи */
+struct Hexlog;
+
+/* кольцо одного потока-источника */
+struct Hexlog_Ring;
+
+/* счетчики журнала */
+struct Hexlog_Stats
+{
+	uint64_t records;        // число принятых записей
+	uint64_t bytes;          // число байт в них
+	uint64_t dropped;        // число отброшенных записей: кольцо заполнено, запись больше половины кольца или 4 ГиБ
+	uint64_t dropped_bytes;  // число байт в них
+	uint64_t char_count;     // число символов, переданных в функцию записи
+	uint64_t errors;         // число записей, не преобразованных или не записанных полностью
+};
+
+/* Создает журнал с выводом через функцию записи sink и запускает поток записи.
+sink вызывается только из потока записи. Возвращает журнал или NULL при ошибке. */
+struct Hexlog *hexlog_create(hexprn_sink sink, void *sink_arg);
+
+/* Записывает все принятые записи, останавливает поток записи и освобождает журнал и его кольца */
+void hexlog_destroy(struct Hexlog *log);
+
+/* Добавляет формат tf с добавочной строкой insert_str (копируется).
+Возвращает номер формата для hexlog_write() или -1 при ошибке. */
+int hexlog_format(struct Hexlog *log, struct Trans_Format *tf, char *insert_str);
+
+/* Создает кольцо размером ring_size байт (0 - HEXLOG_RING_SIZE) для вызывающего потока-источника.
+Кольцо используется одним потоком и освобождается hexlog_destroy(). Возвращает кольцо или NULL. */
+struct Hexlog_Ring *hexlog_ring_create(struct Hexlog *log, size_t ring_size);
+
+/* Копирует byte_count байт с адресом address_start и номером формата format_id в кольцо.
+Возвращает 0 или -1, если запись отброшена (нет места, byte_count больше половины кольца
+или больше UINT32_MAX) или аргументы ошибочны. */
+int hexlog_write(struct Hexlog_Ring *ring, int format_id, const byte *byte_array, size_t byte_count,
+	qword address_start);
+
+/* Ожидает, пока поток записи передаст в sink все записи, принятые до вызова.
+Возвращает 0 или -1, если были ошибки преобразования или записи. */
+int hexlog_flush(struct Hexlog *log);
+
+/* Заполняет st текущими значениями счетчиков журнала */
+void hexlog_stats(struct Hexlog *log, struct Hexlog_Stats *st);
+
+#endif //HEXLOG_H
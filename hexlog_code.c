@@ -0,0 +1,375 @@
+/*
+	hexlog.c
+	Асинхронная запись дампов: копирование байт в кольца потоков-источников и преобразование в отдельном потоке
+*/
+#define _POSIX_C_SOURCE 200809L  // clock_gettime()
+
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+
+#include "hexlog.h"
+
+/* размер строки кэша: позиции записи и чтения кольца разносятся по разным строкам */
+#define LOG_CACHE_LINE 64
+
+/* Заголовок записи в кольце, за ним байты записи, выровненные до LOG_ALIGN.
+Если до конца кольца меньше заголовка или записана пустая запись (format < 0),
+чтение продолжается с начала кольца. */
+struct Log_Record
+{
+	uint32_t length;  // число байт записи
+	int32_t format;   // номер формата, -1 - пустая запись до конца кольца
+	qword address;    // адрес первого байта
+};
+
+#define LOG_ALIGN 8
+#define LOG_HEADER sizeof(struct Log_Record)
+
+/* Формат журнала */
+struct Log_Format
+{
+	struct Compiled_Format cf;
+	char *insert_str;
+};
+
+/* Кольцо потока-источника */
+struct Hexlog_Ring
+{
+	struct Hexlog *log;
+	struct Hexlog_Ring *next;  // следующее кольцо журнала
+	byte *buf;
+	size_t size;               // размер buf, степень двойки
+
+	/* изменяются только источником */
+	uint64_t head;             // позиция записи
+	uint64_t tail_cache;       // последняя прочитанная источником позиция чтения
+	uint64_t records, bytes;   // принятые записи и байты
+	uint64_t dropped, dropped_bytes;  // отброшенные записи и байты
+	byte pad[LOG_CACHE_LINE];
+
+	/* изменяется только потоком записи */
+	uint64_t tail;             // позиция чтения
+};
+
+/* Журнал */
+struct Hexlog
+{
+	hexprn_sink sink;
+	void *sink_arg;
+	struct Log_Format formats[HEXLOG_FORMATS_MAX];
+	int format_count;          // число форматов, публикуется после заполнения формата
+	struct Hexlog_Ring *rings; // список колец, новое кольцо добавляется в начало
+
+	pthread_t writer;
+	pthread_mutex_t lock;
+	pthread_cond_t work;       // есть работа: запрос записи или остановка
+	pthread_cond_t flushed;    // выполнен запрос записи
+	uint64_t flush_req;        // номер последнего запроса записи
+	uint64_t flush_done;       // номер последнего выполненного запроса
+	int stop;
+
+	/* изменяются только потоком записи */
+	uint64_t char_count;
+	uint64_t errors;
+};
+
+/* размер записи из byte_count байт в кольце */
+static size_t log_record_size(size_t byte_count)
+{
+	return LOG_HEADER + (byte_count + (LOG_ALIGN - 1)) / LOG_ALIGN * LOG_ALIGN;
+}
+
+/* Забирает все записи кольца, возвращает их число */
+static size_t log_drain_ring(struct Hexlog *log, struct Hexlog_Ring *ring)
+{
+	uint64_t head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+	uint64_t tail = ring->tail;
+	size_t mask = ring->size - 1;
+	size_t pos, to_end, count = 0;
+	struct Log_Record *rec;
+	struct Log_Format *fmt;
+	struct Trans_Result64 tr;
+	while (tail != head)
+	{
+		pos = (size_t) tail & mask;
+		to_end = ring->size - pos;
+		rec = (struct Log_Record *) (ring->buf + pos);
+		if (to_end < LOG_HEADER || rec->format < 0)
+		{
+			tail += to_end;
+			continue;
+		}
+
+		fmt = &log->formats[rec->format];
+		tr = stream_hexprnc64(log->sink, log->sink_arg, ring->buf + pos + LOG_HEADER, rec->length,
+			rec->address, &fmt->cf, fmt->insert_str);
+		__atomic_store_n(&log->char_count, log->char_count + tr.char_count, __ATOMIC_RELAXED);
+		if (tr.error || tr.byte_count != rec->length)
+			__atomic_store_n(&log->errors, log->errors + 1, __ATOMIC_RELAXED);
+
+		/* место освобождается сразу после каждой записи */
+		tail += log_record_size(rec->length);
+		__atomic_store_n(&ring->tail, tail, __ATOMIC_RELEASE);
+		count++;
+	}
+	__atomic_store_n(&ring->tail, tail, __ATOMIC_RELEASE);
+	return count;
+}
+
+/* Поток записи: обходит кольца, пока в них есть записи, затем отвечает на запросы записи
+и ожидает работы не дольше HEXLOG_IDLE_USEC */
+static void *log_writer(void *arg)
+{
+	struct Hexlog *log = (struct Hexlog *) arg;
+	struct Hexlog_Ring *ring;
+	struct timespec ts;
+	uint64_t req;
+	size_t count;
+	int stop;
+
+	pthread_mutex_lock(&log->lock);
+	for (;;)
+	{
+		req = log->flush_req;
+		stop = log->stop;
+		pthread_mutex_unlock(&log->lock);
+
+		/* обход до первого прохода без записей: записи, принятые до запроса, переданы в sink */
+		do
+		{
+			count = 0;
+			for (ring = __atomic_load_n(&log->rings, __ATOMIC_ACQUIRE); ring != NULL; ring = ring->next)
+				count += log_drain_ring(log, ring);
+		}
+		while (count != 0);
+
+		pthread_mutex_lock(&log->lock);
+		if (req != log->flush_done)
+		{
+			log->flush_done = req;
+			pthread_cond_broadcast(&log->flushed);
+		}
+		if (stop)
+			break;
+		if (log->flush_req == req && !log->stop)
+		{
+			clock_gettime(CLOCK_REALTIME, &ts);
+			ts.tv_nsec += HEXLOG_IDLE_USEC * 1000L;
+			if (ts.tv_nsec >= 1000000000L)
+			{
+				ts.tv_sec++;
+				ts.tv_nsec -= 1000000000L;
+			}
+			pthread_cond_timedwait(&log->work, &log->lock, &ts);
+		}
+	}
+	pthread_mutex_unlock(&log->lock);
+	return NULL;
+}
+
+/* Создает журнал с выводом через функцию записи sink и запускает поток записи */
+struct Hexlog *hexlog_create(hexprn_sink sink, void *sink_arg)
+{
+	if (sink == NULL)
+		return NULL;
+	struct Hexlog *log = (struct Hexlog *) calloc(1, sizeof(struct Hexlog));
+	if (log == NULL)
+		return NULL;
+	log->sink = sink;
+	log->sink_arg = sink_arg;
+	pthread_mutex_init(&log->lock, NULL);
+	pthread_cond_init(&log->work, NULL);
+	pthread_cond_init(&log->flushed, NULL);
+	if (pthread_create(&log->writer, NULL, log_writer, log) != 0)
+	{
+		pthread_cond_destroy(&log->flushed);
+		pthread_cond_destroy(&log->work);
+		pthread_mutex_destroy(&log->lock);
+		free(log);
+		return NULL;
+	}
+	return log;
+}
+
+/* Записывает все принятые записи, останавливает поток записи и освобождает журнал */
+void hexlog_destroy(struct Hexlog *log)
+{
+	if (log == NULL)
+		return;
+	pthread_mutex_lock(&log->lock);
+	log->stop = 1;
+	pthread_cond_signal(&log->work);
+	pthread_mutex_unlock(&log->lock);
+	pthread_join(log->writer, NULL);
+
+	struct Hexlog_Ring *ring, *next;
+	for (ring = log->rings; ring != NULL; ring = next)
+	{
+		next = ring->next;
+		free(ring->buf);
+		free(ring);
+	}
+	int i;
+	for (i = 0; i < log->format_count; i++)
+		free(log->formats[i].insert_str);
+	pthread_cond_destroy(&log->flushed);
+	pthread_cond_destroy(&log->work);
+	pthread_mutex_destroy(&log->lock);
+	free(log);
+}
+
+/* Добавляет формат tf с добавочной строкой insert_str, возвращает номер формата или -1 */
+int hexlog_format(struct Hexlog *log, struct Trans_Format *tf, char *insert_str)
+{
+	if (log == NULL || tf == NULL)
+		return -1;
+	pthread_mutex_lock(&log->lock);
+	int id = log->format_count;
+	struct Log_Format *fmt = &log->formats[id < HEXLOG_FORMATS_MAX ? id : 0];
+	if (id >= HEXLOG_FORMATS_MAX || compile_tf(&fmt->cf, tf) == NULL)
+	{
+		pthread_mutex_unlock(&log->lock);
+		return -1;
+	}
+	fmt->insert_str = NULL;
+	if (insert_str != NULL)
+	{
+		size_t add_length = strlen(insert_str);
+		fmt->insert_str = (char *) malloc(add_length + 1);
+		if (fmt->insert_str == NULL || fmt->cf.length + add_length > HEXPRN_STREAM_BUF)
+		{
+			free(fmt->insert_str);
+			pthread_mutex_unlock(&log->lock);
+			return -1;
+		}
+		memcpy(fmt->insert_str, insert_str, add_length + 1);
+	}
+
+	/* формат виден источникам и потоку записи только после заполнения */
+	__atomic_store_n(&log->format_count, id + 1, __ATOMIC_RELEASE);
+	pthread_mutex_unlock(&log->lock);
+	return id;
+}
+
+/* Создает кольцо размером ring_size байт для вызывающего потока-источника */
+struct Hexlog_Ring *hexlog_ring_create(struct Hexlog *log, size_t ring_size)
+{
+	if (log == NULL)
+		return NULL;
+	if (ring_size == 0)
+		ring_size = HEXLOG_RING_SIZE;
+	size_t size = HEXLOG_RING_MIN;
+	while (size < ring_size)
+	{
+		if (size > ((size_t) -1) / 2)
+			return NULL;
+		size *= 2;
+	}
+
+	struct Hexlog_Ring *ring = (struct Hexlog_Ring *) calloc(1, sizeof(struct Hexlog_Ring));
+	if (ring == NULL)
+		return NULL;
+	ring->buf = (byte *) malloc(size);
+	if (ring->buf == NULL)
+	{
+		free(ring);
+		return NULL;
+	}
+	ring->log = log;
+	ring->size = size;
+
+	/* добавление в начало списка, поток записи читает список без блокировки */
+	pthread_mutex_lock(&log->lock);
+	ring->next = log->rings;
+	__atomic_store_n(&log->rings, ring, __ATOMIC_RELEASE);
+	pthread_mutex_unlock(&log->lock);
+	return ring;
+}
+
+/* Копирует byte_count байт с адресом address_start и номером формата format_id в кольцо */
+int hexlog_write(struct Hexlog_Ring *ring, int format_id, const byte *byte_array, size_t byte_count,
+	qword address_start)
+/* Запись не переходит через конец кольца: если она не помещается до конца, остаток
+заполняется пустой записью и запись начинается с начала кольца. Поток записи не будится:
+он сам проверяет кольца не реже чем через HEXLOG_IDLE_USEC. */
+{
+	if (ring == NULL || (byte_array == NULL && byte_count != 0) || format_id < 0 ||
+		format_id >= __atomic_load_n(&ring->log->format_count, __ATOMIC_ACQUIRE))
+		return -1;
+
+	/* длина записи хранится в 32 разрядах: более длинная запись отбрасывается, как не помещающаяся */
+	size_t need = byte_count > UINT32_MAX ? SIZE_MAX : log_record_size(byte_count);
+	size_t pos = (size_t) ring->head & (ring->size - 1);
+	size_t to_end = ring->size - pos;
+	size_t total = to_end < need ? to_end + need : need;  // с пустой записью до конца кольца
+	if (need > ring->size / 2 || ring->head + total - ring->tail_cache > ring->size)
+	{
+		ring->tail_cache = __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE);
+		if (need > ring->size / 2 || ring->head + total - ring->tail_cache > ring->size)
+		{
+			__atomic_store_n(&ring->dropped, ring->dropped + 1, __ATOMIC_RELAXED);
+			__atomic_store_n(&ring->dropped_bytes, ring->dropped_bytes + byte_count, __ATOMIC_RELAXED);
+			return -1;
+		}
+	}
+
+	struct Log_Record *rec;
+	if (to_end < need)
+	{
+		if (to_end >= LOG_HEADER)
+		{
+			rec = (struct Log_Record *) (ring->buf + pos);
+			rec->format = -1;
+		}
+		pos = 0;
+	}
+	rec = (struct Log_Record *) (ring->buf + pos);
+	rec->length = (uint32_t) byte_count;
+	rec->format = format_id;
+	rec->address = address_start;
+	if (byte_count != 0)
+		memcpy(ring->buf + pos + LOG_HEADER, byte_array, byte_count);
+
+	/* публикация записи для потока записи */
+	__atomic_store_n(&ring->head, ring->head + total, __ATOMIC_RELEASE);
+	__atomic_store_n(&ring->records, ring->records + 1, __ATOMIC_RELAXED);
+	__atomic_store_n(&ring->bytes, ring->bytes + byte_count, __ATOMIC_RELAXED);
+
+	return 0;
+}
+
+/* Ожидает, пока поток записи передаст в sink все записи, принятые до вызова */
+int hexlog_flush(struct Hexlog *log)
+{
+	if (log == NULL)
+		return -1;
+	pthread_mutex_lock(&log->lock);
+	uint64_t req = ++log->flush_req;
+	pthread_cond_signal(&log->work);
+	while (log->flush_done < req)
+		pthread_cond_wait(&log->flushed, &log->lock);
+	pthread_mutex_unlock(&log->lock);
+	return __atomic_load_n(&log->errors, __ATOMIC_RELAXED) == 0 ? 0 : -1;
+}
+
+/* Заполняет st текущими значениями счетчиков журнала */
+void hexlog_stats(struct Hexlog *log, struct Hexlog_Stats *st)
+{
+	if (st == NULL)
+		return;
+	memset(st, 0, sizeof(struct Hexlog_Stats));
+	if (log == NULL)
+		return;
+	struct Hexlog_Ring *ring;
+	for (ring = __atomic_load_n(&log->rings, __ATOMIC_ACQUIRE); ring != NULL; ring = ring->next)
+	{
+		st->records += __atomic_load_n(&ring->records, __ATOMIC_RELAXED);
+		st->bytes += __atomic_load_n(&ring->bytes, __ATOMIC_RELAXED);
+		st->dropped += __atomic_load_n(&ring->dropped, __ATOMIC_RELAXED);
+		st->dropped_bytes += __atomic_load_n(&ring->dropped_bytes, __ATOMIC_RELAXED);
+	}
+	st->char_count = __atomic_load_n(&log->char_count, __ATOMIC_RELAXED);
+	st->errors = __atomic_load_n(&log->errors, __ATOMIC_RELAXED);
+}
@@ -0,0 +1,75 @@
+/*
+	hexparse.h
+	Обратное преобразование: разбор адресных строк обратно в массив байт
+
+Адресные строки одного формата имеют одинаковую длину, а положение каждой цифры
+известно из скомпилированного формата. Поэтому строка разбирается без поиска:
+постоянные символы заготовки (разделители, ': ' после адреса) сравниваются по маске,
+цифры ячеек собираются по смещениям и преобразуются векторным ядром hex_bytes()
+(двоичные ячейки - функцией bin_bytes()), ascii область пропускается.
+*/
+#ifndef HEXPARSE_H
+#define HEXPARSE_H
+
+#include "hexprn.h"
+
+/* коды ошибок разбора */
+enum hexparse_error_v
+{
+	HEXPARSE_OK = 0,        // ошибок нет
+	HEXPARSE_FORMAT = 1,    // ошибочные аргументы или формат
+	HEXPARSE_LENGTH = 2,    // адресная строка короче длины строки формата
+	HEXPARSE_DELIMITER = 3, // постоянный символ строки или добавочная строка не совпадает с форматом
+	HEXPARSE_ADDRESS = 4,   // неверная цифра адреса или адрес не продолжает предыдущую строку
+	HEXPARSE_DIGIT = 5,     // неверная цифра ячейки
+	HEXPARSE_EMPTY = 6,     // пустая ячейка или пустая строка внутри данных
+	HEXPARSE_OVERFLOW = 7,  // не хватает места в массиве байт
+	HEXPARSE_SQUEEZE = 8    // маркер сжатия повторов не после полной строки
+};
+
+/* Структура, определяющая результат разбора адресных строк */
+struct Parse_Result
+{
+	qword address_start;  // адрес первого восстановленного байта, младшие цифры по ширине адреса формата
+	size_t byte_count;    // число восстановленных байтов
+	size_t char_count;    // число разобранных символов текста
+	size_t str_count;     // число разобранных адресных строк
+	int error;            // код ошибки hexparse_error_v, при ошибке счетчики показывают разобранное до неё
+	size_t error_line;    // номер ошибочной адресной строки, считая с нуля
+	size_t error_pos;     // смещение ошибочного символа от начала текста
+};
+
+/* Наибольшее число байт, которое может быть восстановлено из length символов текста
+в формате cf с добавочной строкой insert_str */
+size_t hexparse_max_count(size_t length, struct Compiled_Format *cf, char *insert_str);
+
+/* Разбор адресных строк по скомпилированному формату в массив байт */
+struct Parse_Result shexparsec(byte *byte_array, size_t byte_size, const char *s, size_t length,
+	struct Compiled_Format *cf, char *insert_str);
+/* Разбирает текст s длиной length, полученный shexprnc() с форматом cf и добавочной строкой insert_str,
+и записывает восстановленные байты в byte_array.
+Параметры:
+	byte_array - массив для записи байт
+	byte_size  - размер массива byte_array, достаточно hexparse_max_count()
+	s          - текст адресных строк
+	length     - длина текста, последняя строка может быть без добавочной строки
+	cf         - скомпилированный формат, которым получен текст
+	insert_str - добавочная строка после каждой адресной строки, если NULL, то без неё
+Адрес начала восстанавливается по адресу первой строки и числу пустых ячеек в её начале,
+адреса следующих строк проверяются на непрерывность. Пустые ячейки допускаются только
+в начале первой и в конце последней строки. Разбор останавливается на первой ошибке.
+Строка-маркер сжатия повторов HEXPRN_SQUEEZE_MARK (формат с адресом) заменяется копиями
+предыдущей строки до адреса следующей строки, поэтому для сжатого текста hexparse_max_count()
+не является верхней границей, и размер массива задается по известному размеру данных.
+Раскрашенный текст (Trans_Format.color) не разбирается, возвращается HEXPARSE_FORMAT.
+Возвращает структуру Parse_Result.
+*/
+
+/* Разбор адресных строк с заданным форматом tf, параметры и возврат аналогичны shexparsec() */
+struct Parse_Result shexparsef(byte *byte_array, size_t byte_size, const char *s, size_t length,
+	struct Trans_Format *tf, char *insert_str);
+
+/* возвращает описание кода ошибки разбора */
+const char *hexparse_error_name(int error);
+
+#endif //HEXPARSE_H
@@ -0,0 +1,396 @@
+/*
+	hexparse.c
+	Обратное преобразование: разбор адресных строк обратно в массив байт
+*/
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "hexparse.h"
+
+/* Подготовленный к разбору формат */
+struct Parse_Format
+{
+	struct Compiled_Format *cf;  // скомпилированный формат
+	char *insert_str;            // добавочная строка
+	size_t add_length;           // длина добавочной строки
+	size_t check_length;         // длина проверяемой по маске части строки: адрес и шестнадцатеричная область
+	char mask[HEXPRN_LINE_MAX];  // -1 для постоянных символов заготовки, 0 для цифр адреса и ячеек
+	qword address_mask;          // маска значащих разрядов адреса
+};
+
+/* подготовка формата cf к разбору */
+static void parse_prepare(struct Parse_Format *pf, struct Compiled_Format *cf, char *insert_str)
+{
+	size_t j;
+
+	pf->cf = cf;
+	pf->insert_str = insert_str;
+	pf->add_length = insert_str == NULL ? 0 : strlen(insert_str);
+	pf->check_length = cf->ascii_offset[0];
+	pf->address_mask = cf->address_digits >= QWORD_SIZE_IN_BYTES * BYTE_SIZE_IN_TETRAS ? QWORD_MAX :
+		((qword) 1 << (cf->address_digits * TETRA_SIZE_IN_BITS)) - 1;
+
+	memset(pf->mask, -1, pf->check_length);
+	if (cf->tf.prn_address)
+		memset(pf->mask, 0, cf->address_digits);
+	for (j = 0; j < cf->line_bytes; j++)
+	{
+		memset(pf->mask + cf->hex_offset[j], 0, cf->cell_width);
+		if (cf->cell_width != cf->cell_digits)
+			pf->mask[cf->hex_offset[j] + TETRA_SIZE_IN_BITS] = -1;  // разделитель тетрад
+	}
+}
+
+/* Проверка постоянных символов строки line по маске словами по 8 символов.
+Возвращает смещение первого несовпадающего символа или check_length, если все совпадают. */
+static size_t check_fixed(const char *line, struct Parse_Format *pf)
+{
+	const char *skel = pf->cf->line;
+	uint64_t l, k, m, diff = 0;
+	size_t j = 0;
+
+	for (; j + sizeof(uint64_t) <= pf->check_length; j += sizeof(uint64_t))
+	{
+		memcpy(&l, line + j, sizeof(uint64_t));
+		memcpy(&k, skel + j, sizeof(uint64_t));
+		memcpy(&m, pf->mask + j, sizeof(uint64_t));
+		diff |= (l ^ k) & m;
+	}
+	for (; j < pf->check_length; j++)
+		diff |= (uint64_t) ((line[j] ^ skel[j]) & pf->mask[j]);
+	if (diff == 0)
+		return pf->check_length;
+
+	/* поиск места ошибки */
+	for (j = 0; j < pf->check_length; j++)
+		if ((line[j] ^ skel[j]) & pf->mask[j])
+			break;
+	return j;
+}
+
+/* Разбор digits цифр адреса строки line в *address.
+Возвращает digits при успехе или номер неверной цифры. */
+static size_t parse_address(const char *line, size_t digits, qword *address)
+{
+	size_t j;
+	int t;
+
+	*address = 0;
+	for (j = 0; j < digits; j++)
+	{
+		if ((t = hex_tetra(line[j])) < 0)
+			break;
+		*address = (*address << TETRA_SIZE_IN_BITS) | (qword) t;
+	}
+	return j;
+}
+
+/* Сбор цифр ячейки c без разделителя тетрад в digits */
+static void cell_gather(char *digits, const char *c, struct Compiled_Format *cf)
+{
+	if (cf->cell_width == cf->cell_digits)
+		memcpy(digits, c, cf->cell_digits);
+	else
+	{
+		memcpy(digits, c, TETRA_SIZE_IN_BITS);
+		memcpy(digits + TETRA_SIZE_IN_BITS, c + TETRA_SIZE_IN_BITS + 1, TETRA_SIZE_IN_BITS);
+	}
+}
+
+/* Разбор цифр ячейки c в байт *out. Возвращает -1 при успехе 
+или смещение неверной цифры от начала ячейки. */
+static int parse_cell(const char *c, struct Compiled_Format *cf, byte *out)
+{
+	char digits[BYTE_SIZE_IN_BITS];
+	int hi, lo;
+	size_t k;
+
+	if (cf->cell_digits == BYTE_SIZE_IN_TETRAS)
+	{
+		hi = hex_tetra(c[0]);
+		lo = hex_tetra(c[1]);
+		if (hi < 0 || lo < 0)
+			return hi < 0 ? 0 : 1;
+		*out = (byte) ((hi << TETRA_SIZE_IN_BITS) | lo);
+		return -1;
+	}
+	cell_gather(digits, c, cf);
+	if (bin_bytes(digits, out, 1) == 1)
+		return -1;
+	for (k = 0; digits[k] == '0' || digits[k] == '1'; k++)
+		;
+	return (int) (k < TETRA_SIZE_IN_BITS ? k : k + cf->cell_width - cf->cell_digits);
+}
+
+/* Разбор ячеек строки line в массив out. В first записывается номер первой непустой ячейки,
+в count - число непустых ячеек, они идут подряд. Возвращает код ошибки, в *err - смещение в строке. */
+static int parse_cells(const char *line, struct Parse_Format *pf, byte *out,
+	size_t *first, size_t *count, size_t *err)
+{
+	struct Compiled_Format *cf = pf->cf;
+	char digits[HEXPRN_LINE_BYTES_MAX * BYTE_SIZE_IN_BITS];
+	const char *c;
+	size_t j;
+	int bad;
+	int state = 0;  // 0 - пустые ячейки в начале, 1 - данные, 2 - пустые ячейки в конце
+
+	/* полная строка: все цифры сразу ядром hex_bytes() или bin_bytes(), цифры сплошной области
+	идут в порядке вывода, у слов LITTLE_ENDIAN байты затем переставляются */
+	if (cf->hex_dense)
+		c = line + cf->hex_start;
+	else
+	{
+		for (j = 0; j < cf->line_bytes; j++)
+			cell_gather(digits + j * cf->cell_digits, line + cf->hex_offset[j], cf);
+		c = digits;
+	}
+	if ((cf->cell_digits == BYTE_SIZE_IN_TETRAS ? hex_bytes(c, out, cf->line_bytes) : 
+		bin_bytes(c, out, cf->line_bytes)) == (int) cf->line_bytes)
+	{
+		if (cf->hex_dense && cf->word_swap)
+			bytes_swap(out, out, cf->line_bytes, cf->word_bytes);
+		*first = 0;
+		*count = cf->line_bytes;
+		return HEXPARSE_OK;
+	}
+
+	/* неполная или ошибочная строка: разбор по ячейкам */
+	*first = 0;
+	*count = 0;
+	for (j = 0; j < cf->line_bytes; j++)
+	{
+		c = line + cf->hex_offset[j];
+		if (memcmp(c, cf->line + cf->hex_offset[j], cf->cell_width) == 0)
+		{
+			if (state == 1)
+				state = 2;
+			continue;
+		}
+		if ((bad = parse_cell(c, cf, out + *count)) >= 0)
+		{
+			*err = cf->hex_offset[j] + (size_t) bad;
+			return HEXPARSE_DIGIT;
+		}
+		if (state == 2)
+		{
+			*err = cf->hex_offset[j];
+			return HEXPARSE_EMPTY;
+		}
+		if (state == 0)
+		{
+			state = 1;
+			*first = j;
+		}
+		(*count)++;
+	}
+	return HEXPARSE_OK;
+}
+
+/* Разбор строки-маркера сжатия повторов с позиции pr->char_count текста s: байты предыдущей
+полной строки с адресом *line_address повторяются до адреса следующей строки.
+ended - предыдущая строка неполная. Возвращает код ошибки, при успехе обновляет pr и *line_address. */
+static int parse_squeeze(struct Parse_Result *pr, struct Parse_Format *pf, byte *byte_array, size_t byte_size,
+	const char *s, size_t length, qword *line_address, int ended)
+{
+	struct Compiled_Format *cf = pf->cf;
+	size_t pos = pr->char_count + 1;  // позиция после маркера
+	size_t gap, j;
+	qword address;
+
+	/* перед маркером должна быть полная строка, после маркера - добавочная строка и адресная строка */
+	pr->error_pos = pr->char_count;
+	if (pr->str_count == 0 || ended || pr->byte_count < cf->line_bytes)
+		return HEXPARSE_SQUEEZE;
+	if (length - pos < pf->add_length ||
+		(pf->add_length != 0 && memcmp(s + pos, pf->insert_str, pf->add_length) != 0))
+	{
+		pr->error_pos = pos;
+		return HEXPARSE_DELIMITER;
+	}
+	pos += pf->add_length;
+	if (length - pos < cf->length)
+	{
+		pr->error_pos = length;
+		return HEXPARSE_LENGTH;
+	}
+	if ((j = parse_address(s + pos, cf->address_digits, &address)) != cf->address_digits)
+	{
+		pr->error_line = pr->str_count + 1;
+		pr->error_pos = pos + j;
+		return HEXPARSE_ADDRESS;
+	}
+
+	/* число пропущенных байт - целое число строк */
+	gap = (size_t) ((address - *line_address - cf->line_bytes) & pf->address_mask);
+	if (gap % cf->line_bytes != 0)
+	{
+		pr->error_line = pr->str_count + 1;
+		pr->error_pos = pos;
+		return HEXPARSE_ADDRESS;
+	}
+	if (byte_size - pr->byte_count < gap)
+		return HEXPARSE_OVERFLOW;
+	for (j = 0; j < gap; j += cf->line_bytes)
+		memcpy(byte_array + pr->byte_count + j, byte_array + pr->byte_count - cf->line_bytes, cf->line_bytes);
+
+	pr->byte_count += gap;
+	pr->char_count = pos;
+	pr->str_count++;
+	*line_address += gap;
+	return HEXPARSE_OK;
+}
+
+/* Наибольшее число байт, которое может быть восстановлено из length символов текста */
+size_t hexparse_max_count(size_t length, struct Compiled_Format *cf, char *insert_str)
+{
+	if (cf == NULL || cf->length == 0)
+		return 0;
+	size_t single_length = cf->length + (insert_str == NULL ? 0 : strlen(insert_str));
+	return (length / single_length + 1) * cf->line_bytes;
+}
+
+/* Разбор адресных строк по скомпилированному формату в массив байт */
+struct Parse_Result shexparsec(byte *byte_array, size_t byte_size, const char *s, size_t length,
+	struct Compiled_Format *cf, char *insert_str)
+{
+	struct Parse_Result pr;
+	struct Parse_Format pf;
+	byte part[HEXPRN_LINE_BYTES_MAX];  // байты строки, если в byte_array может не хватить места
+	byte *out;
+	const char *line;
+	size_t first, count, err = 0;
+	qword address = 0, line_address = 0;
+	int ended = 0;  // предыдущая строка закончилась пустыми ячейками
+	size_t j;
+
+	pr.address_start = 0; pr.byte_count = 0; pr.char_count = 0; pr.str_count = 0;
+	pr.error = HEXPARSE_FORMAT; pr.error_line = 0; pr.error_pos = 0;
+
+	/* проверка аргументов */
+	if (byte_array == NULL || s == NULL || cf == NULL || cf->length == 0 || cf->tf.color)
+		return pr;
+	parse_prepare(&pf, cf, insert_str);
+	pr.error = HEXPARSE_OK;
+
+	while (pr.char_count < length)
+	{
+		line = s + pr.char_count;
+		pr.error_line = pr.str_count;
+
+		/* строка-маркер сжатия повторов: адрес строки не начинается с маркера */
+		if (cf->tf.prn_address && line[0] == HEXPRN_SQUEEZE_MARK)
+		{
+			if ((pr.error = parse_squeeze(&pr, &pf, byte_array, byte_size, s, length, &line_address, ended)) != HEXPARSE_OK)
+				return pr;
+			continue;
+		}
+
+		if (length - pr.char_count < cf->length)
+		{
+			pr.error = HEXPARSE_LENGTH;
+			pr.error_pos = length;
+			return pr;
+		}
+
+		/* постоянные символы */
+		if ((err = check_fixed(line, &pf)) != pf.check_length)
+		{
+			pr.error = HEXPARSE_DELIMITER;
+			pr.error_pos = pr.char_count + err;
+			return pr;
+		}
+
+		/* адрес */
+		if (cf->tf.prn_address)
+		{
+			if ((j = parse_address(line, cf->address_digits, &address)) != cf->address_digits)
+			{
+				pr.error = HEXPARSE_ADDRESS;
+				pr.error_pos = pr.char_count + j;
+				return pr;
+			}
+			if (pr.str_count != 0 && address != ((line_address + cf->line_bytes) & pf.address_mask))
+			{
+				pr.error = HEXPARSE_ADDRESS;
+				pr.error_pos = pr.char_count;
+				return pr;
+			}
+		}
+		else
+			address = pr.str_count == 0 ? 0 : line_address + cf->line_bytes;
+
+		/* ячейки */
+		out = byte_size - pr.byte_count >= cf->line_bytes ? byte_array + pr.byte_count : part;
+		if ((pr.error = parse_cells(line, &pf, out, &first, &count, &err)) != HEXPARSE_OK)
+		{
+			pr.error_pos = pr.char_count + err;
+			return pr;
+		}
+
+		/* пустые ячейки допускаются только в начале первой и в конце последней строки */
+		if (pr.str_count != 0 && (ended || first != 0 || count == 0))
+		{
+			pr.error = HEXPARSE_EMPTY;
+			pr.error_pos = pr.char_count + cf->hex_offset[ended ? 0 : first];
+			return pr;
+		}
+		if (out == part)
+		{
+			if (byte_size - pr.byte_count < count)
+			{
+				pr.error = HEXPARSE_OVERFLOW;
+				pr.error_pos = pr.char_count;
+				return pr;
+			}
+			memcpy(byte_array + pr.byte_count, part, count);
+		}
+		if (pr.str_count == 0)
+			pr.address_start = (address + first) & pf.address_mask;
+		ended = first + count < cf->line_bytes;
+		line_address = address;
+		pr.byte_count += count;
+
+		/* добавочная строка, у последней строки её может не быть */
+		pr.char_count += cf->length;
+		pr.str_count++;
+		if (pf.add_length != 0 && pr.char_count < length)
+		{
+			if (length - pr.char_count < pf.add_length ||
+				memcmp(s + pr.char_count, pf.insert_str, pf.add_length) != 0)
+			{
+				pr.error = HEXPARSE_DELIMITER;
+				pr.error_line = pr.str_count - 1;
+				pr.error_pos = pr.char_count;
+				return pr;
+			}
+			pr.char_count += pf.add_length;
+		}
+	}
+	return pr;
+}
+
+/* Разбор адресных строк с заданным форматом tf */
+struct Parse_Result shexparsef(byte *byte_array, size_t byte_size, const char *s, size_t length,
+	struct Trans_Format *tf, char *insert_str)
+{
+	struct Compiled_Format cf;
+	struct Parse_Result pr;
+	pr.address_start = 0; pr.byte_count = 0; pr.char_count = 0; pr.str_count = 0;
+	pr.error = HEXPARSE_FORMAT; pr.error_line = 0; pr.error_pos = 0;
+
+	if (compile_tf(&cf, tf) == NULL)
+		return pr;
+	return shexparsec(byte_array, byte_size, s, length, &cf, insert_str);
+}
+
+/* возвращает описание кода ошибки разбора */
+const char *hexparse_error_name(int error)
+{
+	static const char *names[] = { "ok", "invalid format", "line too short", "delimiter mismatch",
+		"invalid address", "invalid hex digit", "misplaced empty cell", "byte array overflow",
+		"misplaced squeeze marker" };
+	if (error < HEXPARSE_OK || error > HEXPARSE_SQUEEZE)
+		return "unknown";
+	return names[error];
+}
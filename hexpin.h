@@ -0,0 +1,19 @@
+/*
+	hexpin.h
+	Привязка потока к процессору
+
+pthread_setaffinity_np() объявляется только при _GNU_SOURCE, а с ним <endian.h> определяет
+макросы LITTLE_ENDIAN и BIG_ENDIAN, совпадающие с именами порядка байт elements.h.
+Поэтому привязка вынесена в отдельную единицу трансляции, которая не подключает elements.h.
+*/
+#ifndef HEXPIN_H
+#define HEXPIN_H
+
+#include <stddef.h>
+#include <pthread.h>
+
+/* Привязывает поток thread к процессору cpu (номер берется по модулю размера набора процессоров).
+Возвращает 0 при успехе, -1 при ошибке или если привязка не поддерживается. */
+int hexpin_thread(pthread_t thread, size_t cpu);
+
+#endif //HEXPIN_H
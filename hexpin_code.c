@@ -0,0 +1,26 @@
+/*
+	hexpin.c
+	Привязка потока к процессору
+*/
+#define _GNU_SOURCE  // pthread_setaffinity_np()
+
+#include <pthread.h>
+#ifdef __linux__
+#include <sched.h>
+#endif
+
+#include "hexpin.h"
+
+/* Привязывает поток thread к процессору cpu */
+int hexpin_thread(pthread_t thread, size_t cpu)
+{
+#ifdef __linux__
+	cpu_set_t set;
+	CPU_ZERO(&set);
+	CPU_SET(cpu % CPU_SETSIZE, &set);
+	return pthread_setaffinity_np(thread, sizeof(set), &set) == 0 ? 0 : -1;
+#else
+	(void) thread; (void) cpu;
+	return -1;
+#endif
+}
@@ -0,0 +1,54 @@
+/*
+	hexpipe.h
+	Конвейерное преобразование потока: чтение, преобразование и запись в отдельных потоках
+
+Каналы, сокеты и символьные устройства нельзя отобразить в память, а последовательный
+цикл "прочитать блок - преобразовать - записать" простаивает на каждой из стадий.
+Конвейер разделяет стадии: поток чтения заполняет кольцо входных блоков, потоки преобразования
+переводят блоки в адресные строки независимо друг от друга, а вызывающий поток записывает
+готовые блоки по порядку одним вызовом writev() на несколько блоков.
+Все блоки, кроме первого, начинаются на границе адресной строки, поэтому адреса продолжаются
+между блоками, а вывод совпадает с однопоточным stream_hexprnc64() для всего потока.
+Состояние сжатия повторов (Trans_Format.squeeze) каждый блок определяет по двум последним
+строкам предыдущего блока, которые поток чтения копирует перед данными блока.
+*/
+#ifndef HEXPIPE_H
+#define HEXPIPE_H
+
+#include "hexprn.h"
+
+/* размер входного блока по умолчанию, уменьшается до кратного числу байт в адресной строке */
+#define HEXPIPE_BLOCK 0x40000
+
+/* число блоков кольца на один поток преобразования: пока один блок преобразуется,
+следующий читается, а предыдущий ожидает записи */
+#define HEXPIPE_SLOTS_PER_FORMATTER 3
+
+/* коды ошибок конвейера в Trans_Result64.error */
+enum hexpipe_error_v
+{
+	HEXPIPE_OK = 0,      // ошибок нет
+	HEXPIPE_FORMAT = 1,  // ошибочные аргументы или формат
+	HEXPIPE_MEMORY = 2,  // не хватает памяти или не удалось создать поток
+	HEXPIPE_READ = 3,    // ошибка чтения
+	HEXPIPE_WRITE = 4    // ошибка записи
+};
+
+/* Конвейерное преобразование потока in_fd с выводом в файловый дескриптор out_fd */
+struct Trans_Result64 hexpipe_fd(int in_fd, int out_fd, qword address_start, uint64_t byte_limit,
+	struct Compiled_Format *cf, char *insert_str, size_t formatter_count, size_t block_size);
+/* Параметры:
+	in_fd           - входной дескриптор, читается с текущей позиции до конца или byte_limit байт
+	out_fd          - выходной дескриптор, запись функцией writev()
+	address_start   - адрес первого прочитанного байта
+	byte_limit      - наибольшее число байт для чтения, QWORD_MAX - до конца ввода
+	cf              - скомпилированный формат преобразования
+	insert_str      - строка после каждой адресной строки, если NULL, то без вставки
+	formatter_count - число потоков преобразования, если 0, то по числу доступных процессоров
+	block_size      - размер входного блока, если 0, то HEXPIPE_BLOCK
+Возвращает накопленный результат аналогично stream_hexprnc64(), при ошибке Trans_Result64.error
+содержит код hexpipe_error_v, счетчики показывают записанное до ошибки, errno - причину ошибки
+чтения или записи.
+*/
+
+#endif //HEXPIPE_H
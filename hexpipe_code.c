@@ -0,0 +1,480 @@
+/*
+	hexpipe.c
+	Конвейерное преобразование потока: чтение, преобразование и запись в отдельных потоках
+*/
+#define _POSIX_C_SOURCE 200809L  // writev(), sysconf()
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/uio.h>
+
+#include "hexpipe.h"
+
+/* наибольшее число блоков в одном вызове writev(), наименьшее допустимое POSIX значение IOV_MAX */
+#define PIPE_IOV_MAX 16
+
+/* состояния блока кольца */
+enum pipe_slot_state_v
+{
+	SLOT_FREE = 0,       // свободен для чтения
+	SLOT_READ = 1,       // прочитан, ожидает преобразования
+	SLOT_FORMATTING = 2, // преобразуется
+	SLOT_FORMATTED = 3   // преобразован, ожидает записи
+};
+
+/* Блок кольца */
+struct Pipe_Slot
+{
+	byte *buf;        // две строки предыдущего блока и данные блока
+	byte *data;       // данные блока: buf + 2 * line_bytes
+	size_t prefix;    // число байт строк предыдущего блока перед data, 0, line_bytes или 2 * line_bytes
+	size_t length;    // число байт блока
+	qword address;    // адрес первого байта блока
+	int last;         // последний блок ввода
+	char *out;        // адресные строки блока
+	size_t out_size;  // размер out
+	struct Trans_Result64 tr;  // результат преобразования блока
+	int state;        // состояние pipe_slot_state_v
+};
+
+/* Конвейер */
+struct Hex_Pipe
+{
+	int in_fd, out_fd;
+	struct Compiled_Format *cf;
+	char *insert_str;
+	size_t add_length;
+	size_t block_size;       // размер полного блока, кратен числу байт в строке
+	qword address_start;
+	uint64_t byte_limit;
+
+	struct Pipe_Slot *slots; // кольцо блоков
+	size_t slot_count;
+	uint64_t read_seq;       // число прочитанных блоков
+	uint64_t format_seq;     // номер следующего блока для преобразования
+	int read_done;           // поток чтения завершен, read_seq больше не растет
+
+	pthread_mutex_t lock;
+	pthread_cond_t readable;   // освободился блок для чтения
+	pthread_cond_t formattable;// прочитан блок или чтение завершено
+	pthread_cond_t writable;   // преобразован блок
+	int stop;                // остановка по ошибке
+	int error;               // код ошибки hexpipe_error_v
+	int error_errno;         // errno ошибки чтения или записи
+};
+
+/* остановка конвейера с ошибкой error, вызывается под блокировкой */
+static void pipe_fail(struct Hex_Pipe *p, int error, int err)
+{
+	if (p->error == HEXPIPE_OK)
+	{
+		p->error = error;
+		p->error_errno = err;
+	}
+	p->stop = 1;
+	pthread_cond_broadcast(&p->readable);
+	pthread_cond_broadcast(&p->formattable);
+	pthread_cond_broadcast(&p->writable);
+}
+
+/* Чтение из in_fd блока до полного заполнения или конца ввода, возвращает число байт или -1.
+Ожидание в read() - единственное место, где поток чтения может быть отменен. */
+static ssize_t pipe_read_block(int in_fd, byte *block, size_t size)
+{
+	size_t done = 0;
+	ssize_t r;
+	int old;
+	while (done < size)
+	{
+		pthread_setcancelstate(PTHREAD_CANCEL_ENABLE, &old);
+		r = read(in_fd, block + done, size - done);
+		pthread_setcancelstate(PTHREAD_CANCEL_DISABLE, &old);
+		if (r < 0 && errno == EINTR)
+			continue;
+		if (r < 0)
+			return -1;
+		if (r == 0)
+			break;
+		done += (size_t) r;
+	}
+	return (ssize_t) done;
+}
+
+/* Поток чтения: заполняет свободные блоки по порядку. Первый блок заканчивается на границе
+адресной строки, перед данными каждого следующего блока копируются две последние полные строки ввода
+(при коротких блоках они могут принадлежать разным блокам, поэтому хранятся отдельно в tail).
+После полного блока читается один байт вперед: если ввод закончился ровно на границе блока,
+блок отмечается последним, и сжатие повторов выводит его последнюю строку, как при обычном преобразовании.
+Прочитанный вперед байт становится первым байтом следующего блока. */
+static void *pipe_reader(void *arg)
+{
+	struct Hex_Pipe *p = (struct Hex_Pipe *) arg;
+	size_t line_bytes = p->cf->line_bytes;
+	size_t skip = (size_t) (p->address_start % line_bytes);
+	uint64_t left = p->byte_limit;
+	qword address = p->address_start;
+	struct Pipe_Slot *slot;
+	byte tail[2 * HEXPRN_LINE_BYTES_MAX];  // последние полные строки прочитанного ввода
+	size_t tail_length = 0;
+	size_t want, full;
+	ssize_t r;
+	int old, stop;
+	byte ahead;          // байт, прочитанный вперед
+	int have_ahead = 0;  // != 0 - байт ahead прочитан
+	int eof = 0;         // конец ввода обнаружен чтением вперед
+
+	pthread_setcancelstate(PTHREAD_CANCEL_DISABLE, &old);
+	for (;;)
+	{
+		pthread_mutex_lock(&p->lock);
+		slot = &p->slots[p->read_seq % p->slot_count];
+		while (slot->state != SLOT_FREE && !p->stop)
+			pthread_cond_wait(&p->readable, &p->lock);
+		stop = p->stop;
+		pthread_mutex_unlock(&p->lock);
+		if (stop)
+			break;
+
+		/* строки перед блоком для состояния сжатия повторов */
+		slot->prefix = tail_length;
+		memcpy(slot->data - tail_length, tail, tail_length);
+
+		want = p->block_size - skip;
+		if ((uint64_t) want > left)
+			want = (size_t) left;
+		skip = 0;
+		if (want == 0)
+			r = 0;
+		else if (have_ahead)
+		{
+			slot->data[0] = ahead;
+			r = pipe_read_block(p->in_fd, slot->data + 1, want - 1);
+			if (r >= 0)
+				r++;
+		}
+		else
+			r = pipe_read_block(p->in_fd, slot->data, want);
+		have_ahead = 0;
+
+		/* чтение вперед после полного блока, если ввод еще не ограничен byte_limit */
+		if (r > 0 && (size_t) r == want && (uint64_t) r < left)
+		{
+			ssize_t a = pipe_read_block(p->in_fd, &ahead, 1);
+			if (a < 0)
+				r = -1;
+			have_ahead = a == 1;
+			eof = a == 0;
+		}
+
+		pthread_mutex_lock(&p->lock);
+		if (r < 0)
+		{
+			pipe_fail(p, HEXPIPE_READ, errno);
+			pthread_mutex_unlock(&p->lock);
+			break;
+		}
+		slot->length = (size_t) r;
+		slot->address = address;
+		slot->last = (size_t) r < want || (uint64_t) r == left || eof;
+		slot->state = SLOT_READ;
+		p->read_seq++;
+		pthread_cond_signal(&p->formattable);
+		pthread_mutex_unlock(&p->lock);
+
+		if (slot->last)
+			break;
+
+		/* полные строки блока: у первого блока без начальной неполной строки, конец блока выровнен */
+		full = (size_t) r - (size_t) ((line_bytes - address % line_bytes) % line_bytes);
+		if (full >= 2 * line_bytes)
+		{
+			memcpy(tail, slot->data + r - 2 * line_bytes, 2 * line_bytes);
+			tail_length = 2 * line_bytes;
+		}
+		else if (full == line_bytes)
+		{
+			if (tail_length == 2 * line_bytes)
+				memmove(tail, tail + line_bytes, line_bytes);
+			tail_length = tail_length == 0 ? 0 : line_bytes;
+			memcpy(tail + tail_length, slot->data + r - line_bytes, line_bytes);
+			tail_length += line_bytes;
+		}
+		address += (qword) r;
+		left -= (uint64_t) r;
+	}
+
+	pthread_mutex_lock(&p->lock);
+	p->read_done = 1;
+	pthread_cond_broadcast(&p->formattable);
+	pthread_mutex_unlock(&p->lock);
+	return NULL;
+}
+
+/* Преобразование блока. Пустой блок бывает только при пустом вводе: конец ввода на границе
+блока обнаруживается чтением вперед, и последним отмечается предыдущий полный блок. */
+static void pipe_format(struct Hex_Pipe *p, struct Pipe_Slot *slot)
+{
+	struct Compiled_Format *cf = p->cf;
+	struct Squeeze_State sq;
+	struct Trans_Result64 tr;
+
+	squeeze_init(&sq, slot->data - slot->prefix, slot->prefix, cf->line_bytes);
+	if (slot->length != 0)
+	{
+		tr = calc_tr_lines64(slot->length, slot->address, cf->line_bytes, cf->length, p->add_length);
+		slot->tr = shexprnc64_squeeze(slot->out, slot->data, slot->length, slot->address, cf,
+			p->insert_str, tr, &sq, !slot->last);
+		return;
+	}
+
+	memset(&slot->tr, 0, sizeof(slot->tr));
+	slot->tr.single_length = cf->length + p->add_length;
+	slot->tr.add_length = p->add_length;
+}
+
+/* Поток преобразования: берет прочитанные блоки по порядку номеров, преобразует их независимо */
+static void *pipe_formatter(void *arg)
+{
+	struct Hex_Pipe *p = (struct Hex_Pipe *) arg;
+	struct Pipe_Slot *slot;
+
+	pthread_mutex_lock(&p->lock);
+	for (;;)
+	{
+		while (!p->stop && p->format_seq == p->read_seq && !p->read_done)
+			pthread_cond_wait(&p->formattable, &p->lock);
+		if (p->stop || p->format_seq == p->read_seq)
+			break;
+		slot = &p->slots[p->format_seq++ % p->slot_count];
+		slot->state = SLOT_FORMATTING;
+		pthread_mutex_unlock(&p->lock);
+
+		pipe_format(p, slot);
+
+		pthread_mutex_lock(&p->lock);
+		slot->state = SLOT_FORMATTED;
+		pthread_cond_signal(&p->writable);
+	}
+	pthread_mutex_unlock(&p->lock);
+	return NULL;
+}
+
+/* Запись iov_count частей iov полностью, возвращает 0 или -1 при ошибке */
+static int pipe_writev(int fd, struct iovec *iov, int iov_count)
+{
+	ssize_t r;
+	while (iov_count > 0)
+	{
+		r = writev(fd, iov, iov_count);
+		if (r < 0 && errno == EINTR)
+			continue;
+		if (r < 0)
+			return -1;
+
+		/* частичная запись: пропуск записанных частей и начала частично записанной */
+		while (iov_count > 0 && (size_t) r >= iov->iov_len)
+		{
+			r -= (ssize_t) iov->iov_len;
+			iov++;
+			iov_count--;
+		}
+		if (iov_count > 0)
+		{
+			iov->iov_base = (char *) iov->iov_base + r;
+			iov->iov_len -= (size_t) r;
+		}
+	}
+	return 0;
+}
+
+/* Запись в вызывающем потоке: готовые блоки подряд от очередного номера собираются в один writev() */
+static void pipe_writer(struct Hex_Pipe *p, struct Trans_Result64 *total)
+{
+	struct iovec iov[PIPE_IOV_MAX];
+	struct Pipe_Slot *slot;
+	uint64_t write_seq = 0;
+	size_t n, j;
+	int done = 0;
+
+	while (!done)
+	{
+		/* ожидание очередного блока и сбор следующих за ним готовых блоков */
+		pthread_mutex_lock(&p->lock);
+		while (!p->stop && p->slots[write_seq % p->slot_count].state != SLOT_FORMATTED)
+			pthread_cond_wait(&p->writable, &p->lock);
+		if (p->stop)
+		{
+			pthread_mutex_unlock(&p->lock);
+			return;
+		}
+		for (n = 0; n < p->slot_count && n < PIPE_IOV_MAX; n++)
+		{
+			slot = &p->slots[(write_seq + n) % p->slot_count];
+			if (slot->state != SLOT_FORMATTED)
+				break;
+			if (slot->last)
+			{
+				n++;
+				break;
+			}
+		}
+		pthread_mutex_unlock(&p->lock);
+
+		for (j = 0; j < n; j++)
+		{
+			slot = &p->slots[(write_seq + j) % p->slot_count];
+			iov[j].iov_base = slot->out;
+			iov[j].iov_len = (size_t) slot->tr.char_count;
+			if (slot->tr.error)
+			{
+				pthread_mutex_lock(&p->lock);
+				pipe_fail(p, HEXPIPE_FORMAT, 0);
+				pthread_mutex_unlock(&p->lock);
+				return;
+			}
+		}
+		if (pipe_writev(p->out_fd, iov, (int) n) < 0)
+		{
+			pthread_mutex_lock(&p->lock);
+			pipe_fail(p, HEXPIPE_WRITE, errno);
+			pthread_mutex_unlock(&p->lock);
+			return;
+		}
+
+		/* накопление результатов и освобождение блоков для чтения */
+		pthread_mutex_lock(&p->lock);
+		for (j = 0; j < n; j++, write_seq++)
+		{
+			slot = &p->slots[write_seq % p->slot_count];
+			total->byte_count += slot->tr.byte_count;
+			total->char_count += slot->tr.char_count;
+			total->str_count += slot->tr.str_count;
+			done = slot->last;
+			slot->state = SLOT_FREE;
+		}
+		pthread_cond_signal(&p->readable);
+		pthread_mutex_unlock(&p->lock);
+	}
+}
+
+/* освобождение блоков кольца */
+static void pipe_free_slots(struct Hex_Pipe *p)
+{
+	size_t i;
+	for (i = 0; i < p->slot_count; i++)
+	{
+		free(p->slots[i].buf);
+		free(p->slots[i].out);
+	}
+	free(p->slots);
+}
+
+/* Конвейерное преобразование потока in_fd с выводом в файловый дескриптор out_fd */
+struct Trans_Result64 hexpipe_fd(int in_fd, int out_fd, qword address_start, uint64_t byte_limit,
+	struct Compiled_Format *cf, char *insert_str, size_t formatter_count, size_t block_size)
+{
+	struct Trans_Result64 total;
+	struct Hex_Pipe p;
+	pthread_t reader, *formatters;
+	size_t i, started = 0, line_bytes;
+	int reader_started = 0;
+
+	total.byte_count = 0; total.char_count = 0; total.str_count = 0;
+	total.add_length = insert_str == NULL ? 0 : strlen(insert_str);
+	total.single_length = cf == NULL ? 0 : cf->length + total.add_length;
+	total.error = HEXPIPE_FORMAT;
+
+	/* проверка аргументов */
+	if (cf == NULL || cf->line_bytes == 0 || in_fd < 0 || out_fd < 0)
+		return total;
+	line_bytes = cf->line_bytes;
+	if (block_size == 0)
+		block_size = HEXPIPE_BLOCK;
+	block_size -= block_size % line_bytes;
+	if (block_size == 0)
+		block_size = line_bytes;
+	if (formatter_count == 0)
+	{
+		long cpu_count = sysconf(_SC_NPROCESSORS_ONLN);
+		formatter_count = cpu_count < 1 ? 1 : (size_t) cpu_count;
+	}
+
+	memset(&p, 0, sizeof(p));
+	p.in_fd = in_fd;
+	p.out_fd = out_fd;
+	p.cf = cf;
+	p.insert_str = insert_str;
+	p.add_length = total.add_length;
+	p.block_size = block_size;
+	p.address_start = address_start;
+	p.byte_limit = byte_limit;
+
+	/* кольцо блоков: выход блока - его строки и строка squeeze_end() */
+	total.error = HEXPIPE_MEMORY;
+	p.slot_count = formatter_count * HEXPIPE_SLOTS_PER_FORMATTER;
+	p.slots = (struct Pipe_Slot *) calloc(p.slot_count, sizeof(struct Pipe_Slot));
+	if (p.slots == NULL)
+		return total;
+	for (i = 0; i < p.slot_count; i++)
+	{
+		p.slots[i].buf = (byte *) malloc(2 * line_bytes + block_size);
+		p.slots[i].out_size = (block_size / line_bytes + 2) * total.single_length;
+		p.slots[i].out = (char *) malloc(p.slots[i].out_size);
+		if (p.slots[i].buf == NULL || p.slots[i].out == NULL)
+		{
+			pipe_free_slots(&p);
+			return total;
+		}
+		p.slots[i].data = p.slots[i].buf + 2 * line_bytes;
+	}
+	formatters = (pthread_t *) calloc(formatter_count, sizeof(pthread_t));
+	if (formatters == NULL)
+	{
+		pipe_free_slots(&p);
+		return total;
+	}
+
+	pthread_mutex_init(&p.lock, NULL);
+	pthread_cond_init(&p.readable, NULL);
+	pthread_cond_init(&p.formattable, NULL);
+	pthread_cond_init(&p.writable, NULL);
+
+	/* запуск потоков чтения и преобразования, запись - в вызывающем потоке */
+	if (pthread_create(&reader, NULL, pipe_reader, &p) == 0)
+		reader_started = 1;
+	for (i = 0; reader_started && i < formatter_count; i++, started++)
+		if (pthread_create(&formatters[i], NULL, pipe_formatter, &p) != 0)
+			break;
+	if (!reader_started || started == 0)
+	{
+		pthread_mutex_lock(&p.lock);
+		pipe_fail(&p, HEXPIPE_MEMORY, 0);
+		pthread_mutex_unlock(&p.lock);
+	}
+	else
+		pipe_writer(&p, &total);
+
+	/* при ошибке поток чтения может ожидать ввод в read() и отменяется */
+	if (reader_started)
+	{
+		if (p.stop)
+			pthread_cancel(reader);
+		pthread_join(reader, NULL);
+	}
+	for (i = 0; i < started; i++)
+		pthread_join(formatters[i], NULL);
+
+	total.error = p.error;
+	pthread_cond_destroy(&p.writable);
+	pthread_cond_destroy(&p.formattable);
+	pthread_cond_destroy(&p.readable);
+	pthread_mutex_destroy(&p.lock);
+	free(formatters);
+	pipe_free_slots(&p);
+	if (total.error == HEXPIPE_READ || total.error == HEXPIPE_WRITE)
+		errno = p.error_errno;
+	return total;
+}
@@ -0,0 +1,66 @@
+/* 
+	hexpool.h
+	Пул рабочих потоков и многопоточное преобразование массива байт
+	
+Так как все адресные строки одного формата имеют одинаковую длину single_length,
+смещение строки N в выходной строке известно заранее: N * single_length.
+Поэтому диапазон строк делится между потоками пула, и каждый поток записывает свою
+часть прямо в общую выходную строку без последующего объединения.
+При сжатии повторяющихся строк (Trans_Format.squeeze) каждый поток определяет состояние сжатия
+по строкам перед своей частью. Со сжатием или раскраской (Trans_Format.color) длина частей
+заранее неизвестна, поэтому после завершения потоков части сдвигаются вплотную друг к другу
+в вызывающем потоке: этот шаг последовательный, копирует почти всю выходную строку и снижает
+выигрыш от потоков на больших массивах. Сдвиг нельзя разделить между потоками: место части
+может перекрывать еще не сдвинутую предыдущую часть.
+*/
+#ifndef HEXPOOL_H
+#define HEXPOOL_H
+
+#include "hexprn.h"
+
+/* наименьшее число адресных строк на один поток, меньшие части преобразуются в одном потоке */
+#define HEXPOOL_MIN_LINES 0x1000
+
+/* Задача пула: вызывается в каждом из count участвующих потоков, index - номер потока от 0 до count-1 */
+typedef void (*hexprn_task)(void *task_arg, size_t index, size_t count);
+
+/* пул рабочих потоков, существует между вызовами преобразования */
+struct Hexprn_Pool;
+
+/* Создает пул из thread_count потоков (с учетом вызывающего потока).
+Параметры:
+	thread_count - число потоков, если 0, то по числу доступных процессоров
+	pin_cpu      - != 0 привязать рабочие потоки к процессорам (поток i к процессору i)
+Возвращает пул или NULL при ошибке. */
+struct Hexprn_Pool *hexprn_pool_create(size_t thread_count, int pin_cpu);
+
+/* Останавливает рабочие потоки и освобождает пул */
+void hexprn_pool_destroy(struct Hexprn_Pool *pool);
+
+/* Возвращает число потоков пула с учетом вызывающего потока */
+size_t hexprn_pool_size(struct Hexprn_Pool *pool);
+
+/* Выполняет задачу task в count потоках пула (не более hexprn_pool_size()) и ожидает её завершения.
+Вызывающий поток выполняет часть с номером 0. Вызовы из разных потоков выполняются по очереди. */
+void hexprn_pool_run(struct Hexprn_Pool *pool, size_t count, hexprn_task task, void *task_arg);
+
+/* Многопоточное преобразование массива байт длиной byte_count в последовательность адресных строк
+по скомпилированному формату cf. Параметры и возврат аналогичны shexprnc(). */
+struct Trans_Result shexprnc_mt(struct Hexprn_Pool *pool, char *s, byte *byte_array, size_t byte_count,
+	word address_start, struct Compiled_Format *cf, char *insert_str, struct Trans_Result before_tr);
+
+/* Многопоточное преобразование массива байт длиной byte_count с 64-разрядного адреса
+по скомпилированному формату cf. Параметры и возврат аналогичны shexprnc64(),
+если before_tr.byte_count больше byte_count, возвращается ошибка. */
+struct Trans_Result64 shexprnc_mt64(struct Hexprn_Pool *pool, char *s, byte *byte_array, size_t byte_count,
+	qword address_start, struct Compiled_Format *cf, char *insert_str, struct Trans_Result64 before_tr);
+
+/* Многопоточное преобразование массива байт длиной byte_count в последовательность адресных строк
+с заданным форматом. Параметры и возврат аналогичны shexprnf(). */
+struct Trans_Result shexprnf_mt(struct Hexprn_Pool *pool, char *s, byte *byte_array, size_t byte_count,
+	word address_start, struct Trans_Format *tf, char *insert_str, struct Trans_Result before_tr);
+/* Строки делятся между потоками пула поровну, но не менее HEXPOOL_MIN_LINES строк на поток.
+Результат совпадает с результатом shexprnf(). Если pool == NULL, преобразование однопоточное.
+*/
+
+#endif //HEXPOOL_H
@@ -0,0 +1,311 @@
+/* 
+	hexpool.c
+	Пул рабочих потоков и многопоточное преобразование массива байт
+*/
+#define _POSIX_C_SOURCE 200809L  // sysconf()
+
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <unistd.h>
+
+#include "hexpool.h"
+#include "hexpin.h"
+
+/* Пул рабочих потоков */
+struct Hexprn_Pool
+{
+	pthread_t *threads;      // рабочие потоки, их на один меньше числа потоков пула
+	size_t thread_count;     // число потоков пула с учетом вызывающего потока
+	pthread_mutex_t run_lock;  // очередность вызовов hexprn_pool_run()
+	pthread_mutex_t lock;      // защита полей задачи
+	pthread_cond_t start;      // сигнал о новой задаче
+	pthread_cond_t done;       // сигнал о завершении задачи всеми рабочими потоками
+	unsigned long generation;  // номер текущей задачи
+	size_t busy;               // число рабочих потоков, не завершивших задачу
+	int stop;                  // признак остановки пула
+
+	hexprn_task task;        // текущая задача
+	void *task_arg;          // её параметр
+	size_t task_count;       // число участвующих потоков
+};
+
+/* параметр рабочего потока */
+struct Pool_Worker
+{
+	struct Hexprn_Pool *pool;
+	size_t index;    // номер потока в задаче, от 1
+};
+
+/* рабочий поток: ожидает задачу, выполняет свою часть и сообщает о завершении */
+static void *pool_worker(void *arg)
+{
+	struct Pool_Worker *w = (struct Pool_Worker *) arg;
+	struct Hexprn_Pool *pool = w->pool;
+	size_t index = w->index;
+	unsigned long seen = 0;
+	hexprn_task task;
+	void *task_arg;
+	size_t task_count;
+	free(w);
+
+	for (;;)
+	{
+		pthread_mutex_lock(&pool->lock);
+		while (pool->generation == seen && !pool->stop)
+			pthread_cond_wait(&pool->start, &pool->lock);
+		if (pool->stop)
+		{
+			pthread_mutex_unlock(&pool->lock);
+			break;
+		}
+		seen = pool->generation;
+		task = pool->task;
+		task_arg = pool->task_arg;
+		task_count = pool->task_count;
+		pthread_mutex_unlock(&pool->lock);
+
+		if (index < task_count)
+			task(task_arg, index, task_count);
+
+		pthread_mutex_lock(&pool->lock);
+		if (--pool->busy == 0)
+			pthread_cond_signal(&pool->done);
+		pthread_mutex_unlock(&pool->lock);
+	}
+	return NULL;
+}
+
+/* Создает пул из thread_count потоков (с учетом вызывающего потока) */
+struct Hexprn_Pool *hexprn_pool_create(size_t thread_count, int pin_cpu)
+{
+	long cpu_count = sysconf(_SC_NPROCESSORS_ONLN);
+	if (cpu_count < 1)
+		cpu_count = 1;
+	if (thread_count == 0)
+		thread_count = (size_t) cpu_count;
+
+	struct Hexprn_Pool *pool = (struct Hexprn_Pool *) calloc(1, sizeof(struct Hexprn_Pool));
+	if (pool == NULL)
+		return NULL;
+	pool->threads = (pthread_t *) calloc(thread_count, sizeof(pthread_t));
+	if (pool->threads == NULL)
+	{
+		free(pool);
+		return NULL;
+	}
+	pthread_mutex_init(&pool->run_lock, NULL);
+	pthread_mutex_init(&pool->lock, NULL);
+	pthread_cond_init(&pool->start, NULL);
+	pthread_cond_init(&pool->done, NULL);
+
+	/* запуск рабочих потоков, при ошибке пул остается с меньшим числом потоков */
+	pool->thread_count = 1;
+	size_t i;
+	for (i = 1; i < thread_count; i++)
+	{
+		struct Pool_Worker *w = (struct Pool_Worker *) malloc(sizeof(struct Pool_Worker));
+		if (w == NULL)
+			break;
+		w->pool = pool;
+		w->index = i;
+		if (pthread_create(&pool->threads[i - 1], NULL, pool_worker, w) != 0)
+		{
+			free(w);
+			break;
+		}
+		if (pin_cpu)
+			hexpin_thread(pool->threads[i - 1], i % (size_t) cpu_count);
+		pool->thread_count++;
+	}
+	return pool;
+}
+
+/* Останавливает рабочие потоки и освобождает пул */
+void hexprn_pool_destroy(struct Hexprn_Pool *pool)
+{
+	size_t i;
+	if (pool == NULL)
+		return;
+
+	pthread_mutex_lock(&pool->lock);
+	pool->stop = 1;
+	pthread_cond_broadcast(&pool->start);
+	pthread_mutex_unlock(&pool->lock);
+	for (i = 1; i < pool->thread_count; i++)
+		pthread_join(pool->threads[i - 1], NULL);
+
+	pthread_cond_destroy(&pool->done);
+	pthread_cond_destroy(&pool->start);
+	pthread_mutex_destroy(&pool->lock);
+	pthread_mutex_destroy(&pool->run_lock);
+	free(pool->threads);
+	free(pool);
+}
+
+/* Возвращает число потоков пула с учетом вызывающего потока */
+size_t hexprn_pool_size(struct Hexprn_Pool *pool)
+{
+	return pool == NULL ? 1 : pool->thread_count;
+}
+
+/* Выполняет задачу task в count потоках пула и ожидает её завершения */
+void hexprn_pool_run(struct Hexprn_Pool *pool, size_t count, hexprn_task task, void *task_arg)
+{
+	if (task == NULL || count == 0)
+		return;
+	if (count > hexprn_pool_size(pool))
+		count = hexprn_pool_size(pool);
+
+	/* задача из одной части выполняется без пробуждения рабочих потоков */
+	if (count == 1)
+	{
+		task(task_arg, 0, 1);
+		return;
+	}
+
+	pthread_mutex_lock(&pool->run_lock);
+	pthread_mutex_lock(&pool->lock);
+	pool->task = task;
+	pool->task_arg = task_arg;
+	pool->task_count = count;
+	pool->busy = pool->thread_count - 1;
+	pool->generation++;
+	pthread_cond_broadcast(&pool->start);
+	pthread_mutex_unlock(&pool->lock);
+
+	task(task_arg, 0, count);
+
+	pthread_mutex_lock(&pool->lock);
+	while (pool->busy != 0)
+		pthread_cond_wait(&pool->done, &pool->lock);
+	pthread_mutex_unlock(&pool->lock);
+	pthread_mutex_unlock(&pool->run_lock);
+}
+
+/* --- многопоточное преобразование --- */
+
+/* задание на преобразование, общее для всех потоков */
+struct Convert_Job
+{
+	char *s;
+	byte *byte_array;
+	qword address_start;
+	struct Compiled_Format *cf;
+	char *insert_str;
+	struct Trans_Result64 before_tr;
+	struct Trans_Result64 part_tr[];  // результаты частей, по числу потоков
+};
+
+/* смещение в массиве байт начала адресной строки с номером line */
+static size_t line_byte_offset(size_t line, qword address_start, size_t line_bytes)
+{
+	return line == 0 ? 0 : line * line_bytes - (size_t) (address_start % line_bytes);
+}
+
+/* преобразование части строк с номерами [line_start, line_stop) в потоке index */
+static void convert_task(void *task_arg, size_t index, size_t count)
+{
+	struct Convert_Job *job = (struct Convert_Job *) task_arg;
+	size_t str_count = (size_t) job->before_tr.str_count;
+	size_t line_start = str_count * index / count;
+	size_t line_stop = str_count * (index + 1) / count;
+
+	size_t byte_start = line_byte_offset(line_start, job->address_start, job->cf->line_bytes);
+	size_t byte_stop = line_byte_offset(line_stop, job->address_start, job->cf->line_bytes);
+	if (byte_stop > (size_t) job->before_tr.byte_count || line_stop == str_count)
+		byte_stop = (size_t) job->before_tr.byte_count;
+
+	/* состояние сжатия повторов по строкам перед частью, они принадлежат соседней части */
+	struct Squeeze_State sq;
+	squeeze_init(&sq, job->byte_array, byte_start, job->cf->line_bytes);
+
+	struct Trans_Result64 tr = calc_tr_lines64(byte_stop - byte_start, job->address_start + byte_start,
+		job->cf->line_bytes, job->cf->length, job->before_tr.add_length);
+	job->part_tr[index] = shexprnc64_squeeze(job->s + line_start * job->before_tr.single_length,
+		job->byte_array + byte_start, byte_stop - byte_start, job->address_start + byte_start,
+		job->cf, job->insert_str, tr, &sq, line_stop != str_count);
+}
+
+/* Многопоточное преобразование по скомпилированному формату */
+struct Trans_Result shexprnc_mt(struct Hexprn_Pool *pool, char *s, byte *byte_array, size_t byte_count,
+	word address_start, struct Compiled_Format *cf, char *insert_str, struct Trans_Result before_tr)
+{
+	struct Trans_Result tr; 
+	tr.byte_count = -1; tr.char_count = -1; tr.str_count = -1; tr.single_length = 0;
+
+	/* проверка аргументов */
+	if (s == NULL || byte_array == NULL || cf == NULL)
+		return tr;
+	if (before_tr.byte_count < 0 || before_tr.char_count <= 0 || before_tr.single_length <= 0 || before_tr.str_count <= 0)
+		return before_tr;
+	return trans_result32(shexprnc_mt64(pool, s, byte_array, byte_count, address_start, cf, insert_str,
+		trans_result64(before_tr)));
+}
+
+/* Многопоточное преобразование с 64-разрядного адреса по скомпилированному формату */
+struct Trans_Result64 shexprnc_mt64(struct Hexprn_Pool *pool, char *s, byte *byte_array, size_t byte_count,
+	qword address_start, struct Compiled_Format *cf, char *insert_str, struct Trans_Result64 before_tr)
+{
+	struct Trans_Result64 tr; 
+	tr.byte_count = 0; tr.char_count = 0; tr.str_count = 0; tr.single_length = 0; tr.add_length = 0; tr.error = 1;
+
+	/* проверка аргументов */
+	if (s == NULL || byte_array == NULL || cf == NULL)
+		return tr;
+	if (before_tr.error || before_tr.str_count == 0 || before_tr.single_length != cf->length + before_tr.add_length)
+		return tr;
+	if (before_tr.byte_count > byte_count)  // предварительный результат больше массива
+		return tr;
+
+	/* число потоков */
+	size_t count = (size_t) (before_tr.str_count / HEXPOOL_MIN_LINES);
+	if (count > hexprn_pool_size(pool))
+		count = hexprn_pool_size(pool);
+	if (count <= 1)
+		return shexprnc64(s, byte_array, byte_count, address_start, cf, insert_str, before_tr);
+
+	struct Convert_Job *job = (struct Convert_Job *) malloc(sizeof(struct Convert_Job) + 
+		count * sizeof(struct Trans_Result64));
+	if (job == NULL)
+		return tr;
+	job->s = s;
+	job->byte_array = byte_array;
+	job->address_start = address_start;
+	job->cf = cf;
+	job->insert_str = insert_str;
+	job->before_tr = before_tr;
+
+	hexprn_pool_run(pool, count, convert_task, job);
+
+	/* накопление результатов частей. При сжатии повторов и раскраске части короче отведенного им места
+	и сдвигаются вплотную к предыдущим по порядку в этом потоке (см. hexpool.h): сдвиг части
+	может затирать начало предыдущей, еще не сдвинутой, поэтому он не выполняется параллельно. */
+	size_t i;
+	tr = job->part_tr[0];
+	for (i = 1; i < count && !tr.error; i++)
+	{
+		if (cf->tf.squeeze || cf->tf.color)
+			memmove(s + tr.char_count, s + (size_t) (before_tr.str_count * i / count) * before_tr.single_length,
+				(size_t) job->part_tr[i].char_count);
+		tr.error = job->part_tr[i].error;
+		tr.byte_count += job->part_tr[i].byte_count;
+		tr.char_count += job->part_tr[i].char_count;
+		tr.str_count += job->part_tr[i].str_count;
+	}
+	free(job);
+	return tr;
+}
+
+/* Многопоточное преобразование с заданным форматом */
+struct Trans_Result shexprnf_mt(struct Hexprn_Pool *pool, char *s, byte *byte_array, size_t byte_count,
+	word address_start, struct Trans_Format *tf, char *insert_str, struct Trans_Result before_tr)
+{
+	struct Compiled_Format cf;
+	struct Trans_Result tr; 
+	tr.byte_count = -1; tr.char_count = -1; tr.str_count = -1; tr.single_length = 0;
+
+	if (compile_tf(&cf, tf) == NULL)
+		return tr;
+	return shexprnc_mt(pool, s, byte_array, byte_count, address_start, &cf, insert_str, before_tr);
+}
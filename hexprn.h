@@ -60,7 +60,46 @@ struct Trans_Result
 	size_t add_length;   // длина добавочной строки
 };
 
-/* структура, определяющая формат преобразования одной строки */
+/* Структура, определяющая результат преобразования с 64-разрядными адресами.
+Счетчики не ограничены INT_MAX, признак ошибки - поле error. */
+struct Trans_Result64
+{
+	uint64_t byte_count;  // число преобразованных байтов
+	uint64_t char_count;  // число выведенных символов
+	uint64_t str_count;   // число преобразованных адресных строк
+	size_t single_length; // длина одной адресной строки с учетом добавочной строки
+	size_t add_length;    // длина добавочной строки
+	int error;            // != 0 ошибка, счетчики показывают выполненное до ошибки
+};
+
+/* Кодовая страница ascii области: как значения байт показываются символами.
+CHARSET_ASCII - печатаемые ascii символы как есть, один байт на символ.
+Остальные страницы выводят символы в UTF-8 (до HEXPRN_CHAR_MAX байт на символ, один столбец на экране):
+CHARSET_LATIN1 - ISO 8859-1, CHARSET_CP1251 - Windows-1251, CHARSET_KOI8R - KOI8-R,
+CHARSET_CP866 - альтернативная кодировка DOS, CHARSET_EBCDIC - EBCDIC (CP037).
+Управляющие символы и не определенные страницей значения показываются non_print_char. */
+typedef int char_set_types;
+enum char_set_types_v {CHARSET_ASCII = 0, CHARSET_LATIN1, CHARSET_CP1251, CHARSET_KOI8R, CHARSET_CP866,
+	CHARSET_EBCDIC, CHARSET_COUNT};
+
+/* наибольшее число байт символа ascii области в UTF-8 */
+#define HEXPRN_CHAR_MAX 3
+
+/* Классы байт для раскраски ячеек (Trans_Format.color).
+HEXPRN_CLASS_NONE - цвет терминала по умолчанию: адрес, пустые ячейки и конец строки.
+Цвета классов: нулевой байт - серый, печатаемые ascii символы - голубой, управляющие символы
+и 0x7F - зеленый, байты 0x80..0xFE - желтый, 0xFF - красный. */
+enum byte_class_v {HEXPRN_CLASS_NONE = 0, HEXPRN_CLASS_ZERO, HEXPRN_CLASS_PRINT, HEXPRN_CLASS_CONTROL,
+	HEXPRN_CLASS_HIGH, HEXPRN_CLASS_FF, HEXPRN_CLASS_COUNT};
+
+/* наибольшая длина escape-последовательности цвета класса */
+#define HEXPRN_COLOR_MAX 5
+
+/* Структура, определяющая формат преобразования одной строки.
+Поля до non_print_char остаются на местах первой версии библиотеки, новые поля добавляются только
+в конец, поэтому позиционные инициализаторы прежних полей не сдвигаются. Нулевое значение каждого
+нового поля соответствует прежнему выводу. Структуру следует заполнять ret_default_tf()
+и затем менять нужные поля: так новые поля получают значения по умолчанию. */
 struct Trans_Format
 {
 	/* параметры печати адреса */
@@ -81,14 +120,105 @@ struct Trans_Format
 	char ascii_block_delimeter; // разделитель между группами элементов, если '\0' или CHAR_DEL, то не ставится
 	size_t ascii_block_length;  // длина группы элементов, между которыми ставится символ '|', если 0, то не ставится
 	char non_print_char;        // какой символ показывает непечатаемые значения
+
+	/* --- поля, добавленные после первой версии --- */
+
+	/* параметры адреса и длины строки */
+	size_t address_digits; // число выводимых младших цифр адреса: 4, 8, 12 или 16, если 0, то по размеру слова
+	size_t line_bytes;     // число байт (ячеек) в адресной строке, не более HEXPRN_LINE_BYTES_MAX, если 0, то HEXPRN_LINE_BYTES
+
+	/* вид ячеек шестнадцатеричной области */
+	number_base base;           // вид значений ячеек: BASE_HEX - две шестнадцатеричные цифры, BASE_BIN - восемь двоичных
+	char tetra_delimeter;       // разделитель тетрад внутри двоичной ячейки, если '\0' или CHAR_DEL, то не ставится
+	size_t word_bytes;          // число байт в ячейке-слове: 1 (или 0) - байты, 2, 4 или 8 - слова, как od -t x2/x4/x8
+	endian_types word_endian;   // порядок байт слова в памяти: LITTLE_ENDIAN - младший байт первым
+
+	/* кодовая страница ascii области */
+	char_set_types char_set;    // кодовая страница ascii области, CHARSET_ASCII - только ascii символы
+
+	/* параметры цвета */
+	int color;         // раскрашивать ячейки обеих областей по классам байт escape-последовательностями ANSI: != 0 да
+
+	/* параметры сжатия вывода */
+	int squeeze;       // сжимать повторяющиеся строки: != 0 да (серия повторов выводится строкой '*'), == 0 нет
 };
 
-/* четыре функции для преобразования: 
+/* число байт (ячеек) в одной адресной строке по умолчанию */
+#define HEXPRN_LINE_BYTES 0x10
+
+/* наибольшее число байт (ячеек) в одной адресной строке.
+Для 8, 16, 32 и 64 байт в строке используются развернутые варианты преобразования строки,
+остальные длины (например, 24) преобразуются общим вариантом. */
+#define HEXPRN_LINE_BYTES_MAX 0x40
+
+/* наибольшая длина адресной строки без добавочной строки,
+достаточна для HEXPRN_LINE_BYTES_MAX двоичных ячеек со всеми разделителями */
+#define HEXPRN_LINE_MAX 0x800
+
+/* Строка-маркер сжатия повторяющихся строк (Trans_Format.squeeze), как у hexdump.
+Полные адресные строки, байты которых совпадают с байтами предыдущей полной строки, не преобразуются:
+вместо первой строки серии выводится маркер и добавочная строка, остальные строки серии пропускаются.
+Последняя строка всего преобразования выводится всегда, поэтому следующая за маркером строка
+показывает адрес конца серии. При сжатии calc_tr_result() возвращает верхнюю границу,
+а функции преобразования - фактическое число символов и строк (маркеры считаются строками).
+Так же при раскраске (Trans_Format.color) calc_tr_result() считает строки наибольшей длины
+Compiled_Format.length, а функции преобразования возвращают фактическое число символов. */
+#define HEXPRN_SQUEEZE_MARK '*'
+
+/* Скомпилированный формат преобразования.
+Строится из Trans_Format один раз функцией compile_tf() и содержит заготовку адресной строки
+со всеми разделителями и пустыми ячейками, а также смещения, по которым в заготовку
+записываются шестнадцатеричные цифры и ascii символы ячеек.
+В виде слов (word_bytes > 1) ячейка шестнадцатеричной области - слово, байты которого выводятся
+старшим вперед: у слов LITTLE_ENDIAN смещения цифр байт идут в обратном порядке внутри слова,
+а полная строка выводится после перестановки байт bytes_swap(). Разделители и длина группы
+шестнадцатеричной области относятся к словам, ascii область остается побайтной.
+Символы ascii области выбираются по таблицам из 256 значений: для CHARSET_ASCII - ascii_map
+(полная строка с подряд идущими символами заполняется векторной классификацией bytes_print()),
+для остальных страниц - UTF-8 последовательности char_utf8 длиной char_len. Ascii область - последняя
+в строке, поэтому при многобайтовых символах она сдвигается только вправо: заготовка содержит
+область с однобайтовыми пустыми ячейками и HEXPRN_CHAR_MAX - 1 (или 1 для страниц без трехбайтовых символов)
+пробелов на ячейку в конце. Длина строки line_length остается постоянной и является верхней границей
+значащих символов, columns - ширина строки на экране.
+При раскраске строка без цвета затем копируется с escape-последовательностью перед ячейкой, класс
+которой (color_class) отличается от класса предыдущей ячейки, и сбросом цвета в конце; дополняющие
+пробелы не выводятся. length - верхняя граница: смена класса у каждой ячейки обеих областей. */
+struct Compiled_Format
+{
+	struct Trans_Format tf;         // исходный формат
+	char line[HEXPRN_LINE_MAX];     // заготовка адресной строки с пустыми ячейками
+	size_t length;                  // длина адресной строки без добавочной строки, при раскраске - наибольшая
+	size_t line_length;             // длина заготовки адресной строки (строки без цвета)
+	size_t address_digits;          // число цифр адреса
+	size_t line_bytes;              // число байт (ячеек) в адресной строке
+	size_t cell_digits;             // число цифр ячейки: BYTE_SIZE_IN_TETRAS или BYTE_SIZE_IN_BITS
+	size_t cell_width;              // ширина ячейки в символах с разделителем тетрад
+	size_t word_bytes;              // число байт в ячейке-слове, line_bytes кратно word_bytes
+	struct trans_mode word_mode;    // вид слова: ячейка-слово совпадает с byte_trans(байты слова, word_bytes, word_mode)
+	int word_swap;                  // байты слов выводятся в обратном порядке (слова LITTLE_ENDIAN)
+	size_t word_width;              // ширина ячейки-слова в символах
+	size_t hex_start;               // смещение первой цифры шестнадцатеричной области
+	size_t hex_offset[HEXPRN_LINE_BYTES_MAX];   // смещения цифр байт в порядке байт в памяти
+	size_t ascii_offset[HEXPRN_LINE_BYTES_MAX]; // смещения ascii символов ячеек
+	int hex_dense;                  // цифры ячеек идут подряд без разделителей (в порядке вывода с hex_start)
+	int ascii_dense;                // ascii символы ячеек идут подряд без разделителей
+	size_t ascii_end;               // конец ascii области с однобайтовыми символами
+	size_t columns;                 // ширина адресной строки на экране (без дополняющих пробелов)
+	size_t char_width;              // наибольшее число байт символа ascii области: 1 - CHARSET_ASCII
+	char non_print;                 // символ непечатаемых значений
+	char ascii_map[BYTE_MAX + 1];   // отображаемый ascii символ для каждого значения байта
+	char char_utf8[BYTE_MAX + 1][HEXPRN_CHAR_MAX + 1]; // UTF-8 символ для каждого значения байта
+	byte char_len[BYTE_MAX + 1];    // длина UTF-8 символа в байтах
+	byte color_class[BYTE_MAX + 1]; // класс байта для раскраски
+};
+
+/* функции для преобразования: 
 
  hexprn()  вывод на экран n байт из массива байт без смещения со стандартным форматом вывода
  fhexprn() вывод в файл n байт из массива байт с задаваемым адресом со стандартным форматом вывода
+ dhexprn() вывод в файловый дескриптор n байт из массива байт с задаваемым адресом со стандартным форматом вывода
  shexprn() вывод в строку n байт из массива байт с задаваемым адресом со стандартным форматом вывода
- shexprn_formatted() вывод в строку n байт из массива байт с задаваемым форматом вывода
+ shexprnf() вывод в строку n байт из массива байт с задаваемым форматом вывода
  
 */
 
@@ -99,12 +229,59 @@ struct Trans_Format
 struct Trans_Result hexprn(byte *byte_array, size_t byte_count);
 
 /* Выводит в файл (можно в stdout) n байт.
-Преобразует массив байт byte_array длиной byte_count в строку
-и записывает её в файл fp. Формат преобразования - по-умолчанию, 
+Преобразует массив байт byte_array длиной byte_count в последовательность адресных строк
+и записывает её в файл fp порциями через буфер HEXPRN_STREAM_BUF. Формат преобразования - по-умолчанию, 
 смещение адреса нулевого элемента массива - address.
 Возвращает число выведенных символов в формате возврата. */
 struct Trans_Result fhexprn(FILE *fp, byte *byte_array, size_t byte_count, word address);
 
+/* Выводит в файловый дескриптор fd n байт.
+Аналогична fhexprn(), запись производится функцией write(). */
+struct Trans_Result dhexprn(int fd, byte *byte_array, size_t byte_count, word address);
+
+/* размер буфера потокового вывода, в пределах кэша данных процессора */
+#define HEXPRN_STREAM_BUF 0x8000
+
+/* Функция записи для потокового вывода: записывает n символов строки s,
+sink_arg - её произвольный параметр (файл, дескриптор и т.п.).
+Возвращает число записанных символов, если оно меньше n - ошибка записи. */
+typedef size_t (*hexprn_sink)(void *sink_arg, const char *s, size_t n);
+
+/* функция записи в файл, sink_arg - FILE * */
+size_t hexprn_sink_file(void *sink_arg, const char *s, size_t n);
+
+/* функция записи в файловый дескриптор функцией write(), sink_arg - int * */
+size_t hexprn_sink_fd(void *sink_arg, const char *s, size_t n);
+
+/* Потоковое преобразование массива байт длиной byte_count в последовательность адресных строк
+по скомпилированному формату cf с выводом через функцию записи sink. */
+struct Trans_Result stream_hexprnc(hexprn_sink sink, void *sink_arg, byte *byte_array, size_t byte_count,
+	word address_start, struct Compiled_Format *cf, char *insert_str);
+/* Адресные строки преобразуются порциями в буфер размером HEXPRN_STREAM_BUF, расположенный в стеке,
+и после каждой порции передаются в sink. Расход памяти не зависит от числа байт.
+Параметры:
+	sink           - функция записи
+	sink_arg       - параметр функции записи
+	byte_array     - массив исходных байт
+	byte_count     - наибольшее число байт для преобразования, ограничивается hex_max_count()
+	address_start  - адрес (смещение) нулевого элемента массива byte_array
+	cf             - скомпилированный формат преобразования
+	insert_str     - строка, которая будет вставляться после каждой преобразованной адресной строки,
+	                 допустим "\r\n" или "\n", если NULL, то без вставки
+Возвращает структуру аналогично shexprnf(), Trans_Result.char_count - число записанных символов.
+При ошибке записи Trans_Result.str_count = -1, остальные поля показывают записанное до ошибки.
+*/
+
+/* Потоковое преобразование массива байт в файл fp с заданным форматом tf.
+Параметры и возврат аналогичны stream_hexprnc(). */
+struct Trans_Result fhexprnf(FILE *fp, byte *byte_array, size_t byte_count, word address_start,
+	struct Trans_Format *tf, char *insert_str);
+
+/* Потоковое преобразование массива байт в файловый дескриптор fd с заданным форматом tf.
+Параметры и возврат аналогичны stream_hexprnc(). */
+struct Trans_Result dhexprnf(int fd, byte *byte_array, size_t byte_count, word address_start,
+	struct Trans_Format *tf, char *insert_str);
+
 /* Преобразует массив байт длиной byte_count в массив символов (последовательность адресных строк)
 с форматом по-умолчанию. Выделяет необходимую память для строки *s. 
 Перед использованием необходимо выделить память s = (char **) malloc(sizof(char **));
@@ -152,6 +329,233 @@ struct Trans_Result shexprnf(char *s, byte *byte_array, size_t byte_count, \
   проверка на переполнение не производится.
 */
 
+/* Преобразование массива байт длиной byte_count в последовательность адресных строк
+по скомпилированному формату cf. Параметры и возврат аналогичны shexprnf().
+Формат компилируется один раз через compile_tf() и используется многократно,
+before_tr подсчитывается через calc_tr_result() по исходному формату cf->tf. */
+struct Trans_Result shexprnc(char *s, byte *byte_array, size_t byte_count, \
+	word address_start, struct Compiled_Format *cf, char *insert_str, struct Trans_Result before_tr);
+
+/* Компилирует формат tf в заготовку адресной строки cf.
+Возвращает cf при успехе, NULL при ошибке. */
+struct Compiled_Format *compile_tf(struct Compiled_Format *cf, struct Trans_Format *tf);
+
+/* Преобразование одной адресной строки по скомпилированному формату cf.
+count байт bytes записываются в ячейки, начиная с ячейки first, остальные ячейки пустые,
+address - адрес ячейки 0. Записывает в s cf->line_length символов без добавочной строки и без цвета
+и возвращает число значащих символов: при многобайтовой кодовой странице ascii области
+строка после них дополняется пробелами до cf->line_length. Используется для вывода отдельных строк
+(сравнение, поиск и т.п.). */
+size_t sprn_line(char *s, struct Compiled_Format *cf, const byte *bytes, qword address,
+	size_t first, size_t count);
+
+/* Отметка ячейки-слова, содержащей байт номер cell, в строке s, полученной sprn_line():
+символ mark ставится вместо разделителя перед цифрами ячейки, если разделителя нет - цифры
+ячейки переводятся в нижний регистр (двоичные ячейки без разделителя не отмечаются). */
+void sprn_mark(char *s, struct Compiled_Format *cf, size_t cell, char mark);
+
+/* --- Контекст преобразования ---
+Контекст владеет скомпилированным форматом и копией добавочной строки. Функции библиотеки
+не используют статических переменных, поэтому любое число потоков может одновременно
+выполнять преобразования без блокировок, каждый со своим контекстом или с общим контекстом
+только для чтения. Функции shexprnf(), fhexprnf() и т.п. - обертки, создающие контекст в стеке.
+
+	struct Hexprn_Ctx *ctx = hexprn_ctx_create(&tf, "\n");
+	struct Trans_Result64 tr = hexprn_ctx_calc(ctx, byte_count, address);
+	char *s = (char *) malloc(tr.char_count);
+	tr = hexprn_ctx_convert(ctx, s, byte_array, byte_count, address);
+	hexprn_ctx_destroy(ctx);
+*/
+struct Hexprn_Ctx;
+
+/* Создает контекст преобразования с форматом tf и добавочной строкой insert_str
+(если NULL, то без вставки). Возвращает контекст или NULL при ошибке. */
+struct Hexprn_Ctx *hexprn_ctx_create(struct Trans_Format *tf, char *insert_str);
+
+/* Освобождает контекст преобразования */
+void hexprn_ctx_destroy(struct Hexprn_Ctx *ctx);
+
+/* Подсчитывает предполагаемый результат преобразования byte_count байт с адреса address_start
+в контексте ctx. Возврат аналогичен calc_tr_result64(). */
+struct Trans_Result64 hexprn_ctx_calc(struct Hexprn_Ctx *ctx, size_t byte_count, qword address_start);
+
+/* Преобразование массива байт длиной byte_count в последовательность адресных строк
+и запись их в s в контексте ctx. Длина s не менее Trans_Result64.char_count из hexprn_ctx_calc().
+Возврат аналогичен shexprnf64(). */
+struct Trans_Result64 hexprn_ctx_convert(struct Hexprn_Ctx *ctx, char *s, byte *byte_array, 
+	size_t byte_count, qword address_start);
+
+/* Потоковое преобразование массива байт с выводом через функцию записи sink в контексте ctx.
+Возврат аналогичен stream_hexprnc64(). */
+struct Trans_Result64 hexprn_ctx_write(struct Hexprn_Ctx *ctx, hexprn_sink sink, void *sink_arg,
+	byte *byte_array, size_t byte_count, qword address_start);
+
+/* Возвращает скомпилированный формат контекста */
+struct Compiled_Format *hexprn_ctx_format(struct Hexprn_Ctx *ctx);
+
+/* Возвращает добавочную строку контекста */
+char *hexprn_ctx_insert_str(struct Hexprn_Ctx *ctx);
+
+/* --- Преобразование с 64-разрядными адресами ---
+Функции аналогичны функциям с 32-разрядными адресами, но адрес имеет тип qword,
+число байт ограничивается только концом 64-разрядного адресного пространства,
+а результат возвращается в структуре Trans_Result64. */
+
+/* Ограничение числа байт count по перекрытию наибольшего адреса QWORD_MAX:
+	max_count <= QWORD_MAX + 1 - address */
+size_t hex_max_count64(size_t count, qword address);
+
+/* Число адресных строк по line_bytes байт для преобразования count байт с адреса address,
+count должно быть ограничено hex_max_count64() */
+uint64_t hex_addr_str64(size_t count, qword address, size_t line_bytes);
+
+/* Подсчитывает результат преобразования аналогично calc_tr_lines() */
+struct Trans_Result64 calc_tr_lines64(size_t byte_count, qword address_start, 
+	size_t line_bytes, size_t length, size_t add_length);
+
+/* Подсчитывает предполагаемый результат преобразования аналогично calc_tr_result() */
+struct Trans_Result64 calc_tr_result64(size_t byte_count, qword address_start,
+	struct Trans_Format *tf, char *insert_str);
+
+/* Преобразование по скомпилированному формату аналогично shexprnc(),
+before_tr - результат calc_tr_lines64() или calc_tr_result64() */
+struct Trans_Result64 shexprnc64(char *s, byte *byte_array, size_t byte_count, 
+	qword address_start, struct Compiled_Format *cf, char *insert_str, struct Trans_Result64 before_tr);
+
+/* Преобразование с заданным форматом аналогично shexprnf() */
+struct Trans_Result64 shexprnf64(char *s, byte *byte_array, size_t byte_count, 
+	qword address_start, struct Trans_Format *tf, char *insert_str, struct Trans_Result64 before_tr);
+
+/* Потоковое преобразование аналогично stream_hexprnc() */
+struct Trans_Result64 stream_hexprnc64(hexprn_sink sink, void *sink_arg, byte *byte_array, size_t byte_count,
+	qword address_start, struct Compiled_Format *cf, char *insert_str);
+
+/* Смещение в массиве первого байта адресной строки с номером line последовательности строк
+массива с адреса address_start: 0 для нулевой строки, иначе line * line_bytes - address_start % line_bytes */
+uint64_t hex_line_offset64(uint64_t line, qword address_start, size_t line_bytes);
+
+/* Преобразование только адресных строк с номерами [line_first, line_end) последовательности
+адресных строк массива байт длиной byte_count с адреса address_start */
+struct Trans_Result64 shexprnc64_lines(char *s, byte *byte_array, size_t byte_count, qword address_start,
+	struct Compiled_Format *cf, char *insert_str, uint64_t line_first, uint64_t line_end);
+/* Все строки имеют одинаковую длину single_length, поэтому строка N занимает известный участок
+массива (hex_line_offset64()) и известное место в выводе (N * single_length): строки диапазона
+преобразуются без преобразования предшествующих, например, для просмотра только видимой части
+дампа большого файла. Сжатие повторов не применяется, номера строк соответствуют выводу без сжатия.
+line_end ограничивается числом строк hex_addr_str64(), s должна вмещать
+(line_end - line_first) * single_length символов. Возвращает результат для строк диапазона,
+при line_first за последней строкой - пустой результат без ошибки. */
+
+/* --- Сжатие повторяющихся строк по частям ---
+Функции выше сжимают повторы в пределах одного вызова. Если массив преобразуется частями
+(окна отображения файла, блоки чтения, части потоков пула), состояние сжатия переносится
+между частями, и результат совпадает с преобразованием всего массива за один вызов. */
+
+/* Состояние сжатия повторяющихся строк между частями преобразования */
+struct Squeeze_State
+{
+	byte line[HEXPRN_LINE_BYTES_MAX];  // байты предыдущей полной адресной строки
+	qword address;  // адрес предыдущей строки
+	int full;       // предыдущая строка полная, со следующей строкой сравнивается она
+	int repeat;     // предыдущая строка повторяет строку перед ней (заменена маркером или пропущена)
+	int held;       // предыдущая строка пропущена и выводится squeeze_end(), если она последняя
+};
+
+/* Начальное состояние сжатия перед адресной строкой, начинающейся с байта offset массива bytes.
+Предыдущие строки берутся из байт перед offset, если их нет (bytes == NULL или offset меньше
+длины строки), то состояние соответствует началу преобразования. */
+void squeeze_init(struct Squeeze_State *sq, const byte *bytes, size_t offset, size_t line_bytes);
+
+/* Преобразование части массива аналогично shexprnc64() с состоянием сжатия sq.
+Если more != 0, то после части будут еще байты, и последняя строка части тоже может быть пропущена,
+тогда после последней части вызывается squeeze_end(). Без Trans_Format.squeeze sq не используется.
+Если before_tr.byte_count больше byte_count, возвращается ошибка. */
+struct Trans_Result64 shexprnc64_squeeze(char *s, byte *byte_array, size_t byte_count,
+	qword address_start, struct Compiled_Format *cf, char *insert_str, struct Trans_Result64 before_tr,
+	struct Squeeze_State *sq, int more);
+
+/* Потоковое преобразование части массива аналогично stream_hexprnc64() с состоянием сжатия sq,
+параметр more аналогичен shexprnc64_squeeze() */
+struct Trans_Result64 stream_hexprnc64_squeeze(hexprn_sink sink, void *sink_arg, byte *byte_array,
+	size_t byte_count, qword address_start, struct Compiled_Format *cf, char *insert_str,
+	struct Squeeze_State *sq, int more);
+
+/* Запись в s пропущенной последней строки после преобразования частей с more != 0.
+Возвращает число записанных символов: длина строки с добавочной строкой или 0, если выводить нечего. */
+size_t squeeze_end(char *s, struct Compiled_Format *cf, char *insert_str, struct Squeeze_State *sq);
+
+/* Состояние вытягивающего преобразования: адресные строки выдаются в буферы вызывающего
+любого размера, преобразование останавливается внутри строки и продолжается с того же символа.
+Память не выделяется, состояние целиком располагается у вызывающего (например, в стеке). */
+struct Hexprn_Encoder
+{
+	struct Compiled_Format *cf;  // скомпилированный формат, существует до конца преобразования
+	char *insert_str;            // добавочная строка
+	size_t add_length;           // её длина
+	byte *byte_array;            // массив исходных байт, существует до конца преобразования
+	size_t byte_count;           // число байт для преобразования
+	qword address_start;         // адрес нулевого элемента массива
+	struct Squeeze_State sq;     // состояние сжатия повторов
+	char line[HEXPRN_LINE_MAX];  // начатая строка (адресная строка или маркер) без добавочной строки
+	size_t line_length;          // её длина, 0 - начатой строки нет
+	size_t line_pos;             // число выданных символов начатой строки вместе с добавочной строкой
+	struct Trans_Result64 tr;    // преобразованные байты, выданные символы и строки, признак ошибки
+};
+
+/* Подготовка вытягивающего преобразования массива байт по скомпилированному формату cf.
+Параметры аналогичны shexprnc64(). Возвращает enc или NULL при ошибке аргументов. */
+struct Hexprn_Encoder *hexprn_encoder_init(struct Hexprn_Encoder *enc, byte *byte_array, size_t byte_count,
+	qword address_start, struct Compiled_Format *cf, char *insert_str);
+
+/* Записывает в s очередные не более size символов адресных строк.
+Возвращает число записанных символов: size, меньше size - преобразование закончено,
+0 - больше нечего выдавать или ошибка (enc->tr.error != 0).
+Полные строки, помещающиеся в остаток буфера, преобразуются прямо в s, строка на границе буфера
+преобразуется в enc->line и выдается по частям. Вывод всех порций вместе совпадает с shexprnc64(). */
+size_t hexprn_encoder_fill(struct Hexprn_Encoder *enc, char *s, size_t size);
+
+/* возвращает != 0, если все символы выданы или произошла ошибка */
+int hexprn_encoder_done(struct Hexprn_Encoder *enc);
+
+/* Состояние проталкиваемого преобразования: байты поступают частями любого размера,
+через sink выводятся только законченные адресные строки, незаконченная строка переносится
+в следующий вызов. Адреса частей продолжаются, память не выделяется. */
+struct Hexprn_Feeder
+{
+	struct Compiled_Format *cf;  // скомпилированный формат, существует до конца преобразования
+	char *insert_str;            // добавочная строка
+	hexprn_sink sink;            // функция записи
+	void *sink_arg;              // её аргумент
+	qword address;               // адрес следующего поступающего байта
+	struct Squeeze_State sq;     // состояние сжатия повторов
+	byte line[HEXPRN_LINE_BYTES_MAX];  // байты незаконченной строки
+	size_t pend;                 // их число, адрес первого из них address - pend
+	struct Trans_Result64 tr;    // байты выведенных строк, записанные символы и строки, признак ошибки
+};
+
+/* Подготовка проталкиваемого преобразования с адреса address_start с выводом через sink.
+Возвращает feeder или NULL при ошибке аргументов. */
+struct Hexprn_Feeder *hexprn_feeder_init(struct Hexprn_Feeder *feeder, qword address_start,
+	struct Compiled_Format *cf, char *insert_str, hexprn_sink sink, void *sink_arg);
+
+/* Принимает очередные byte_count байт. Законченные строки преобразуются прямо из byte_array,
+копируются только байты незаконченной строки. Возвращает 0 или -1 при ошибке записи
+(ошибка сохраняется в feeder->tr.error, последующие вызовы ничего не выводят). */
+int hexprn_feeder_write(struct Hexprn_Feeder *feeder, byte *byte_array, size_t byte_count);
+
+/* Завершение: незаконченная строка выводится с пустыми ячейками (empty_hex, empty_ascii),
+при сжатии выводится пропущенная последняя строка. Если байт не поступало, ничего не выводится.
+Возвращает 0 или -1 при ошибке. */
+int hexprn_feeder_flush(struct Hexprn_Feeder *feeder);
+
+/* Приведение результата к 64-разрядному виду и обратно. При обратном приведении 
+значения более INT_MAX не проверяются, ошибка передается как str_count = -1. */
+struct Trans_Result64 trans_result64(struct Trans_Result tr);
+struct Trans_Result trans_result32(struct Trans_Result64 tr);
+
+/* печать 64-разрядных результатов преобразования tr в файл fp */
+int fprint_tr64(FILE *fp, struct Trans_Result64 *tr);
+
 /* возврат формата вывода по умолчанию */
 struct Trans_Format ret_default_tf();
 
@@ -161,6 +565,49 @@ int fprint_tr(FILE *fp, struct Trans_Result *tr);
 /* печать результатов преобразования tr в стандартный вывод stdout */
 int print_tr(struct Trans_Result *tr);
 
+/* Счетчики и таймеры этапов преобразования. Собираются, только если библиотека собрана
+с -DHEXPRN_STATS (make CFLAGS="-O2 -Wall -DHEXPRN_STATS"), иначе код учета не компилируется,
+функции ниже остаются и возвращают нули с enabled = 0. */
+
+/* этапы преобразования адресной строки и вывода */
+enum hexprn_phase_v
+{
+	HEXPRN_PHASE_INIT = 0,  // копирование заготовки строки и адрес
+	HEXPRN_PHASE_HEX,       // шестнадцатеричная (двоичная) область
+	HEXPRN_PHASE_ASCII,     // символьная область
+	HEXPRN_PHASE_INSERT,    // копирование добавочной строки
+	HEXPRN_PHASE_ALLOC,     // выделение памяти
+	HEXPRN_PHASE_WRITE,     // вызовы функции записи sink
+	HEXPRN_PHASE_COUNT
+};
+
+/* снимок счетчиков */
+struct Hexprn_Stats
+{
+	int enabled;             // != 0 - библиотека собрана с HEXPRN_STATS
+	int cycles;              // единица времени: 1 - такты счетчика процессора (rdtsc), 0 - наносекунды
+	uint64_t calls;          // вызовы преобразования: части массива в shexprnc64_squeeze() и sprn_line()
+	uint64_t bytes;          // преобразованные байты
+	uint64_t lines;          // записанные строки, включая маркеры сжатия
+	uint64_t chars;          // записанные символы
+	uint64_t allocs;         // выделения памяти
+	uint64_t alloc_bytes;    // выделенные байты
+	uint64_t writes;         // вызовы функции записи sink
+	uint64_t write_chars;    // символы, переданные в sink
+	uint64_t total_ticks;    // время внутри вызовов преобразования, без выделения памяти и записи
+	uint64_t phase_ticks[HEXPRN_PHASE_COUNT];  // время по этапам
+};
+
+/* Заполняет st текущими значениями счетчиков всех потоков. Счетчики вызова добавляются
+в общие по его завершении, поэтому снимок во время преобразования не включает незаконченные вызовы. */
+void hexprn_stats(struct Hexprn_Stats *st);
+
+/* Обнуляет счетчики */
+void hexprn_stats_reset(void);
+
+/* печать счетчиков st в файл fp, рядом с fprint_tr() */
+int fprint_stats(FILE *fp, struct Hexprn_Stats *st);
+
 /* Подсчет и возврат количества символов для вывода одной
 адресной строки в формате tf */
 size_t calc_chars_tf(struct Trans_Format *tf);
@@ -179,6 +626,14 @@ size_t hex_max_count(size_t count, word address);
 Перед вызовом этой функции необходимо подавать число байт, ограниченное hex_max_count(). */
 size_t hex_addr_str(size_t count, word address);
 
+/* Подсчитывает результат преобразования byte_count байт с адреса address_start
+при line_bytes байт в адресной строке, длине адресной строки length (без добавочной строки)
+и длине добавочной строки add_length. Используется со скомпилированным форматом:
+line_bytes = Compiled_Format.line_bytes, length = Compiled_Format.length.
+Возврат аналогичен calc_tr_result(). */
+struct Trans_Result calc_tr_lines(size_t byte_count, word address_start, 
+	size_t line_bytes, size_t length, size_t add_length);
+
 /* Подсчитывает и возвращает предполагаемый результат преобразования массива байт
 byte_array длиной count в последовательность адресных строк s.
 Внимание! Значения полей возвращаемой структуры ограничены INT_MAX, проверка на переполнение не производится.  */
@@ -205,6 +660,8 @@ struct Trans_Result calc_tr_result(size_t byte_count, word address_start,
 		== 0  ошибка
 	   	 > 0  предполагаемая длина одной преобразованной строки с учетом длины добавочной строки
 	Внимание! Значения полей возвращаемой структуры ограничены INT_MAX, проверка на переполнение не производится.
+	При сжатии повторяющихся строк (Trans_Format.squeeze) char_count и str_count - верхняя граница,
+	фактические значения возвращает функция преобразования.
 */
 
 #endif //HEX_PRN_H
\ No newline at end of file
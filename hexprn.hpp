@@ -0,0 +1,435 @@
+/*
+	hexprn.hpp
+	Интерфейс C++20 без отдельной сборки: формат адресной строки задается параметром шаблона
+
+Функции библиотеки на C интерпретируют формат во время выполнения: заготовка строки и смещения
+ячеек берутся из Compiled_Format, длина строки и ширина ячеек - переменные. Здесь формат
+(адрес, число байт в строке, разделители и длины групп, вид ячеек) - значение hexprn_cpp::format,
+передаваемое параметром шаблона, поэтому заготовка, смещения ячеек и таблица символов вычисляются
+при компиляции, а преобразование строки - развернутый цикл без ветвлений по формату:
+
+	constexpr hexprn_cpp::format dump{ .line_bytes = 8, .hex_block_length = 4 };
+	std::string s = hexprn_cpp::to_string<dump>(std::as_bytes(std::span(buffer)), 0x1000);
+	hexprn_cpp::write<dump>(std::ostreambuf_iterator<char>(std::cout), bytes);
+	for (std::string_view line : hexprn_cpp::lines<dump>(bytes, address))
+		log(line);
+
+Результат совпадает с shexprnf() для того же формата (to_trans_format()): первая строка
+начинается с ячейки address % line_bytes, пустые ячейки первой и последней строки заполняются
+empty_hex и empty_ascii. Поддерживаются байтовые ячейки в шестнадцатеричном и двоичном виде и ascii
+область CHARSET_ASCII; ячейки-слова, кодовые страницы, раскраска и сжатие повторов - через библиотеку
+(hexprn_ctx_create() с to_trans_format()). Только заголовочный файл, библиотека для него не нужна.
+*/
+#ifndef HEXPRN_HPP
+#define HEXPRN_HPP
+
+#if __cplusplus < 202002L
+#error "hexprn.hpp requires C++20"
+#endif
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <iterator>
+#include <ranges>
+#include <span>
+#include <string>
+#include <string_view>
+
+/* g++ определяет _GNU_SOURCE, и заголовки стандартной библиотеки могут определить макросы
+LITTLE_ENDIAN и BIG_ENDIAN из <endian.h>: на время подключения elements.h они снимаются,
+а здесь используются имена ENDIAN_LITTLE и ENDIAN_BIG */
+#pragma push_macro("LITTLE_ENDIAN")
+#pragma push_macro("BIG_ENDIAN")
+#undef LITTLE_ENDIAN
+#undef BIG_ENDIAN
+extern "C" {
+#include "hexprn.h"
+}
+#pragma pop_macro("BIG_ENDIAN")
+#pragma pop_macro("LITTLE_ENDIAN")
+
+namespace hexprn_cpp
+{
+
+/* Формат адресной строки, поля и значения по умолчанию - как у Trans_Format (ret_default_tf()).
+Используется как параметр шаблона, поэтому все поля - простые значения. */
+struct format
+{
+	bool prn_address = true;              // печатать адрес
+	std::size_t address_digits = WORD_SIZE_IN_BYTES * BYTE_SIZE_IN_TETRAS;  // число цифр адреса, 1..16
+	std::size_t line_bytes = HEXPRN_LINE_BYTES;  // число байт в строке, 1..HEXPRN_LINE_BYTES_MAX
+	char empty_hex = '*';                 // символ цифр пустых ячеек
+	char empty_ascii = '.';               // ascii символ пустых ячеек
+	bool binary = false;                  // ячейки восемью двоичными цифрами (BASE_BIN)
+	char tetra_delimeter = '\0';          // разделитель тетрад двоичной ячейки
+	char hex_char_delimeter = ' ';        // разделитель ячеек шестнадцатеричной области
+	char hex_block_delimeter = '|';       // разделитель групп шестнадцатеричной области
+	std::size_t hex_block_length = 8;     // длина группы, 0 - без групп
+	char ascii_char_delimeter = '\0';     // разделитель ячеек ascii области
+	char ascii_block_delimeter = '\0';    // разделитель групп ascii области
+	std::size_t ascii_block_length = 0;   // длина группы, 0 - без групп
+	char non_print_char = '.';            // символ непечатаемых значений
+};
+
+/* Формат библиотеки на C, соответствующий f */
+constexpr Trans_Format to_trans_format(const format &f) noexcept
+{
+	Trans_Format tf{};
+	tf.prn_address = f.prn_address;
+	tf.address_digits = f.address_digits;
+	tf.line_bytes = f.line_bytes;
+	tf.empty_value = 0x00;
+	tf.empty_hex = f.empty_hex;
+	tf.empty_ascii = f.empty_ascii;
+	tf.base = f.binary ? BASE_BIN : BASE_HEX;
+	tf.tetra_delimeter = f.tetra_delimeter;
+	tf.word_bytes = 1;
+	tf.word_endian = ENDIAN_LITTLE;
+	tf.hex_char_delimeter = f.hex_char_delimeter;
+	tf.hex_block_delimeter = f.hex_block_delimeter;
+	tf.hex_block_length = f.hex_block_length;
+	tf.ascii_char_delimeter = f.ascii_char_delimeter;
+	tf.ascii_block_delimeter = f.ascii_block_delimeter;
+	tf.ascii_block_length = f.ascii_block_length;
+	tf.non_print_char = f.non_print_char;
+	tf.char_set = CHARSET_ASCII;
+	tf.color = 0;
+	tf.squeeze = 0;
+	return tf;
+}
+
+namespace detail
+{
+
+/* ставится ли разделитель c ('\0' и DEL не ставятся) */
+constexpr bool delim_used(char c) noexcept
+{
+	return c != '\0' && c != 0x7F;
+}
+
+/* непечатаемый символ заменяется пробелом, как в compile_tf() */
+constexpr char printable(char c) noexcept
+{
+	return (c <= 0x1F || c == 0x7F) ? ' ' : c;
+}
+
+/* Длина области строки с line_bytes ячейками по width символов с разделителями, как у compile_pane() */
+constexpr std::size_t pane_length(std::size_t line_bytes, std::size_t width, char ch_delim, char bl_delim,
+	std::size_t bl_len) noexcept
+{
+	std::size_t cell = width + (delim_used(ch_delim) ? 1 : 0);
+	std::size_t blocks = bl_len == 0 || !delim_used(bl_delim) ? 0 : line_bytes / bl_len;
+	return line_bytes * cell + blocks * (1 + (delim_used(ch_delim) ? 1 : 0));
+}
+
+/* Запись области строки в line с позиции l, как compile_pane(): пустые ячейки и разделители,
+смещения ячеек в offset. Возвращает позицию после области. */
+constexpr std::size_t compile_pane(char *line, std::size_t l, std::size_t *offset, std::size_t line_bytes,
+	std::size_t width, char empty, char ch_delim, char bl_delim, std::size_t bl_len) noexcept
+{
+	std::size_t bl_count = 0;
+	for (std::size_t cell = 0; cell < line_bytes; cell++)
+	{
+		offset[cell] = l;
+		for (std::size_t j = 0; j < width; j++)
+			line[l++] = empty;
+		if (delim_used(ch_delim))
+			line[l++] = ch_delim;
+		if (++bl_count == bl_len)
+		{
+			bl_count = 0;
+			if (delim_used(bl_delim))
+			{
+				line[l++] = bl_delim;
+				if (delim_used(ch_delim))
+					line[l++] = ch_delim;
+			}
+		}
+	}
+	return l;
+}
+
+/* число цифр ячейки и ширина ячейки с разделителем тетрад */
+constexpr std::size_t cell_digits(const format &f) noexcept
+{
+	return f.binary ? BYTE_SIZE_IN_BITS : BYTE_SIZE_IN_TETRAS;
+}
+
+constexpr std::size_t cell_width(const format &f) noexcept
+{
+	return cell_digits(f) + (f.binary && delim_used(f.tetra_delimeter) ? 1 : 0);
+}
+
+/* Длина адресной строки формата f. Вычисляется без заготовки, поэтому годится для размера массива. */
+constexpr std::size_t line_length(const format &f) noexcept
+{
+	return (f.prn_address ? f.address_digits + 2 : 0) +
+		pane_length(f.line_bytes, cell_width(f), f.hex_char_delimeter, f.hex_block_delimeter, f.hex_block_length) +
+		pane_length(f.line_bytes, 1, f.ascii_char_delimeter, f.ascii_block_delimeter, f.ascii_block_length);
+}
+
+/* Запись заготовки строки формата f в line и смещений ячеек, возвращает длину строки */
+constexpr std::size_t compile_line(const format &f, char *line, std::size_t *hex_offset,
+	std::size_t *ascii_offset) noexcept
+{
+	std::size_t l = 0;
+	if (f.prn_address)
+	{
+		for (; l < f.address_digits; l++)
+			line[l] = '0';
+		line[l++] = ':';
+		line[l++] = ' ';
+	}
+	l = compile_pane(line, l, hex_offset, f.line_bytes, cell_width(f), printable(f.empty_hex),
+		f.hex_char_delimeter, f.hex_block_delimeter, f.hex_block_length);
+	l = compile_pane(line, l, ascii_offset, f.line_bytes, 1, printable(f.empty_ascii),
+		f.ascii_char_delimeter, f.ascii_block_delimeter, f.ascii_block_length);
+	if (cell_width(f) != cell_digits(f))
+		for (std::size_t j = 0; j < f.line_bytes; j++)
+			line[hex_offset[j] + TETRA_SIZE_IN_BITS] = f.tetra_delimeter;
+	return l;
+}
+
+/* Скомпилированный формат F: заготовка, смещения ячеек и ascii символы всех значений байта */
+template <format F>
+struct compiled
+{
+	static_assert(F.line_bytes >= 1 && F.line_bytes <= HEXPRN_LINE_BYTES_MAX, "line_bytes: 1..HEXPRN_LINE_BYTES_MAX");
+	static_assert(F.address_digits >= 1 && F.address_digits <= 16, "address_digits: 1..16");
+
+	static constexpr std::size_t length = line_length(F);
+	static_assert(length <= HEXPRN_LINE_MAX, "line longer than HEXPRN_LINE_MAX");
+
+	std::array<char, length> line{};
+	std::array<std::size_t, F.line_bytes> hex_offset{};
+	std::array<std::size_t, F.line_bytes> ascii_offset{};
+	std::array<char, 0x100> ascii_map{};
+
+	constexpr compiled() noexcept
+	{
+		compile_line(F, line.data(), hex_offset.data(), ascii_offset.data());
+		for (std::size_t b = 0; b < 0x100; b++)
+			ascii_map[b] = (b > 0x1F && b < 0x7F) ? static_cast<char>(b) : printable(F.non_print_char);
+	}
+};
+
+template <format F>
+inline constexpr compiled<F> compiled_v{};
+
+/* цифры ячейки для каждого значения байта: шестнадцатеричные (2) или двоичные (8) */
+template <std::size_t Digits>
+struct digit_table
+{
+	std::array<char, 0x100 * Digits> digits{};
+
+	constexpr digit_table() noexcept
+	{
+		constexpr char hex[] = "0123456789ABCDEF";
+		for (std::size_t b = 0; b < 0x100; b++)
+			for (std::size_t k = 0; k < Digits; k++)
+				digits[b * Digits + k] = Digits == BYTE_SIZE_IN_TETRAS ?
+					hex[(b >> (TETRA_SIZE_IN_BITS * (Digits - 1 - k))) & 0xF] :
+					static_cast<char>('0' + ((b >> (Digits - 1 - k)) & 1));
+	}
+};
+
+template <std::size_t Digits>
+inline constexpr digit_table<Digits> digit_table_v{};
+
+} // namespace detail
+
+/* Преобразование адресных строк формата F. Длина строки length постоянна и известна при компиляции,
+формат не проверяется во время выполнения. */
+template <format F>
+struct line_formatter
+{
+	static constexpr std::size_t line_bytes = F.line_bytes;
+	static constexpr std::size_t length = detail::compiled<F>::length;  // длина строки без добавочной строки
+
+	/* Записывает в s строку с адресом address (адрес ячейки 0), ячейки first..first + count - 1
+	заполняются байтами bytes[0..count - 1], остальные остаются пустыми. Возвращает s + length. */
+	static char *format_line(char *s, const std::byte *bytes, std::uint64_t address,
+		std::size_t first = 0, std::size_t count = F.line_bytes) noexcept
+	{
+		std::memcpy(s, detail::compiled_v<F>.line.data(), length);
+		if constexpr (F.prn_address)
+			for (std::size_t k = 0; k < F.address_digits; k++)
+				s[k] = "0123456789ABCDEF"[(address >> (TETRA_SIZE_IN_BITS * (F.address_digits - 1 - k))) & 0xF];
+
+		/* полная строка: число ячеек постоянно, цикл разворачивается компилятором */
+		if (first == 0 && count == F.line_bytes)
+			for (std::size_t j = 0; j < F.line_bytes; j++)
+				put_cell(s, j, bytes[j]);
+		else
+			for (std::size_t j = 0; j < count; j++)
+				put_cell(s, first + j, bytes[j]);
+		return s + length;
+	}
+
+	/* число строк для byte_count байт с адреса address */
+	static constexpr std::size_t line_count(std::size_t byte_count, std::uint64_t address) noexcept
+	{
+		if (byte_count == 0)
+			return 0;
+		return (static_cast<std::size_t>(address % F.line_bytes) + byte_count + F.line_bytes - 1) / F.line_bytes;
+	}
+
+private:
+	/* цифры и ascii символ ячейки cell со значением value */
+	static void put_cell(char *s, std::size_t cell, std::byte value) noexcept
+	{
+		constexpr auto &cf = detail::compiled_v<F>;
+		constexpr std::size_t digits = detail::cell_digits(F);
+		constexpr const char *table = detail::digit_table_v<digits>.digits.data();
+
+		unsigned b = std::to_integer<unsigned>(value);
+		if constexpr (detail::cell_width(F) == digits)
+			std::memcpy(s + cf.hex_offset[cell], table + b * digits, digits);
+		else
+		{
+			/* двоичная ячейка с разделителем тетрад из заготовки */
+			std::memcpy(s + cf.hex_offset[cell], table + b * digits, TETRA_SIZE_IN_BITS);
+			std::memcpy(s + cf.hex_offset[cell] + TETRA_SIZE_IN_BITS + 1, table + b * digits + TETRA_SIZE_IN_BITS,
+				TETRA_SIZE_IN_BITS);
+		}
+		s[cf.ascii_offset[cell]] = cf.ascii_map[b];
+	}
+};
+
+/* число символов преобразования byte_count байт с адреса address при добавочной строке длиной add_length */
+template <format F = format{}>
+constexpr std::size_t char_count(std::size_t byte_count, std::uint64_t address = 0, std::size_t add_length = 1) noexcept
+{
+	return line_formatter<F>::line_count(byte_count, address) * (line_formatter<F>::length + add_length);
+}
+
+/* Записывает адресные строки байт bytes с адресом address через итератор вывода out,
+после каждой строки - insert. Возвращает итератор после записанного. */
+template <format F = format{}, std::output_iterator<const char &> Out>
+Out write(Out out, std::span<const std::byte> bytes, std::uint64_t address = 0, std::string_view insert = "\n")
+{
+	using formatter = line_formatter<F>;
+	char line[formatter::length];
+	std::size_t first = static_cast<std::size_t>(address % F.line_bytes);
+	std::size_t done = 0, count;
+	while (done < bytes.size())
+	{
+		count = std::min(F.line_bytes - first, bytes.size() - done);
+		formatter::format_line(line, bytes.data() + done, address - first, first, count);
+		out = std::copy(line, line + formatter::length, out);
+		out = std::copy(insert.begin(), insert.end(), out);
+		done += count;
+		address += count;
+		first = 0;
+	}
+	return out;
+}
+
+/* Адресные строки байт bytes с адресом address и добавочной строкой insert одной строкой */
+template <format F = format{}>
+std::string to_string(std::span<const std::byte> bytes, std::uint64_t address = 0, std::string_view insert = "\n")
+{
+	std::string s(char_count<F>(bytes.size(), address, insert.size()), '\0');
+	write<F>(s.data(), bytes, address, insert);
+	return s;
+}
+
+/* Ленивый диапазон адресных строк (без добавочной строки): строка преобразуется при переходе к ней
+в буфер итератора, std::string_view действителен до следующего перехода итератора. */
+template <format F = format{}>
+class lines : public std::ranges::view_interface<lines<F>>
+{
+	using formatter = line_formatter<F>;
+
+public:
+	class iterator
+	{
+	public:
+		using value_type = std::string_view;
+		using difference_type = std::ptrdiff_t;
+		using iterator_concept = std::input_iterator_tag;
+
+		iterator() = default;
+
+		std::string_view operator*() const noexcept
+		{
+			return std::string_view(line_, formatter::length);
+		}
+
+		iterator &operator++() noexcept
+		{
+			done_ += count_;
+			address_ += count_;
+			load();
+			return *this;
+		}
+
+		void operator++(int) noexcept
+		{
+			++*this;
+		}
+
+		friend bool operator==(const iterator &it, std::default_sentinel_t) noexcept
+		{
+			return it.done_ >= it.bytes_.size();
+		}
+
+	private:
+		friend class lines;
+
+		iterator(std::span<const std::byte> bytes, std::uint64_t address) noexcept
+			: bytes_(bytes), address_(address)
+		{
+			load();
+		}
+
+		/* преобразование строки с байтом done_ */
+		void load() noexcept
+		{
+			if (done_ >= bytes_.size())
+				return;
+			std::size_t first = static_cast<std::size_t>(address_ % F.line_bytes);
+			count_ = std::min(F.line_bytes - first, bytes_.size() - done_);
+			formatter::format_line(line_, bytes_.data() + done_, address_ - first, first, count_);
+		}
+
+		std::span<const std::byte> bytes_;
+		std::uint64_t address_ = 0;  // адрес байта done_
+		std::size_t done_ = 0;       // число байт предыдущих строк
+		std::size_t count_ = 0;      // число байт текущей строки
+		char line_[formatter::length];
+	};
+
+	lines() = default;
+
+	lines(std::span<const std::byte> bytes, std::uint64_t address = 0) noexcept
+		: bytes_(bytes), address_(address)
+	{
+	}
+
+	iterator begin() const noexcept
+	{
+		return iterator(bytes_, address_);
+	}
+
+	std::default_sentinel_t end() const noexcept
+	{
+		return std::default_sentinel;
+	}
+
+	std::size_t size() const noexcept
+	{
+		return formatter::line_count(bytes_.size(), address_);
+	}
+
+private:
+	std::span<const std::byte> bytes_;
+	std::uint64_t address_ = 0;
+};
+
+} // namespace hexprn_cpp
+
+#endif //HEXPRN_HPP
@@ -0,0 +1,757 @@
+/*
+	hexprn_bench.c
+	Программа hexprn_bench: измерение скорости путей преобразования
+
+Для каждого размера входных данных (от 16 байт до заданного наибольшего, с шагом x16)
+и каждого формата из набора измеряются пути преобразования библиотеки: hexprn(), shexprn(),
+shexprnf(), fhexprnf(), потоковое, вытягивающее, проталкиваемое, скомпилированное и многопоточное преобразование,
+примитивы elements, поиск образцов, а также базовые варианты: sprintf("%02X") и программа xxd.
+Каждое измерение повторяется, пока не наберется заданное время, из нескольких серий
+берется лучшая. Результаты выводятся по одному JSON объекту в строке:
+
+	{"type":"result","bench":"shexprnf","preset":"default","bytes":1048576,"lines":65536,
+	 "iters":512,"seconds":0.000401,"gbps":2.614,"ns_per_line":6.12}
+
+seconds - время одного преобразования, gbps - входные байты в секунду (10^9),
+ns_per_line - время на одну адресную строку.
+*/
+#define _POSIX_C_SOURCE 200809L  // clock_gettime(), fork() и т.п.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+
+#include "hexprn.h"
+#include "hexpool.h"
+#include "hexparse.h"
+#include "hexgrep.h"
+#include "hexemit.h"
+
+/* число серий измерения, берется лучшая */
+#define BENCH_ROUNDS 3
+
+/* размер порции для примитивов elements, в пределах кэша данных процессора */
+#define BENCH_CHUNK 0x4000
+
+/* буфер вытягивающего преобразования, не кратный длине строки: строки на границе выдаются по частям */
+#define BENCH_FRAME 4093
+
+/* часть проталкиваемого преобразования, как данные пакета Ethernet */
+#define BENCH_FRAGMENT 1514
+
+/* образцы поиска, в псевдослучайных данных практически не встречаются */
+#define BENCH_PATTERNS 4
+static const byte bench_patterns[BENCH_PATTERNS][8] = {
+	{ 0xDE, 0xAD, 0xBE, 0xEF, 0x00, 0x11, 0x22, 0x33 },
+	{ 0x7F, 'E', 'L', 'F', 0x02, 0x01, 0x01, 0x00 },
+	{ 'M', 'Z', 0x90, 0x00, 0x03, 0x00, 0x00, 0x00 },
+	{ 0x89, 'P', 'N', 'G', 0x0D, 0x0A, 0x1A, 0x0A },
+};
+
+/* формат преобразования из набора */
+struct Bench_Preset
+{
+	const char *name;
+	struct Trans_Format tf;
+	int zero_data;  // != 0 - входные данные из нулей (для сжатия повторов)
+};
+
+/* параметры программы */
+struct Bench_Options
+{
+	size_t min_size;       // наименьший размер входных данных
+	size_t max_size;       // наибольший размер входных данных
+	size_t max_out;        // наибольший размер выходной строки для преобразований в память
+	double min_time;       // время одной серии измерения, секунды
+	const char *bench;     // фильтр по имени пути, NULL - все
+	const char *preset;    // фильтр по имени формата, NULL - все
+	const char *xxd;       // программа xxd, NULL - не измерять
+	const char *cli;       // программа hexprn, NULL - не измерять
+	const char *out_path;  // файл результатов, NULL - стандартный вывод
+	size_t threads;        // число потоков пула, 0 - по числу процессоров
+};
+
+/* состояние измерения одного размера и формата */
+struct Bench_Ctx
+{
+	struct Bench_Options *opt;
+	struct Bench_Preset *preset;
+	struct Compiled_Format cf;
+	byte *in;               // входные данные текущего формата
+	byte *random;           // псевдослучайные входные данные
+	size_t size;            // их размер
+	char *out;              // выходная строка для преобразований в память
+	size_t out_size;        // её размер
+	size_t text_length;     // длина преобразованного текста в out для разбора
+	struct Trans_Result64 tr;  // предполагаемый результат для формата
+	struct Hexprn_Pool *pool;
+	FILE *null_fp;          // /dev/null для вывода в файл
+	char *file_path;        // временный файл с входными данными для внешних программ
+	char chunk[BENCH_CHUNK * (BYTE_SIZE_IN_BITS + 1)];  // цифры примитивов, двоичные с разделителями
+	char digits[BENCH_CHUNK * BYTE_SIZE_IN_TETRAS];  // шестнадцатеричные цифры для hex_bytes()
+	byte chunk_bytes[BENCH_CHUNK];
+	byte *copy;             // копия входных данных для сравнения, в неё же пишет разбор
+	struct Hexgrep *grep;   // набор образцов bench_patterns
+};
+
+/* путь преобразования: возвращает 0 при успехе, BENCH_SKIP - путь не применим
+(внешняя программа не задана или не найдена), < 0 - ошибка преобразования */
+typedef int (*bench_fn)(struct Bench_Ctx *b);
+#define BENCH_SKIP 1
+
+/* результаты bench_measure(), кроме времени: путь не применим и ошибка */
+#define BENCH_SKIPPED (-1.0)
+#define BENCH_FAILED  (-2.0)
+
+struct Bench_Case
+{
+	const char *name;
+	bench_fn run;
+	int formatted;  // != 0 - зависит от формата, иначе измеряется только с первым форматом
+	int in_memory;  // != 0 - пишет всю выходную строку в память, ограничивается max_out
+};
+
+/* время в секундах */
+static double bench_now(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (double) ts.tv_sec + (double) ts.tv_nsec * 1e-9;
+}
+
+/* функция записи, отбрасывающая вывод */
+static size_t sink_null(void *sink_arg, const char *s, size_t n)
+{
+	(void) sink_arg; (void) s;
+	return n;
+}
+
+/* --- пути преобразования библиотеки --- */
+
+static int run_hexprn(struct Bench_Ctx *b)
+{
+	/* stdout направлен в /dev/null на всё время работы программы */
+	return hexprn(b->in, b->size).str_count > 0 ? 0 : -1;
+}
+
+static int run_shexprn(struct Bench_Ctx *b)
+{
+	char **s = (char **) malloc(sizeof(char *));
+	if (s == NULL)
+		return -1;
+	int r = shexprn(s, b->in, b->size, 0).str_count > 0 ? 0 : -1;
+	if (r == 0)
+		free(*s);
+	free(s);
+	return r;
+}
+
+static int run_shexprnf(struct Bench_Ctx *b)
+{
+	/* как у вызывающего: подсчет результата и преобразование с компиляцией формата */
+	struct Trans_Result tr = calc_tr_result(b->size, 0, &b->preset->tf, "\n");
+	if (tr.char_count <= 0)
+		return -1;
+	return shexprnf(b->out, b->in, b->size, 0, &b->preset->tf, "\n", tr).str_count > 0 ? 0 : -1;
+}
+
+static int run_shexprnc64(struct Bench_Ctx *b)
+{
+	return shexprnc64(b->out, b->in, b->size, 0, &b->cf, "\n", b->tr).error ? -1 : 0;
+}
+
+static int run_shexprnc_mt64(struct Bench_Ctx *b)
+{
+	return shexprnc_mt64(b->pool, b->out, b->in, b->size, 0, &b->cf, "\n", b->tr).error ? -1 : 0;
+}
+
+static int run_stream(struct Bench_Ctx *b)
+{
+	return stream_hexprnc64(sink_null, NULL, b->in, b->size, 0, &b->cf, "\n").error ? -1 : 0;
+}
+
+static int run_encoder(struct Bench_Ctx *b)
+{
+	struct Hexprn_Encoder enc;
+	if (hexprn_encoder_init(&enc, b->in, b->size, 0, &b->cf, "\n") == NULL)
+		return -1;
+	while (!hexprn_encoder_done(&enc))
+		hexprn_encoder_fill(&enc, b->chunk, BENCH_FRAME);
+	return enc.tr.error ? -1 : 0;
+}
+
+static int run_feeder(struct Bench_Ctx *b)
+{
+	struct Hexprn_Feeder feeder;
+	size_t pos, n;
+	if (hexprn_feeder_init(&feeder, 0, &b->cf, "\n", sink_null, NULL) == NULL)
+		return -1;
+	for (pos = 0; pos < b->size; pos += n)
+	{
+		n = b->size - pos < BENCH_FRAGMENT ? b->size - pos : BENCH_FRAGMENT;
+		if (hexprn_feeder_write(&feeder, b->in + pos, n) != 0)
+			return -1;
+	}
+	return hexprn_feeder_flush(&feeder);
+}
+
+static int run_fhexprnf(struct Bench_Ctx *b)
+{
+	/* 32-разрядный результат ограничен INT_MAX, поэтому ошибкой считается только str_count < 0 */
+	return fhexprnf(b->null_fp, b->in, b->size, 0, &b->preset->tf, "\n").str_count < 0 ? -1 : 0;
+}
+
+static int run_shexparsec(struct Bench_Ctx *b)
+{
+	/* разбор текста, подготовленного при настройке измерения */
+	struct Parse_Result pr = shexparsec(b->copy, b->size, b->out, b->text_length, &b->cf, "\n");
+	return pr.error == HEXPARSE_OK && pr.byte_count == b->size ? 0 : -1;
+}
+
+/* --- примитивы elements, по порциям BENCH_CHUNK байт --- */
+
+static int run_bytes_hex(struct Bench_Ctx *b)
+{
+	size_t pos, n;
+	for (pos = 0; pos < b->size; pos += n)
+	{
+		n = b->size - pos < BENCH_CHUNK ? b->size - pos : BENCH_CHUNK;
+		bytes_hex(b->in + pos, b->chunk, n, BIG_ENDIAN);
+	}
+	return 0;
+}
+
+static int run_bytes_hex_scalar(struct Bench_Ctx *b)
+{
+	int level = simd_level();
+	simd_set_level(SIMD_SCALAR);
+	run_bytes_hex(b);
+	simd_set_level(level);
+	return 0;
+}
+
+static int run_bytes_bin(struct Bench_Ctx *b)
+{
+	size_t pos, n;
+	for (pos = 0; pos < b->size; pos += n)
+	{
+		n = b->size - pos < BENCH_CHUNK ? b->size - pos : BENCH_CHUNK;
+		bytes_bin(b->in + pos, b->chunk, n, BIG_ENDIAN);
+	}
+	return 0;
+}
+
+static int run_bytes_bin_scalar(struct Bench_Ctx *b)
+{
+	int level = simd_level();
+	simd_set_level(SIMD_SCALAR);
+	run_bytes_bin(b);
+	simd_set_level(level);
+	return 0;
+}
+
+static int run_bytes_swap(struct Bench_Ctx *b)
+{
+	size_t pos, n;
+	for (pos = 0; pos < b->size; pos += n)
+	{
+		n = b->size - pos < BENCH_CHUNK ? b->size - pos : BENCH_CHUNK;
+		bytes_swap(b->in + pos, b->chunk_bytes, n & ~(size_t) 7, 8);
+	}
+	return 0;
+}
+
+static int run_byte_trans(struct Bench_Ctx *b)
+{
+	struct trans_mode tm;
+	size_t pos, n;
+	tm.base = BASE_HEX;
+	tm.seq_endian = BIG_ENDIAN;
+	tm.byte_endian = BIG_ENDIAN;
+	tm.gap = 1;
+	tm.gap_delim = ' ';
+	for (pos = 0; pos < b->size; pos += n)
+	{
+		n = b->size - pos < BENCH_CHUNK ? b->size - pos : BENCH_CHUNK;
+		if (byte_trans(b->in + pos, b->chunk, n, tm) < 0)
+			return -1;
+	}
+	return 0;
+}
+
+static int run_hex_bytes(struct Bench_Ctx *b)
+{
+	size_t pos, n;
+	for (pos = 0; pos < b->size; pos += n)
+	{
+		n = b->size - pos < BENCH_CHUNK ? b->size - pos : BENCH_CHUNK;
+		if (hex_bytes(b->digits, b->chunk_bytes, n) != (int) n)
+			return -1;
+	}
+	return 0;
+}
+
+static int run_bytes_mismatch(struct Bench_Ctx *b)
+{
+	return bytes_mismatch(b->in, b->copy, b->size) == b->size ? 0 : -1;
+}
+
+static int run_bytes_find(struct Bench_Ctx *b)
+{
+	bytes_find(b->in, b->size, bench_patterns[0], sizeof(bench_patterns[0]));
+	return 0;
+}
+
+/* инициализатор массива C по 12 значений в строке, как у xxd -i */
+static int run_hexemit(struct Bench_Ctx *b)
+{
+	struct Emit_Format ef = ret_default_ef();
+	ef.type = EMIT_C;
+	ef.line_bytes = 12;
+	return stream_hexemit(sink_null, NULL, b->in, b->size, &ef, "\n").error ? -1 : 0;
+}
+
+/* несколько образцов: автомат, вывод окон отбрасывается */
+static int run_hexgrep(struct Bench_Ctx *b)
+{
+	return stream_hexgrepc(sink_null, NULL, b->in, b->size, 0, b->grep, &b->cf, "\n", NULL).error ? -1 : 0;
+}
+
+/* --- базовые варианты --- */
+
+/* построчное преобразование sprintf() в формате по умолчанию: адрес, ячейки, ascii */
+static int run_sprintf(struct Bench_Ctx *b)
+{
+	char *s = b->out;
+	size_t pos, j, n;
+	for (pos = 0; pos < b->size; pos += HEXPRN_LINE_BYTES)
+	{
+		n = b->size - pos < HEXPRN_LINE_BYTES ? b->size - pos : HEXPRN_LINE_BYTES;
+		s += sprintf(s, "%08X: ", (unsigned) pos);
+		for (j = 0; j < n; j++)
+			s += sprintf(s, j == 7 ? "%02X | " : "%02X ", b->in[pos + j]);
+		s += sprintf(s, "| ");
+		for (j = 0; j < n; j++)
+			*s++ = b->in[pos + j] < 0x20 || b->in[pos + j] >= 0x7F ? '.' : (char) b->in[pos + j];
+		*s++ = '\n';
+	}
+	return 0;
+}
+
+/* запуск внешней программы path с файлом входных данных, вывод в /dev/null */
+static int run_program(const char *path, const char *file_path)
+{
+	int status;
+	pid_t pid = fork();
+	if (pid < 0)
+		return -1;
+	if (pid == 0)
+	{
+		execlp(path, path, file_path, (char *) NULL);
+		_exit(127);
+	}
+	if (waitpid(pid, &status, 0) < 0 || !WIFEXITED(status))
+		return -1;
+	if (WEXITSTATUS(status) == 127)
+		return BENCH_SKIP;  // программа не найдена
+	return WEXITSTATUS(status) == 0 ? 0 : -1;
+}
+
+static int run_xxd(struct Bench_Ctx *b)
+{
+	if (b->opt->xxd == NULL || b->file_path == NULL)
+		return BENCH_SKIP;
+	return run_program(b->opt->xxd, b->file_path);
+}
+
+static int run_cli(struct Bench_Ctx *b)
+{
+	if (b->opt->cli == NULL || b->file_path == NULL)
+		return BENCH_SKIP;
+	return run_program(b->opt->cli, b->file_path);
+}
+
+/* измеряемые пути */
+static struct Bench_Case bench_cases[] =
+{
+	{ "hexprn",         run_hexprn,           0, 0 },
+	{ "shexprn",        run_shexprn,          0, 1 },
+	{ "shexprnf",       run_shexprnf,         1, 1 },
+	{ "shexprnc64",     run_shexprnc64,       1, 1 },
+	{ "shexprnc_mt64",  run_shexprnc_mt64,    1, 1 },
+	{ "stream_hexprnc64", run_stream,         1, 0 },
+	{ "hexprn_encoder", run_encoder,          1, 0 },
+	{ "hexprn_feeder",  run_feeder,           1, 0 },
+	{ "fhexprnf",       run_fhexprnf,         1, 0 },
+	{ "shexparsec",     run_shexparsec,       1, 1 },
+	{ "bytes_hex",      run_bytes_hex,        0, 0 },
+	{ "bytes_hex_scalar", run_bytes_hex_scalar, 0, 0 },
+	{ "bytes_bin",      run_bytes_bin,        0, 0 },
+	{ "bytes_bin_scalar", run_bytes_bin_scalar, 0, 0 },
+	{ "bytes_swap",     run_bytes_swap,       0, 0 },
+	{ "byte_trans",     run_byte_trans,       0, 0 },
+	{ "hex_bytes",      run_hex_bytes,        0, 0 },
+	{ "bytes_mismatch", run_bytes_mismatch,   0, 0 },
+	{ "bytes_find",     run_bytes_find,       0, 0 },
+	{ "stream_hexgrepc", run_hexgrep,         0, 0 },
+	{ "stream_hexemit", run_hexemit,          0, 0 },
+	{ "sprintf_02X",    run_sprintf,          0, 1 },
+	{ "xxd",            run_xxd,              0, 0 },
+	{ "hexprn_cli",     run_cli,              0, 0 },
+};
+
+/* набор форматов, первый - формат по умолчанию */
+static size_t bench_presets(struct Bench_Preset *p)
+{
+	size_t n = 0;
+
+	p[n].name = "default";
+	p[n].tf = ret_default_tf();
+	p[n++].zero_data = 0;
+
+	p[n].name = "dense";
+	p[n].tf = ret_default_tf();
+	p[n].tf.hex_char_delimeter = '\0';
+	p[n].tf.hex_block_delimeter = '\0';
+	p[n].tf.hex_block_length = 0;
+	p[n++].zero_data = 0;
+
+	p[n].name = "wide32";
+	p[n].tf = ret_default_tf();
+	p[n].tf.line_bytes = 0x20;
+	p[n].tf.address_digits = 0x10;
+	p[n++].zero_data = 0;
+
+	p[n].name = "line24";
+	p[n].tf = ret_default_tf();
+	p[n].tf.line_bytes = 0x18;
+	p[n++].zero_data = 0;
+
+	p[n].name = "binary";
+	p[n].tf = ret_default_tf();
+	p[n].tf.base = BASE_BIN;
+	p[n].tf.hex_block_length = 0x4;
+	p[n++].zero_data = 0;
+
+	p[n].name = "words32";
+	p[n].tf = ret_default_tf();
+	p[n].tf.word_bytes = 4;
+	p[n].tf.hex_block_length = 0;
+	p[n++].zero_data = 0;
+
+	p[n].name = "cp1251";
+	p[n].tf = ret_default_tf();
+	p[n].tf.char_set = CHARSET_CP1251;
+	p[n++].zero_data = 0;
+
+	p[n].name = "color";
+	p[n].tf = ret_default_tf();
+	p[n].tf.color = 1;
+	p[n++].zero_data = 0;
+
+	p[n].name = "squeeze_zero";
+	p[n].tf = ret_default_tf();
+	p[n].tf.squeeze = 1;
+	p[n++].zero_data = 1;
+
+	return n;
+}
+
+/* Измерение пути c: серии по min_time секунд, возвращает лучшее время одного вызова,
+BENCH_SKIPPED или BENCH_FAILED */
+static double bench_measure(struct Bench_Ctx *b, struct Bench_Case *c, unsigned long *iters)
+{
+	double best = -1.0, start, t;
+	unsigned long n, i;
+	int round, r;
+
+	/* пробный вызов и оценка числа повторов */
+	start = bench_now();
+	if ((r = c->run(b)) != 0)
+		return r == BENCH_SKIP ? BENCH_SKIPPED : BENCH_FAILED;
+	t = bench_now() - start;
+	n = t <= 0.0 ? 1000000 : (unsigned long) (b->opt->min_time / t) + 1;
+	if (n > 1000000)
+		n = 1000000;
+
+	for (round = 0; round < BENCH_ROUNDS; round++)
+	{
+		start = bench_now();
+		for (i = 0; i < n; i++)
+			if (c->run(b) != 0)
+				return BENCH_FAILED;
+		t = (bench_now() - start) / (double) n;
+		if (best < 0.0 || t < best)
+			best = t;
+	}
+	*iters = n;
+	return best;
+}
+
+/* запись временного файла с входными данными для внешних программ */
+static char *bench_file(const byte *in, size_t size)
+{
+	const char *dir = getenv("TMPDIR");
+	char *path = (char *) malloc(strlen(dir == NULL ? "/tmp" : dir) + 32);
+	int fd;
+	size_t done = 0;
+	ssize_t r;
+
+	if (path == NULL)
+		return NULL;
+	sprintf(path, "%s/hexprn_bench_XXXXXX", dir == NULL ? "/tmp" : dir);
+	if ((fd = mkstemp(path)) < 0)
+	{
+		free(path);
+		return NULL;
+	}
+	while (done < size && (r = write(fd, in + done, size - done)) > 0)
+		done += (size_t) r;
+	close(fd);
+	if (done < size)
+	{
+		unlink(path);
+		free(path);
+		return NULL;
+	}
+	return path;
+}
+
+/* разбор размера с суффиксом K, M, G, возвращает 0 при ошибке */
+static size_t parse_size(const char *s)
+{
+	char *end;
+	errno = 0;
+	unsigned long long v = strtoull(s, &end, 0);
+	if (errno != 0 || end == s)
+		return 0;
+	switch (*end)
+	{
+	case 'k': case 'K': v <<= 10; end++; break;
+	case 'm': case 'M': v <<= 20; end++; break;
+	case 'g': case 'G': v <<= 30; end++; break;
+	}
+	return *end == '\0' ? (size_t) v : 0;
+}
+
+static void usage(FILE *fp)
+{
+	fprintf(fp,
+		"Usage: hexprn_bench [options]\n"
+		"Measure throughput of hexprn conversion paths, print JSON lines.\n"
+		"  -s size    smallest input size (default 16)\n"
+		"  -m size    largest input size (default 64M), sizes grow x16; K, M, G suffixes\n"
+		"  -M size    largest output for in-memory paths (default 1G)\n"
+		"  -t sec     time of one measuring round (default 0.2)\n"
+		"  -b name    measure only paths whose name contains name\n"
+		"  -p name    measure only the named format preset\n"
+		"  -j count   pool threads (default: all processors)\n"
+		"  -x path    xxd program (default xxd), empty to skip\n"
+		"  -c path    hexprn program (default ./hexprn), empty to skip\n"
+		"  -o file    write results to file\n"
+		"  -h         show this help\n");
+}
+
+static int parse_options(int argc, char **argv, struct Bench_Options *opt)
+{
+	int c;
+	opt->min_size = 0x10;
+	opt->max_size = (size_t) 0x4000000;
+	opt->max_out = (size_t) 0x40000000;
+	opt->min_time = 0.2;
+	opt->bench = NULL;
+	opt->preset = NULL;
+	opt->xxd = "xxd";
+	opt->cli = "./hexprn";
+	opt->out_path = NULL;
+	opt->threads = 0;
+
+	while ((c = getopt(argc, argv, "s:m:M:t:b:p:j:x:c:o:h")) != -1)
+	{
+		switch (c)
+		{
+		case 's': case 'm': case 'M': case 'j':
+		{
+			size_t v = parse_size(optarg);
+			if (v == 0)
+			{
+				fprintf(stderr, "hexprn_bench: invalid size '%s'\n", optarg);
+				return -1;
+			}
+			if (c == 's') opt->min_size = v;
+			else if (c == 'm') opt->max_size = v;
+			else if (c == 'M') opt->max_out = v;
+			else opt->threads = v;
+			break;
+		}
+		case 't': opt->min_time = atof(optarg); break;
+		case 'b': opt->bench = optarg; break;
+		case 'p': opt->preset = optarg; break;
+		case 'x': opt->xxd = optarg[0] == '\0' ? NULL : optarg; break;
+		case 'c': opt->cli = optarg[0] == '\0' ? NULL : optarg; break;
+		case 'o': opt->out_path = optarg; break;
+		case 'h': usage(stdout); exit(0);
+		default: usage(stderr); return -1;
+		}
+	}
+	if (optind < argc || opt->min_time <= 0.0 || opt->min_size > opt->max_size)
+	{
+		usage(stderr);
+		return -1;
+	}
+	if (opt->cli != NULL && access(opt->cli, X_OK) != 0)
+		opt->cli = NULL;
+	return 0;
+}
+
+int main(int argc, char **argv)
+{
+	struct Bench_Options opt;
+	struct Bench_Preset presets[0x10];
+	struct Bench_Ctx *b;
+	FILE *out = stdout;
+	size_t preset_count, size, p, k;
+	unsigned long iters;
+	double t;
+	int r = 0;
+
+	if (parse_options(argc, argv, &opt) < 0)
+		return 2;
+	if (opt.out_path != NULL && (out = fopen(opt.out_path, "w")) == NULL)
+	{
+		fprintf(stderr, "hexprn_bench: %s: %s\n", opt.out_path, strerror(errno));
+		return 1;
+	}
+
+	/* hexprn() и внешние программы пишут в stdout, он направляется в /dev/null,
+	а результаты без -o выводятся в копию исходного stdout */
+	int null_fd = open("/dev/null", O_WRONLY);
+	if (null_fd < 0 || (out == stdout && (out = fdopen(dup(STDOUT_FILENO), "w")) == NULL))
+	{
+		fprintf(stderr, "hexprn_bench: %s\n", strerror(errno));
+		return 1;
+	}
+	dup2(null_fd, STDOUT_FILENO);
+	close(null_fd);
+	preset_count = bench_presets(presets);
+
+	b = (struct Bench_Ctx *) calloc(1, sizeof(struct Bench_Ctx));
+	if (b == NULL)
+		return 1;
+	b->opt = &opt;
+	b->pool = hexprn_pool_create(opt.threads, 0);
+	b->null_fp = fopen("/dev/null", "w");
+	b->random = (byte *) malloc(opt.max_size);
+	b->copy = (byte *) malloc(opt.max_size);
+	const byte *patterns[BENCH_PATTERNS];
+	size_t pattern_lengths[BENCH_PATTERNS];
+	for (k = 0; k < BENCH_PATTERNS; k++)
+	{
+		patterns[k] = bench_patterns[k];
+		pattern_lengths[k] = sizeof(bench_patterns[k]);
+	}
+	b->grep = hexgrep_create(patterns, pattern_lengths, BENCH_PATTERNS);
+	if (b->pool == NULL || b->null_fp == NULL || b->random == NULL || b->copy == NULL || b->grep == NULL)
+	{
+		fprintf(stderr, "hexprn_bench: out of memory\n");
+		return 1;
+	}
+
+	/* псевдослучайные входные данные, повторяемые между запусками */
+	unsigned long long x = 0x9E3779B97F4A7C15ULL;
+	for (k = 0; k < opt.max_size; k++)
+	{
+		x ^= x << 13; x ^= x >> 7; x ^= x << 17;
+		b->random[k] = (byte) x;
+	}
+	bytes_hex(b->random, b->digits, opt.max_size < BENCH_CHUNK ? opt.max_size : BENCH_CHUNK, BIG_ENDIAN);
+
+	fprintf(out, "{\"type\":\"meta\",\"simd\":\"%s\",\"threads\":%lu,\"round_seconds\":%g,\"rounds\":%d}\n",
+		simd_level_name(simd_level()), (unsigned long) hexprn_pool_size(b->pool), opt.min_time, BENCH_ROUNDS);
+
+	/* размеры растут в 0x10 раз, последний - наибольший */
+	for (size = opt.min_size; ; size = size > opt.max_size / 0x10 ? opt.max_size : size * 0x10)
+	{
+		b->size = size;
+		b->file_path = (opt.xxd != NULL || opt.cli != NULL) ? bench_file(b->random, size) : NULL;
+
+		for (p = 0; p < preset_count; p++)
+		{
+			b->preset = &presets[p];
+			if (opt.preset != NULL && strcmp(opt.preset, presets[p].name) != 0)
+				continue;
+			if (compile_tf(&b->cf, &presets[p].tf) == NULL)
+				continue;
+			b->in = presets[p].zero_data ? (byte *) calloc(size, 1) : b->random;
+			if (b->in == NULL)
+				continue;
+			memcpy(b->copy, b->in, size);
+			b->tr = calc_tr_result64(size, 0, &presets[p].tf, "\n");
+
+			/* выходная строка для преобразований в память, с запасом для построчного sprintf() */
+			b->out = NULL;
+			b->out_size = (size_t) b->tr.char_count + HEXPRN_LINE_MAX;
+			if (b->out_size <= opt.max_out)
+			{
+				b->out = (char *) malloc(b->out_size);
+				if (b->out != NULL)
+					b->text_length = (size_t) shexprnc64(b->out, b->in, size, 0, &b->cf, "\n", b->tr).char_count;
+			}
+
+			for (k = 0; k < sizeof(bench_cases) / sizeof(bench_cases[0]); k++)
+			{
+				struct Bench_Case *c = &bench_cases[k];
+				if (opt.bench != NULL && strstr(c->name, opt.bench) == NULL)
+					continue;
+				if (!c->formatted && p != 0)
+					continue;
+				if (c->in_memory && b->out == NULL)
+					continue;
+				t = bench_measure(b, c, &iters);
+				if (t == BENCH_SKIPPED)
+					continue;
+				if (t == BENCH_FAILED)
+				{
+					fprintf(stderr, "hexprn_bench: %s, preset %s, %llu bytes: conversion failed\n",
+						c->name, c->formatted ? presets[p].name : "-", (unsigned long long) size);
+					r = 1;
+					continue;
+				}
+				fprintf(out, "{\"type\":\"result\",\"bench\":\"%s\",\"preset\":\"%s\",\"bytes\":%llu,\"lines\":%llu,"
+					"\"iters\":%lu,\"seconds\":%.9f,\"gbps\":%.4f,\"ns_per_line\":%.3f}\n",
+					c->name, c->formatted ? presets[p].name : "-", (unsigned long long) size,
+					(unsigned long long) b->tr.str_count, iters, t, (double) size / t * 1e-9,
+					t * 1e9 / (double) b->tr.str_count);
+				fflush(out);
+			}
+
+			free(b->out);
+			if (b->in != b->random)
+				free(b->in);
+		}
+
+		if (b->file_path != NULL)
+		{
+			unlink(b->file_path);
+			free(b->file_path);
+		}
+		if (size >= opt.max_size)
+			break;
+	}
+
+	hexprn_pool_destroy(b->pool);
+	fclose(b->null_fp);
+	if (fclose(out) != 0)
+		r = 1;
+	free(b->random);
+	free(b->copy);
+	hexgrep_destroy(b->grep);
+	free(b);
+	return r;
+}
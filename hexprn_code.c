@@ -1,16 +1,24 @@
 /* Код проекта hex_prn */
+#define _POSIX_C_SOURCE 200809L  // write() и ssize_t для вывода в файловый дескриптор
+
 #include <stdint.h>
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
+#include <stddef.h>
+#include <errno.h>
+#include <time.h>
+#ifdef _WIN32
+#include <io.h>
+#define write _write
+typedef int ssize_t;
+#else
+#include <unistd.h>
+#endif
 
 #include "elements.h"
 #include "hexprn.h"
 
-
-enum CellType {cell_empty, cell_byte};
-enum ASCIIType {value_hex, value_ascii};
-
 /* ASCII коды управляющих символов */
 #define CHAR_NUL 0x00  // Null Character
 #define CHAR_LF  0x0A  // Line Feed
@@ -18,28 +26,248 @@ enum ASCIIType {value_hex, value_ascii};
 #define CHAR_US  0x1F  // Unit Separator
 #define CHAR_DEL 0x7F  // Delete
 
-/* Структура, определяющая одну ячейку */
-static struct Cell
-{
-	int type;  // тип ячейки
-	word address;  // адрес байта
-	byte value;    // значение байта
-	char hex[BYTE_SIZE_IN_TETRAS];  // значение ячейки в hex [BYTE_SIZE_IN_TETRAS]
-	char ascii;    // отображаемый символ ячейки ASCII
+/* символы Latin-1, которые не показываются в ascii области как есть */
+#define CHAR_NBSP 0xA0  // No-Break Space, значения 0x80..0x9F - управляющие символы C1
+#define CHAR_SHY  0xAD  // Soft Hyphen, не виден на экране
+
+/* escape-последовательности ANSI классов байт, длина каждой не больше HEXPRN_COLOR_MAX */
+static const char *color_sgr[HEXPRN_CLASS_COUNT] = {
+	"\033[0m", "\033[90m", "\033[36m", "\033[32m", "\033[33m", "\033[31m"
+};
+static const size_t color_sgr_length[HEXPRN_CLASS_COUNT] = { 4, 5, 5, 5, 5, 5 };
+
+/* число значений старшей половины кодовой страницы 0x80..0xFF */
+#define CHARSET_HIGH_SIZE 0x80
+
+/* Таблицы кодовых страниц ascii области: код символа Unicode для каждого значения байта,
+0 - управляющий или не определенный символ. Младшая половина CP1251, KOI8-R и CP866 совпадает с ascii. */
+
+/* CP1251 (Windows-1251), байты 0x80..0xFF */
+static const uint16_t charset_cp1251[CHARSET_HIGH_SIZE] = {
+	0x0402, 0x0403, 0x201A, 0x0453, 0x201E, 0x2026, 0x2020, 0x2021,
+	0x20AC, 0x2030, 0x0409, 0x2039, 0x040A, 0x040C, 0x040B, 0x040F,
+	0x0452, 0x2018, 0x2019, 0x201C, 0x201D, 0x2022, 0x2013, 0x2014,
+	0x0000, 0x2122, 0x0459, 0x203A, 0x045A, 0x045C, 0x045B, 0x045F,
+	0x00A0, 0x040E, 0x045E, 0x0408, 0x00A4, 0x0490, 0x00A6, 0x00A7,
+	0x0401, 0x00A9, 0x0404, 0x00AB, 0x00AC, 0x0000, 0x00AE, 0x0407,
+	0x00B0, 0x00B1, 0x0406, 0x0456, 0x0491, 0x00B5, 0x00B6, 0x00B7,
+	0x0451, 0x2116, 0x0454, 0x00BB, 0x0458, 0x0405, 0x0455, 0x0457,
+	0x0410, 0x0411, 0x0412, 0x0413, 0x0414, 0x0415, 0x0416, 0x0417,
+	0x0418, 0x0419, 0x041A, 0x041B, 0x041C, 0x041D, 0x041E, 0x041F,
+	0x0420, 0x0421, 0x0422, 0x0423, 0x0424, 0x0425, 0x0426, 0x0427,
+	0x0428, 0x0429, 0x042A, 0x042B, 0x042C, 0x042D, 0x042E, 0x042F,
+	0x0430, 0x0431, 0x0432, 0x0433, 0x0434, 0x0435, 0x0436, 0x0437,
+	0x0438, 0x0439, 0x043A, 0x043B, 0x043C, 0x043D, 0x043E, 0x043F,
+	0x0440, 0x0441, 0x0442, 0x0443, 0x0444, 0x0445, 0x0446, 0x0447,
+	0x0448, 0x0449, 0x044A, 0x044B, 0x044C, 0x044D, 0x044E, 0x044F,
 };
 
-/* Структура, определяющая адресную строку */
-static struct AddressString
-{
-	struct Cell cells[0x10];    // массив ячеек
-	word address_start;  // адрес, соответствующий нулевому элементу массива байт
-	byte *byte_array;    // массив байт
-	size_t byte_count;   // число байт в адресной строке для преобразования, не более 0x10
-	size_t bytes_start;  // номер ячейки, с какой записываются байты
-	size_t bytes_finish; // номер ячейки, на какой заканчивается заканчивается запись байтов
+/* KOI8-R, байты 0x80..0xFF */
+static const uint16_t charset_koi8r[CHARSET_HIGH_SIZE] = {
+	0x2500, 0x2502, 0x250C, 0x2510, 0x2514, 0x2518, 0x251C, 0x2524,
+	0x252C, 0x2534, 0x253C, 0x2580, 0x2584, 0x2588, 0x258C, 0x2590,
+	0x2591, 0x2592, 0x2593, 0x2320, 0x25A0, 0x2219, 0x221A, 0x2248,
+	0x2264, 0x2265, 0x00A0, 0x2321, 0x00B0, 0x00B2, 0x00B7, 0x00F7,
+	0x2550, 0x2551, 0x2552, 0x0451, 0x2553, 0x2554, 0x2555, 0x2556,
+	0x2557, 0x2558, 0x2559, 0x255A, 0x255B, 0x255C, 0x255D, 0x255E,
+	0x255F, 0x2560, 0x2561, 0x0401, 0x2562, 0x2563, 0x2564, 0x2565,
+	0x2566, 0x2567, 0x2568, 0x2569, 0x256A, 0x256B, 0x256C, 0x00A9,
+	0x044E, 0x0430, 0x0431, 0x0446, 0x0434, 0x0435, 0x0444, 0x0433,
+	0x0445, 0x0438, 0x0439, 0x043A, 0x043B, 0x043C, 0x043D, 0x043E,
+	0x043F, 0x044F, 0x0440, 0x0441, 0x0442, 0x0443, 0x0436, 0x0432,
+	0x044C, 0x044B, 0x0437, 0x0448, 0x044D, 0x0449, 0x0447, 0x044A,
+	0x042E, 0x0410, 0x0411, 0x0426, 0x0414, 0x0415, 0x0424, 0x0413,
+	0x0425, 0x0418, 0x0419, 0x041A, 0x041B, 0x041C, 0x041D, 0x041E,
+	0x041F, 0x042F, 0x0420, 0x0421, 0x0422, 0x0423, 0x0416, 0x0412,
+	0x042C, 0x042B, 0x0417, 0x0428, 0x042D, 0x0429, 0x0427, 0x042A,
+};
+
+/* CP866 (альтернативная кодировка DOS), байты 0x80..0xFF */
+static const uint16_t charset_cp866[CHARSET_HIGH_SIZE] = {
+	0x0410, 0x0411, 0x0412, 0x0413, 0x0414, 0x0415, 0x0416, 0x0417,
+	0x0418, 0x0419, 0x041A, 0x041B, 0x041C, 0x041D, 0x041E, 0x041F,
+	0x0420, 0x0421, 0x0422, 0x0423, 0x0424, 0x0425, 0x0426, 0x0427,
+	0x0428, 0x0429, 0x042A, 0x042B, 0x042C, 0x042D, 0x042E, 0x042F,
+	0x0430, 0x0431, 0x0432, 0x0433, 0x0434, 0x0435, 0x0436, 0x0437,
+	0x0438, 0x0439, 0x043A, 0x043B, 0x043C, 0x043D, 0x043E, 0x043F,
+	0x2591, 0x2592, 0x2593, 0x2502, 0x2524, 0x2561, 0x2562, 0x2556,
+	0x2555, 0x2563, 0x2551, 0x2557, 0x255D, 0x255C, 0x255B, 0x2510,
+	0x2514, 0x2534, 0x252C, 0x251C, 0x2500, 0x253C, 0x255E, 0x255F,
+	0x255A, 0x2554, 0x2569, 0x2566, 0x2560, 0x2550, 0x256C, 0x2567,
+	0x2568, 0x2564, 0x2565, 0x2559, 0x2558, 0x2552, 0x2553, 0x256B,
+	0x256A, 0x2518, 0x250C, 0x2588, 0x2584, 0x258C, 0x2590, 0x2580,
+	0x0440, 0x0441, 0x0442, 0x0443, 0x0444, 0x0445, 0x0446, 0x0447,
+	0x0448, 0x0449, 0x044A, 0x044B, 0x044C, 0x044D, 0x044E, 0x044F,
+	0x0401, 0x0451, 0x0404, 0x0454, 0x0407, 0x0457, 0x040E, 0x045E,
+	0x00B0, 0x2219, 0x00B7, 0x221A, 0x2116, 0x00A4, 0x25A0, 0x00A0,
+};
+
+/* EBCDIC (CP037), все байты */
+static const uint16_t charset_ebcdic[BYTE_MAX + 1] = {
+	0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000,
+	0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000,
+	0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000,
+	0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000,
+	0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000,
+	0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000,
+	0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000,
+	0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000,
+	0x0020, 0x00A0, 0x00E2, 0x00E4, 0x00E0, 0x00E1, 0x00E3, 0x00E5,
+	0x00E7, 0x00F1, 0x00A2, 0x002E, 0x003C, 0x0028, 0x002B, 0x007C,
+	0x0026, 0x00E9, 0x00EA, 0x00EB, 0x00E8, 0x00ED, 0x00EE, 0x00EF,
+	0x00EC, 0x00DF, 0x0021, 0x0024, 0x002A, 0x0029, 0x003B, 0x00AC,
+	0x002D, 0x002F, 0x00C2, 0x00C4, 0x00C0, 0x00C1, 0x00C3, 0x00C5,
+	0x00C7, 0x00D1, 0x00A6, 0x002C, 0x0025, 0x005F, 0x003E, 0x003F,
+	0x00F8, 0x00C9, 0x00CA, 0x00CB, 0x00C8, 0x00CD, 0x00CE, 0x00CF,
+	0x00CC, 0x0060, 0x003A, 0x0023, 0x0040, 0x0027, 0x003D, 0x0022,
+	0x00D8, 0x0061, 0x0062, 0x0063, 0x0064, 0x0065, 0x0066, 0x0067,
+	0x0068, 0x0069, 0x00AB, 0x00BB, 0x00F0, 0x00FD, 0x00FE, 0x00B1,
+	0x00B0, 0x006A, 0x006B, 0x006C, 0x006D, 0x006E, 0x006F, 0x0070,
+	0x0071, 0x0072, 0x00AA, 0x00BA, 0x00E6, 0x00B8, 0x00C6, 0x00A4,
+	0x00B5, 0x007E, 0x0073, 0x0074, 0x0075, 0x0076, 0x0077, 0x0078,
+	0x0079, 0x007A, 0x00A1, 0x00BF, 0x00D0, 0x00DD, 0x00DE, 0x00AE,
+	0x005E, 0x00A3, 0x00A5, 0x00B7, 0x00A9, 0x00A7, 0x00B6, 0x00BC,
+	0x00BD, 0x00BE, 0x005B, 0x005D, 0x00AF, 0x00A8, 0x00B4, 0x00D7,
+	0x007B, 0x0041, 0x0042, 0x0043, 0x0044, 0x0045, 0x0046, 0x0047,
+	0x0048, 0x0049, 0x0000, 0x00F4, 0x00F6, 0x00F2, 0x00F3, 0x00F5,
+	0x007D, 0x004A, 0x004B, 0x004C, 0x004D, 0x004E, 0x004F, 0x0050,
+	0x0051, 0x0052, 0x00B9, 0x00FB, 0x00FC, 0x00F9, 0x00FA, 0x00FF,
+	0x005C, 0x00F7, 0x0053, 0x0054, 0x0055, 0x0056, 0x0057, 0x0058,
+	0x0059, 0x005A, 0x00B2, 0x00D4, 0x00D6, 0x00D2, 0x00D3, 0x00D5,
+	0x0030, 0x0031, 0x0032, 0x0033, 0x0034, 0x0035, 0x0036, 0x0037,
+	0x0038, 0x0039, 0x00B3, 0x00DB, 0x00DC, 0x00D9, 0x00DA, 0x0000,
 };
 
 
+/* --- счетчики и таймеры этапов --- */
+
+#ifdef HEXPRN_STATS
+
+/* Счетчики строк и этапов копятся в переменной потока и добавляются в общие в конце вызова,
+чтобы потоки hexpool и hexpipe не обращались к общим счетчикам на каждой строке.
+Выделение памяти и запись редки и добавляются в общие сразу. */
+static struct Hexprn_Stats stats_all;
+static __thread struct Hexprn_Stats stats_thread;
+
+/* отсчет времени: счетчик тактов x86 или монотонные часы в наносекундах */
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define STATS_CYCLES 1
+static inline uint64_t stats_ticks(void)
+{
+	return __builtin_ia32_rdtsc();
+}
+#else
+#define STATS_CYCLES 0
+static inline uint64_t stats_ticks(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t) ts.tv_sec * 1000000000u + (uint64_t) ts.tv_nsec;
+}
+#endif
+
+/* добавление счетчиков потока в общие */
+static void stats_flush(void)
+{
+	uint64_t *from = &stats_thread.calls, *to = &stats_all.calls;
+	size_t k, n = (sizeof(struct Hexprn_Stats) - offsetof(struct Hexprn_Stats, calls)) / sizeof(uint64_t);
+	for (k = 0; k < n; k++)
+		if (from[k] != 0)
+		{
+			__atomic_fetch_add(&to[k], from[k], __ATOMIC_RELAXED);
+			from[k] = 0;
+		}
+}
+
+/* отметка времени t, добавка времени от нее до текущего к этапу phase и новая отметка */
+#define STATS_CLOCK(t) uint64_t t = stats_ticks()
+#define STATS_PHASE(t, phase) do { uint64_t now_ = stats_ticks(); \
+	stats_thread.phase_ticks[phase] += now_ - (t); (t) = now_; } while (0)
+
+/* конец вызова преобразования с отметкой t в начале: bytes байт, lines строк, chars символов */
+#define STATS_CALL(t, bytes_, lines_, chars_) do { stats_thread.calls++; \
+	stats_thread.bytes += (bytes_); stats_thread.lines += (lines_); stats_thread.chars += (chars_); \
+	stats_thread.total_ticks += stats_ticks() - (t); stats_flush(); } while (0)
+
+/* выделение size байт, начатое в отметку t */
+#define STATS_ALLOC(t, size) do { __atomic_fetch_add(&stats_all.allocs, 1, __ATOMIC_RELAXED); \
+	__atomic_fetch_add(&stats_all.alloc_bytes, (size), __ATOMIC_RELAXED); \
+	__atomic_fetch_add(&stats_all.phase_ticks[HEXPRN_PHASE_ALLOC], stats_ticks() - (t), __ATOMIC_RELAXED); } while (0)
+
+/* запись n символов, начатая в отметку t */
+#define STATS_WRITE(t, n) do { __atomic_fetch_add(&stats_all.writes, 1, __ATOMIC_RELAXED); \
+	__atomic_fetch_add(&stats_all.write_chars, (n), __ATOMIC_RELAXED); \
+	__atomic_fetch_add(&stats_all.phase_ticks[HEXPRN_PHASE_WRITE], stats_ticks() - (t), __ATOMIC_RELAXED); } while (0)
+
+#else
+
+#define STATS_CLOCK(t) do { } while (0)
+#define STATS_PHASE(t, phase) do { } while (0)
+#define STATS_CALL(t, bytes_, lines_, chars_) do { } while (0)
+#define STATS_ALLOC(t, size) do { } while (0)
+#define STATS_WRITE(t, n) do { } while (0)
+
+#endif //HEXPRN_STATS
+
+/* Заполняет st текущими значениями счетчиков всех потоков */
+void hexprn_stats(struct Hexprn_Stats *st)
+{
+	if (st == NULL)
+		return;
+	memset(st, 0, sizeof(struct Hexprn_Stats));
+#ifdef HEXPRN_STATS
+	uint64_t *from = &stats_all.calls, *to = &st->calls;
+	size_t k, n = (sizeof(struct Hexprn_Stats) - offsetof(struct Hexprn_Stats, calls)) / sizeof(uint64_t);
+	for (k = 0; k < n; k++)
+		to[k] = __atomic_load_n(&from[k], __ATOMIC_RELAXED);
+	st->enabled = 1;
+	st->cycles = STATS_CYCLES;
+#endif
+}
+
+/* Обнуляет счетчики */
+void hexprn_stats_reset(void)
+{
+#ifdef HEXPRN_STATS
+	uint64_t *to = &stats_all.calls;
+	size_t k, n = (sizeof(struct Hexprn_Stats) - offsetof(struct Hexprn_Stats, calls)) / sizeof(uint64_t);
+	for (k = 0; k < n; k++)
+		__atomic_store_n(&to[k], 0, __ATOMIC_RELAXED);
+#endif
+}
+
+/* печать счетчиков st в файл fp */
+int fprint_stats(FILE *fp, struct Hexprn_Stats *st)
+{
+	static const char *phase_names[HEXPRN_PHASE_COUNT] = { "init", "hex", "ascii", "insert", "alloc", "write" };
+	if (st == NULL || fp == NULL)
+		return 0;
+	if (!st->enabled)
+		return fprintf(fp, "Transform stats: not compiled in (build with -DHEXPRN_STATS).\n");
+
+	const char *unit = st->cycles ? "cycles" : "ns";
+	int n = fprintf(fp, "Transform stats:\ncalls: %llu.\nbyte count: %llu.\nstring count: %llu.\nchar count: %llu.\n"
+		"allocations: %llu, %llu bytes.\nwrites: %llu, %llu chars.\ntotal %s: %llu",
+		(unsigned long long) st->calls, (unsigned long long) st->bytes, (unsigned long long) st->lines,
+		(unsigned long long) st->chars, (unsigned long long) st->allocs, (unsigned long long) st->alloc_bytes,
+		(unsigned long long) st->writes, (unsigned long long) st->write_chars, unit,
+		(unsigned long long) st->total_ticks);
+	if (st->lines != 0)
+		n += fprintf(fp, " (%.2f per string)", (double) st->total_ticks / (double) st->lines);
+	n += fprintf(fp, ".\n");
+
+	/* этапы строки - доля общего времени вызовов, выделение памяти и запись идут вне вызовов */
+	int k;
+	for (k = 0; k < HEXPRN_PHASE_COUNT; k++)
+	{
+		n += fprintf(fp, "%s %s: %llu", phase_names[k], unit, (unsigned long long) st->phase_ticks[k]);
+		if (k < HEXPRN_PHASE_ALLOC && st->total_ticks != 0)
+			n += fprintf(fp, " (%.1f%%)", 100.0 * (double) st->phase_ticks[k] / (double) st->total_ticks);
+		n += fprintf(fp, ".\n");
+	}
+	return n;
+}
+
 /* печать результатов преобразования tr в файл fp */
 int fprint_tr(FILE *fp, struct Trans_Result *tr)
 {
@@ -55,6 +283,16 @@ inline int print_tr(struct Trans_Result *tr)
 	return fprint_tr(stdout, tr);
 }
 
+/* печать 64-разрядных результатов преобразования tr в файл fp */
+int fprint_tr64(FILE *fp, struct Trans_Result64 *tr)
+{
+	if (tr == NULL || fp == NULL)
+		return 0;
+	return fprintf(fp, "Transform result:\nbyte count: %llu.\nchar count: %llu.\nstring count: %llu.\nsingle string length inc. add.str: %llu.\nadd.string length: %llu.\nerror: %d.\n",
+		(unsigned long long) tr->byte_count, (unsigned long long) tr->char_count, (unsigned long long) tr->str_count,
+		(unsigned long long) tr->single_length, (unsigned long long) tr->add_length, tr->error);
+}
+
 /* возврат формата вывода по умолчанию */
 struct Trans_Format ret_default_tf()
 {
@@ -62,6 +300,10 @@ struct Trans_Format ret_default_tf()
 
 	/* параметры адреса */
 	tf.prn_address = 1; // истина, печать адрес
+	tf.address_digits = WORD_SIZE_IN_BYTES * BYTE_SIZE_IN_TETRAS;
+
+	/* число байт в адресной строке */
+	tf.line_bytes = HEXPRN_LINE_BYTES;
 
 	/* параметры пустых ячеек */
 	tf.empty_value = 0x00;
@@ -69,6 +311,10 @@ struct Trans_Format ret_default_tf()
 	tf.empty_ascii = '.';
 
 	/* параметры вывода шестнадцатеричных значений ячеек */
+	tf.base = BASE_HEX;
+	tf.tetra_delimeter = '\0';
+	tf.word_bytes = 1;
+	tf.word_endian = LITTLE_ENDIAN;
 	tf.hex_char_delimeter = ' ';
 	tf.hex_block_delimeter = '|';
 	tf.hex_block_length = 0x8;
@@ -78,374 +324,539 @@ struct Trans_Format ret_default_tf()
 	tf.ascii_block_delimeter = '\0';
 	tf.ascii_block_length = 0;
 	tf.non_print_char = '.';
+	tf.char_set = CHARSET_ASCII;
+	tf.color = 0;
+
+	/* параметры сжатия вывода */
+	tf.squeeze = 0;
 
 	/* возврат */
 	return tf;
 }
 
-/* Подсчет и возврат количества символов для вывода одной адресной строки в формате tf */
-size_t calc_chars_tf(struct Trans_Format *tf)
+/* проверка: печатаемый/непечатаемый символ */
+static inline int non_print_char(char c)
 {
-	size_t l = 0;
+	return (c <= CHAR_US || c == CHAR_DEL) ? 1 : 0;
+}
 
-	/* проверка аргумента */
-	if (tf == NULL)
-		return 0;
+/* проверка: ставится ли разделитель c ('\0' и CHAR_DEL не ставятся) */
+static inline int delim_used(char c)
+{
+	return (c != '\0' && c != CHAR_DEL) ? 1 : 0;
+}
 
-	/* подсчет адреса */
-	if (tf->prn_address)
+/* код символа Unicode для значения байта b в кодовой странице char_set, 0 - непечатаемый символ */
+static unsigned int charset_code(char_set_types char_set, int b)
+{
+	if (char_set == CHARSET_EBCDIC)
+		return charset_ebcdic[b];
+	if (b <= CHAR_US || b == CHAR_DEL)
+		return 0;
+	if (b <= CHAR_MAX)
+		return (unsigned int) b;
+	switch (char_set)
 	{
-		l += WORD_SIZE_IN_BYTES * BYTE_SIZE_IN_TETRAS; 
-		// учет символов ':' и ' ' после адреса
-		l += 2;
+	case CHARSET_LATIN1: return (b < CHAR_NBSP || b == CHAR_SHY) ? 0 : (unsigned int) b;
+	case CHARSET_CP1251: return charset_cp1251[b - CHARSET_HIGH_SIZE];
+	case CHARSET_KOI8R:  return charset_koi8r[b - CHARSET_HIGH_SIZE];
+	case CHARSET_CP866:  return charset_cp866[b - CHARSET_HIGH_SIZE];
+	default:             return 0;
 	}
+}
 
-	/* подсчет вывода шестнадцатеричных значений ячеек */
-	l += 0x10 * BYTE_SIZE_IN_TETRAS;  // непосредственные значения
+/* записывает символ code (не больше 0xFFFF) в s в UTF-8, возвращает число байт */
+static size_t utf8_char(unsigned int code, char *s)
+{
+	if (code < 0x80)
+	{
+		s[0] = (char) code;
+		return 1;
+	}
+	if (code < 0x800)
+	{
+		s[0] = (char) (0xC0 | (code >> 6));
+		s[1] = (char) (0x80 | (code & 0x3F));
+		return 2;
+	}
+	s[0] = (char) (0xE0 | (code >> 12));
+	s[1] = (char) (0x80 | ((code >> 6) & 0x3F));
+	s[2] = (char) (0x80 | (code & 0x3F));
+	return 3;
+}
 
-	// если есть разделитель между ячейками
-	if (tf->hex_char_delimeter != '\0' && tf->hex_char_delimeter != CHAR_DEL)
-		l += 0x10;
+/* Заполняет таблицы символов ascii области cf для кодовой страницы char_set
+и наибольшую длину символа cf->char_width */
+static void compile_charset(struct Compiled_Format *cf, char_set_types char_set)
+{
+	unsigned int code;
+	size_t len;
+	int j;
 
-	// если есть разделитель между группами
-	if (tf->hex_block_delimeter != 0 && tf->hex_block_delimeter != '\0' && 
-		tf->hex_block_delimeter != CHAR_DEL)
+	cf->char_width = 1;
+	memset(cf->char_utf8, 0, sizeof(cf->char_utf8));
+	for (j = 0; j <= BYTE_MAX; j++)
 	{
-		l += 0x10 / tf->hex_block_length;
-		if (tf->hex_char_delimeter != '\0' && tf->hex_char_delimeter != CHAR_DEL)
-			l += 0x10 / tf->hex_block_length; // если есть просто разделитель
+		code = charset_code(char_set, j);
+		cf->ascii_map[j] = (code != 0 && code <= CHAR_MAX) ? (char) code : cf->non_print;
+		if (code == 0)
+		{
+			cf->char_utf8[j][0] = cf->non_print;
+			len = 1;
+		}
+		else
+			len = utf8_char(code, cf->char_utf8[j]);
+		cf->char_len[j] = (byte) len;
+		if (len > cf->char_width)
+			cf->char_width = len;
 	}
-	
-	/* подсчет вывода ascii значений ячеек */
-	l += 0x10;  // непосредственные ascii значения
+}
 
-	// если есть разделитель между ячейками
-	if (tf->ascii_char_delimeter != '\0' && tf->ascii_char_delimeter != CHAR_DEL)
-		l += 0x10;
+/* класс значения байта b для раскраски */
+static byte color_class(int b)
+{
+	if (b == 0)
+		return HEXPRN_CLASS_ZERO;
+	if (b <= CHAR_US || b == CHAR_DEL)
+		return HEXPRN_CLASS_CONTROL;
+	if (b < CHAR_DEL)
+		return HEXPRN_CLASS_PRINT;
+	return b == BYTE_MAX ? HEXPRN_CLASS_FF : HEXPRN_CLASS_HIGH;
+}
+
+/* Записывает в заготовку строки cf->line, начиная с позиции l, пустые значения ячеек
+одной области (шестнадцатеричной или ascii) с разделителями, запоминает смещения байт в offset.
+Ячейка состоит из word_bytes байт по width символов, между байтами ставится sub_delim,
+при swap байты ячейки выводятся в обратном порядке. Возвращает позицию после области. */
+static size_t compile_pane(struct Compiled_Format *cf, size_t l, size_t *offset, size_t width,
+	size_t word_bytes, char sub_delim, int swap, char empty, char ch_delim, char bl_delim, size_t bl_len)
+{
+	size_t cell_counter;  // счетчик ячеек
+	size_t bl_count = 0;  // счетчик для группы
+	size_t j, k;          // счётчики вывода символов и байт ячейки
 
-	// если есть разделитель между группами
-	if (tf->ascii_block_delimeter != 0 && tf->ascii_block_delimeter != '\0' &&
-		tf->ascii_block_delimeter != CHAR_DEL)
+	for (cell_counter = 0; cell_counter < cf->line_bytes; cell_counter += word_bytes)
 	{
-		l += 0x10 / tf->ascii_block_length;
-		if (tf->ascii_char_delimeter != '\0' && tf->ascii_char_delimeter != CHAR_DEL)
-			l += 0x10 / tf->ascii_block_length; // если есть просто разделитель
-	}
+		for (k = 0; k < word_bytes; k++)
+		{
+			if (k != 0 && delim_used(sub_delim))
+				cf->line[l++] = sub_delim;
+			offset[cell_counter + (swap ? word_bytes - 1 - k : k)] = l;
+			for (j = 0; j < width; j++)
+				cf->line[l++] = empty;
+		}
 
+		/* постановка разделителя между ячейками */
+		if (delim_used(ch_delim))
+			cf->line[l++] = ch_delim;
+
+		/* постановка разделителя между группами и разделителя между ячейками после него */
+		if (++bl_count == bl_len)
+		{
+			bl_count = 0;
+			if (delim_used(bl_delim))
+			{
+				cf->line[l++] = bl_delim;
+				if (delim_used(ch_delim))
+					cf->line[l++] = ch_delim;
+			}
+		}
+	}
 	return l;
 }
 
-/* проверка: печатаемый/непечатаемый символ */
-static inline int non_print_char(char c)
+/* Проверка: ячейки области в порядке вывода идут подряд без разделителей с позиции start.
+При swap порядок вывода байт внутри слов из word_bytes байт обратный. */
+static int pane_dense(size_t *offset, size_t count, size_t width, size_t start, size_t word_bytes, int swap)
 {
-	return (c <= CHAR_US || c == CHAR_DEL) ? 1 : 0;
+	size_t j, p;
+	for (j = 0; j < count; j++)
+	{
+		p = swap ? j - j % word_bytes + word_bytes - 1 - j % word_bytes : j;
+		if (offset[j] != start + p * width)
+			return 0;
+	}
+	return 1;
 }
 
-/* инициализация структуры адресной строки addr_str */
-static struct AddressString *init_addr_str(struct AddressString *addr_str,
-	byte *byte_array, size_t byte_count, word address_start)
+/* Компилирует формат tf в заготовку адресной строки cf */
+struct Compiled_Format *compile_tf(struct Compiled_Format *cf, struct Trans_Format *tf)
 {
+	size_t l = 0;
+	int j;
+
 	/* проверка аргументов */
-	if (addr_str == NULL || byte_array == NULL)
+	if (cf == NULL || tf == NULL || tf->char_set < CHARSET_ASCII || tf->char_set >= CHARSET_COUNT)
 		return NULL;
-	
-	/* массив байт */
-	addr_str->byte_array = byte_array;
+	cf->tf = *tf;
 
-	/* начальный адрес нулевого элемента массива */
-	addr_str->address_start = address_start;
-	
-	/* установка номера начальной байтовой ячейки */
-	addr_str->bytes_start = addr_str->address_start & 0xF;
+	/* непечатаемые символы заменяются на печатаемые */
+	char empty_hex = non_print_char(tf->empty_hex) ? ' ' : tf->empty_hex;
+	char empty_ascii = non_print_char(tf->empty_ascii) ? ' ' : tf->empty_ascii;
+	char non_print_ch = non_print_char(tf->non_print_char) ? ' ' : tf->non_print_char;
 
-	/* число байт в строке для преобразования не более 0x10 */
-	addr_str->byte_count = byte_count;
-	if (addr_str->byte_count > 0x10)
-		addr_str->byte_count = 0x10;
+	/* число цифр адреса: по-умолчанию по размеру слова, не более цифр в qword */
+	cf->address_digits = tf->address_digits == 0 ? WORD_SIZE_IN_BYTES * BYTE_SIZE_IN_TETRAS : tf->address_digits;
+	if (cf->address_digits > QWORD_SIZE_IN_BYTES * BYTE_SIZE_IN_TETRAS)
+		return NULL;
 
-	/* установка номера конечной байтовой ячейки */
-	/* если число равно байт для вывода равно нулю */
-	if (addr_str->byte_count == 0)
-	{
-		addr_str->bytes_finish = addr_str->bytes_start;
-	}
-	else
+	/* число байт в адресной строке */
+	cf->line_bytes = tf->line_bytes == 0 ? HEXPRN_LINE_BYTES : tf->line_bytes;
+	if (cf->line_bytes > HEXPRN_LINE_BYTES_MAX)
+		return NULL;
+
+	/* ячейки-слова: слово целиком в строке, вид слова - как у byte_trans() */
+	cf->word_bytes = tf->word_bytes == 0 ? 1 : tf->word_bytes;
+	if ((cf->word_bytes != 1 && cf->word_bytes != 2 && cf->word_bytes != 4 && cf->word_bytes != 8) ||
+		cf->line_bytes % cf->word_bytes != 0)
+		return NULL;
+	cf->word_mode.base = tf->base;
+	cf->word_mode.seq_endian = tf->word_endian;
+	cf->word_mode.byte_endian = BIG_ENDIAN;
+	cf->word_mode.gap = 0;
+	cf->word_mode.gap_delim = '\0';
+	cf->word_swap = cf->word_bytes > 1 && cf->word_mode.seq_endian == LITTLE_ENDIAN;
+
+	/* место под адрес и символы ':' и ' ' после него */
+	if (tf->prn_address)
 	{
-		addr_str->bytes_finish = addr_str->bytes_start + addr_str->byte_count - 1;
-		// конечная байтовая ячейка имеет номер не более 0xF
-		if (addr_str->bytes_finish > 0xF)
-		{
-			addr_str->bytes_finish = 0xF;
-			addr_str->byte_count = addr_str->bytes_finish - addr_str->bytes_start + 1; // правка числа байт
-		}
+		for (; l < cf->address_digits; l++)
+			cf->line[l] = '0';
+		cf->line[l++] = ':';
+		cf->line[l++] = ' ';
 	}
-	return addr_str;
+
+	/* ширина ячейки: две шестнадцатеричные цифры или восемь двоичных с разделителем тетрад */
+	cf->cell_digits = tf->base == BASE_HEX ? BYTE_SIZE_IN_TETRAS : BYTE_SIZE_IN_BITS;
+	cf->cell_width = cf->cell_digits + (tf->base != BASE_HEX && delim_used(tf->tetra_delimeter) ? 1 : 0);
+
+	/* шестнадцатеричная и ascii области с пустыми ячейками, байты двоичного слова разделяются
+	так же, как тетрады */
+	char sub_delim = cf->cell_width != cf->cell_digits ? tf->tetra_delimeter : '\0';
+	l = compile_pane(cf, l, cf->hex_offset, cf->cell_width, cf->word_bytes, sub_delim, cf->word_swap, empty_hex,
+		tf->hex_char_delimeter, tf->hex_block_delimeter, tf->hex_block_length);
+	l = compile_pane(cf, l, cf->ascii_offset, 1, 1, '\0', 0, empty_ascii,
+		tf->ascii_char_delimeter, tf->ascii_block_delimeter, tf->ascii_block_length);
+	cf->ascii_end = l;
+	cf->columns = l;
+
+	/* символы ascii области и место в конце строки под их многобайтовые последовательности */
+	cf->non_print = non_print_ch;
+	compile_charset(cf, tf->char_set);
+	memset(cf->line + l, ' ', (cf->char_width - 1) * cf->line_bytes);
+	l += (cf->char_width - 1) * cf->line_bytes;
+	cf->line_length = l;
+
+	/* раскраска: классы байт и наибольшая длина строки со сменой цвета у каждой ячейки и сбросом в конце */
+	for (j = 0; j <= BYTE_MAX; j++)
+		cf->color_class[j] = color_class(j);
+	cf->length = tf->color ? l + (2 * cf->line_bytes + 1) * HEXPRN_COLOR_MAX : l;
+	if (cf->length > HEXPRN_LINE_MAX)
+		return NULL;
+	if (cf->cell_width != cf->cell_digits)
+		for (j = 0; j < (int) cf->line_bytes; j++)
+			cf->line[cf->hex_offset[j] + TETRA_SIZE_IN_BITS] = tf->tetra_delimeter;
+	cf->word_width = cf->word_bytes * cf->cell_width + (delim_used(sub_delim) ? cf->word_bytes - 1 : 0);
+	cf->hex_start = cf->hex_offset[cf->word_swap ? cf->word_bytes - 1 : 0];
+	cf->hex_dense = cf->cell_width == cf->cell_digits &&
+		pane_dense(cf->hex_offset, cf->line_bytes, cf->cell_width, cf->hex_start, cf->word_bytes, cf->word_swap);
+	cf->ascii_dense = pane_dense(cf->ascii_offset, cf->line_bytes, 1, cf->ascii_offset[0], 1, 0);
+
+	return cf;
 }
 
-/* инициализация массива ячеек по заданным значениям и инициализированной структуре адресной строки */
-static struct AddressString *init_cells(struct AddressString *addr_str,
-	byte empty_value, char empty_hex, char empty_ascii,
-	char non_print_ch)
-/* Инициализирует массив ячеек адресной строки addr_str. Непечатаемые символы заменяются на печатаемые.
-Параметры:
-	addr_str     - адресная строка 
-	empty_value  - что записывается в значение пустых ячеек
-	empty_hex    - какой символ отображает шестнадцатеричное значение пустых ячеек
-	empty_ascii  - какой символ отображает ascii значение пустых ячеек
-	non_print_ch - какой символ показывает шестнадцатеричное значение непечатаемых символов
-Возврат:
-	!= NULL  инициализация успешна
-	== NULL  инициализация неуспешна
-*/
+/* Подсчет и возврат количества символов для вывода одной адресной строки в формате tf */
+size_t calc_chars_tf(struct Trans_Format *tf)
 {
-	/* проверка аргументов */
-	if (addr_str->byte_array == NULL && addr_str->byte_count != 0)
-		return NULL;
+	struct Compiled_Format cf;
+	if (compile_tf(&cf, tf) == NULL)
+		return 0;
+	return cf.length;
+}
 
-	/* непечатаемые символы заменяются на печатаемые */
-	if (non_print_char(empty_hex))
-		empty_hex = ' ';
-	if (non_print_char(empty_ascii))
-		empty_ascii = ' ';
-	if (non_print_char(non_print_ch))
-		non_print_ch = ' ';
-
-	/* инициализация ячеек */
-	addr_str->cells[0].address = addr_str->address_start & ~0xF;
-	size_t j = 0;
-	size_t i; 
-	
-	if (addr_str->byte_count != 0) 
-	/* если число байт не равно нулю, инициализация первых двух групп */
-	{
-		/* инициализация пустых ячеек #1 */
-		for (; j < addr_str->bytes_start; j++)
+/* цифры n байт подряд в строку s: шестнадцатеричные или двоичные по виду ячеек */
+static inline void cells_digits(char *s, struct Compiled_Format *cf, const byte *bytes, size_t n)
+{
+	if (cf->cell_digits == BYTE_SIZE_IN_TETRAS)
+		bytes_hex(bytes, s, n, BIG_ENDIAN);
+	else
+		bytes_bin(bytes, s, n, BIG_ENDIAN);
+}
+
+/* Разнос цифр n ячеек из digits по смещениям ячеек строки s, начиная с ячейки first.
+Ширина копирования постоянна в каждой ветви, поэтому memcpy() заменяется пересылкой слова. */
+static inline void cells_scatter(char *s, struct Compiled_Format *cf, const char *digits, size_t first, size_t n)
+{
+	size_t j;
+	char *c;
+
+	if (cf->cell_digits == BYTE_SIZE_IN_TETRAS)
+		for (j = 0; j < n; j++)
+			memcpy(s + cf->hex_offset[first + j], digits + j * BYTE_SIZE_IN_TETRAS, BYTE_SIZE_IN_TETRAS);
+	else if (cf->cell_width == BYTE_SIZE_IN_BITS)
+		for (j = 0; j < n; j++)
+			memcpy(s + cf->hex_offset[first + j], digits + j * BYTE_SIZE_IN_BITS, BYTE_SIZE_IN_BITS);
+	else
+		for (j = 0; j < n; j++)
 		{
-			addr_str->cells[j].type = cell_empty;
-			addr_str->cells[j].address = addr_str->cells[0].address + j;		
-			addr_str->cells[j].value = empty_value;
-			for (i = 0; i < BYTE_SIZE_IN_TETRAS; i++)
-				addr_str->cells[j].hex[i] = empty_hex;
-			addr_str->cells[j].ascii = empty_ascii;
+			/* тетрады по обе стороны разделителя из заготовки */
+			c = s + cf->hex_offset[first + j];
+			memcpy(c, digits + j * BYTE_SIZE_IN_BITS, TETRA_SIZE_IN_BITS);
+			memcpy(c + TETRA_SIZE_IN_BITS + 1, digits + j * BYTE_SIZE_IN_BITS + TETRA_SIZE_IN_BITS, TETRA_SIZE_IN_BITS);
 		}
+}
 
-		/* инициализация байт */
-		size_t byte_counter = 0;
-		for (; j <= addr_str->bytes_finish; j++)
+/* Запись ascii области многобайтовой кодовой страницы: count байт в ячейки, начиная с first,
+остальные ячейки пустые. Символы сдвигают разделители области вправо, после области
+до cf->line_length записываются пробелы. */
+static void chars_utf8(char *s, struct Compiled_Format *cf, const byte *bytes, size_t first, size_t count)
+{
+	char *p = s + cf->ascii_offset[0];
+	size_t last = cf->ascii_offset[cf->line_bytes - 1] + 1;  // позиция за последней ячейкой в заготовке
+	size_t j, k, end;
+
+	/* полная строка печатаемых ascii символов страниц, совпадающих с ascii в младшей половине,
+	записывается векторной классификацией */
+	if (count == cf->line_bytes && cf->ascii_dense && cf->tf.char_set != CHARSET_EBCDIC &&
+		bytes_print(bytes, p, count, cf->non_print) == 0)
+		p += count;
+	else
+	{
+		for (j = 0; j < cf->line_bytes; j++)
 		{
-			addr_str->cells[j].type = cell_byte;
-			addr_str->cells[j].address = addr_str->cells[0].address + j;		
-			addr_str->cells[j].value = addr_str->byte_array[byte_counter];
-
-			// перевод в шестнадцатеричный вид одного байта
-			if (byte_hex(addr_str->cells[j].value, addr_str->cells[j].hex, BIG_ENDIAN) < 0)
-				return NULL;
-
-			// установка неотображаемого символа
-			if (addr_str->byte_array[byte_counter] <= (byte) CHAR_US   || 
-				addr_str->byte_array[byte_counter] == (byte) CHAR_DEL  || 
-				addr_str->byte_array[byte_counter] >  (byte) CHAR_MAX)
+			if (j >= first && j < first + count)
 			{
-				addr_str->cells[j].ascii = non_print_ch;
+				if (cf->char_width == HEXPRN_CHAR_MAX)
+					memcpy(p, cf->char_utf8[bytes[j - first]], HEXPRN_CHAR_MAX);
+				else
+					memcpy(p, cf->char_utf8[bytes[j - first]], 2);
+				p += cf->char_len[bytes[j - first]];
 			}
 			else
-			// установка отображаемого символа
-			{
-				addr_str->cells[j].ascii = (char) addr_str->byte_array[byte_counter];
-			}
-			byte_counter++;
+				*p++ = cf->line[cf->ascii_offset[j]];
+			end = j + 1 < cf->line_bytes ? cf->ascii_offset[j + 1] : last;
+			for (k = cf->ascii_offset[j] + 1; k < end; k++)
+				*p++ = cf->line[k];
 		}
 	}
+	memcpy(p, cf->line + last, cf->ascii_end - last);
+	p += cf->ascii_end - last;
+	memset(p, ' ', (size_t) (s + cf->line_length - p));
+}
 
-	/* инициализация пустых ячеек #2 */
-	for (; j <= 0xF; j++)
+/* Преобразование полной адресной строки из n байт. При постоянном n циклы разворачиваются
+компилятором, поэтому для частых длин строки ниже определены отдельные варианты. */
+static inline void sprn_line_full_n(char *s, struct Compiled_Format *cf, const byte *bytes, qword address,
+	const size_t n)
+{
+	char digits[HEXPRN_LINE_BYTES_MAX * BYTE_SIZE_IN_BITS];
+	byte swapped[HEXPRN_LINE_BYTES_MAX];
+	size_t j;
+
+	STATS_CLOCK(t);
+	memcpy(s, cf->line, cf->line_length);
+	if (cf->tf.prn_address)
+		qword_hex(address, s, cf->address_digits);
+	STATS_PHASE(t, HEXPRN_PHASE_INIT);
+
+	/* значения ячеек: напрямую (слова LITTLE_ENDIAN - после перестановки байт) или разносом по смещениям байт */
+	if (cf->hex_dense && cf->word_swap)
 	{
-		addr_str->cells[j].type = cell_empty;
-		addr_str->cells[j].address = addr_str->cells[0].address + j;		
-		addr_str->cells[j].value = empty_value;
-		for (i = 0; i < BYTE_SIZE_IN_TETRAS; i++)
-			addr_str->cells[j].hex[i] = empty_hex;
-		addr_str->cells[j].ascii = empty_ascii;
+		bytes_swap(bytes, swapped, n, cf->word_bytes);
+		cells_digits(s + cf->hex_start, cf, swapped, n);
 	}
+	else if (cf->hex_dense)
+		cells_digits(s + cf->hex_start, cf, bytes, n);
+	else
+	{
+		cells_digits(digits, cf, bytes, n);
+		cells_scatter(s, cf, digits, 0, n);
+	}
+	STATS_PHASE(t, HEXPRN_PHASE_HEX);
 
-	return addr_str;
+	/* ascii значения: многобайтовые символы, векторная классификация или разнос по смещениям */
+	if (cf->char_width > 1)
+		chars_utf8(s, cf, bytes, 0, n);
+	else if (cf->ascii_dense)
+		bytes_print(bytes, s + cf->ascii_offset[0], n, cf->non_print);
+	else
+	{
+		for (j = 0; j < n; j++)
+			s[cf->ascii_offset[j]] = cf->ascii_map[bytes[j]];
+	}
+	STATS_PHASE(t, HEXPRN_PHASE_ASCII);
 }
 
-/* Выводит в строку s адрес строки addr_str с обнулением младшей тетрады. Возвращает число символов */
-static int sprn_address(char *s, struct AddressString *addr_str)
+/* варианты преобразования полной адресной строки для частых длин строки и общий вариант */
+static void sprn_line_full_8(char *s, struct Compiled_Format *cf, const byte *bytes, qword address)
 {
-	/* проверка аргументов */
-	if (addr_str == NULL)
-		return -1;
-	int r; // результат вызова функции
-
-	/* преобразование адреса */
-	r = word_hex(addr_str->address_start & ~0xF, s); if (r < 0) return r;
-
-	/* добавка символов */
-	s[r++] = ':';
-	s[r++] = ' ';
-	return r;
+	sprn_line_full_n(s, cf, bytes, address, 0x08);
 }
 
-/* Выводит значения ячеек (в шестнадцатеричном или ascii виде) адресной строки в строку s. 
-Возвращает число символов */
-static int sprn_values(char *s, struct AddressString *addr_str, int type,
-	char ch_delim, char bl_delim, size_t bl_len)
-/* Выводит значения ячеек адресной строки в строку s.
-Параметры:
-	s         - строка символов для записи
-	addr_str  - строка 
-	type      - тип для вывода (шестнадцатеричный или ascii)
-	ch_delim  - разделитель между выведенными элементами, если '\0' или CHAR_DEL, то не ставится
-	bl_delim  - разделитель между группами элементов, если '\0' или CHAR_DEL, то не ставится
-	bl_len    - длина группы элементов, между которыми ставится символ '|', если 0, то не ставится
-Возврат:
-	>= 0	число записанных символов
-	 < 0	ошибка
-*/
+static void sprn_line_full_16(char *s, struct Compiled_Format *cf, const byte *bytes, qword address)
 {
-	/* проверка аргументов */
-	if (s == NULL || addr_str == NULL)
-		return -1;
-
-	/* настройка локальных переменных */
-	size_t cell_counter;  // счетчик ячеек
-	int ch_counter = 0;   // счетчик выведенных символов
-	size_t bl_count = 0;  // счетчик для группы
-	size_t j;             // счётчик вывода символов
+	sprn_line_full_n(s, cf, bytes, address, 0x10);
+}
 
-	/* вывод значений ячеек */
-	for (cell_counter = 0; cell_counter <= 0xF; cell_counter++)
-	{
-		// выводим или в шестнадцатеричном или ascii виде
-		if (type == value_hex)
-		{
-			for (j = 0; j < BYTE_SIZE_IN_TETRAS; j++)
-				s[ch_counter++] = addr_str->cells[cell_counter].hex[j];
-		}
-		else
-		{
-			s[ch_counter++] = addr_str->cells[cell_counter].ascii;
-		}
+static void sprn_line_full_32(char *s, struct Compiled_Format *cf, const byte *bytes, qword address)
+{
+	sprn_line_full_n(s, cf, bytes, address, 0x20);
+}
 
-		/* постановка разделителя между ячейками */
-		if (ch_delim != '\0' && ch_delim != CHAR_DEL)
-			s[ch_counter++] = ch_delim; 
+static void sprn_line_full_64(char *s, struct Compiled_Format *cf, const byte *bytes, qword address)
+{
+	sprn_line_full_n(s, cf, bytes, address, 0x40);
+}
 
-		/* постановка разделителя между группами */
-		if (++bl_count == bl_len)
-		{
-			if (bl_delim != '\0' && bl_delim != CHAR_DEL)
-				s[ch_counter++] = bl_delim;
-			bl_count = 0;
-			/* постановка разделителя между ячейками после разделителя между группами */
-			if (ch_delim != '\0' && ch_delim != CHAR_DEL)
-				s[ch_counter++] = ch_delim; 
-		}
-	}
-		
-	/* возврат числа выведенных символов */
-	return ch_counter;
+static void sprn_line_full_any(char *s, struct Compiled_Format *cf, const byte *bytes, qword address)
+{
+	sprn_line_full_n(s, cf, bytes, address, cf->line_bytes);
 }
 
-/* Вывод строки в шестнадцатеричном виде */
-static inline int sprn_values_hex(char *s, struct AddressString *addr_str, 
-						   char ch_delim, char bl_delim, size_t bl_len)
+/* функция преобразования полной адресной строки */
+typedef void (*sprn_line_fn)(char *s, struct Compiled_Format *cf, const byte *bytes, qword address);
+
+/* выбор варианта преобразования полной адресной строки по числу байт в строке */
+static sprn_line_fn sprn_line_full(size_t line_bytes)
 {
-	return sprn_values(s, addr_str, value_hex, ch_delim, bl_delim, bl_len);
+	switch (line_bytes)
+	{
+	case 0x08: return sprn_line_full_8;
+	case 0x10: return sprn_line_full_16;
+	case 0x20: return sprn_line_full_32;
+	case 0x40: return sprn_line_full_64;
+	default:   return sprn_line_full_any;
+	}
 }
 
-/* Вывод в ascii виде */
-static inline int sprn_values_ascii(char *s, struct AddressString *addr_str, 
-						   char ch_delim, char bl_delim, size_t bl_len)
+/* Преобразование неполной адресной строки: count байт записываются в ячейки, начиная с first,
+остальные ячейки остаются пустыми из заготовки */
+static void sprn_line_part(char *s, struct Compiled_Format *cf, const byte *bytes, qword address,
+	size_t first, size_t count)
 {
-	return sprn_values(s, addr_str, value_ascii, ch_delim, bl_delim, bl_len);
+	char digits[HEXPRN_LINE_BYTES_MAX * BYTE_SIZE_IN_BITS];
+	size_t j;
+
+	STATS_CLOCK(t);
+	memcpy(s, cf->line, cf->line_length);
+	if (cf->tf.prn_address)
+		qword_hex(address, s, cf->address_digits);
+	STATS_PHASE(t, HEXPRN_PHASE_INIT);
+
+	cells_digits(digits, cf, bytes, count);
+	cells_scatter(s, cf, digits, first, count);
+	STATS_PHASE(t, HEXPRN_PHASE_HEX);
+	if (cf->char_width > 1)
+		chars_utf8(s, cf, bytes, first, count);
+	else
+		for (j = 0; j < count; j++)
+			s[cf->ascii_offset[first + j]] = cf->ascii_map[bytes[j]];
+	STATS_PHASE(t, HEXPRN_PHASE_ASCII);
 }
 
-/* Преобразование массива байт в массив символов одной адресной строки без добавочной строки */
-static struct Trans_Result shexprn_str(char *s, byte *byte_array, size_t byte_count, 
-	word address_start, struct Trans_Format *tf)
-/* Преобразует byte_count байт из массива байт byte_array в одну адресную строку и 
-записывает её в символьную строку s. Нулевому элементу массива byte_array соответствует адрес address_start.
-Автоматически определяет и ограничивает число преобразуемых байт. Преобразование согласно формату tf.
-Преобразует байты от начального адреса, но не далее, чем вплоть до WORD_MAX.
-Параметры:
-	s              - символьная строка для записи
-	byte_array     - массив исходных байт
-	byte_count     - наибольшее число байт для преобразования, если больше 0xF, то сокращается до 0xF,
-	               ноль допускается
-	address_start  - адрес (смещение) нулевого элемента массива byte_array
-	tf             - формат преобразования
-Возвращает структуру:
-	Trans_Result.char_count = Trans_Result.single_length:
-	    < 0   ошибка до непосредственного преобразования
-	    > 0   число символов, записанное в строку s:
-	        != длина_адресной_строки - ошибка при преобразовании
-	        == длина_адресной_строки - корректный результат
-	Trans_Result.byte_count:
-	    < 0   ошибка
-	    >= 0  число преобразованных байт
-	Trans_Result.str_count:
-	    != 1  есть какая-то ошибка
-	    == 1  преобразована одна строка
-*/
+/* Преобразование одной адресной строки по скомпилированному формату */
+size_t sprn_line(char *s, struct Compiled_Format *cf, const byte *bytes, qword address,
+	size_t first, size_t count)
 {
-	int r;
-	 // предполагается, что функция будет вызываться много раз
-	static struct Trans_Result tr;
-	tr.byte_count = -1;
-	tr.char_count = -1;
-	tr.str_count = -1;
-	// структура имеет большой размер,
-   	// и предполагается, что эта функция будет вызываться много раз,
-	// поэтому пусть будет структура статической
-	static struct AddressString addr_str;
-	
-	/* Проверка аргументов */
-	if (s == NULL || byte_array == NULL || tf == NULL)
-		return tr;
+	if (s == NULL || cf == NULL || (bytes == NULL && count != 0) || first + count > cf->line_bytes)
+		return 0;
+	size_t length = cf->columns;
+	size_t j;
 
-	/* Инициализации структуры, ячеек */
-	if (!init_addr_str(&addr_str, byte_array, byte_count, address_start))
-		return tr;
-	if (!init_cells(&addr_str, tf->empty_value, tf->empty_hex, tf->empty_ascii, tf->non_print_char))
-		return tr;
-	
-	/* Установка предварительных значений */
-	tr.byte_count = 0;
-	tr.char_count = 0;
-	tr.str_count = 0;
+	STATS_CLOCK(call);
+	if (first == 0 && count == cf->line_bytes)
+		sprn_line_full(cf->line_bytes)(s, cf, bytes, address);
+	else
+		sprn_line_part(s, cf, bytes, address, first, count);
 
-	/* Преобразование адреса */
-	if (tf->prn_address)
-		tr.char_count = sprn_address(s, &addr_str);
-        if (tr.char_count < 0)
-            return tr;
-
-	/* Преобразование шестнадцатеричных значений */
-	r = sprn_values_hex(s + tr.char_count, &addr_str, tf->hex_char_delimeter, 
-		tf->hex_block_delimeter, tf->hex_block_length);
-	if (r < 0)
-		return tr;
+	/* значащие символы: однобайтовая строка и продолжения многобайтовых символов */
+	if (cf->char_width == 1)
+		length = cf->line_length;
 	else
-		tr.char_count += r;
+		for (j = 0; j < count; j++)
+			length += cf->char_len[bytes[j]] - 1;
+	STATS_CALL(call, count, 1, length);
+	return length;
+}
 
-	/* Преобразование ascii значений */
-	r = sprn_values_ascii(s + tr.char_count, &addr_str, tf->ascii_char_delimeter, 
-		tf->ascii_block_delimeter, tf->ascii_block_length);
-	if (r < 0)
-            return tr;
+/* Отметка ячейки-слова с байтом номер cell в строке s, полученной sprn_line() */
+void sprn_mark(char *s, struct Compiled_Format *cf, size_t cell, char mark)
+{
+	size_t wb = cf->word_bytes;
+	size_t first = cf->word_swap ? wb - 1 : 0;  // байт слова, который выводится первым
+	size_t j = cell - cell % wb;
+	size_t k, pos = cf->hex_offset[j + first];
+
+	if (pos != 0 && (j == 0 ? (!cf->tf.prn_address || pos > cf->address_digits) :
+		pos - 1 != cf->hex_offset[j - wb + first] + cf->word_width - 1))
+		s[pos - 1] = mark;
 	else
-            tr.char_count += r;
+		for (k = pos; k < pos + cf->word_width; k++)
+			if (s[k] >= 'A' && s[k] <= 'F')
+				s[k] += 'a' - 'A';
+}
 
-	/* Установка числа байт */
-	tr.byte_count = addr_str.byte_count;
-	tr.single_length = (size_t) tr.char_count;
-        tr.str_count = 1; // главный признак успешности преобразования - что преобразована одна строка
+/* Копирует в s строку без цвета plain, в которой count байт записаны в ячейки, начиная с first,
+и вставляет escape-последовательность перед ячейкой, класс которой отличается от класса предыдущей.
+Разделители наследуют цвет предыдущей ячейки, в конце цвет сбрасывается. Возвращает длину строки. */
+static size_t line_color(char *s, const char *plain, struct Compiled_Format *cf, const byte *bytes,
+	size_t first, size_t count)
+{
+	size_t wb = cf->word_bytes;
+	size_t pos = 0;    // начало еще не скопированной части plain
+	size_t shift = 0;  // сдвиг ascii области многобайтовыми символами
+	size_t k, j, start, n = 0, len;
+	byte cls, cur = HEXPRN_CLASS_NONE;
 
-	/* Возврат */
-	return tr;
+	for (k = 0; k < 2 * cf->line_bytes; k++)
+	{
+		/* ячейки шестнадцатеричной области в порядке вывода, затем ascii области */
+		if (k < cf->line_bytes)
+		{
+			j = cf->word_swap ? k - k % wb + wb - 1 - k % wb : k;
+			start = cf->hex_offset[j];
+		}
+		else
+		{
+			j = k - cf->line_bytes;
+			start = cf->ascii_offset[j] + shift;
+		}
+		cls = j >= first && j < first + count ? cf->color_class[bytes[j - first]] : HEXPRN_CLASS_NONE;
+		if (k >= cf->line_bytes && j >= first && j < first + count)
+			shift += cf->char_len[bytes[j - first]] - 1u;
+		if (cls == cur)
+			continue;
+
+		/* смена класса: часть строки до ячейки (несколько символов, без вызова memcpy) и цвет её класса */
+		while (pos < start)
+			s[n++] = plain[pos++];
+		memcpy(s + n, color_sgr[cls], HEXPRN_COLOR_MAX);
+		n += color_sgr_length[cls];
+		cur = cls;
+	}
+
+	/* остаток строки без дополняющих пробелов и сброс цвета */
+	len = cf->ascii_end + shift - pos;
+	memcpy(s + n, plain + pos, len);
+	n += len;
+	if (cur != HEXPRN_CLASS_NONE)
+	{
+		memcpy(s + n, color_sgr[HEXPRN_CLASS_NONE], color_sgr_length[HEXPRN_CLASS_NONE]);
+		n += color_sgr_length[HEXPRN_CLASS_NONE];
+	}
+	return n;
+}
+
+/* Преобразование одной адресной строки с раскраской, возвращает её длину */
+static size_t sprn_line_color(char *s, struct Compiled_Format *cf, const byte *bytes, qword address,
+	size_t first, size_t count)
+{
+	char plain[HEXPRN_LINE_MAX];
+	if (first == 0 && count == cf->line_bytes)
+		sprn_line_full(cf->line_bytes)(plain, cf, bytes, address);
+	else
+		sprn_line_part(plain, cf, bytes, address, first, count);
+	return line_color(s, plain, cf, bytes, first, count);
 }
 
 /* Проверяет ограничение числа байт для преобразования count 
@@ -462,7 +873,7 @@ size_t hex_max_count(size_t count, word address)
 	// случай, если размерность size_t больше, чем у word
 	if (SIZE_MAX > WORD_MAX)
 	{
-		max_count = WORD_MAX + 1 - address;
+		max_count = (size_t) WORD_MAX + 1 - address;
 		return max_count < count ? max_count : count;
 	}
 	// случай, если размерность size_t меньше или равна word
@@ -487,7 +898,7 @@ size_t hex_addr_str(size_t count, word address)
 	// проверка предельного значения count >= WORD_MAX + 1
 	if (SIZE_MAX > WORD_MAX)
 	{
-		if (count >= (WORD_MAX + 1))
+		if (count >= ((size_t) WORD_MAX + 1))
 			return (WORD_MAX >> 4) + 1; // это предел количества строк для преобразования
 	}
 
@@ -507,6 +918,97 @@ size_t hex_addr_str(size_t count, word address)
 	return SIZE_MAX < q ? SIZE_MAX : q;
 }
 
+/* Проверяет ограничение числа байт для преобразования count 
+по перекрытию наибольшего 64-разрядного адреса QWORD_MAX, аналогично hex_max_count().
+Если адрес равен нулю, то ограничения нет: size_t не более qword. */
+size_t hex_max_count64(size_t count, qword address)
+{
+	if (address == 0)
+		return count;
+	qword max_count = QWORD_MAX - address + 1;
+	return max_count < (qword) count ? (size_t) max_count : count;
+}
+
+/* Определение, сколько адресных строк по line_bytes байт требуется для преобразования массива байт
+с 64-разрядного адреса, аналогично hex_addr_str(). Номера строк - частные от деления адресов на line_bytes.
+Перед вызовом этой функции необходимо проверить число байт в hex_max_count64(). */
+uint64_t hex_addr_str64(size_t count, qword address, size_t line_bytes)
+{
+	if (count == 0 || count == 1 || line_bytes == 0)
+		return 1;
+	return (address + (count - 0x01)) / line_bytes - address / line_bytes + 0x01;
+}
+
+/* Подсчитывает результат преобразования byte_count байт с 64-разрядного адреса address_start
+при line_bytes байт в адресной строке, длине адресной строки length и длине добавочной строки add_length */
+struct Trans_Result64 calc_tr_lines64(size_t byte_count, qword address_start, 
+	size_t line_bytes, size_t length, size_t add_length)
+{
+	struct Trans_Result64 tr; 
+	tr.byte_count = 0; tr.char_count = 0; tr.str_count = 0; tr.single_length = 0; tr.error = 1;
+	tr.add_length = add_length;
+
+	// учет ограничения количества байт сверху по адресу
+	byte_count = hex_max_count64(byte_count, address_start);
+
+	// число строк для преобразования
+	tr.str_count = hex_addr_str64(byte_count, address_start, line_bytes);
+	tr.byte_count = byte_count;
+
+	// учет длины добавочной строки, добавочная строка добавляется и в последнюю строку
+	tr.single_length = length + add_length;
+	tr.char_count = (uint64_t) tr.single_length * tr.str_count;
+	tr.error = 0;
+
+	return tr;
+}
+
+/* Подсчитывает результат преобразования byte_count байт с адреса address_start
+при line_bytes байт в адресной строке, длине адресной строки length и длине добавочной строки add_length */
+struct Trans_Result calc_tr_lines(size_t byte_count, word address_start, 
+	size_t line_bytes, size_t length, size_t add_length)
+{
+	// учет ограничения количества байт сверху по 32-разрядному адресу
+	byte_count = hex_max_count(byte_count, address_start);
+	return trans_result32(calc_tr_lines64(byte_count, address_start, line_bytes, length, add_length));
+}
+
+/* Приведение результата к 64-разрядному виду, отрицательные счетчики - признак ошибки */
+struct Trans_Result64 trans_result64(struct Trans_Result tr)
+{
+	struct Trans_Result64 tr64;
+	tr64.error = (tr.byte_count < 0 || tr.char_count < 0 || tr.str_count <= 0) ? 1 : 0;
+	tr64.byte_count = tr.byte_count < 0 ? 0 : (uint64_t) tr.byte_count;
+	tr64.char_count = tr.char_count < 0 ? 0 : (uint64_t) tr.char_count;
+	tr64.str_count = tr.str_count < 0 ? 0 : (uint64_t) tr.str_count;
+	tr64.single_length = tr.single_length;
+	tr64.add_length = tr.add_length;
+	return tr64;
+}
+
+/* Приведение результата к 32-разрядному виду. При ошибке str_count = -1,
+если ничего не было преобразовано, то и остальные счетчики равны -1. */
+struct Trans_Result trans_result32(struct Trans_Result64 tr64)
+{
+	struct Trans_Result tr;
+	tr.byte_count = (int) tr64.byte_count;
+	tr.char_count = (int) tr64.char_count;
+	tr.str_count = (int) tr64.str_count;
+	tr.single_length = tr64.single_length;
+	tr.add_length = tr64.add_length;
+	if (tr64.error)
+	{
+		tr.str_count = -1;
+		if (tr64.char_count == 0)
+		{
+			tr.byte_count = -1;
+			tr.char_count = -1;
+			tr.single_length = 0;
+		}
+	}
+	return tr;
+}
+
 /* Подсчитывает и возвращает предполагаемый результат преобразования массива байт
 byte_array длиной count в последовательность адресных строк s.
 Внимание! Значения полей возвращаемой структуры ограничены INT_MAX, проверка на переполнение не производится.  */
@@ -533,6 +1035,8 @@ struct Trans_Result calc_tr_result(size_t byte_count, word address_start, struct
 		== 0  ошибка
 	   	 > 0  предполагаемая длина одной преобразованной строки с учетом длины добавочной строки
 	Внимание! Значения полей возвращаемой структуры ограничены INT_MAX, проверка на переполнение не производится.
+	При сжатии повторяющихся строк (Trans_Format.squeeze) char_count и str_count - верхняя граница,
+	фактические значения возвращает функция преобразования.
 */
 {
 	// наш возврат
@@ -544,7 +1048,7 @@ struct Trans_Result calc_tr_result(size_t byte_count, word address_start, struct
 		return tr;
 
 	// длина добавочной строки
-	size_t sd = strlen(insert_str);
+	size_t sd = insert_str == NULL ? 0 : strlen(insert_str);
 	if (sd > INT_MAX)
 	{
 		tr.add_length = 0;
@@ -553,27 +1057,52 @@ struct Trans_Result calc_tr_result(size_t byte_count, word address_start, struct
 	else
 		tr.add_length = (int) sd;
 
-	// число символов для преобразования одной адресной строки
-	tr.single_length = calc_chars_tf(tf);
-	if (tr.single_length == 0)
+	// число байт и символов для преобразования одной адресной строки
+	struct Compiled_Format cf;
+	if (compile_tf(&cf, tf) == NULL)
 		return tr;
 
-	// число строк для преобразования
-	tr.str_count = hex_addr_str(byte_count, address_start);
-	if (tr.str_count == 0)
+	return calc_tr_lines(byte_count, address_start, cf.line_bytes, cf.length, tr.add_length);
+}
+
+/* Подсчитывает и возвращает предполагаемый результат преобразования массива байт
+с 64-разрядного адреса. Параметры аналогичны calc_tr_result(), при ошибке Trans_Result64.error != 0. */
+struct Trans_Result64 calc_tr_result64(size_t byte_count, qword address_start, struct Trans_Format *tf,
+	char *insert_str)
+{
+	struct Trans_Result64 tr;
+	tr.byte_count = 0; tr.char_count = 0; tr.str_count = 0; tr.single_length = 0; tr.add_length = 0; tr.error = 1;
+
+	// проверка аргументов
+	if (tf == NULL)
 		return tr;
 
-	// подсчет количеств
-	// учет ограничения количества байт сверху по адресу
-	tr.byte_count = hex_max_count(byte_count, address_start);
+	// число байт и символов для преобразования одной адресной строки
+	struct Compiled_Format cf;
+	if (compile_tf(&cf, tf) == NULL)
+		return tr;
 
-	// учет длины добавочной строки
-	tr.single_length += tr.add_length;
+	return calc_tr_lines64(byte_count, address_start, cf.line_bytes, cf.length,
+		insert_str == NULL ? 0 : strlen(insert_str));
+}
 
-	// учет того, что добавочная строка добавляется и в последнюю строку
-	tr.char_count = tr.single_length * tr.str_count;
+/* Контекст преобразования: всё состояние, необходимое для преобразования,
+принадлежит контексту, поэтому разные контексты используются в разных потоках без блокировок */
+struct Hexprn_Ctx
+{
+	struct Compiled_Format cf;  // скомпилированный формат
+	char *insert_str;           // добавочная строка, у созданного контекста - собственная копия
+	size_t add_length;          // длина добавочной строки
+};
 
-	return tr;
+/* инициализация контекста ctx форматом tf и добавочной строкой insert_str без выделения памяти */
+static struct Hexprn_Ctx *ctx_init(struct Hexprn_Ctx *ctx, struct Trans_Format *tf, char *insert_str)
+{
+	if (compile_tf(&ctx->cf, tf) == NULL)
+		return NULL;
+	ctx->insert_str = insert_str;
+	ctx->add_length = insert_str == NULL ? 0 : strlen(insert_str);
+	return ctx;
 }
 
 /* Преобразование массива байт длиной byte_count в последовательность адресных строк */
@@ -605,58 +1134,283 @@ struct Trans_Result shexprnf(char *s, byte *byte_array, size_t byte_count, \
 	Внимание! Значения полей возвращаемой структуры ограничены INT_MAX, проверка на переполнение не производится.
 */
 {
-	// результат одного преобразования
+	struct Hexprn_Ctx ctx;
 	struct Trans_Result tr; 
-        tr.byte_count = -1; tr.char_count = -1; tr.str_count = -1; tr.single_length = 0;
+	tr.byte_count = -1; tr.char_count = -1; tr.str_count = -1; tr.single_length = 0;
+
+	/* компиляция формата один раз на всё преобразование */
+	if (ctx_init(&ctx, tf, insert_str) == NULL)
+		return tr;
+	return shexprnc(s, byte_array, byte_count, address_start, &ctx.cf, ctx.insert_str, before_tr);
+}
+
+/* Преобразование массива байт длиной byte_count с 64-разрядного адреса
+в последовательность адресных строк, аналогично shexprnf() */
+struct Trans_Result64 shexprnf64(char *s, byte *byte_array, size_t byte_count, \
+	qword address_start, struct Trans_Format *tf, char *insert_str, struct Trans_Result64 before_tr)
+{
+	struct Hexprn_Ctx ctx;
+	struct Trans_Result64 tr;
+	tr.byte_count = 0; tr.char_count = 0; tr.str_count = 0; tr.single_length = 0; tr.add_length = 0; tr.error = 1;
+
+	/* компиляция формата один раз на всё преобразование */
+	if (ctx_init(&ctx, tf, insert_str) == NULL)
+		return tr;
+	return shexprnc64(s, byte_array, byte_count, address_start, &ctx.cf, ctx.insert_str, before_tr);
+}
+
+/* Преобразование массива байт длиной byte_count в последовательность адресных строк
+по скомпилированному формату */
+struct Trans_Result shexprnc(char *s, byte *byte_array, size_t byte_count, \
+	word address_start, struct Compiled_Format *cf, char *insert_str, struct Trans_Result before_tr)
+/* Параметры и возврат аналогичны shexprnf(), вместо формата tf - скомпилированный формат cf.
+Преобразование выполняет shexprnc64(), результат приводится к Trans_Result. */
+{
+	struct Trans_Result tr;
+	tr.byte_count = -1; tr.char_count = -1; tr.str_count = -1; tr.single_length = 0;
 
 	// проверка аргументов
-	if (s == NULL || byte_array == NULL || tf == NULL)
+	if (s == NULL || byte_array == NULL || cf == NULL)
 		return tr;
 	if (before_tr.byte_count < 0 || before_tr.char_count <= 0 || before_tr.single_length <= 0 || before_tr.str_count <= 0)
 		return before_tr;
+	return trans_result32(shexprnc64(s, byte_array, byte_count, address_start, cf, insert_str,
+		trans_result64(before_tr)));
+}
+
+/* Преобразование массива байт длиной byte_count с 64-разрядного адреса
+в последовательность адресных строк по скомпилированному формату */
+struct Trans_Result64 shexprnc64(char *s, byte *byte_array, size_t byte_count, \
+	qword address_start, struct Compiled_Format *cf, char *insert_str, struct Trans_Result64 before_tr)
+/* Параметры аналогичны shexprnc(), при ошибке Trans_Result64.error != 0.
+Массив преобразуется целиком, поэтому последняя строка выводится и при сжатии повторов. */
+{
+	struct Squeeze_State sq;
+	squeeze_init(&sq, NULL, 0, 0);
+	return shexprnc64_squeeze(s, byte_array, byte_count, address_start, cf, insert_str, before_tr, &sq, 0);
+}
+
+/* Смещение в массиве первого байта адресной строки с номером line */
+uint64_t hex_line_offset64(uint64_t line, qword address_start, size_t line_bytes)
+{
+	if (line == 0 || line_bytes == 0)
+		return 0;
+	return line * line_bytes - address_start % line_bytes;
+}
+
+/* Преобразование только адресных строк с номерами [line_first, line_end) */
+struct Trans_Result64 shexprnc64_lines(char *s, byte *byte_array, size_t byte_count, qword address_start,
+	struct Compiled_Format *cf, char *insert_str, uint64_t line_first, uint64_t line_end)
+{
+	struct Trans_Result64 tr;
+	tr.byte_count = 0; tr.char_count = 0; tr.str_count = 0; tr.single_length = 0; tr.add_length = 0; tr.error = 1;
+	if (s == NULL || byte_array == NULL || cf == NULL || cf->line_bytes == 0 || line_end < line_first)
+		return tr;
+
+	size_t add_length = insert_str == NULL ? 0 : strlen(insert_str);
+	size_t line_bytes = cf->line_bytes;
+	byte_count = hex_max_count64(byte_count, address_start);
+	uint64_t lines = hex_addr_str64(byte_count, address_start, line_bytes);
+	if (line_end > lines)
+		line_end = lines;
+	if (line_first >= line_end)
+	{
+		tr.single_length = cf->length + add_length;
+		tr.add_length = add_length;
+		tr.error = 0;
+		return tr;
+	}
 
-	struct Trans_Result cumul_tr;   // накопленный результат
+	/* участок массива строк диапазона, последняя строка может быть неполной */
+	uint64_t first = hex_line_offset64(line_first, address_start, line_bytes);
+	uint64_t last = line_end == lines ? byte_count : hex_line_offset64(line_end, address_start, line_bytes);
+	size_t count = (size_t) (last - first);
+	tr = calc_tr_lines64(count, address_start + first, line_bytes, cf->length, add_length);
+
+	/* без состояния сжатия строки выводятся все */
+	return shexprnc64_squeeze(s, byte_array + first, count, address_start + first, cf, insert_str, tr, NULL, 0);
+}
+
+/* Запись строки-маркера сжатия и добавочной строки в s, возвращает число символов */
+static size_t sprn_squeeze_mark(char *s, char *insert_str, size_t add_length)
+{
+	s[0] = HEXPRN_SQUEEZE_MARK;
+	if (add_length != 0)
+		memcpy(s + 1, insert_str, add_length);
+	return 1 + add_length;
+}
+
+/* Начальное состояние сжатия перед адресной строкой, начинающейся с байта offset массива bytes */
+void squeeze_init(struct Squeeze_State *sq, const byte *bytes, size_t offset, size_t line_bytes)
+{
+	if (sq == NULL)
+		return;
+	sq->address = 0;
+	sq->full = 0;
+	sq->repeat = 0;
+	sq->held = 0;
+	if (bytes == NULL || line_bytes == 0 || line_bytes > HEXPRN_LINE_BYTES_MAX || offset < line_bytes)
+		return;
+
+	/* предыдущая строка и признак её повтора по байтам перед offset */
+	memcpy(sq->line, bytes + offset - line_bytes, line_bytes);
+	sq->full = 1;
+	if (offset >= 2 * line_bytes && memcmp(bytes + offset - line_bytes, bytes + offset - 2 * line_bytes, line_bytes) == 0)
+		sq->repeat = 1;
+}
+
+/* Преобразование части массива байт по скомпилированному формату с состоянием сжатия sq */
+struct Trans_Result64 shexprnc64_squeeze(char *s, byte *byte_array, size_t byte_count,
+	qword address_start, struct Compiled_Format *cf, char *insert_str, struct Trans_Result64 before_tr,
+	struct Squeeze_State *sq, int more)
+/* Полные адресные строки записываются копированием заготовки и разносом цифр и символов
+по смещениям ячеек, пустые ячейки есть только у первой и последней строки.
+При сжатии строка сравнивается с предыдущей полной строкой, а серия повторов пропускается
+одним векторным сравнением массива с самим собой со сдвигом на длину строки. */
+{
+	struct Trans_Result64 cumul_tr;   // накопленный результат
+	cumul_tr.byte_count = 0; cumul_tr.char_count = 0; cumul_tr.str_count = 0; cumul_tr.single_length = 0;
+	cumul_tr.add_length = before_tr.add_length; cumul_tr.error = 1;
+
+	// проверка аргументов
+	if (s == NULL || byte_array == NULL || cf == NULL)
+		return cumul_tr;
+	if (before_tr.error || before_tr.str_count == 0 || before_tr.single_length == 0)
+		return cumul_tr;
+	if (before_tr.single_length != cf->length + before_tr.add_length)
+		return cumul_tr;
+	if (before_tr.byte_count > byte_count)  // предварительный результат больше массива
+		return cumul_tr;
 
-	/* ограничение числа байт */
-	byte_count = hex_addr_str(byte_count, address_start);
-	
 	/* инициализация накопленного результата */
-	cumul_tr.add_length = before_tr.add_length;
 	cumul_tr.single_length = before_tr.single_length;
-	cumul_tr.byte_count = 0;
-	cumul_tr.char_count = 0;
-	cumul_tr.str_count = 0;
-
-	/* цикл преобразования */
-	int j, i;
+	cumul_tr.error = 0;
+	STATS_CLOCK(call);
+
+	/* состояние сжатия: предыдущая полная строка и признак серии повторов */
+	int squeeze = cf->tf.squeeze && sq != NULL;
+	const byte *prev = squeeze && sq->full ? sq->line : NULL;
+	int repeat = squeeze ? sq->repeat : 0;
+	int held = squeeze ? sq->held : 0;
+
+	/* цикл преобразования: только первая строка может начинаться не с первой ячейки */
+	size_t line_bytes = cf->line_bytes;
+	sprn_line_fn line_full = sprn_line_full(line_bytes);
+	size_t bytes_left = (size_t) before_tr.byte_count;  // число оставшихся байт
+	qword address = address_start;  // адрес очередного байта
+	size_t first = (size_t) (address % line_bytes);  // номер первой ячейки с байтом
+	size_t count;                   // число байт в строке
+	size_t run;                     // число байт в серии повторов
+	const byte *bytes;              // байты строки
+	uint64_t j;
 	for (j = 0; j < before_tr.str_count; j++)
 	{
+		count = line_bytes - first;
+		if (count > bytes_left)
+			count = bytes_left;
+		bytes = byte_array + cumul_tr.byte_count;
+
+		/* повтор предыдущей полной строки, кроме последней строки преобразования */
+		if (prev != NULL && count == line_bytes && (more || bytes_left > count) &&
+			memcmp(bytes, prev, line_bytes) == 0)
+		{
+			/* маркер выводится только вместо первой строки серии */
+			if (!repeat)
+			{
+				cumul_tr.char_count += sprn_squeeze_mark(s + cumul_tr.char_count, insert_str, before_tr.add_length);
+				cumul_tr.str_count++;
+			}
+
+			/* остальные строки серии: сравнение со сдвигом на строку */
+			run = line_bytes;
+			if (bytes_left >= 2 * line_bytes)
+			{
+				run += bytes_mismatch(bytes + line_bytes, bytes, bytes_left - line_bytes) / line_bytes * line_bytes;
+				if (!more && run == bytes_left)
+					run -= line_bytes;
+			}
+			prev = bytes + run - line_bytes;
+			repeat = 1;
+			held = 1;
+			first = 0;
+
+			cumul_tr.byte_count += run;
+			bytes_left -= run;
+			address += run;
+			j += run / line_bytes - 1;
+			continue;
+		}
+
 		/* преобразование одной строки */
-		tr = shexprn_str(\
-			s + cumul_tr.char_count,            // сдвиг строки символов на число преобразованных символов
-			byte_array + cumul_tr.byte_count,   // сдвиг массива байт на число преобразованных байт
-			before_tr.byte_count - cumul_tr.byte_count,  // в количестве байт учет количества преобразованных байт
-			address_start + cumul_tr.byte_count, // в адресе учет количества преобразованных байт
-			tf);
-		
-		/* проверка результатов */
-		if (tr.byte_count < 0 || tr.char_count <= 0 || tr.str_count != 1)
-			return cumul_tr;
-		cumul_tr.byte_count += tr.byte_count;
-		cumul_tr.char_count += tr.char_count;
-		cumul_tr.str_count  += tr.str_count;
+		if (cf->tf.color)
+			cumul_tr.char_count += sprn_line_color(s + cumul_tr.char_count, cf, bytes, address - first, first, count);
+		else
+		{
+			if (count == line_bytes)
+				line_full(s + cumul_tr.char_count, cf, bytes, address);
+			else
+				sprn_line_part(s + cumul_tr.char_count, cf, bytes, address - first, first, count);
+			cumul_tr.char_count += cf->length;
+		}
+		first = 0;
+		if (squeeze)
+		{
+			prev = count == line_bytes ? bytes : NULL;
+			repeat = 0;
+			held = 0;
+		}
+
+		cumul_tr.byte_count += count;
+		cumul_tr.str_count++;
+		bytes_left -= count;
+		address += count;
 
 		/* добавка дополнительной строки, если она есть */
 		if (before_tr.add_length != 0)
 		{
-			for (i = 0; i < before_tr.add_length; i++)
-				s[cumul_tr.char_count++] = insert_str[i];
+			STATS_CLOCK(t);
+			memcpy(s + cumul_tr.char_count, insert_str, before_tr.add_length);
+			cumul_tr.char_count += before_tr.add_length;
+			STATS_PHASE(t, HEXPRN_PHASE_INSERT);
 		}
 	}
 
+	/* состояние для следующей части: байты последней строки копируются, массив может быть освобожден */
+	if (squeeze)
+	{
+		if (prev != NULL && prev != sq->line)
+			memcpy(sq->line, prev, line_bytes);
+		if (cumul_tr.byte_count != 0)
+			sq->address = address - line_bytes;
+		sq->full = prev != NULL;
+		sq->repeat = repeat;
+		sq->held = held;
+	}
+
+	STATS_CALL(call, cumul_tr.byte_count, cumul_tr.str_count, cumul_tr.char_count);
 	return cumul_tr;
 }
 
+/* Запись в s пропущенной последней строки после преобразования частей с more != 0 */
+size_t squeeze_end(char *s, struct Compiled_Format *cf, char *insert_str, struct Squeeze_State *sq)
+{
+	if (s == NULL || cf == NULL || sq == NULL || !cf->tf.squeeze || !sq->held || !sq->full)
+		return 0;
+	size_t add_length = insert_str == NULL ? 0 : strlen(insert_str);
+	size_t length = cf->length;
+	STATS_CLOCK(call);
+	if (cf->tf.color)
+		length = sprn_line_color(s, cf, sq->line, sq->address, 0, cf->line_bytes);
+	else
+		sprn_line_full(cf->line_bytes)(s, cf, sq->line, sq->address);
+	if (add_length != 0)
+		memcpy(s + length, insert_str, add_length);
+	sq->repeat = 0;
+	sq->held = 0;
+	STATS_CALL(call, 0, 1, length + add_length);
+	return length + add_length;
+}
+
 /* Преобразование массива байт длиной byte_count в последовательность адресных строк 
 с форматом по-умолчанию. Выделяет необходимую память для строки *s.
 Перед использованием необходимо выделить память s = (char **) malloc(sizof(char **));
@@ -678,15 +1432,20 @@ struct Trans_Result shexprn(char **s, byte *byte_array, size_t byte_count, word
 		return tr;
 
 	/* задание формата преобразования по-умолчанию */
+	struct Hexprn_Ctx ctx;
 	struct Trans_Format tf = ret_default_tf();
+	if (ctx_init(&ctx, &tf, "\n") == NULL)
+		return tr;
 
 	/* вычисление формата */
-	tr = calc_tr_result(byte_count, address_start, &tf, "\n");
+	tr = calc_tr_lines(byte_count, address_start, ctx.cf.line_bytes, ctx.cf.length, ctx.add_length);
 	if (tr.char_count < 0)
 		return tr;
 
 	/* подготовка строки для записи */
+	STATS_CLOCK(t);
 	*s = (char *) calloc(tr.char_count+1, sizeof(char));
+	STATS_ALLOC(t, (size_t) tr.char_count + 1);
 	if (*s == NULL)
 	{
 		tr.char_count = -1;
@@ -695,7 +1454,7 @@ struct Trans_Result shexprn(char **s, byte *byte_array, size_t byte_count, word
 	(*s)[tr.char_count] = '\0';
 
 	/* результат преобразования */
-	prtr = shexprnf(*s, byte_array, byte_count, address_start, &tf, "\n", tr);
+	prtr = shexprnc(*s, byte_array, byte_count, address_start, &ctx.cf, ctx.insert_str, tr);
 	// если были ошибки при преобразовании
 	if (prtr.char_count <= 0)
 	{
@@ -707,46 +1466,505 @@ struct Trans_Result shexprn(char **s, byte *byte_array, size_t byte_count, word
 	char *ns;
 	if (prtr.char_count < tr.char_count)
 	{
+		STATS_CLOCK(t);
 		ns = (char *) realloc((void *) *s, ((size_t) prtr.char_count) * sizeof(char)); // sizeof(char) = 1
+		STATS_ALLOC(t, (size_t) prtr.char_count);
 		*s = ns;
 	}
 	return prtr;
 }
 
-/* Преобразует массив байт byte_array длиной byte_count в строку
-и печатает её в файл fp. Формат преобразования - по-умолчанию, смещение адреса - address.
-Возвращает результат преобразования с числом записанных символов */
-struct Trans_Result fhexprn(FILE *fp, byte *byte_array, size_t byte_count, word address)
+/* Записывает в файл строку s длиной n, возвращает число записанных символов */
+size_t hexprn_sink_file(void *sink_arg, const char *s, size_t n)
 {
-	char **s; 
-        struct Trans_Result prtr2; prtr2.str_count = -1;
-        
-	// проверка аргументов
-	if (fp == NULL || byte_array == NULL)
-		return prtr2;
-	
-	// выделение памяти под указатель на массив символов для преобразования
-	s = (char **) malloc(sizeof(char **)); 
-	if (s == NULL)
-		return prtr2;
+	return fwrite(s, sizeof(char), n, (FILE *) sink_arg);
+}
+
+/* Записывает в файловый дескриптор строку s длиной n, возвращает число записанных символов */
+size_t hexprn_sink_fd(void *sink_arg, const char *s, size_t n)
+{
+	int fd = *(int *) sink_arg;
+	size_t done = 0;
+	while (done < n)
+	{
+		ssize_t r = write(fd, s + done, n - done);
+		if (r < 0 && errno == EINTR)
+			continue;
+		if (r <= 0)
+			break;
+		done += (size_t) r;
+	}
+	return done;
+}
+
+/* Потоковое преобразование массива байт длиной byte_count в последовательность адресных строк
+по скомпилированному формату cf с выводом через функцию записи sink */
+struct Trans_Result stream_hexprnc(hexprn_sink sink, void *sink_arg, byte *byte_array, size_t byte_count,
+	word address_start, struct Compiled_Format *cf, char *insert_str)
+/* Адресные строки преобразуются порциями в буфер размером HEXPRN_STREAM_BUF и после
+каждой порции передаются в sink, поэтому расход памяти не зависит от числа байт.
+Возврат аналогичен shexprnf(), Trans_Result.char_count - число записанных символов.
+При ошибке записи Trans_Result.str_count = -1. */
+{
+	// учет ограничения количества байт сверху по 32-разрядному адресу
+	byte_count = hex_max_count(byte_count, address_start);
+	return trans_result32(stream_hexprnc64(sink, sink_arg, byte_array, byte_count, address_start, cf, insert_str));
+}
+
+/* Потоковое преобразование массива байт длиной byte_count с 64-разрядного адреса
+в последовательность адресных строк по скомпилированному формату cf с выводом через функцию записи sink */
+struct Trans_Result64 stream_hexprnc64(hexprn_sink sink, void *sink_arg, byte *byte_array, size_t byte_count,
+	qword address_start, struct Compiled_Format *cf, char *insert_str)
+/* Аналогично stream_hexprnc(), при ошибке записи Trans_Result64.error != 0,
+а счетчики показывают число байт, символов и строк, переданных в sink до ошибки. */
+{
+	struct Squeeze_State sq;
+	squeeze_init(&sq, NULL, 0, 0);
+	return stream_hexprnc64_squeeze(sink, sink_arg, byte_array, byte_count, address_start, cf, insert_str, &sq, 0);
+}
+
+/* вызов функции записи с учетом в счетчиках */
+static inline size_t sink_write(hexprn_sink sink, void *sink_arg, const char *s, size_t n)
+{
+	STATS_CLOCK(t);
+	size_t written = sink(sink_arg, s, n);
+	STATS_WRITE(t, written);
+	return written;
+}
+
+/* Потоковое преобразование части массива байт с состоянием сжатия sq */
+struct Trans_Result64 stream_hexprnc64_squeeze(hexprn_sink sink, void *sink_arg, byte *byte_array,
+	size_t byte_count, qword address_start, struct Compiled_Format *cf, char *insert_str,
+	struct Squeeze_State *sq, int more)
+/* Порции преобразуются shexprnc64_squeeze() с общим состоянием сжатия,
+последняя строка порции может быть пропущена, если за порцией следуют еще байты. */
+{
+	char buf[HEXPRN_STREAM_BUF];
+	struct Trans_Result64 tr, part_tr, cumul_tr;
+	cumul_tr.byte_count = 0; cumul_tr.char_count = 0; cumul_tr.str_count = 0; cumul_tr.single_length = 0;
+	cumul_tr.add_length = 0; cumul_tr.error = 1;
+
+	/* проверка аргументов */
+	if (sink == NULL || byte_array == NULL || cf == NULL)
+		return cumul_tr;
+
+	/* общий результат и число строк в одной порции */
+	size_t add_length = insert_str == NULL ? 0 : strlen(insert_str);
+	tr = calc_tr_lines64(byte_count, address_start, cf->line_bytes, cf->length, add_length);
+	if (tr.error || tr.single_length > HEXPRN_STREAM_BUF)
+		return cumul_tr;
+	size_t part_lines = HEXPRN_STREAM_BUF / tr.single_length;
+
+	cumul_tr = tr;
+	cumul_tr.byte_count = 0;
+	cumul_tr.char_count = 0;
+	cumul_tr.str_count = 0;
+
+	/* цикл по порциям: каждая порция, кроме первой, начинается с начала адресной строки */
+	size_t bytes_left = (size_t) tr.byte_count;
+	size_t part_bytes;
+	qword address = address_start;
+	do
+	{
+		part_bytes = part_lines * cf->line_bytes - (size_t) (address % cf->line_bytes);
+		if (part_bytes > bytes_left)
+			part_bytes = bytes_left;
+		part_tr = calc_tr_lines64(part_bytes, address, cf->line_bytes, cf->length, add_length);
+		part_tr = shexprnc64_squeeze(buf, byte_array + cumul_tr.byte_count, part_bytes, address, cf, insert_str,
+			part_tr, sq, more || part_bytes < bytes_left);
+		if (part_tr.error || sink_write(sink, sink_arg, buf, (size_t) part_tr.char_count) != (size_t) part_tr.char_count)
+		{
+			cumul_tr.error = 1;
+			return cumul_tr;
+		}
+		cumul_tr.byte_count += part_tr.byte_count;
+		cumul_tr.char_count += part_tr.char_count;
+		cumul_tr.str_count += part_tr.str_count;
+		bytes_left -= part_bytes;
+		address += part_bytes;
+	}
+	while (bytes_left > 0);
+
+	return cumul_tr;
+}
+
+/* Подготовка вытягивающего преобразования массива байт по скомпилированному формату cf */
+struct Hexprn_Encoder *hexprn_encoder_init(struct Hexprn_Encoder *enc, byte *byte_array, size_t byte_count,
+	qword address_start, struct Compiled_Format *cf, char *insert_str)
+{
+	if (enc == NULL || byte_array == NULL || cf == NULL || cf->length > HEXPRN_LINE_MAX)
+		return NULL;
+
+	enc->cf = cf;
+	enc->insert_str = insert_str;
+	enc->add_length = insert_str == NULL ? 0 : strlen(insert_str);
+	enc->tr = calc_tr_lines64(byte_count, address_start, cf->line_bytes, cf->length, enc->add_length);
+	if (enc->tr.error)
+		return NULL;
+	enc->byte_array = byte_array;
+	enc->byte_count = (size_t) enc->tr.byte_count;
+	enc->address_start = address_start;
+	squeeze_init(&enc->sq, NULL, 0, 0);
+	enc->line_length = 0;
+	enc->line_pos = 0;
+
+	/* счетчики накапливают выданное */
+	enc->tr.byte_count = 0;
+	enc->tr.char_count = 0;
+	enc->tr.str_count = 0;
+	return enc;
+}
+
+/* Признак непреобразованных байт, пустой массив дает одну строку без байт, как shexprnc64() */
+static int encoder_more(struct Hexprn_Encoder *enc)
+{
+	return enc->tr.byte_count < enc->byte_count || (enc->byte_count == 0 && enc->tr.str_count == 0);
+}
+
+/* Выдача в s не более size символов начатой строки и добавочной строки, возвращает число символов */
+static size_t encoder_drain(struct Hexprn_Encoder *enc, char *s, size_t size)
+{
+	size_t total = enc->line_length + enc->add_length;  // длина строки вместе с добавочной строкой
+	size_t n = 0, k;
+	while (enc->line_length != 0 && n < size)
+	{
+		if (enc->line_pos < enc->line_length)
+		{
+			k = enc->line_length - enc->line_pos;
+			if (k > size - n)
+				k = size - n;
+			memcpy(s + n, enc->line + enc->line_pos, k);
+		}
+		else
+		{
+			k = total - enc->line_pos;
+			if (k > size - n)
+				k = size - n;
+			memcpy(s + n, enc->insert_str + (enc->line_pos - enc->line_length), k);
+		}
+		n += k;
+		enc->line_pos += k;
+		if (enc->line_pos == total)
+		{
+			enc->line_length = 0;
+			enc->line_pos = 0;
+		}
+	}
+	return n;
+}
+
+/* Записывает в s очередные не более size символов адресных строк */
+size_t hexprn_encoder_fill(struct Hexprn_Encoder *enc, char *s, size_t size)
+/* Сначала дописывается начатая строка, затем полные строки, помещающиеся в остаток буфера,
+преобразуются shexprnc64_squeeze() прямо в s, а строка, не помещающаяся целиком,
+преобразуется без добавочной строки в enc->line и выдается частично. */
+{
+	if (enc == NULL || s == NULL || enc->tr.error)
+		return 0;
+
+	struct Compiled_Format *cf = enc->cf;
+	size_t line_bytes = cf->line_bytes;
+	size_t single_length = cf->length + enc->add_length;
+	size_t n = encoder_drain(enc, s, size);  // число записанных символов
+	size_t done, left, part_bytes;
+	qword address;
+	struct Trans_Result64 part_tr;
+	while (n < size && encoder_more(enc))
+	{
+		done = (size_t) enc->tr.byte_count;
+		left = enc->byte_count - done;
+		address = enc->address_start + done;
+
+		/* полные строки прямо в буфер вызывающего, иначе одна строка в enc->line */
+		size_t lines = (size - n) / single_length;
+		part_bytes = (lines != 0 ? lines : 1) * line_bytes - (size_t) (address % line_bytes);
+		if (part_bytes > left)
+			part_bytes = left;
+		if (lines != 0)
+		{
+			part_tr = calc_tr_lines64(part_bytes, address, line_bytes, cf->length, enc->add_length);
+			part_tr = shexprnc64_squeeze(s + n, enc->byte_array + done, part_bytes, address, cf, enc->insert_str,
+				part_tr, &enc->sq, part_bytes < left);
+		}
+		else
+		{
+			part_tr = calc_tr_lines64(part_bytes, address, line_bytes, cf->length, 0);
+			part_tr = shexprnc64_squeeze(enc->line, enc->byte_array + done, part_bytes, address, cf, NULL,
+				part_tr, &enc->sq, part_bytes < left);
+		}
+		if (part_tr.error)
+		{
+			enc->tr.error = 1;
+			break;
+		}
+		enc->tr.byte_count += part_tr.byte_count;
+		enc->tr.str_count += part_tr.str_count;
+		if (lines != 0)
+			n += (size_t) part_tr.char_count;
+		else
+		{
+			enc->line_length = (size_t) part_tr.char_count;
+			enc->line_pos = 0;
+			n += encoder_drain(enc, s + n, size - n);
+		}
+	}
+
+	enc->tr.char_count += n;
+	return n;
+}
+
+/* Возвращает != 0, если все символы выданы или произошла ошибка */
+int hexprn_encoder_done(struct Hexprn_Encoder *enc)
+{
+	if (enc == NULL || enc->tr.error)
+		return 1;
+	return enc->line_length == 0 && !encoder_more(enc);
+}
+
+/* Подготовка проталкиваемого преобразования с адреса address_start с выводом через sink */
+struct Hexprn_Feeder *hexprn_feeder_init(struct Hexprn_Feeder *feeder, qword address_start,
+	struct Compiled_Format *cf, char *insert_str, hexprn_sink sink, void *sink_arg)
+{
+	if (feeder == NULL || cf == NULL || sink == NULL)
+		return NULL;
+	size_t add_length = insert_str == NULL ? 0 : strlen(insert_str);
+	if (cf->line_bytes == 0 || cf->line_bytes > HEXPRN_LINE_BYTES_MAX || cf->length + add_length > HEXPRN_STREAM_BUF)
+		return NULL;
+
+	feeder->cf = cf;
+	feeder->insert_str = insert_str;
+	feeder->sink = sink;
+	feeder->sink_arg = sink_arg;
+	feeder->address = address_start;
+	squeeze_init(&feeder->sq, NULL, 0, 0);
+	feeder->pend = 0;
+	feeder->tr.byte_count = 0; feeder->tr.char_count = 0; feeder->tr.str_count = 0;
+	feeder->tr.single_length = cf->length + add_length;
+	feeder->tr.add_length = add_length;
+	feeder->tr.error = 0;
+	return feeder;
+}
+
+/* Вывод byte_count байт с адреса address через sink, more != 0 - за ними следуют еще байты */
+static int feeder_emit(struct Hexprn_Feeder *feeder, byte *byte_array, size_t byte_count, qword address, int more)
+{
+	struct Trans_Result64 tr = stream_hexprnc64_squeeze(feeder->sink, feeder->sink_arg, byte_array, byte_count,
+		address, feeder->cf, feeder->insert_str, &feeder->sq, more);
+	feeder->tr.byte_count += tr.byte_count;
+	feeder->tr.char_count += tr.char_count;
+	feeder->tr.str_count += tr.str_count;
+	if (tr.error || tr.byte_count != byte_count)
+	{
+		feeder->tr.error = 1;
+		return -1;
+	}
+	return 0;
+}
+
+/* Принимает очередные byte_count байт */
+int hexprn_feeder_write(struct Hexprn_Feeder *feeder, byte *byte_array, size_t byte_count)
+/* Сначала дополняется незаконченная строка и выводится, если закончилась, затем все строки,
+заканчивающиеся в byte_array, выводятся одним потоковым преобразованием,
+а остаток копируется в feeder->line. При сжатии повторов строка выводится только после
+поступления следующего байта: последняя строка выводится полностью, а не маркером,
+поэтому законченная последняя строка части тоже остается в feeder->line. */
+{
+	if (feeder == NULL || feeder->tr.error)
+		return -1;
+	if (byte_count == 0)
+		return 0;
+	if (byte_array == NULL)
+		return -1;
+
+	size_t line_bytes = feeder->cf->line_bytes;
+	int squeeze = feeder->cf->tf.squeeze;
+	size_t need = line_bytes - (size_t) (feeder->address % line_bytes);  // байт до конца текущей строки
+	size_t k;
+
+	/* дополнение незаконченной строки */
+	if (feeder->pend != 0)
+	{
+		if (need == line_bytes)
+			need = 0;  // строка закончена и ожидает следующего байта
+		k = byte_count < need ? byte_count : need;
+		memcpy(feeder->line + feeder->pend, byte_array, k);
+		feeder->pend += k;
+		feeder->address += k;
+		byte_array += k;
+		byte_count -= k;
+		if (k < need || (squeeze && byte_count == 0))
+			return 0;
+		if (feeder_emit(feeder, feeder->line, feeder->pend, feeder->address - feeder->pend, 1) != 0)
+			return -1;
+		feeder->pend = 0;
+		need = line_bytes;
+	}
+
+	/* строки, заканчивающиеся в byte_array, без копирования */
+	k = byte_count < need ? 0 : byte_count - (size_t) ((feeder->address + byte_count) % line_bytes);
+	if (squeeze && k != 0 && k == byte_count)
+		k -= k <= need ? k : line_bytes;  // последняя строка ожидает следующего байта
+	if (k != 0)
+	{
+		if (feeder_emit(feeder, byte_array, k, feeder->address, 1) != 0)
+			return -1;
+		feeder->address += k;
+		byte_array += k;
+		byte_count -= k;
+	}
+
+	/* начало незаконченной строки */
+	memcpy(feeder->line + feeder->pend, byte_array, byte_count);
+	feeder->pend += byte_count;
+	feeder->address += byte_count;
+	return 0;
+}
 
-	// преобразование с параметрами по-умолчанию
-	prtr2 = shexprn(s, byte_array, byte_count, address);
-	if (prtr2.char_count <= 0)
+/* Завершение: вывод незаконченной строки или пропущенной при сжатии последней строки */
+int hexprn_feeder_flush(struct Hexprn_Feeder *feeder)
+{
+	if (feeder == NULL || feeder->tr.error)
+		return -1;
+
+	if (feeder->pend != 0)
+	{
+		if (feeder_emit(feeder, feeder->line, feeder->pend, feeder->address - feeder->pend, 0) != 0)
+			return -1;
+		feeder->pend = 0;
+		return 0;
+	}
+
+	char buf[HEXPRN_STREAM_BUF];
+	size_t n = squeeze_end(buf, feeder->cf, feeder->insert_str, &feeder->sq);
+	if (n == 0)
+		return 0;
+	if (sink_write(feeder->sink, feeder->sink_arg, buf, n) != n)
 	{
-            free(s); // помним, что *s была освобождена в default_to_strings()
-            prtr2.str_count = -1;
-            return prtr2;
+		feeder->tr.error = 1;
+		return -1;
 	}
+	feeder->tr.char_count += n;
+	feeder->tr.str_count++;
+	return 0;
+}
+
+/* --- контекст преобразования --- */
+
+/* Создает контекст преобразования с форматом tf и добавочной строкой insert_str */
+struct Hexprn_Ctx *hexprn_ctx_create(struct Trans_Format *tf, char *insert_str)
+{
+	size_t add_length = insert_str == NULL ? 0 : strlen(insert_str);
+
+	/* копия добавочной строки располагается сразу за контекстом */
+	STATS_CLOCK(t);
+	struct Hexprn_Ctx *ctx = (struct Hexprn_Ctx *) malloc(sizeof(struct Hexprn_Ctx) + add_length + 1);
+	STATS_ALLOC(t, sizeof(struct Hexprn_Ctx) + add_length + 1);
+	if (ctx == NULL)
+		return NULL;
+	char *copy = (char *) (ctx + 1);
+	if (add_length != 0)
+		memcpy(copy, insert_str, add_length);
+	copy[add_length] = '\0';
+
+	if (ctx_init(ctx, tf, copy) == NULL)
+	{
+		free(ctx);
+		return NULL;
+	}
+	return ctx;
+}
+
+/* Освобождает контекст преобразования */
+void hexprn_ctx_destroy(struct Hexprn_Ctx *ctx)
+{
+	free(ctx);
+}
+
+/* Подсчитывает предполагаемый результат преобразования в контексте ctx */
+struct Trans_Result64 hexprn_ctx_calc(struct Hexprn_Ctx *ctx, size_t byte_count, qword address_start)
+{
+	struct Trans_Result64 tr;
+	tr.byte_count = 0; tr.char_count = 0; tr.str_count = 0; tr.single_length = 0; tr.add_length = 0; tr.error = 1;
+	if (ctx == NULL)
+		return tr;
+	return calc_tr_lines64(byte_count, address_start, ctx->cf.line_bytes, ctx->cf.length, ctx->add_length);
+}
+
+/* Преобразование массива байт в строку s в контексте ctx */
+struct Trans_Result64 hexprn_ctx_convert(struct Hexprn_Ctx *ctx, char *s, byte *byte_array,
+	size_t byte_count, qword address_start)
+{
+	struct Trans_Result64 tr = hexprn_ctx_calc(ctx, byte_count, address_start);
+	if (tr.error)
+		return tr;
+	return shexprnc64(s, byte_array, byte_count, address_start, &ctx->cf, ctx->insert_str, tr);
+}
 
-	// вывод результата преобразования
-	prtr2.char_count = fprintf(fp, "%s", *s);
+/* Потоковое преобразование массива байт с выводом через функцию записи sink в контексте ctx */
+struct Trans_Result64 hexprn_ctx_write(struct Hexprn_Ctx *ctx, hexprn_sink sink, void *sink_arg,
+	byte *byte_array, size_t byte_count, qword address_start)
+{
+	struct Trans_Result64 tr;
+	tr.byte_count = 0; tr.char_count = 0; tr.str_count = 0; tr.single_length = 0; tr.add_length = 0; tr.error = 1;
+	if (ctx == NULL)
+		return tr;
+	return stream_hexprnc64(sink, sink_arg, byte_array, byte_count, address_start, &ctx->cf, ctx->insert_str);
+}
+
+/* Возвращает скомпилированный формат контекста */
+struct Compiled_Format *hexprn_ctx_format(struct Hexprn_Ctx *ctx)
+{
+	return ctx == NULL ? NULL : &ctx->cf;
+}
+
+/* Возвращает добавочную строку контекста */
+char *hexprn_ctx_insert_str(struct Hexprn_Ctx *ctx)
+{
+	return ctx == NULL ? NULL : ctx->insert_str;
+}
 
-	// освобождение памяти
-	free(*s); // памяти строки
-	free(s);  // указателя на строку
+/* Потоковое преобразование массива байт в файл fp с заданным форматом */
+struct Trans_Result fhexprnf(FILE *fp, byte *byte_array, size_t byte_count, word address_start,
+	struct Trans_Format *tf, char *insert_str)
+{
+	struct Hexprn_Ctx ctx;
+	struct Trans_Result tr; tr.byte_count = -1; tr.char_count = -1; tr.str_count = -1; tr.single_length = 0;
 
-	return prtr2;
+	// проверка аргументов
+	if (fp == NULL || ctx_init(&ctx, tf, insert_str) == NULL)
+		return tr;
+	return stream_hexprnc(hexprn_sink_file, fp, byte_array, byte_count, address_start, &ctx.cf, ctx.insert_str);
+}
+
+/* Потоковое преобразование массива байт в файловый дескриптор fd с заданным форматом */
+struct Trans_Result dhexprnf(int fd, byte *byte_array, size_t byte_count, word address_start,
+	struct Trans_Format *tf, char *insert_str)
+{
+	struct Hexprn_Ctx ctx;
+	struct Trans_Result tr; tr.byte_count = -1; tr.char_count = -1; tr.str_count = -1; tr.single_length = 0;
+
+	// проверка аргументов
+	if (fd < 0 || ctx_init(&ctx, tf, insert_str) == NULL)
+		return tr;
+	return stream_hexprnc(hexprn_sink_fd, &fd, byte_array, byte_count, address_start, &ctx.cf, ctx.insert_str);
+}
+
+/* Преобразует массив байт byte_array длиной byte_count в последовательность адресных строк
+и печатает её в файл fp. Формат преобразования - по-умолчанию, смещение адреса - address.
+Возвращает результат преобразования с числом записанных символов */
+struct Trans_Result fhexprn(FILE *fp, byte *byte_array, size_t byte_count, word address)
+{
+	struct Trans_Format tf = ret_default_tf();
+	return fhexprnf(fp, byte_array, byte_count, address, &tf, "\n");
+}
+
+/* Преобразует массив байт byte_array длиной byte_count в последовательность адресных строк
+и записывает её в файловый дескриптор fd. Формат преобразования - по-умолчанию, смещение адреса - address.
+Возвращает результат преобразования с числом записанных символов */
+struct Trans_Result dhexprn(int fd, byte *byte_array, size_t byte_count, word address)
+{
+	struct Trans_Format tf = ret_default_tf();
+	return dhexprnf(fd, byte_array, byte_count, address, &tf, "\n");
 }
 
 /* Преобразует массив байт byte_array длиной byte_count в массив символов и записывает его
@@ -755,4 +1973,4 @@ struct Trans_Result fhexprn(FILE *fp, byte *byte_array, size_t byte_count, word
 inline struct Trans_Result hexprn(byte *byte_array, size_t byte_count)
 {
 	return fhexprn(stdout, byte_array, byte_count, 0);
-}
\ No newline at end of file
+}
@@ -0,0 +1,990 @@
+/*
+	hexprn_main.c
+	Программа hexprn: вывод содержимого файла в шестнадцатеричном виде
+
+Обычный файл отображается в память окнами по HEXPRN_MAP_WINDOW байт,
+каналы и устройства преобразуются конвейером hexpipe_fd(): чтение, преобразование
+блоков по HEXPRN_READ_BLOCK байт и запись идут одновременно в отдельных потоках.
+Вывод идет потоком через буфер библиотеки, расход памяти не зависит от размера файла.
+Просмотр (-P) преобразует только строки видимого экрана shexprnc64_lines(), поэтому
+открытие и листание файла любого размера не зависят от его длины.
+Поиск (-g, -G) выводит только окна строк вокруг вхождений образцов stream_hexgrepc().
+Вид -F выводит байты для других программ stream_hexemit(): цифры, массив C или JSON.
+*/
+#define _POSIX_C_SOURCE 200809L  // posix_madvise(), getopt(); без _GNU_SOURCE: имена порядка байт elements.h
+#define _FILE_OFFSET_BITS 64
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <ctype.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <sys/ioctl.h>
+#include <termios.h>
+#include <signal.h>
+
+#include "hexprn.h"
+#include "hexdiff.h"
+#include "hexgrep.h"
+#include "hexemit.h"
+#include "hexpipe.h"
+
+/* размер окна отображения файла в память, уменьшается до кратного числу байт в адресной строке */
+#define HEXPRN_MAP_WINDOW ((off_t) 0x10000000)
+
+/* размер блока чтения для файлов, не отображаемых в память, уменьшается так же */
+#define HEXPRN_READ_BLOCK 0x100000
+
+/* место под управляющие последовательности и строку состояния экрана просмотра */
+#define HEXPRN_PAGER_STATUS 0x100
+
+/* клавиши просмотра, кроме обычных символов */
+enum pager_key_v
+{
+	PAGER_UP = 0x100,
+	PAGER_DOWN,
+	PAGER_PGUP,
+	PAGER_PGDN,
+	PAGER_HOME,
+	PAGER_END
+};
+
+/* параметры программы */
+struct Options
+{
+	struct Trans_Format tf;  // формат преобразования
+	char *insert_str;        // добавочная строка
+	off_t offset;            // смещение начала вывода в файле
+	off_t length;            // число байт для вывода, < 0 - до конца файла
+	char *in_path;           // входной файл, NULL или "-" - стандартный ввод
+	char *out_path;          // выходной файл, NULL - стандартный вывод
+	char *diff_path;         // файл для сравнения, NULL - без сравнения
+	const byte *patterns[HEXGREP_PATTERNS_MAX];  // образцы поиска
+	size_t pattern_lengths[HEXGREP_PATTERNS_MAX];
+	size_t pattern_count;    // число образцов, 0 - без поиска
+	size_t context;          // число строк до и после строк вхождения
+	emit_types emit;         // вид вывода для других программ, < 0 - адресные строки
+	size_t threads;          // число потоков преобразования конвейера, 0 - по числу процессоров
+	int pager;               // != 0 - просмотр в терминале
+};
+
+/* содержимое файла целиком: отображение в память или прочитанный блок */
+struct File_Data
+{
+	byte *data;
+	size_t size;
+	int mapped;  // != 0 - отображение в память, иначе блок из malloc()
+};
+
+/* вывод справки */
+static void usage(FILE *fp)
+{
+	fprintf(fp,
+		"Usage: hexprn [options] [file]\n"
+		"Dump a file (or standard input) in hexadecimal view.\n"
+		"  -s offset  start at byte offset\n"
+		"  -n length  dump at most length bytes\n"
+		"  -o file    write to file instead of standard output\n"
+		"  -A         do not print the address column\n"
+		"  -w digits  address width in hex digits, 1..16 (default 8, wider for large files)\n"
+		"  -l bytes   bytes per line, 1..64 (default 16; with -F hex 30 and -F c 12, like xxd)\n"
+		"  -2         show cells as 8 binary digits instead of 2 hex digits\n"
+		"  -T char    delimiter between the nibbles of a binary cell\n"
+		"  -W size[b] hex cells of 2, 4 or 8 byte words, little-endian or with 'b' big-endian\n"
+		"  -c char    hex cell delimiter\n"
+		"  -B char    hex block delimiter\n"
+		"  -b count   hex block length in cells\n"
+		"  -C char    ascii cell delimiter\n"
+		"  -K char    ascii block delimiter\n"
+		"  -k count   ascii block length in cells\n"
+		"  -e char    hex value of empty cells\n"
+		"  -E char    ascii value of empty cells\n"
+		"  -p char    ascii value of non-printable bytes\n"
+		"  -a charset ascii pane code page: ascii (default), latin1, cp1251, koi8r, cp866, ebcdic;\n"
+		"             all but ascii print UTF-8 and pad lines with spaces to a fixed length\n"
+		"  -R         colour zero, printable, control, high and 0xFF bytes with ANSI escapes\n"
+		"  -r         end lines with \"\\r\\n\"\n"
+		"  -z         squeeze runs of repeated lines into a single '*' line\n"
+		"  -d file2   side-by-side diff of file and file2, exit status 1 if they differ\n"
+		"  -g hex     dump only the lines around matches of a byte pattern given in hex digits;\n"
+		"             may be repeated, exit status 1 if nothing matches; standard input or\n"
+		"             a device is read whole into memory before the search\n"
+		"  -G text    the same for a text pattern\n"
+		"  -x count   lines of context around matches (default 2)\n"
+		"  -F type    emit plain data instead of a dump: hex (continuous digits), c (array\n"
+		"             initialiser, declared like xxd -i for a named file), json (array of numbers)\n"
+		"             or jsonhex (array of hex strings) with lowercase digits; -l sets the bytes\n"
+		"             per output line\n"
+		"  -j count   formatting threads for pipes and devices (default: number of CPUs)\n"
+		"  -P         browse in the terminal: j/k line, space/b page, g/G start/end, q or ^C quit\n"
+		"  -S         print conversion counters and phase timers to standard error on exit\n"
+		"             (the library must be built with -DHEXPRN_STATS)\n"
+		"  -h         show this help\n"
+		"An empty char argument disables the delimiter. Numbers may be decimal or 0x-prefixed.\n");
+}
+
+/* названия кодовых страниц ascii области для параметра -a, по порядку char_set_types */
+static const char *charset_names[CHARSET_COUNT] = { "ascii", "latin1", "cp1251", "koi8r", "cp866", "ebcdic" };
+
+/* названия видов вывода для параметра -F, по порядку emit_types */
+static const char *emit_names[EMIT_COUNT] = { "hex", "c", "json", "jsonhex" };
+
+/* печать счетчиков преобразования при завершении, параметр -S */
+static void print_stats(void)
+{
+	struct Hexprn_Stats st;
+	hexprn_stats(&st);
+	fprint_stats(stderr, &st);
+}
+
+/* разбор числового параметра, возвращает -1 при ошибке */
+static long long parse_number(const char *s)
+{
+	char *end;
+	errno = 0;
+	long long v = strtoll(s, &end, 0);
+	if (errno != 0 || end == s || *end != '\0' || v < 0)
+		return -1;
+	return v;
+}
+
+/* разбор параметров командной строки, возвращает 0 при успехе */
+static int parse_options(int argc, char **argv, struct Options *opt)
+{
+	int c;
+	long long v;
+	char *end;
+
+	opt->tf = ret_default_tf();
+	opt->insert_str = "\n";
+	opt->offset = 0;
+	opt->length = -1;
+	opt->in_path = NULL;
+	opt->out_path = NULL;
+	opt->diff_path = NULL;
+	opt->pattern_count = 0;
+	opt->context = ret_default_gf().context;
+	opt->emit = -1;
+	opt->threads = 0;
+	opt->pager = 0;
+
+	opt->tf.address_digits = 0;
+	opt->tf.line_bytes = 0;  // по умолчанию HEXPRN_LINE_BYTES, у -F hex и -F c - как у xxd
+	while ((c = getopt(argc, argv, "s:n:o:Aw:l:2T:W:c:B:b:C:K:k:e:E:p:a:Rrzd:g:G:x:F:j:PSh")) != -1)
+	{
+		switch (c)
+		{
+		case 's':
+		case 'n':
+		case 'b':
+		case 'k':
+		case 'w':
+		case 'l':
+		case 'x':
+		case 'j':
+			if ((v = parse_number(optarg)) < 0 || (c == 'w' && (v == 0 || v > 16))
+				|| (c == 'l' && (v == 0 || v > HEXPRN_LINE_BYTES_MAX)))
+			{
+				fprintf(stderr, "hexprn: invalid number '%s'\n", optarg);
+				return -1;
+			}
+			if (c == 's')
+				opt->offset = (off_t) v;
+			else if (c == 'n')
+				opt->length = (off_t) v;
+			else if (c == 'b')
+				opt->tf.hex_block_length = (size_t) v;
+			else if (c == 'w')
+				opt->tf.address_digits = (size_t) v;
+			else if (c == 'l')
+				opt->tf.line_bytes = (size_t) v;
+			else if (c == 'j')
+				opt->threads = (size_t) v;
+			else if (c == 'x')
+				opt->context = (size_t) v;
+			else
+				opt->tf.ascii_block_length = (size_t) v;
+			break;
+		case 'W':
+			opt->tf.word_bytes = (size_t) strtoul(optarg, &end, 10);
+			opt->tf.word_endian = *end == 'b' ? BIG_ENDIAN : LITTLE_ENDIAN;
+			if (end == optarg || (*end != '\0' && strcmp(end, "b") != 0 && strcmp(end, "l") != 0))
+			{
+				fprintf(stderr, "hexprn: invalid word size '%s'\n", optarg);
+				return -1;
+			}
+			break;
+		case 'o': opt->out_path = optarg; break;
+		case 'A': opt->tf.prn_address = 0; break;
+		case '2': opt->tf.base = BASE_BIN; break;
+		case 'T': opt->tf.tetra_delimeter = optarg[0]; break;
+		case 'c': opt->tf.hex_char_delimeter = optarg[0]; break;
+		case 'B': opt->tf.hex_block_delimeter = optarg[0]; break;
+		case 'C': opt->tf.ascii_char_delimeter = optarg[0]; break;
+		case 'K': opt->tf.ascii_block_delimeter = optarg[0]; break;
+		case 'e': opt->tf.empty_hex = optarg[0]; break;
+		case 'E': opt->tf.empty_ascii = optarg[0]; break;
+		case 'p': opt->tf.non_print_char = optarg[0]; break;
+		case 'a':
+			for (v = 0; v < CHARSET_COUNT && strcmp(optarg, charset_names[v]) != 0; v++)
+				;
+			if (v == CHARSET_COUNT)
+			{
+				fprintf(stderr, "hexprn: unknown code page '%s'\n", optarg);
+				return -1;
+			}
+			opt->tf.char_set = (char_set_types) v;
+			break;
+		case 'F':
+			for (v = 0; v < EMIT_COUNT && strcmp(optarg, emit_names[v]) != 0; v++)
+				;
+			if (v == EMIT_COUNT)
+			{
+				fprintf(stderr, "hexprn: unknown output type '%s'\n", optarg);
+				return -1;
+			}
+			opt->emit = (emit_types) v;
+			break;
+		case 'R': opt->tf.color = 1; break;
+		case 'r': opt->insert_str = "\r\n"; break;
+		case 'z': opt->tf.squeeze = 1; break;
+		case 'd': opt->diff_path = optarg; break;
+		case 'g':
+		case 'G':
+			if (opt->pattern_count == HEXGREP_PATTERNS_MAX)
+			{
+				fprintf(stderr, "hexprn: too many patterns\n");
+				return -1;
+			}
+			/* цифры заменяются байтами на месте: строка параметра больше не нужна */
+			v = (long long) strlen(optarg);
+			if (v == 0 || (c == 'g' && (v % 2 != 0 || strspn(optarg, "0123456789ABCDEFabcdef") != (size_t) v)))
+			{
+				fprintf(stderr, "hexprn: invalid pattern '%s'\n", optarg);
+				return -1;
+			}
+			if (c == 'g')
+				hex_bytes(optarg, (byte *) optarg, (size_t) v / 2);
+			opt->patterns[opt->pattern_count] = (const byte *) optarg;
+			opt->pattern_lengths[opt->pattern_count++] = (size_t) (c == 'g' ? v / 2 : v);
+			break;
+		case 'P': opt->pager = 1; break;
+		case 'S': atexit(print_stats); break;
+		case 'h': usage(stdout); exit(0);
+		default: usage(stderr); return -1;
+		}
+	}
+	if (optind < argc)
+		opt->in_path = argv[optind++];
+	if (optind < argc)
+	{
+		usage(stderr);
+		return -1;
+	}
+	return 0;
+}
+
+/* Вывод участка байт, адрес - смещение в файле. Состояние сжатия повторов sq переносится
+между участками, more != 0 - за участком будут еще байты. */
+static int dump_part(struct Hexprn_Ctx *ctx, int out_fd, byte *bytes, size_t count, off_t offset,
+	struct Squeeze_State *sq, int more)
+{
+	struct Trans_Result64 tr = stream_hexprnc64_squeeze(hexprn_sink_fd, &out_fd, bytes, count, (qword) offset,
+		hexprn_ctx_format(ctx), hexprn_ctx_insert_str(ctx), sq, more);
+	if (tr.error)
+	{
+		fprintf(stderr, "hexprn: write error: %s\n", strerror(errno));
+		return -1;
+	}
+	return 0;
+}
+
+/* Вывод обычного файла отображением в память окнами по HEXPRN_MAP_WINDOW байт.
+Границы окон кратны числу байт в адресной строке, поэтому строки не разрываются между окнами. */
+static int dump_mapped(struct Hexprn_Ctx *ctx, int in_fd, int out_fd, off_t start, off_t stop)
+{
+	off_t page = (off_t) sysconf(_SC_PAGESIZE);
+	off_t line_bytes = (off_t) hexprn_ctx_format(ctx)->line_bytes;
+	off_t window = HEXPRN_MAP_WINDOW - HEXPRN_MAP_WINDOW % line_bytes;
+	off_t pos = start;
+	off_t part_stop, map_start;
+	size_t map_length;
+	byte *map;
+	struct Squeeze_State sq;
+
+	squeeze_init(&sq, NULL, 0, 0);
+	while (pos < stop)
+	{
+		part_stop = (pos / window + 1) * window;
+		if (part_stop > stop)
+			part_stop = stop;
+		map_start = pos - pos % page;
+		map_length = (size_t) (part_stop - map_start);
+
+		map = (byte *) mmap(NULL, map_length, PROT_READ, MAP_PRIVATE, in_fd, map_start);
+		if (map == MAP_FAILED)
+		{
+			fprintf(stderr, "hexprn: mmap: %s\n", strerror(errno));
+			return -1;
+		}
+		posix_madvise(map, map_length, POSIX_MADV_SEQUENTIAL);
+
+		int r = dump_part(ctx, out_fd, map + (pos - map_start), (size_t) (part_stop - pos), pos, &sq, part_stop < stop);
+		munmap(map, map_length);
+		if (r < 0)
+			return r;
+		pos = part_stop;
+	}
+	return 0;
+}
+
+/* Чтение из in_fd блока до полного заполнения или конца файла, возвращает число байт или -1 */
+static ssize_t read_block(int in_fd, byte *block, size_t size)
+{
+	size_t done = 0;
+	ssize_t r;
+	while (done < size)
+	{
+		r = read(in_fd, block + done, size - done);
+		if (r < 0 && errno == EINTR)
+			continue;
+		if (r < 0)
+			return -1;
+		if (r == 0)
+			break;
+		done += (size_t) r;
+	}
+	return (ssize_t) done;
+}
+
+/* Вывод канала или устройства конвейером: байты до смещения start пропускаются чтением,
+остальные преобразуются hexpipe_fd() в threads потоках, адреса продолжаются между блоками. */
+static int dump_read(struct Hexprn_Ctx *ctx, int in_fd, int out_fd, off_t start, off_t length, size_t threads)
+{
+	size_t line_bytes = hexprn_ctx_format(ctx)->line_bytes;
+	size_t block_size = HEXPRN_READ_BLOCK - HEXPRN_READ_BLOCK % line_bytes;
+	byte *block = (byte *) malloc(block_size);
+	off_t pos = 0;
+	ssize_t r;
+	size_t want;
+
+	if (block == NULL)
+		return -1;
+
+	/* пропуск байт до смещения start */
+	while (pos < start)
+	{
+		want = start - pos < (off_t) block_size ? (size_t) (start - pos) : block_size;
+		if ((r = read_block(in_fd, block, want)) <= 0)
+			break;
+		pos += r;
+	}
+	free(block);
+	if (length >= 0 && pos >= start + length)
+		return 0;
+
+	struct Trans_Result64 tr = hexpipe_fd(in_fd, out_fd, (qword) pos, length < 0 ? QWORD_MAX : (uint64_t) (start + length - pos),
+		hexprn_ctx_format(ctx), hexprn_ctx_insert_str(ctx), threads, block_size);
+	if (tr.error == HEXPIPE_READ)
+		fprintf(stderr, "hexprn: read: %s\n", strerror(errno));
+	else if (tr.error == HEXPIPE_WRITE)
+		fprintf(stderr, "hexprn: write error: %s\n", strerror(errno));
+	else if (tr.error != HEXPIPE_OK)
+		fprintf(stderr, "hexprn: out of memory\n");
+	return tr.error == HEXPIPE_OK ? 0 : -1;
+}
+
+/* Загрузка файла целиком: обычный файл отображается в память, остальное читается */
+static int load_file(int fd, struct File_Data *fdata)
+{
+	struct stat st;
+	size_t capacity = HEXPRN_READ_BLOCK;
+	ssize_t r;
+	byte *p;
+
+	fdata->data = NULL;
+	fdata->size = 0;
+	fdata->mapped = 0;
+	if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0)
+	{
+		p = (byte *) mmap(NULL, (size_t) st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+		if (p == MAP_FAILED)
+			return -1;
+		posix_madvise(p, (size_t) st.st_size, POSIX_MADV_SEQUENTIAL);
+		fdata->data = p;
+		fdata->size = (size_t) st.st_size;
+		fdata->mapped = 1;
+		return 0;
+	}
+
+	fdata->data = (byte *) malloc(capacity);
+	if (fdata->data == NULL)
+		return -1;
+	while ((r = read_block(fd, fdata->data + fdata->size, capacity - fdata->size)) > 0)
+	{
+		fdata->size += (size_t) r;
+		if (fdata->size < capacity)
+			break;
+		p = (byte *) realloc(fdata->data, capacity * 2);
+		if (p == NULL)
+			return -1;
+		fdata->data = p;
+		capacity *= 2;
+	}
+	return r < 0 ? -1 : 0;
+}
+
+/* Вывод -F канала или устройства частями из целых строк: байты до смещения пропускаются чтением,
+блок выводится, когда прочитан следующий (после последней строки нет запятой), поэтому память
+не зависит от длины потока, а текст совпадает с выводом того же файла целиком. */
+static int emit_read(int in_fd, int out_fd, struct Emit_Format *ef, struct Options *opt)
+{
+	size_t block_size = HEXPRN_READ_BLOCK - HEXPRN_READ_BLOCK % ef->line_bytes;
+	byte *blocks[2];
+	uint64_t left = opt->length < 0 ? UINT64_MAX : (uint64_t) opt->length;
+	uint64_t done = 0;
+	off_t pos = 0;
+	ssize_t r = 0, next = 0;
+	size_t want, cur = 0;
+	struct Trans_Result64 tr;
+
+	blocks[0] = (byte *) malloc(block_size);
+	blocks[1] = (byte *) malloc(block_size);
+	if (blocks[0] == NULL || blocks[1] == NULL)
+	{
+		fprintf(stderr, "hexprn: out of memory\n");
+		free(blocks[0]);
+		free(blocks[1]);
+		return -1;
+	}
+	memset(&tr, 0, sizeof(tr));
+
+	/* пропуск байт до смещения */
+	while (pos < opt->offset)
+	{
+		want = opt->offset - pos < (off_t) block_size ? (size_t) (opt->offset - pos) : block_size;
+		if ((r = read_block(in_fd, blocks[0], want)) <= 0)
+			break;
+		pos += r;
+	}
+
+	want = left < block_size ? (size_t) left : block_size;
+	if (r >= 0)
+		r = read_block(in_fd, blocks[cur], want);
+	while (r >= 0)
+	{
+		left -= (uint64_t) r;
+
+		/* чтение следующего блока: неполный блок - конец потока */
+		next = 0;
+		if ((size_t) r == block_size && left != 0)
+		{
+			want = left < block_size ? (size_t) left : block_size;
+			next = read_block(in_fd, blocks[cur ^ 1], want);
+			if (next < 0)
+				break;
+		}
+		tr = stream_hexemit_part(hexprn_sink_fd, &out_fd, blocks[cur], (size_t) r, done, next > 0,
+			ef, opt->insert_str);
+		if (tr.error)
+		{
+			fprintf(stderr, "hexprn: write error: %s\n", strerror(errno));
+			break;
+		}
+		done += (uint64_t) r;
+		if (next == 0)
+			break;
+		cur ^= 1;
+		r = next;
+	}
+	if (r < 0 || next < 0)
+		fprintf(stderr, "hexprn: read: %s\n", strerror(errno));
+	free(blocks[0]);
+	free(blocks[1]);
+	return r < 0 || next < 0 || tr.error ? -1 : 0;
+}
+
+/* освобождение содержимого файла */
+static void free_file(struct File_Data *fdata)
+{
+	if (fdata->mapped)
+		munmap(fdata->data, fdata->size);
+	else
+		free(fdata->data);
+}
+
+/* сигналы просмотра: номер сигнала завершения и признак изменения размера экрана */
+static volatile sig_atomic_t pager_stop = 0;
+static volatile sig_atomic_t pager_resize = 0;
+
+/* Обработчик сигналов просмотра: только отметка, режим терминала восстанавливает цикл просмотра */
+static void pager_signal(int sig)
+{
+	if (sig == SIGWINCH)
+		pager_resize = 1;
+	else
+		pager_stop = sig;
+}
+
+/* Запись n символов s в терминал с повтором после прерывания сигналом, возвращает 0 при успехе */
+static int pager_write(int tty_fd, const char *s, size_t n)
+{
+	ssize_t r;
+	while (n != 0)
+	{
+		r = write(tty_fd, s, n);
+		if (r < 0 && errno == EINTR && !pager_stop)
+			continue;
+		if (r <= 0)
+			return -1;
+		s += r;
+		n -= (size_t) r;
+	}
+	return 0;
+}
+
+/* Размер экрана терминала tty_fd в строках и столбцах */
+static void pager_size(int tty_fd, size_t *rows, size_t *cols)
+{
+	struct winsize ws;
+	*rows = 24;
+	*cols = 80;
+	if (ioctl(tty_fd, TIOCGWINSZ, &ws) == 0 && ws.ws_row > 1 && ws.ws_col > 0)
+	{
+		*rows = ws.ws_row;
+		*cols = ws.ws_col;
+	}
+}
+
+/* Чтение клавиши: символ, pager_key_v, 0 - неизвестная последовательность, -1 - ошибка или конец ввода */
+static int pager_key(int tty_fd)
+{
+	char k[8];
+	ssize_t r = read(tty_fd, k, sizeof(k));
+	if (r < 0 && errno == EINTR)
+		return 0;
+	if (r <= 0)
+		return -1;
+	if (k[0] != '\033')
+		return (unsigned char) k[0];
+	if (r < 3 || (k[1] != '[' && k[1] != 'O'))
+		return 0;
+	switch (k[2])
+	{
+	case 'A': return PAGER_UP;
+	case 'B': return PAGER_DOWN;
+	case '5': return PAGER_PGUP;
+	case '6': return PAGER_PGDN;
+	case 'H': case '1': case '7': return PAGER_HOME;
+	case 'F': case '4': case '8': return PAGER_END;
+	}
+	return 0;
+}
+
+/* Просмотр участка [start, stop) файла в терминале: на каждом шаге преобразуются только
+строки экрана. Файл отображается в память целиком, читаются только страницы видимых строк.
+Клавиши читаются из /dev/tty, туда же выводится экран. SIGINT, SIGQUIT, SIGTERM и SIGHUP завершают
+просмотр с восстановлением режима терминала, после чего сигнал повторяется с прежним
+обработчиком; SIGWINCH перерисовывает экран. Возвращает 0 или -1 при ошибке. */
+static int dump_pager(struct Hexprn_Ctx *ctx, int in_fd, off_t start, off_t length)
+{
+	static const int pager_signals[] = {SIGINT, SIGQUIT, SIGTERM, SIGHUP, SIGWINCH};
+	struct sigaction sa, old_sa[sizeof(pager_signals) / sizeof(pager_signals[0])];
+	struct File_Data fdata;
+	struct termios saved, raw;
+	int tty_fd, key, r = -1, write_error = 0;  // write_error - errno ошибки записи в терминал
+	size_t i;
+
+	if (load_file(in_fd, &fdata) < 0)
+	{
+		fprintf(stderr, "hexprn: read: %s\n", strerror(errno));
+		free_file(&fdata);
+		return -1;
+	}
+	if (fdata.mapped)
+		posix_madvise(fdata.data, fdata.size, POSIX_MADV_RANDOM);
+	tty_fd = open("/dev/tty", O_RDWR);
+	if (tty_fd < 0 || tcgetattr(tty_fd, &saved) < 0)
+	{
+		fprintf(stderr, "hexprn: /dev/tty: %s\n", strerror(errno));
+		if (tty_fd >= 0)
+			close(tty_fd);
+		free_file(&fdata);
+		return -1;
+	}
+	/* обработчики без SA_RESTART: сигнал прерывает ожидание клавиши в read() */
+	memset(&sa, 0, sizeof(sa));
+	sa.sa_handler = pager_signal;
+	sigemptyset(&sa.sa_mask);
+	pager_stop = 0;
+	pager_resize = 0;
+	for (i = 0; i < sizeof(pager_signals) / sizeof(pager_signals[0]); i++)
+		sigaction(pager_signals[i], &sa, &old_sa[i]);
+
+	/* ISIG остается: ^C и ^\ приходят сигналами и завершают просмотр */
+	raw = saved;
+	raw.c_lflag &= ~(ICANON | ECHO);
+	raw.c_cc[VMIN] = 1;
+	raw.c_cc[VTIME] = 0;
+	tcsetattr(tty_fd, TCSAFLUSH, &raw);
+
+	/* участок файла и число его строк */
+	size_t first = (size_t) start < fdata.size ? (size_t) start : fdata.size;
+	size_t count = fdata.size - first;
+	if (length >= 0 && (size_t) length < count)
+		count = (size_t) length;
+	struct Compiled_Format *cf = hexprn_ctx_format(ctx);
+	char *insert_str = hexprn_ctx_insert_str(ctx);
+	size_t single_length = cf->length + (insert_str == NULL ? 0 : strlen(insert_str));
+	uint64_t lines = hex_addr_str64(count, (qword) start, cf->line_bytes);
+	uint64_t top = 0, page;
+
+	char *screen = NULL, *p;
+	size_t screen_size = 0, rows, cols, wrap, need, n;
+	struct Trans_Result64 tr;
+	while (!pager_stop)
+	{
+		/* строк на экране с учетом переноса длинных строк и строки состояния */
+		pager_resize = 0;
+		pager_size(tty_fd, &rows, &cols);
+		wrap = (cf->line_length + cols - 1) / cols;
+		page = (rows - 1) / (wrap != 0 ? wrap : 1);
+		if (page == 0)
+			page = 1;
+		if (top + page > lines)
+			top = lines > page ? lines - page : 0;
+
+		need = (size_t) page * single_length + HEXPRN_PAGER_STATUS;
+		if (need > screen_size)
+		{
+			p = (char *) realloc(screen, need);
+			if (p == NULL)
+			{
+				fprintf(stderr, "hexprn: out of memory\n");
+				break;
+			}
+			screen = p;
+			screen_size = need;
+		}
+
+		/* экран: очистка, видимые строки и строка состояния */
+		n = (size_t) sprintf(screen, "\033[H\033[2J");
+		tr = shexprnc64_lines(screen + n, fdata.data + first, count, (qword) start, cf, insert_str, top, top + page);
+		if (tr.error)
+			break;
+		n += (size_t) tr.char_count;
+		n += (size_t) snprintf(screen + n, screen_size - n,
+			"\033[7m lines %llu-%llu of %llu  j/k line  space/b page  g/G start/end  q quit \033[0m",
+			(unsigned long long) top + 1, (unsigned long long) (top + tr.str_count), (unsigned long long) lines);
+		if (pager_write(tty_fd, screen, n) < 0)
+		{
+			write_error = pager_stop ? 0 : (errno != 0 ? errno : EIO);
+			break;
+		}
+
+		/* изменение размера до чтения клавиши: сразу перерисовка */
+		if (pager_resize)
+			continue;
+		key = pager_key(tty_fd);
+		if (key < 0 || key == 'q' || key == 'Q')
+		{
+			r = 0;
+			break;
+		}
+		switch (key)
+		{
+		case 'j': case '\n': case '\r': case PAGER_DOWN: top++; break;
+		case 'k': case PAGER_UP: top -= top > 0 ? 1 : 0; break;
+		case ' ': case 'f': case PAGER_PGDN: top += page; break;
+		case 'b': case PAGER_PGUP: top -= top > page ? page : top; break;
+		case 'g': case PAGER_HOME: top = 0; break;
+		case 'G': case PAGER_END: top = lines; break;
+		}
+	}
+
+	/* восстановление режима терминала при любом выходе из цикла, в том числе по сигналу
+	и после ошибки записи в закрытый терминал */
+	tcsetattr(tty_fd, TCSAFLUSH, &saved);
+	if (write_error == 0 && pager_write(tty_fd, "\n", 1) < 0)
+		write_error = pager_stop ? 0 : (errno != 0 ? errno : EIO);
+	if (write_error != 0)
+	{
+		fprintf(stderr, "hexprn: /dev/tty: %s\n", strerror(write_error));
+		r = -1;
+	}
+	if (pager_stop)
+		r = 0;
+	close(tty_fd);
+	free(screen);
+	free_file(&fdata);
+	for (i = 0; i < sizeof(pager_signals) / sizeof(pager_signals[0]); i++)
+		sigaction(pager_signals[i], &old_sa[i], NULL);
+
+	/* завершение по сигналу с прежним обработчиком, код возврата - как у прерванной программы */
+	if (pager_stop)
+		raise(pager_stop);
+	return r;
+}
+
+/* Сравнение файлов in_fd и opt->diff_path с одинаковыми смещением и длиной.
+Возвращает 0, если участки совпадают, 1 - если отличаются, -1 при ошибке. */
+static int dump_diff(struct Hexprn_Ctx *ctx, int in_fd, int out_fd, struct Options *opt)
+{
+	struct File_Data fa, fb;
+	int diff_fd, r = -1;
+
+	diff_fd = open(opt->diff_path, O_RDONLY);
+	if (diff_fd < 0)
+	{
+		fprintf(stderr, "hexprn: %s: %s\n", opt->diff_path, strerror(errno));
+		return -1;
+	}
+	if (load_file(in_fd, &fa) < 0)
+	{
+		fprintf(stderr, "hexprn: read: %s\n", strerror(errno));
+		free_file(&fa);
+		close(diff_fd);
+		return -1;
+	}
+	if (load_file(diff_fd, &fb) < 0)
+	{
+		fprintf(stderr, "hexprn: %s: %s\n", opt->diff_path, strerror(errno));
+		free_file(&fa);
+		free_file(&fb);
+		close(diff_fd);
+		return -1;
+	}
+
+	/* участки файлов по смещению и длине */
+	size_t start = (size_t) opt->offset;
+	size_t ca = start < fa.size ? fa.size - start : 0;
+	size_t cb = start < fb.size ? fb.size - start : 0;
+	if (opt->length >= 0 && (size_t) opt->length < ca)
+		ca = (size_t) opt->length;
+	if (opt->length >= 0 && (size_t) opt->length < cb)
+		cb = (size_t) opt->length;
+
+	struct Diff_Result dr = stream_hexdiffc(hexprn_sink_fd, &out_fd, fa.data + (ca ? start : 0), ca, (qword) start,
+		fb.data + (cb ? start : 0), cb, (qword) start, hexprn_ctx_format(ctx), hexprn_ctx_insert_str(ctx), NULL);
+	if (dr.error)
+		fprintf(stderr, "hexprn: write error: %s\n", strerror(errno));
+	else
+		r = dr.str_count != 0 ? 1 : 0;
+
+	free_file(&fa);
+	free_file(&fb);
+	close(diff_fd);
+	return r;
+}
+
+/* Вывод участка файла in_fd по смещению и длине для других программ.
+Имя массива C строится из имени файла, как у xxd -i: символы, кроме букв и цифр, заменяются '_'. */
+static int dump_emit(int in_fd, int out_fd, struct Options *opt)
+{
+	struct stat st;
+	struct File_Data fdata;
+	struct Emit_Format ef = ret_default_ef();
+	char name[HEXEMIT_NAME_MAX + 1];
+	const char *path;
+	size_t k;
+	int r = 0;
+
+	ef.type = opt->emit;
+	ef.line_bytes = opt->tf.line_bytes;
+	if (ef.line_bytes == 0)
+		ef.line_bytes = ef.type == EMIT_HEX ? HEXEMIT_HEX_LINE_BYTES :
+			(ef.type == EMIT_C ? HEXEMIT_C_LINE_BYTES : HEXPRN_LINE_BYTES);
+	ef.lower = 1;  // как у xxd -i и xxd -p
+	if (ef.type == EMIT_C && opt->in_path != NULL && strcmp(opt->in_path, "-") != 0)
+	{
+		path = opt->in_path;
+		k = 0;
+		if (*path >= '0' && *path <= '9')
+		{
+			name[k++] = '_';
+			name[k++] = '_';
+		}
+		for (; *path != '\0' && k < HEXEMIT_NAME_MAX; path++)
+			name[k++] = isalnum((unsigned char) *path) ? *path : '_';
+		name[k] = '\0';
+		ef.name = name;
+	}
+
+	if (fstat(in_fd, &st) < 0 || !S_ISREG(st.st_mode))
+		return emit_read(in_fd, out_fd, &ef, opt);
+
+	if (load_file(in_fd, &fdata) < 0)
+	{
+		fprintf(stderr, "hexprn: read: %s\n", strerror(errno));
+		free_file(&fdata);
+		return -1;
+	}
+	size_t start = (size_t) opt->offset;
+	size_t count = start < fdata.size ? fdata.size - start : 0;
+	if (opt->length >= 0 && (size_t) opt->length < count)
+		count = (size_t) opt->length;
+
+	struct Trans_Result64 tr = stream_hexemit(hexprn_sink_fd, &out_fd, fdata.data + (count ? start : 0), count,
+		&ef, opt->insert_str);
+	if (tr.error)
+	{
+		fprintf(stderr, "hexprn: write error: %s\n", strerror(errno));
+		r = -1;
+	}
+	free_file(&fdata);
+	return r;
+}
+
+/* Поиск образцов в участке файла in_fd по смещению и длине.
+Возвращает 0, если найдено хотя бы одно вхождение, 1 - если вхождений нет, -1 при ошибке. */
+static int dump_grep(struct Hexprn_Ctx *ctx, int in_fd, int out_fd, struct Options *opt)
+{
+	struct File_Data fdata;
+	struct Grep_Format gf = ret_default_gf();
+	struct Hexgrep *g;
+	int r = -1;
+
+	g = hexgrep_create(opt->patterns, opt->pattern_lengths, opt->pattern_count);
+	if (g == NULL)
+	{
+		fprintf(stderr, "hexprn: invalid patterns\n");
+		return -1;
+	}
+	if (load_file(in_fd, &fdata) < 0)
+	{
+		fprintf(stderr, "hexprn: read: %s\n", strerror(errno));
+		free_file(&fdata);
+		hexgrep_destroy(g);
+		return -1;
+	}
+
+	/* Канал или устройство читается целиком: окна с контекстом могут начинаться до блока,
+	где найдено вхождение, а stream_hexgrepc() просматривает один массив */
+
+	/* участок файла по смещению и длине */
+	size_t start = (size_t) opt->offset;
+	size_t count = start < fdata.size ? fdata.size - start : 0;
+	if (opt->length >= 0 && (size_t) opt->length < count)
+		count = (size_t) opt->length;
+
+	gf.context = opt->context;
+	struct Grep_Result gr = stream_hexgrepc(hexprn_sink_fd, &out_fd, fdata.data + (count ? start : 0), count,
+		(qword) start, g, hexprn_ctx_format(ctx), hexprn_ctx_insert_str(ctx), &gf);
+	if (gr.error)
+		fprintf(stderr, "hexprn: write error: %s\n", strerror(errno));
+	else
+		r = gr.match_count != 0 ? 0 : 1;
+
+	free_file(&fdata);
+	hexgrep_destroy(g);
+	return r;
+}
+
+int main(int argc, char **argv)
+{
+	struct Options opt;
+	struct stat st;
+	int in_fd = STDIN_FILENO, out_fd = STDOUT_FILENO;
+	int r;
+
+	if (parse_options(argc, argv, &opt) < 0)
+		return 2;
+
+	/* открытие файлов */
+	if (opt.in_path != NULL && strcmp(opt.in_path, "-") != 0)
+	{
+		in_fd = open(opt.in_path, O_RDONLY);
+		if (in_fd < 0)
+		{
+			fprintf(stderr, "hexprn: %s: %s\n", opt.in_path, strerror(errno));
+			return 1;
+		}
+	}
+	if (opt.out_path != NULL)
+	{
+		out_fd = open(opt.out_path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+		if (out_fd < 0)
+		{
+			fprintf(stderr, "hexprn: %s: %s\n", opt.out_path, strerror(errno));
+			return 1;
+		}
+	}
+
+	/* вывод для других программ не использует формат адресных строк */
+	if (opt.emit >= 0)
+	{
+		r = dump_emit(in_fd, out_fd, &opt);
+		if (in_fd != STDIN_FILENO)
+			close(in_fd);
+		if (out_fd != STDOUT_FILENO && close(out_fd) < 0)
+			r = -1;
+		return r < 0 ? 1 : 0;
+	}
+
+	/* ширина адреса по наибольшему адресу обычного файла, если не задана */
+	int regular = fstat(in_fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0;
+	if (opt.tf.address_digits == 0)
+	{
+		opt.tf.address_digits = 8;
+		if (regular)
+			while (opt.tf.address_digits < 16 && ((qword) st.st_size - 1) >> (opt.tf.address_digits * 4) != 0)
+				opt.tf.address_digits += 4;
+	}
+
+	struct Hexprn_Ctx *ctx = hexprn_ctx_create(&opt.tf, opt.insert_str);
+	if (ctx == NULL)
+	{
+		fprintf(stderr, "hexprn: invalid format\n");
+		return 2;
+	}
+
+	/* сравнение файлов: 0 - совпадают, 1 - отличаются, 2 - ошибка */
+	if (opt.diff_path != NULL)
+	{
+		r = dump_diff(ctx, in_fd, out_fd, &opt);
+		hexprn_ctx_destroy(ctx);
+		if (in_fd != STDIN_FILENO)
+			close(in_fd);
+		if (out_fd != STDOUT_FILENO && close(out_fd) < 0)
+			r = -1;
+		return r < 0 ? 2 : r;
+	}
+
+	/* поиск образцов: 0 - найдены, 1 - не найдены, 2 - ошибка */
+	if (opt.pattern_count != 0)
+	{
+		r = dump_grep(ctx, in_fd, out_fd, &opt);
+		hexprn_ctx_destroy(ctx);
+		if (in_fd != STDIN_FILENO)
+			close(in_fd);
+		if (out_fd != STDOUT_FILENO && close(out_fd) < 0)
+			r = -1;
+		return r < 0 ? 2 : r;
+	}
+
+	/* просмотр в терминале, без сжатия повторов: номера строк постоянны */
+	if (opt.pager)
+		r = dump_pager(ctx, in_fd, opt.offset, opt.length);
+	/* обычный файл отображается в память, остальное читается */
+	else if (regular)
+	{
+		off_t stop = st.st_size;
+		if (opt.length >= 0 && opt.offset + opt.length < stop)
+			stop = opt.offset + opt.length;
+		r = opt.offset < stop ? dump_mapped(ctx, in_fd, out_fd, opt.offset, stop) : 0;
+	}
+	else
+		r = dump_read(ctx, in_fd, out_fd, opt.offset, opt.length, opt.threads);
+
+	hexprn_ctx_destroy(ctx);
+	if (in_fd != STDIN_FILENO)
+		close(in_fd);
+	if (out_fd != STDOUT_FILENO && close(out_fd) < 0)
+		r = -1;
+	return r < 0 ? 1 : 0;
+}
@@ -0,0 +1,968 @@
+/*
+	hexprn_test.c
+	Программа hexprn_test: псевдослучайная проверка путей преобразования по однопоточному shexprnc64()
+
+В каждой итерации выбираются случайный формат (длина строки, вид ячеек, разделители, адрес,
+сжатие повторов, добавочная строка) и случайные данные с сериями повторяющихся строк. Проверяются:
+	hexpipe - вывод конвейера hexpipe_fd() из канала совпадает с shexprnc64() для всего потока,
+	          в том числе когда ввод кончается ровно на границе блока повторяющимися строками;
+	parse   - текст shexprnc64(), в том числе сжатый и без добавочной строки, разбирается
+	          shexparsec() обратно в исходные байты и адрес;
+	diff    - сравнение stream_hexdiffc() массива с его копией после вставок, удалений и замен байт,
+	          в том числе с sync_range SIZE_MAX и 2^44, завершается без ошибки и учитывает все байты;
+	grep    - поиск stream_hexgrepc() одного образца (bytes_find()) и нескольких (автомат) совпадает
+	          с прямым перебором: перекрывающиеся вхождения и вхождения через границу строки,
+	          отмеченные ячейки, окна с контекстом и разделители;
+	emit    - вывод stream_hexemit_part() частями из целых строк совпадает посимвольно с текстом
+	          xxd -p и xxd -i (с объявлением и строкой _len), в том числе для пустого массива;
+	pool    - многопоточное shexprnc_mt64() на нескольких потоках пула (не менее 2 * HEXPOOL_MIN_LINES
+	          строк) совпадает с shexprnc64(), before_tr больше массива отклоняется;
+	kernels - ядра elements (bytes_hex, bytes_bin, hex_bytes, bytes_swap, bytes_print, bytes_mismatch,
+	          bytes_find, bytes_find_any) на каждом доступном уровне simd_set_level() дают тот же
+	          результат, что и скалярное ядро, на невыровненных массивах с хвостами любой длины.
+Ошибки выводятся в stderr с номером итерации и зерном, программа возвращает 1.
+Ошибка повторяется запуском с зерном итерации: hexprn_test -s зерно -n 1.
+*/
+#define _POSIX_C_SOURCE 200809L  // pthread, pipe() и т.п.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <signal.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include "hexprn.h"
+#include "hexparse.h"
+#include "hexdiff.h"
+#include "hexgrep.h"
+#include "hexemit.h"
+#include "hexpipe.h"
+#include "hexpool.h"
+
+/* наибольший размер данных одной проверки, байт */
+#define TEST_SIZE_MAX 0x8000
+
+/* наибольшее число правок копии массива при проверке сравнения */
+#define TEST_EDITS_MAX 4
+
+/* наибольшее число и длина образцов поиска: длинный образец переходит через две строки */
+#define TEST_GREP_PATTERNS 5
+#define TEST_GREP_PATTERN_MAX (2 * HEXPRN_LINE_BYTES_MAX + 2)
+
+/* потоки пула и наибольший размер данных многопоточного преобразования:
+до 4 * HEXPOOL_MIN_LINES строк, чтобы преобразование делилось между потоками */
+#define TEST_POOL_THREADS 4
+#define TEST_POOL_SIZE (4 * HEXPOOL_MIN_LINES * HEXPRN_LINE_BYTES_MAX)
+
+/* наибольшая длина массива проверки ядер: несколько проходов AVX2 и хвост */
+#define TEST_KERNEL_MAX 0x200
+
+/* число размеров слова bytes_swap(): 1, 2, 4 и 8 байт */
+#define TEST_SWAP_SIZES 4
+
+/* параметры программы */
+struct Test_Options
+{
+	unsigned long iterations;  // число итераций
+	unsigned long long seed;   // зерно псевдослучайной последовательности
+	int verbose;               // != 0 - выводить формат каждой итерации
+};
+
+/* состояние проверки */
+struct Test_Ctx
+{
+	unsigned long long x;     // состояние генератора xorshift
+	unsigned long iteration;  // номер текущей итерации
+	unsigned long long seed;  // зерно текущей итерации
+	unsigned long checks;     // выполнено проверок
+	unsigned long failures;   // из них с ошибкой
+	byte *a;                  // данные проверки
+	byte *b;                  // копия данных после правок, разобранные байты
+	byte *big;                // данные многопоточного преобразования, TEST_POOL_SIZE байт
+	struct Hexprn_Pool *pool; // пул из TEST_POOL_THREADS потоков
+	int verbose;
+};
+
+/* запись данных в канал частями случайной длины из отдельного потока */
+struct Test_Feed
+{
+	int fd;
+	const byte *bytes;
+	size_t count;
+	unsigned long long x;  // собственное состояние генератора: длины частей
+};
+
+/* результаты ядер elements на одном уровне векторных расширений */
+struct Test_Kernels
+{
+	char hex[2][TEST_KERNEL_MAX * BYTE_SIZE_IN_TETRAS];  // bytes_hex() в обоих порядках тетрад
+	char bin[2][TEST_KERNEL_MAX * BYTE_SIZE_IN_BITS];    // bytes_bin() в обоих порядках разрядов
+	byte unhex[TEST_KERNEL_MAX];                         // hex_bytes()
+	byte swap[TEST_SWAP_SIZES][TEST_KERNEL_MAX];         // bytes_swap() по размерам слова
+	char print[TEST_KERNEL_MAX];                         // bytes_print()
+	int hex_r[2], bin_r[2], unhex_r, swap_r[TEST_SWAP_SIZES], print_r;
+	size_t mismatch, find, find_any;
+};
+
+/* входные данные проверки ядер */
+struct Test_Kernel_In
+{
+	const byte *bytes;           // невыровненный массив
+	size_t count;
+	byte other[TEST_KERNEL_MAX]; // копия с одним измененным байтом или без изменений
+	char digits[TEST_KERNEL_MAX * BYTE_SIZE_IN_TETRAS];  // цифры в разном регистре, возможно с ошибкой
+	byte needle[0x10];
+	size_t needle_length;
+	byte set[BYTES_SET_MAX];
+	size_t set_count;
+};
+
+/* вывод сравнения: подсчет символов и строк */
+struct Test_Count
+{
+	uint64_t chars;
+	uint64_t lines;
+};
+
+/* вывод в память */
+struct Test_Buf
+{
+	char *s;
+	size_t used;
+	size_t size;
+};
+
+/* псевдослучайное число xorshift */
+static unsigned long long test_rand(unsigned long long *x)
+{
+	*x ^= *x << 13; *x ^= *x >> 7; *x ^= *x << 17;
+	return *x;
+}
+
+/* псевдослучайное число из [0, n) */
+static size_t test_below(struct Test_Ctx *t, size_t n)
+{
+	return n == 0 ? 0 : (size_t) (test_rand(&t->x) % n);
+}
+
+/* сообщение об ошибке проверки */
+static void test_fail(struct Test_Ctx *t, const char *check, const char *what)
+{
+	t->failures++;
+	fprintf(stderr, "hexprn_test: iteration %lu, seed %llu: %s: %s\n", t->iteration, t->seed, check, what);
+}
+
+/* Случайный формат: parse != 0 - формат, текст которого разбирается shexparsec().
+Возвращает cf или NULL, если формат не компилируется. */
+static struct Compiled_Format *test_format(struct Test_Ctx *t, struct Compiled_Format *cf, int parse)
+{
+	static const size_t line_bytes[] = { 1, 3, 8, 16, 16, 24, 32, 64 };
+	static const size_t word_bytes[] = { 1, 1, 1, 2, 4, 8 };
+	struct Trans_Format tf = ret_default_tf();
+
+	tf.line_bytes = test_below(t, 4) == 0 ? 1 + test_below(t, HEXPRN_LINE_BYTES_MAX) :
+		line_bytes[test_below(t, sizeof(line_bytes) / sizeof(line_bytes[0]))];
+	tf.word_bytes = word_bytes[test_below(t, sizeof(word_bytes) / sizeof(word_bytes[0]))];
+	if (tf.line_bytes % tf.word_bytes != 0)
+		tf.word_bytes = 1;
+	tf.word_endian = test_below(t, 2) ? LITTLE_ENDIAN : BIG_ENDIAN;
+	tf.base = test_below(t, 4) == 0 ? BASE_BIN : BASE_HEX;
+	tf.tetra_delimeter = test_below(t, 2) ? '_' : '\0';
+	tf.hex_char_delimeter = test_below(t, 4) == 0 ? '\0' : ' ';
+	tf.hex_block_length = test_below(t, 2) ? 4 : 0;
+	tf.ascii_block_length = test_below(t, 2) ? 8 : 0;
+	tf.prn_address = test_below(t, 4) != 0;
+	tf.squeeze = test_below(t, 2);
+	if (parse && !tf.prn_address)
+		tf.squeeze = 0;  // маркер сжатия разбирается только в формате с адресом
+	return compile_tf(cf, &tf);
+}
+
+/* случайная добавочная строка, в том числе без неё */
+static char *test_insert(struct Test_Ctx *t)
+{
+	static char *inserts[] = { "\n", "\n", "\r\n", NULL };
+	return inserts[test_below(t, sizeof(inserts) / sizeof(inserts[0]))];
+}
+
+/* Случайные данные: случайные байты, нули, байт-заполнитель и повторы предыдущей строки */
+static void test_data(struct Test_Ctx *t, byte *bytes, size_t count, size_t line_bytes)
+{
+	size_t pos = 0, len, j;
+	byte v;
+	while (pos < count)
+	{
+		len = 1 + test_below(t, 4 * line_bytes);
+		if (len > count - pos)
+			len = count - pos;
+		switch (test_below(t, 4))
+		{
+		case 0:
+			for (j = 0; j < len; j++)
+				bytes[pos + j] = (byte) test_rand(&t->x);
+			break;
+		case 1:
+			memset(bytes + pos, 0, len);
+			break;
+		case 2:
+			v = (byte) test_rand(&t->x);
+			memset(bytes + pos, v, len);
+			break;
+		default:
+			/* повтор строки: серия строк, совпадающих с предыдущей */
+			for (j = 0; j < len; j++)
+				bytes[pos + j] = pos + j >= line_bytes ? bytes[pos + j - line_bytes] : 0;
+			break;
+		}
+		pos += len;
+	}
+}
+
+/* Эталон: однопоточное преобразование всего массива shexprnc64().
+Возвращает текст (освобождается free()) и его длину в length или NULL при ошибке. */
+static char *test_reference(byte *bytes, size_t count, qword address, struct Compiled_Format *cf,
+	char *insert_str, size_t *length)
+{
+	struct Trans_Result64 tr;
+	char *s;
+
+	*length = 0;
+	if (count == 0)
+		return (char *) calloc(1, 1);
+	tr = calc_tr_result64(count, address, &cf->tf, insert_str);
+	if (tr.error || (s = (char *) malloc((size_t) tr.char_count + 1)) == NULL)
+		return NULL;
+	tr = shexprnc64(s, bytes, count, address, cf, insert_str, tr);
+	if (tr.error)
+	{
+		free(s);
+		return NULL;
+	}
+	*length = (size_t) tr.char_count;
+	return s;
+}
+
+/* поток записи данных в канал частями случайной длины */
+static void *test_feed(void *arg)
+{
+	struct Test_Feed *feed = (struct Test_Feed *) arg;
+	size_t done = 0, part;
+	ssize_t w;
+	while (done < feed->count)
+	{
+		part = 1 + (size_t) (test_rand(&feed->x) % 0x3000);
+		if (part > feed->count - done)
+			part = feed->count - done;
+		w = write(feed->fd, feed->bytes + done, part);
+		if (w <= 0)
+			break;
+		done += (size_t) w;
+	}
+	close(feed->fd);
+	return NULL;
+}
+
+/* Конвейер hexpipe_fd(): ввод из канала, вывод во временный файл, сравнение с эталоном */
+static void test_pipe(struct Test_Ctx *t)
+{
+	struct Compiled_Format cf;
+	struct Trans_Result64 tr;
+	struct Test_Feed feed;
+	pthread_t feeder;
+	size_t count, length, out_length, block_size, j;
+	char *ref, *out;
+	FILE *fp;
+	int fds[2];
+
+	if (test_format(t, &cf, 0) == NULL)
+		return;
+	char *insert_str = test_insert(t);
+	size_t line_bytes = cf.line_bytes;
+	qword address = test_below(t, 4) == 0 ? 0 : (qword) test_rand(&t->x) % 0x100000;
+	size_t formatter_count = 1 + test_below(t, 4);
+
+	/* малые блоки: границы блоков встречаются часто */
+	block_size = line_bytes * (1 + test_below(t, 16));
+	if (test_below(t, 2))
+	{
+		/* ввод кончается ровно на границе блока, первый блок короче на смещение адреса в строке */
+		count = block_size * (1 + test_below(t, TEST_SIZE_MAX / block_size)) - (size_t) (address % line_bytes);
+		if (count > TEST_SIZE_MAX)
+			count = TEST_SIZE_MAX;
+	}
+	else
+		count = test_below(t, TEST_SIZE_MAX + 1);
+	test_data(t, t->a, count, line_bytes);
+
+	/* последние строки ввода - повторы предыдущей */
+	if (test_below(t, 2) && count >= 3 * line_bytes)
+		for (j = count - 2 * line_bytes; j < count; j++)
+			t->a[j] = t->a[j - line_bytes];
+
+	if (t->verbose)
+		fprintf(stderr, "hexpipe: %zu bytes, line %zu, block %zu, squeeze %d, threads %zu\n",
+			count, line_bytes, block_size, cf.tf.squeeze, formatter_count);
+
+	t->checks++;
+	ref = test_reference(t->a, count, address, &cf, insert_str, &length);
+	if (ref == NULL)
+	{
+		test_fail(t, "hexpipe", "reference conversion failed");
+		return;
+	}
+	if (pipe(fds) != 0 || (fp = tmpfile()) == NULL)
+	{
+		test_fail(t, "hexpipe", "cannot create pipe or temporary file");
+		free(ref);
+		return;
+	}
+	feed.fd = fds[1];
+	feed.bytes = t->a;
+	feed.count = count;
+	feed.x = t->x | 1;
+	if (pthread_create(&feeder, NULL, test_feed, &feed) != 0)
+	{
+		test_fail(t, "hexpipe", "cannot create thread");
+		close(fds[0]);
+		close(fds[1]);
+		fclose(fp);
+		free(ref);
+		return;
+	}
+	tr = hexpipe_fd(fds[0], fileno(fp), address, QWORD_MAX, &cf, insert_str, formatter_count, block_size);
+	pthread_join(feeder, NULL);
+	close(fds[0]);
+
+	fseek(fp, 0, SEEK_END);
+	out_length = (size_t) ftell(fp);
+	rewind(fp);
+	out = (char *) malloc(out_length + 1);
+	if (out == NULL || fread(out, 1, out_length, fp) != out_length)
+		test_fail(t, "hexpipe", "cannot read output");
+	else if (tr.error)
+		test_fail(t, "hexpipe", "conversion error");
+	else if (out_length != length || tr.char_count != length)
+		test_fail(t, "hexpipe", "output length differs from shexprnc64()");
+	else if (memcmp(out, ref, length) != 0)
+		test_fail(t, "hexpipe", "output differs from shexprnc64()");
+	free(out);
+	fclose(fp);
+	free(ref);
+}
+
+/* Разбор shexparsec() текста shexprnc64() обратно в байты */
+static void test_parse(struct Test_Ctx *t)
+{
+	struct Compiled_Format cf;
+	struct Parse_Result pr;
+	size_t count, length;
+	char *ref;
+
+	if (test_format(t, &cf, 1) == NULL)
+		return;
+	char *insert_str = test_insert(t);
+	qword address = test_below(t, 4) == 0 ? 0 : (qword) test_rand(&t->x) % 0x10000;
+	count = 1 + test_below(t, TEST_SIZE_MAX);
+	test_data(t, t->a, count, cf.line_bytes);
+
+	if (t->verbose)
+		fprintf(stderr, "parse: %zu bytes, line %zu, squeeze %d, insert %s\n",
+			count, cf.line_bytes, cf.tf.squeeze, insert_str == NULL ? "no" : "yes");
+
+	t->checks++;
+	ref = test_reference(t->a, count, address, &cf, insert_str, &length);
+	if (ref == NULL)
+	{
+		test_fail(t, "parse", "reference conversion failed");
+		return;
+	}
+	pr = shexparsec(t->b, count, ref, length, &cf, insert_str);
+	if (pr.error)
+		test_fail(t, "parse", hexparse_error_name(pr.error));
+	else if (pr.byte_count != count || memcmp(t->a, t->b, count) != 0)
+		test_fail(t, "parse", "bytes differ from the source");
+	else if (cf.tf.prn_address && pr.address_start != address)
+		test_fail(t, "parse", "address differs from the source");
+	free(ref);
+}
+
+/* функция записи сравнения: подсчет символов */
+static size_t test_count_sink(void *sink_arg, const char *s, size_t n)
+{
+	struct Test_Count *c = (struct Test_Count *) sink_arg;
+	size_t j;
+	c->chars += n;
+	for (j = 0; j < n; j++)
+		c->lines += s[j] == '\n';
+	return n;
+}
+
+/* Сравнение stream_hexdiffc() массива с копией после вставок, удалений и замен байт */
+static void test_diff(struct Test_Ctx *t)
+{
+	static const size_t sync_lengths[] = { 0, 4, 0x10 };
+	static const size_t sync_ranges[] = { SIZE_MAX, SIZE_MAX - 1, SIZE_MAX >> 20, 0x1000, 0x40, 1, 0 };  // SIZE_MAX >> 20 - 2^44 - 1
+	struct Compiled_Format cf;
+	struct Diff_Format df = ret_default_df();
+	struct Diff_Result dr;
+	struct Test_Count c;
+	size_t count, b_count, edits, pos, len, j;
+
+	if (test_format(t, &cf, 0) == NULL)
+		return;
+	char *insert_str = test_below(t, 4) == 0 ? NULL : "\n";
+	df.sync_length = sync_lengths[test_below(t, sizeof(sync_lengths) / sizeof(sync_lengths[0]))];
+	df.sync_range = sync_ranges[test_below(t, sizeof(sync_ranges) / sizeof(sync_ranges[0]))];
+	count = test_below(t, TEST_SIZE_MAX / 2 + 1);
+	test_data(t, t->a, count, cf.line_bytes);
+
+	/* правки копии: замена, вставка или удаление до двух строк байт */
+	memcpy(t->b, t->a, count);
+	b_count = count;
+	edits = test_below(t, TEST_EDITS_MAX + 1);
+	for (j = 0; j < edits; j++)
+	{
+		pos = test_below(t, b_count + 1);
+		len = 1 + test_below(t, 2 * cf.line_bytes);
+		switch (test_below(t, 3))
+		{
+		case 0:
+			for (; len != 0 && pos < b_count; len--, pos++)
+				t->b[pos] ^= (byte) (1 + test_below(t, 0xFF));
+			break;
+		case 1:
+			memmove(t->b + pos + len, t->b + pos, b_count - pos);
+			for (b_count += len; len != 0; len--, pos++)
+				t->b[pos] = (byte) test_rand(&t->x);
+			break;
+		default:
+			if (len > b_count - pos)
+				len = b_count - pos;
+			memmove(t->b + pos, t->b + pos + len, b_count - pos - len);
+			b_count -= len;
+			break;
+		}
+	}
+
+	if (t->verbose)
+		fprintf(stderr, "diff: %zu and %zu bytes, line %zu, edits %zu, sync %zu, range %zu\n",
+			count, b_count, cf.line_bytes, edits, df.sync_length, df.sync_range);
+
+	t->checks++;
+	memset(&c, 0, sizeof(c));
+	dr = stream_hexdiffc(test_count_sink, &c, t->a, count, 0, t->b, b_count, 0, &cf, insert_str, &df);
+	if (dr.error)
+		test_fail(t, "diff", "comparison error");
+	else if (dr.same_count + dr.diff_count_a != count || dr.same_count + dr.diff_count_b != b_count)
+		test_fail(t, "diff", "bytes are lost or counted twice");
+	else if (dr.char_count != c.chars || (insert_str != NULL && dr.str_count != c.lines))
+		test_fail(t, "diff", "result differs from the output");
+	else if (count == b_count && memcmp(t->a, t->b, count) == 0 && dr.str_count != 0)
+		test_fail(t, "diff", "equal arrays have differing lines");
+}
+
+/* функция записи в память */
+static size_t test_buf_sink(void *sink_arg, const char *s, size_t n)
+{
+	struct Test_Buf *b = (struct Test_Buf *) sink_arg;
+	char *p;
+	if (n == 0)
+		return 0;
+	if (b->used + n > b->size)
+	{
+		p = (char *) realloc(b->s, 2 * (b->used + n));
+		if (p == NULL)
+			return 0;
+		b->s = p;
+		b->size = 2 * (b->used + n);
+	}
+	memcpy(b->s + b->used, s, n);
+	b->used += n;
+	return n;
+}
+
+/* Случайные образцы из четырех букв, чтобы вхождения разных образцов перекрывались.
+Одинаковые образцы отбрасываются: вхождения считаются по образцам. Возвращает число образцов. */
+static size_t test_patterns(struct Test_Ctx *t, byte patterns[][TEST_GREP_PATTERN_MAX], size_t *lengths,
+	size_t count)
+{
+	size_t i, j, k;
+	for (i = 0; i < count; i++)
+	{
+		lengths[i] = 1 + test_below(t, test_below(t, 4) == 0 ? TEST_GREP_PATTERN_MAX : 6);
+		for (j = 0; j < lengths[i]; j++)
+			patterns[i][j] = (byte) ('A' + test_below(t, 4));
+		for (k = 0; k < i; k++)
+			if (lengths[k] == lengths[i] && memcmp(patterns[k], patterns[i], lengths[i]) == 0)
+				break;
+		if (k < i)
+		{
+			count--;
+			i--;
+		}
+	}
+	return count;
+}
+
+/* Поиск stream_hexgrepc(): эталон - прямой перебор вхождений всех образцов во всех позициях
+и адресные строки shexprnc64_lines() с отметками sprn_mark() */
+static void test_grep(struct Test_Ctx *t)
+{
+	struct Compiled_Format cf;
+	struct Grep_Format gf = ret_default_gf();
+	struct Grep_Result gr;
+	struct Hexgrep *g;
+	struct Test_Buf out, ref;
+	byte patterns[TEST_GREP_PATTERNS][TEST_GREP_PATTERN_MAX];
+	const byte *pattern_ptrs[TEST_GREP_PATTERNS];
+	size_t lengths[TEST_GREP_PATTERNS];
+	size_t pattern_count, count, pos, len, lo, hi, b, i, n;
+	uint64_t matches = 0, windows = 0, shown = 0, lines, line, shown_end = 0, m;
+	char *hit, *row;
+
+	if (test_format(t, &cf, 0) == NULL)
+		return;
+	char *insert_str = test_insert(t);
+	size_t add_length = insert_str == NULL ? 0 : strlen(insert_str);
+	size_t lb = cf.line_bytes;
+	qword address = test_below(t, 4) == 0 ? 0 : (qword) test_rand(&t->x) % 0x100000;
+	size_t offset = (size_t) (address % lb);
+	gf.context = test_below(t, 4);
+	gf.separator = test_below(t, 4) == 0 ? NULL : "--";
+
+	/* половина проверок - один образец (bytes_find()), остальные - автомат */
+	pattern_count = test_patterns(t, patterns, lengths, test_below(t, 2) ? 1 : 2 + test_below(t, TEST_GREP_PATTERNS - 1));
+	for (i = 0; i < pattern_count; i++)
+		pattern_ptrs[i] = patterns[i];
+
+	/* данные со вставленными образцами, в том числе перекрывающимися, и сериями одной буквы */
+	count = test_below(t, TEST_SIZE_MAX / 8 + 1);
+	test_data(t, t->a, count, lb);
+	for (n = test_below(t, 16); n != 0 && count != 0; n--)
+	{
+		pos = test_below(t, count);
+		i = test_below(t, pattern_count);
+		len = test_below(t, 4) == 0 ? 1 + test_below(t, 3 * lb) : lengths[i];
+		if (len > count - pos)
+			len = count - pos;
+		if (len != lengths[i])
+			memset(t->a + pos, 'A' + (int) test_below(t, 4), len);
+		else
+		{
+			memcpy(t->a + pos, patterns[i], len);
+			pos += 1 + test_below(t, len);
+			i = test_below(t, pattern_count);
+			if (test_below(t, 2) && lengths[i] <= count - pos)
+				memcpy(t->a + pos, patterns[i], lengths[i]);
+		}
+	}
+
+	if (t->verbose)
+		fprintf(stderr, "grep: %zu bytes, line %zu, %zu patterns, context %zu\n",
+			count, lb, pattern_count, gf.context);
+
+	/* эталон: байты вхождений и строки с ними */
+	lines = hex_addr_str64(count, address, lb);
+	hit = (char *) calloc((size_t) lines + 1, 1);
+	row = (char *) malloc(cf.line_length + add_length);
+	memset(&ref, 0, sizeof(ref));
+	memset(&out, 0, sizeof(out));
+	g = hexgrep_create(pattern_ptrs, lengths, pattern_count);
+	t->checks++;
+	if (hit == NULL || row == NULL || g == NULL)
+	{
+		test_fail(t, "grep", "cannot create patterns");
+		free(hit);
+		free(row);
+		hexgrep_destroy(g);
+		return;
+	}
+	memset(t->b, 0, count);
+	for (pos = 0; pos < count; pos++)
+		for (i = 0; i < pattern_count; i++)
+			if (lengths[i] <= count - pos && memcmp(t->a + pos, patterns[i], lengths[i]) == 0)
+			{
+				matches++;
+				memset(t->b + pos, 1, lengths[i]);
+			}
+	for (b = 0; b < count; b++)
+		if (t->b[b])
+			hit[(offset + b) / lb] = 1;
+
+	/* эталон: строки не дальше context от строк с вхождениями, окна через разделитель */
+	for (line = 0; line < lines; line++)
+	{
+		for (m = line > gf.context ? line - gf.context : 0; m <= line + gf.context && m < lines && !hit[m]; m++)
+			;
+		if (m > line + gf.context || m >= lines)
+			continue;
+		if (shown_end == 0 || line != shown_end)
+		{
+			if (shown_end != 0 && gf.separator != NULL)
+			{
+				test_buf_sink(&ref, gf.separator, strlen(gf.separator));
+				test_buf_sink(&ref, insert_str, add_length);
+			}
+			windows++;
+		}
+		shexprnc64_lines(row, t->a, count, address, &cf, insert_str, line, line + 1);
+		lo = line * lb > offset ? (size_t) (line * lb - offset) : 0;
+		hi = (size_t) (line * lb + lb - offset) < count ? (size_t) (line * lb + lb - offset) : count;
+		for (b = lo; b < hi; b++)
+			if (t->b[b])
+				sprn_mark(row, &cf, (size_t) (offset + b - line * lb), gf.mark);
+		test_buf_sink(&ref, row, cf.line_length + add_length);
+		shown++;
+		shown_end = line + 1;
+	}
+
+	gr = stream_hexgrepc(test_buf_sink, &out, t->a, count, address, g, &cf, insert_str, &gf);
+	if (gr.error)
+		test_fail(t, "grep", "search error");
+	else if (gr.match_count != matches)
+		test_fail(t, "grep", "match count differs from brute force");
+	else if (gr.str_count != shown || gr.window_count != windows)
+		test_fail(t, "grep", "lines or windows differ from brute force");
+	else if (gr.char_count != out.used || out.used != ref.used || (ref.used != 0 && memcmp(out.s, ref.s, ref.used) != 0))
+		test_fail(t, "grep", "output differs from brute force");
+	free(out.s);
+	free(ref.s);
+	free(hit);
+	free(row);
+	hexgrep_destroy(g);
+}
+
+/* Эталон текста xxd -p (c == 0) или xxd -i (c != 0) с именем name или без него */
+static void test_xxd(struct Test_Buf *ref, const byte *bytes, size_t count, int c, const char *name)
+{
+	size_t lb = c ? HEXEMIT_C_LINE_BYTES : HEXEMIT_HEX_LINE_BYTES;
+	size_t j;
+	char item[0x100];
+
+	if (c && name != NULL)
+	{
+		snprintf(item, sizeof(item), "unsigned char %s[] = {\n", name);
+		test_buf_sink(ref, item, strlen(item));
+	}
+	for (j = 0; j < count; j++)
+	{
+		if (c)
+			snprintf(item, sizeof(item), "%s0x%02x%s", j % lb == 0 ? "  " : " ", bytes[j],
+				j + 1 == count ? "\n" : (j % lb == lb - 1 ? ",\n" : ","));
+		else
+			snprintf(item, sizeof(item), "%02x%s", bytes[j], j % lb == lb - 1 || j + 1 == count ? "\n" : "");
+		test_buf_sink(ref, item, strlen(item));
+	}
+	if (c && name != NULL)
+	{
+		snprintf(item, sizeof(item), "};\nunsigned int %s_len = %zu;\n", name, count);
+		test_buf_sink(ref, item, strlen(item));
+	}
+}
+
+/* Вывод -F: stream_hexemit_part() частями случайной длины, кратной строке, как при чтении канала,
+сравнивается с эталоном xxd; в первой итерации - еще и с готовым текстом xxd -i */
+static void test_emit(struct Test_Ctx *t)
+{
+	static const char hello_c[] =
+		"unsigned char data[] = {\n"
+		"  0x48, 0x65, 0x6c, 0x6c, 0x6f, 0x2c, 0x20, 0x77, 0x6f, 0x72, 0x6c, 0x64,\n"
+		"  0x21, 0x0a\n"
+		"};\n"
+		"unsigned int data_len = 14;\n";
+	struct Emit_Format ef = ret_default_ef();
+	struct Trans_Result64 tr;
+	struct Test_Buf out, ref;
+	size_t count, pos = 0, part;
+	uint64_t byte_count = 0;
+	int c = test_below(t, 2);
+
+	ef.type = c ? EMIT_C : EMIT_HEX;
+	ef.line_bytes = c ? HEXEMIT_C_LINE_BYTES : HEXEMIT_HEX_LINE_BYTES;
+	ef.lower = 1;
+	ef.name = c && test_below(t, 4) != 0 ? "data" : NULL;
+	count = test_below(t, 4) == 0 ? test_below(t, 2 * ef.line_bytes) : test_below(t, TEST_SIZE_MAX + 1);
+	test_data(t, t->a, count, ef.line_bytes);
+
+	if (t->verbose)
+		fprintf(stderr, "emit: %zu bytes, %s, name %s\n", count, c ? "c" : "hex", ef.name == NULL ? "no" : "yes");
+
+	t->checks++;
+	memset(&out, 0, sizeof(out));
+	memset(&ref, 0, sizeof(ref));
+	test_xxd(&ref, t->a, count, c, ef.name);
+	do
+	{
+		/* часть из целых строк, в том числе пустая; последняя - остаток */
+		part = ef.line_bytes * test_below(t, test_below(t, 2) ? 4 : TEST_SIZE_MAX / ef.line_bytes / 4);
+		if (part >= count - pos)
+			part = count - pos;
+		tr = stream_hexemit_part(test_buf_sink, &out, t->a + pos, part, pos, pos + part < count,
+			&ef, "\n");
+		byte_count += tr.byte_count;
+		pos += part;
+	}
+	while (!tr.error && pos < count);
+	if (tr.error)
+		test_fail(t, "emit", "output error");
+	else if (byte_count != count)
+		test_fail(t, "emit", "bytes are lost or counted twice");
+	else if (out.used != ref.used || (ref.used != 0 && memcmp(out.s, ref.s, ref.used) != 0))
+		test_fail(t, "emit", c ? "output differs from xxd -i" : "output differs from xxd -p");
+	free(out.s);
+	free(ref.s);
+
+	if (t->iteration != 0)
+		return;
+	t->checks++;
+	memset(&out, 0, sizeof(out));
+	ef.type = EMIT_C;
+	ef.line_bytes = HEXEMIT_C_LINE_BYTES;
+	ef.name = "data";
+	tr = stream_hexemit(test_buf_sink, &out, (byte *) "Hello, world!\n", 14, &ef, "\n");
+	if (tr.error || out.used != sizeof(hello_c) - 1 || memcmp(out.s, hello_c, out.used) != 0)
+		test_fail(t, "emit", "output differs from xxd -i text");
+	free(out.s);
+}
+
+/* Многопоточное преобразование shexprnc_mt64() частями на потоках пула */
+static void test_pool(struct Test_Ctx *t)
+{
+	struct Compiled_Format cf;
+	struct Trans_Format tf;
+	struct Trans_Result64 before_tr, tr;
+	size_t count, length;
+	char *ref, *out;
+
+	if (test_format(t, &cf, 0) == NULL)
+		return;
+	tf = cf.tf;
+	tf.color = test_below(t, 4) == 0;  // раскрашенные строки короче отведенного места, как и сжатые
+	if (compile_tf(&cf, &tf) == NULL)
+		return;
+	char *insert_str = test_insert(t);
+	qword address = test_below(t, 4) == 0 ? 0 : (qword) test_rand(&t->x) % 0x100000;
+	count = HEXPOOL_MIN_LINES * (2 + test_below(t, 3)) * cf.line_bytes - test_below(t, cf.line_bytes);
+	test_data(t, t->big, count, cf.line_bytes);
+
+	if (t->verbose)
+		fprintf(stderr, "pool: %zu bytes, line %zu, squeeze %d, color %d\n",
+			count, cf.line_bytes, cf.tf.squeeze, cf.tf.color);
+
+	t->checks++;
+	ref = test_reference(t->big, count, address, &cf, insert_str, &length);
+	before_tr = calc_tr_result64(count, address, &cf.tf, insert_str);
+	out = before_tr.error ? NULL : (char *) malloc((size_t) before_tr.char_count + 1);
+	if (ref == NULL || out == NULL)
+	{
+		test_fail(t, "pool", "reference conversion failed");
+		free(ref);
+		free(out);
+		return;
+	}
+	tr = shexprnc_mt64(t->pool, out, t->big, count, address, &cf, insert_str, before_tr);
+	if (tr.error)
+		test_fail(t, "pool", "conversion error");
+	else if (tr.byte_count != count || tr.char_count != length)
+		test_fail(t, "pool", "result differs from shexprnc64()");
+	else if (memcmp(out, ref, length) != 0)
+		test_fail(t, "pool", "output differs from shexprnc64()");
+
+	/* предварительный результат для большего массива: ошибка без чтения за концом массива */
+	t->checks++;
+	tr = shexprnc_mt64(t->pool, out, t->big, count / 4 + 1, address, &cf, insert_str, before_tr);
+	if (!tr.error)
+		test_fail(t, "pool", "before_tr larger than the array is accepted");
+	free(out);
+	free(ref);
+}
+
+/* вызов всех ядер на текущем уровне векторных расширений */
+static void test_run_kernels(struct Test_Kernel_In *in, struct Test_Kernels *k)
+{
+	static const size_t swap_sizes[TEST_SWAP_SIZES] = { 1, 2, 4, 8 };
+	int e;
+	size_t w;
+
+	memset(k, 0, sizeof(*k));
+	for (e = 0; e < 2; e++)
+	{
+		k->hex_r[e] = bytes_hex(in->bytes, k->hex[e], in->count, e ? BIG_ENDIAN : LITTLE_ENDIAN);
+		k->bin_r[e] = bytes_bin(in->bytes, k->bin[e], in->count, e ? BIG_ENDIAN : LITTLE_ENDIAN);
+	}
+	k->unhex_r = hex_bytes(in->digits, k->unhex, in->count);
+	for (w = 0; w < TEST_SWAP_SIZES; w++)
+		k->swap_r[w] = bytes_swap(in->bytes, k->swap[w], in->count - in->count % swap_sizes[w], swap_sizes[w]);
+	k->print_r = bytes_print(in->bytes, k->print, in->count, '.');
+	k->mismatch = bytes_mismatch(in->bytes, in->other, in->count);
+	k->find = bytes_find(in->bytes, in->count, in->needle, in->needle_length);
+	k->find_any = bytes_find_any(in->bytes, in->count, in->set, in->set_count);
+}
+
+/* Ядра elements на каждом доступном уровне simd_set_level() против скалярного ядра */
+static void test_kernels(struct Test_Ctx *t)
+{
+	static struct Test_Kernel_In in;
+	static struct Test_Kernels scalar, k;
+	size_t j, pos;
+	int level, top = simd_level();
+
+	/* невыровненный массив с сериями повторов: совпадения первого и последнего байта образца */
+	in.count = test_below(t, TEST_KERNEL_MAX + 1);
+	in.bytes = t->a + test_below(t, 0x40);
+	test_data(t, t->a, TEST_KERNEL_MAX + 0x40, 1 + test_below(t, 0x10));
+
+	memcpy(in.other, in.bytes, in.count);
+	if (in.count != 0 && test_below(t, 4) != 0)
+		in.other[test_below(t, in.count)] ^= (byte) (1 + test_below(t, 0xFF));
+
+	/* цифры в верхнем и нижнем регистре, иногда с неверной цифрой */
+	for (j = 0; j < in.count; j++)
+		byte_hex(in.bytes[j], in.digits + j * BYTE_SIZE_IN_TETRAS, BIG_ENDIAN);
+	for (j = 0; j < in.count * BYTE_SIZE_IN_TETRAS; j++)
+		if (in.digits[j] >= 'A' && in.digits[j] <= 'F' && test_below(t, 2))
+			in.digits[j] = (char) (in.digits[j] - 'A' + 'a');
+	if (in.count != 0 && test_below(t, 3) == 0)
+		in.digits[test_below(t, in.count * BYTE_SIZE_IN_TETRAS)] = "g G/:@`"[test_below(t, 7)];
+
+	/* образец из массива или случайный, набор из байт массива или случайный */
+	in.needle_length = 1 + test_below(t, sizeof(in.needle));
+	pos = in.count > in.needle_length ? test_below(t, in.count - in.needle_length + 1) : 0;
+	for (j = 0; j < in.needle_length; j++)
+		in.needle[j] = test_below(t, 4) != 0 && pos + j < in.count ? in.bytes[pos + j] : (byte) test_rand(&t->x);
+	in.set_count = 1 + test_below(t, BYTES_SET_MAX);
+	for (j = 0; j < in.set_count; j++)
+		in.set[j] = test_below(t, 2) && in.count != 0 ? in.bytes[test_below(t, in.count)] : (byte) test_rand(&t->x);
+
+	if (t->verbose)
+		fprintf(stderr, "kernels: %zu bytes, levels up to %s\n", in.count, simd_level_name(top));
+
+	simd_set_level(SIMD_SCALAR);
+	test_run_kernels(&in, &scalar);
+	for (level = SIMD_SCALAR + 1; level <= top; level++)
+	{
+		t->checks++;
+		simd_set_level(level);
+		test_run_kernels(&in, &k);
+		if (memcmp(k.hex, scalar.hex, sizeof(k.hex)) != 0 || memcmp(k.hex_r, scalar.hex_r, sizeof(k.hex_r)) != 0)
+			test_fail(t, simd_level_name(level), "bytes_hex() differs from scalar");
+		else if (memcmp(k.bin, scalar.bin, sizeof(k.bin)) != 0 || memcmp(k.bin_r, scalar.bin_r, sizeof(k.bin_r)) != 0)
+			test_fail(t, simd_level_name(level), "bytes_bin() differs from scalar");
+		else if (memcmp(k.unhex, scalar.unhex, sizeof(k.unhex)) != 0 || k.unhex_r != scalar.unhex_r)
+			test_fail(t, simd_level_name(level), "hex_bytes() differs from scalar");
+		else if (memcmp(k.swap, scalar.swap, sizeof(k.swap)) != 0 || memcmp(k.swap_r, scalar.swap_r, sizeof(k.swap_r)) != 0)
+			test_fail(t, simd_level_name(level), "bytes_swap() differs from scalar");
+		else if (memcmp(k.print, scalar.print, sizeof(k.print)) != 0 || k.print_r != scalar.print_r)
+			test_fail(t, simd_level_name(level), "bytes_print() differs from scalar");
+		else if (k.mismatch != scalar.mismatch)
+			test_fail(t, simd_level_name(level), "bytes_mismatch() differs from scalar");
+		else if (k.find != scalar.find)
+			test_fail(t, simd_level_name(level), "bytes_find() differs from scalar");
+		else if (k.find_any != scalar.find_any)
+			test_fail(t, simd_level_name(level), "bytes_find_any() differs from scalar");
+	}
+	simd_set_level(top);
+}
+
+static void usage(FILE *fp)
+{
+	fprintf(fp,
+		"Usage: hexprn_test [options]\n"
+		"Check the pipeline, parser, diff, grep and pool paths against serial shexprnc64(),\n"
+		"the -F output against the xxd text and the SIMD kernels against the scalar ones\n"
+		"on random data.\n"
+		"  -n count   iterations (default 300)\n"
+		"  -s seed    seed of the first iteration (default 1), iteration i uses seed + i\n"
+		"  -v         print the parameters of each check\n"
+		"  -h         show this help\n");
+}
+
+static int parse_options(int argc, char **argv, struct Test_Options *opt)
+{
+	char *end;
+	int c;
+	opt->iterations = 300;
+	opt->seed = 1;
+	opt->verbose = 0;
+
+	while ((c = getopt(argc, argv, "n:s:vh")) != -1)
+	{
+		switch (c)
+		{
+		case 'n':
+			opt->iterations = strtoul(optarg, &end, 0);
+			if (*end != '\0' || end == optarg)
+			{
+				fprintf(stderr, "hexprn_test: invalid count '%s'\n", optarg);
+				return -1;
+			}
+			break;
+		case 's':
+			opt->seed = strtoull(optarg, &end, 0);
+			if (*end != '\0' || end == optarg)
+			{
+				fprintf(stderr, "hexprn_test: invalid seed '%s'\n", optarg);
+				return -1;
+			}
+			break;
+		case 'v': opt->verbose = 1; break;
+		case 'h': usage(stdout); exit(0);
+		default: usage(stderr); return -1;
+		}
+	}
+	if (optind < argc)
+	{
+		usage(stderr);
+		return -1;
+	}
+	return 0;
+}
+
+int main(int argc, char **argv)
+{
+	struct Test_Options opt;
+	struct Test_Ctx t;
+	unsigned long i;
+
+	if (parse_options(argc, argv, &opt) < 0)
+		return 2;
+
+	/* запись в канал после ошибки конвейера не завершает программу */
+	signal(SIGPIPE, SIG_IGN);
+
+	memset(&t, 0, sizeof(t));
+	t.verbose = opt.verbose;
+	t.a = (byte *) malloc(TEST_SIZE_MAX);
+	t.b = (byte *) malloc(TEST_SIZE_MAX + TEST_EDITS_MAX * 2 * HEXPRN_LINE_BYTES_MAX);
+	t.big = (byte *) malloc(TEST_POOL_SIZE);
+	t.pool = hexprn_pool_create(TEST_POOL_THREADS, 0);
+	if (t.a == NULL || t.b == NULL || t.big == NULL || t.pool == NULL)
+	{
+		fprintf(stderr, "hexprn_test: out of memory\n");
+		return 1;
+	}
+
+	for (i = 0; i < opt.iterations; i++)
+	{
+		/* зерно итерации: ошибка повторяется запуском с -s seed -n 1 */
+		t.iteration = i;
+		t.seed = opt.seed + i;
+		t.x = t.seed * 0x9E3779B97F4A7C15ULL | 1;
+		test_pipe(&t);
+		test_parse(&t);
+		test_diff(&t);
+		test_grep(&t);
+		test_emit(&t);
+		test_pool(&t);
+		test_kernels(&t);
+	}
+
+	printf("hexprn_test: %lu checks, %lu failed\n", t.checks, t.failures);
+	hexprn_pool_destroy(t.pool);
+	free(t.a);
+	free(t.b);
+	free(t.big);
+	return t.failures != 0;
+}
@@ -0,0 +1,108 @@
+/*
+	hexprn_test_hpp.cpp
+	Программа hexprn_test_hpp: проверка интерфейса C++20 hexprn.hpp по библиотеке на C
+
+Для нескольких форматов, заданных параметром шаблона, текст hexprn_cpp::to_string<F>()
+и строки hexprn_cpp::lines<F>() сравниваются с shexprnf() того же формата (to_trans_format())
+на псевдослучайных непустых массивах с адресами, не кратными длине строки.
+Ошибки выводятся в stderr с именем формата, длиной и адресом, программа возвращает 1.
+*/
+#include <cstdio>
+#include <cstdint>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "hexprn.hpp"
+
+/* число массивов на формат и наибольшая длина массива в строках */
+#define TEST_HPP_ITERATIONS 300
+#define TEST_HPP_LINES_MAX 8
+
+/* состояние проверки */
+struct Test_Hpp_Ctx
+{
+	unsigned long long x;     // состояние генератора xorshift
+	unsigned long checks;     // выполнено проверок
+	unsigned long failures;   // из них с ошибкой
+};
+
+/* псевдослучайное число xorshift */
+static unsigned long long test_rand(Test_Hpp_Ctx &t)
+{
+	t.x ^= t.x << 13; t.x ^= t.x >> 7; t.x ^= t.x << 17;
+	return t.x;
+}
+
+/* сообщение об ошибке проверки */
+static void test_fail(Test_Hpp_Ctx &t, const char *name, std::size_t count, word address, const char *what)
+{
+	t.failures++;
+	std::fprintf(stderr, "hexprn_test_hpp: %s: %zu bytes at 0x%lx: %s\n", name, count, (unsigned long) address, what);
+}
+
+/* Проверка формата F: to_string<F>() и lines<F>() против shexprnf() с добавочной строкой "\n" */
+template <hexprn_cpp::format F>
+static void test_format(Test_Hpp_Ctx &t, const char *name)
+{
+	Trans_Format tf = hexprn_cpp::to_trans_format(F);
+	char insert_str[] = "\n";
+
+	for (int i = 0; i < TEST_HPP_ITERATIONS; i++)
+	{
+		std::size_t count = 1 + test_rand(t) % (TEST_HPP_LINES_MAX * F.line_bytes);
+		word address = (word) (test_rand(t) % 0x100000);
+		std::vector<byte> bytes(count);
+		for (byte &b : bytes)
+			b = (byte) test_rand(t);
+		auto span = std::as_bytes(std::span(bytes));
+
+		/* эталон библиотеки на C */
+		t.checks++;
+		Trans_Result tr = calc_tr_result(count, address, &tf, insert_str);
+		if (tr.char_count <= 0)
+		{
+			test_fail(t, name, count, address, "calc_tr_result() error");
+			continue;
+		}
+		std::string ref((std::size_t) tr.char_count, '\0');
+		tr = shexprnf(ref.data(), bytes.data(), count, address, &tf, insert_str, tr);
+		if (tr.char_count < 0)
+		{
+			test_fail(t, name, count, address, "shexprnf() error");
+			continue;
+		}
+		ref.resize((std::size_t) tr.char_count);
+
+		if (hexprn_cpp::to_string<F>(span, address) != ref)
+			test_fail(t, name, count, address, "to_string() differs from shexprnf()");
+
+		t.checks++;
+		std::string joined;
+		for (std::string_view line : hexprn_cpp::lines<F>(span, address))
+		{
+			joined += line;
+			joined += insert_str;
+		}
+		if (joined != ref)
+			test_fail(t, name, count, address, "lines() differ from shexprnf()");
+	}
+}
+
+int main()
+{
+	Test_Hpp_Ctx t{ 0x9E3779B97F4A7C15ULL, 0, 0 };
+
+	test_format<hexprn_cpp::format{}>(t, "default");
+	test_format<hexprn_cpp::format{ .line_bytes = 8, .hex_block_length = 4 }>(t, "line 8");
+	test_format<hexprn_cpp::format{ .prn_address = false, .line_bytes = 12, .hex_block_length = 5,
+		.ascii_char_delimeter = ' ', .ascii_block_delimeter = '|', .ascii_block_length = 3 }>(t, "no address");
+	test_format<hexprn_cpp::format{ .address_digits = 4, .binary = true, .tetra_delimeter = '_',
+		.hex_block_length = 0 }>(t, "binary");
+	test_format<hexprn_cpp::format{ .address_digits = 12, .line_bytes = 7, .hex_char_delimeter = '\0',
+		.hex_block_delimeter = ',', .hex_block_length = 7, .non_print_char = '~' }>(t, "line 7");
+
+	std::printf("hexprn_test_hpp: %lu checks, %lu failed\n", t.checks, t.failures);
+	return t.failures != 0;
+}